@@ -0,0 +1,76 @@
+#include "./bitboard.h"
+#include "./utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WORD_BITS 64
+
+static uint64_t *get_row(const bitboard *bb, TILE t, int y) {
+    return bb->bits + ((size_t)t * bb->dim.height + y) * bb->words_per_row;
+}
+
+static void set_bit(bitboard *bb, TILE t, int x, int y) {
+    get_row(bb, t, y)[x / WORD_BITS] |= (uint64_t)1 << (x % WORD_BITS);
+}
+
+static void clear_bit(bitboard *bb, TILE t, int x, int y) {
+    get_row(bb, t, y)[x / WORD_BITS] &= ~((uint64_t)1 << (x % WORD_BITS));
+}
+
+bitboard *create_bitboard(const board *b) {
+    bitboard *bb = malloc(sizeof(bitboard));
+    RETURN_NULL_IF_NULL_PERROR(bb, "malloc bitboard");
+
+    bb->dim = b->dim;
+    bb->words_per_row = (b->dim.width + WORD_BITS - 1) / WORD_BITS;
+    bb->bits = calloc((size_t)NB_TILES * b->dim.height * bb->words_per_row, sizeof(uint64_t));
+    if (bb->bits == NULL) {
+        perror("calloc bitboard");
+        free(bb);
+        return NULL;
+    }
+
+    for (int y = 0; y < b->dim.height; y++) {
+        for (int x = 0; x < b->dim.width; x++) {
+            TILE t = b->grid[coord_to_int_dim(x, y, b->dim)];
+            if (t < NB_TILES) {
+                set_bit(bb, t, x, y);
+            }
+        }
+    }
+    return bb;
+}
+
+void free_bitboard(bitboard *bb) {
+    RETURN_IF_NULL(bb);
+    free(bb->bits);
+    free(bb);
+}
+
+void bitboard_set_tile(bitboard *bb, int x, int y, TILE old_tile, TILE new_tile) {
+    if (old_tile < NB_TILES) {
+        clear_bit(bb, old_tile, x, y);
+    }
+    if (new_tile < NB_TILES) {
+        set_bit(bb, new_tile, x, y);
+    }
+}
+
+uint64_t bitboard_row_window(const bitboard *bb, TILE t, int x, int y) {
+    if (y < 0 || y >= bb->dim.height || x >= bb->dim.width || x <= -WORD_BITS) {
+        return 0;
+    }
+    if (x < 0) {
+        return bitboard_row_window(bb, t, 0, y) << -x;
+    }
+
+    const uint64_t *row = get_row(bb, t, y);
+    int word = x / WORD_BITS;
+    int offset = x % WORD_BITS;
+    uint64_t window = row[word] >> offset;
+    if (offset != 0 && word + 1 < bb->words_per_row) {
+        window |= row[word + 1] << (WORD_BITS - offset);
+    }
+    return window;
+}
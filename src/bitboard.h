@@ -0,0 +1,35 @@
+#ifndef SRC_BITBOARD_H_
+#define SRC_BITBOARD_H_
+
+#include "./model.h"
+
+#include <stdint.h>
+
+#define NB_TILES (HORIZONTAL_BORDER + 1)
+
+/** Bitboard of a board: for every tile type, one bitset per row where the bit x is set if the tile (x, y) has this
+ *  type. It is kept alongside the grid of the board so that the tiles around a position can be read with a few word
+ *  operations instead of a get_grid per tile.
+ */
+typedef struct bitboard {
+    dimension dim;
+    int words_per_row;
+    uint64_t *bits; // NB_TILES * dim.height * words_per_row words
+} bitboard;
+
+/** Creates the bitboard of the current content of the board
+ */
+bitboard *create_bitboard(const board *);
+
+void free_bitboard(bitboard *);
+
+/** Moves the bit of the tile (x, y) from the layer of old_tile to the layer of new_tile
+ */
+void bitboard_set_tile(bitboard *, int x, int y, TILE old_tile, TILE new_tile);
+
+/** Returns the bits of the 64 tiles (x, y) to (x + 63, y) with the given type, the bit i being the tile (x + i, y).
+ *  x can be negative and the tiles outside the board are never set.
+ */
+uint64_t bitboard_row_window(const bitboard *, TILE, int x, int y);
+
+#endif // SRC_BITBOARD_H_
@@ -0,0 +1,56 @@
+#ifndef SRC_BOARD_VIEW_H_
+#define SRC_BOARD_VIEW_H_
+
+#include "./model.h"
+
+#include <stdbool.h>
+
+/** Tiles of a board read and written through its pointer, for the code going over many tiles of a game, which looks
+ *  the game up once instead of once per tile. The unchecked functions expect a position inside the board, the checked
+ *  ones accept any position.
+ */
+
+/** Returns true if (x, y) is inside the board
+ */
+static inline bool board_contains(const board *b, int x, int y) {
+    return x >= 0 && x < b->dim.width && y >= 0 && y < b->dim.height;
+}
+
+/** Returns the index in the grid of the position (x, y)
+ */
+static inline int board_index(const board *b, int x, int y) {
+    return y * b->dim.width + x;
+}
+
+/** Returns the position of the index i of the grid
+ */
+static inline coord board_coord(const board *b, int i) {
+    coord c = {i % b->dim.width, i / b->dim.width};
+    return c;
+}
+
+static inline TILE board_get_unchecked(const board *b, int x, int y) {
+    return (TILE)b->grid[board_index(b, x, y)];
+}
+
+static inline void board_set_unchecked(board *b, int x, int y, TILE t) {
+    b->grid[board_index(b, x, y)] = t;
+}
+
+/** Returns the tile at (x, y), or INDESTRUCTIBLE_WALL outside the board, which nothing goes through
+ */
+static inline TILE board_get(const board *b, int x, int y) {
+    return board_contains(b, x, y) ? board_get_unchecked(b, x, y) : INDESTRUCTIBLE_WALL;
+}
+
+/** Sets the tile at (x, y), returns false without changing anything if it is outside the board
+ */
+static inline bool board_set(board *b, int x, int y, TILE t) {
+    if (!board_contains(b, x, y)) {
+        return false;
+    }
+    board_set_unchecked(b, x, y, t);
+    return true;
+}
+
+#endif // SRC_BOARD_VIEW_H_
@@ -110,7 +110,7 @@ void add_to_line(chat *chat, char c) {
 }
 
 chat_node *create_chat_node(int sender, char msg[TEXT_SIZE], bool whispered) {
-    if (sender < 0 || sender >= PLAYER_NUM) {
+    if (sender < 0 || sender >= MAX_PLAYER_NUM) {
         return NULL;
     }
 
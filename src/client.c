@@ -4,6 +4,7 @@
 #include <unistd.h>
 
 #include "controller.h"
+#include "netem.h"
 #include "network_client.h"
 #include "utils.h"
 
@@ -15,6 +16,9 @@
 typedef struct flags {
     char *mode;
     char *port;
+    char *multicast_interface;
+    char *version;
+    char *capabilities;
 } flags;
 
 static GAME_MODE choosen_game_mode;
@@ -30,6 +34,9 @@ int init_client_flags() {
     RETURN_FAILURE_IF_NULL(client_flags);
     client_flags->mode = NULL;
     client_flags->port = NULL;
+    client_flags->multicast_interface = NULL;
+    client_flags->version = NULL;
+    client_flags->capabilities = NULL;
 
     return EXIT_SUCCESS;
 }
@@ -40,6 +47,12 @@ void parse_client_flags(int argc, char *argv[]) {
             client_flags->port = argv[i];
         } else if (strcmp(argv[i - 1], "-m") == 0) {
             client_flags->mode = argv[i];
+        } else if (strcmp(argv[i - 1], "-i") == 0) {
+            client_flags->multicast_interface = argv[i];
+        } else if (strcmp(argv[i - 1], "-V") == 0) {
+            client_flags->version = argv[i];
+        } else if (strcmp(argv[i - 1], "-C") == 0) {
+            client_flags->capabilities = argv[i];
         }
     }
 }
@@ -131,6 +144,26 @@ int try_to_init_port_and_connect_client() {
 }
 
 int try_to_init_client() {
+    if (client_flags->multicast_interface != NULL &&
+        set_multicast_interface(client_flags->multicast_interface) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    if (client_flags->version != NULL) {
+        int version = parse_unsigned_within_bounds(client_flags->version, PROTOCOL_V1, PROTOCOL_V2);
+        if (version < 0) {
+            printf("Your version argument is not valid, it has to be between %d and %d.\n", PROTOCOL_V1, PROTOCOL_V2);
+            return EXIT_FAILURE;
+        }
+        set_protocol_version(version);
+    }
+    if (client_flags->capabilities != NULL) {
+        int announced = parse_unsigned_within_bounds(client_flags->capabilities, NO, YES);
+        if (announced < 0) {
+            printf("Your capabilities argument is not valid, it has to be between %d and %d.\n", NO, YES);
+            return EXIT_FAILURE;
+        }
+        set_capabilities_announced(announced == YES);
+    }
     int r = try_to_init_mode_client();
 
     if (r != EXIT_SUCCESS) {
@@ -150,6 +183,7 @@ int be_ready() {
 }
 
 int main(int argc, char *argv[]) {
+    RETURN_FAILURE_IF_ERROR(netem_configure_from_env());
     RETURN_FAILURE_IF_ERROR(init_client_flags());
     parse_client_flags(argc, argv);
     int r = try_to_init_client();
@@ -21,10 +21,29 @@ int send_connexion_header_raw(int sock, connection_header_raw *serialized_head)
     return EXIT_SUCCESS;
 }
 
-int send_initial_connexion_information(int sock, GAME_MODE mode) {
+int send_tcp(int sock, const void *buffer, uint8_t size) {
+    unsigned sent = 0;
+    while (sent < size) {
+        int res = send(sock, (char *)buffer + sent, size - sent, 0);
+        if (res < 0) {
+            perror("send tcp");
+            return EXIT_FAILURE;
+        }
+        if (res == 0) {
+            perror("send tcp: connection closed");
+            return EXIT_FAILURE;
+        }
+        sent += res;
+    }
+    return EXIT_SUCCESS;
+}
+
+int send_initial_connexion_information(int sock, GAME_MODE mode, PROTOCOL_VERSION version, const capabilities *caps) {
     initial_connection_header *head = malloc(sizeof(initial_connection_header));
     RETURN_FAILURE_IF_NULL_PERROR(head, "malloc initial_connection_header");
     head->game_mode = mode;
+    head->version = version;
+    head->capabilities = caps != NULL;
 
     connection_header_raw *serialized_head = serialize_initial_connection(head);
     free(head);
@@ -32,7 +51,14 @@ int send_initial_connexion_information(int sock, GAME_MODE mode) {
     RETURN_FAILURE_IF_NULL(serialized_head);
     int res = send_connexion_header_raw(sock, serialized_head);
     free(serialized_head);
+    if (res == EXIT_FAILURE || caps == NULL) {
+        return res;
+    }
 
+    char *serialized_caps = serialize_capabilities(caps);
+    RETURN_FAILURE_IF_NULL(serialized_caps);
+    res = send_tcp(sock, serialized_caps, CAPABILITIES_SIZE);
+    free(serialized_caps);
     return res;
 }
 
@@ -53,23 +79,6 @@ int send_ready_connexion_information(int sock, GAME_MODE mode, int id, int eq) {
     return res;
 }
 
-int send_tcp(int sock, const void *buffer, uint8_t size) {
-    unsigned sent = 0;
-    while (sent < size) {
-        int res = send(sock, (char *)buffer + sent, size - sent, 0);
-        if (res < 0) {
-            perror("send tcp");
-            return EXIT_FAILURE;
-        }
-        if (res == 0) {
-            perror("send tcp: connection closed");
-            return EXIT_FAILURE;
-        }
-        sent += res;
-    }
-    return EXIT_SUCCESS;
-}
-
 int send_chat_message(int sock, chat_message_type type, int id, int eq, uint8_t message_length, char *message) {
     chat_message *msg = malloc(sizeof(chat_message));
     RETURN_FAILURE_IF_NULL_PERROR(msg, "malloc chat_message");
@@ -99,95 +108,67 @@ int send_chat_message(int sock, chat_message_type type, int id, int eq, uint8_t
     return res;
 }
 
-connection_information_raw *recv_connexion_information_raw(int sock) {
-    connection_information_raw *head = malloc(sizeof(connection_information_raw));
-    RETURN_NULL_IF_NULL_PERROR(head, "malloc connection_information_raw");
-    unsigned received = 0;
-    while (received < sizeof(connection_information_raw)) {
-        int res = recv(sock, head + received, sizeof(connection_information_raw) - received, 0);
-
-        if (res < 0) {
-            perror("recv connection_information_raw");
-            free(head);
-            return NULL;
-        }
-        received += res;
+connection_information *recv_connexion_information(tcp_reader *reader) {
+    const char *message;
+    size_t size;
+    if (tcp_reader_wait_next(reader, &message, &size) != 1) {
+        return NULL;
     }
-    return head;
-}
-
-connection_information *recv_connexion_information(int sock) {
-    connection_information_raw *head = recv_connexion_information_raw(sock);
-    RETURN_NULL_IF_NULL(head);
-    connection_information *deserialized_head = deserialize_connection_information(head);
-    free(head);
-    return deserialized_head;
+    connection_information_raw head;
+    memcpy(&head, message, sizeof(connection_information_raw));
+    return deserialize_connection_information(&head);
 }
 
-int recv_tcp(int sock, void *buffer, int size) {
-    int received = 0;
-    while (received < size) {
-        int res = recv(sock, (char *)buffer + received, size - received, 0);
-        if (res < 0) {
-            perror("recv tcp");
-            return EXIT_FAILURE;
-        }
-        if (res == 0) {
-            perror("recv tcp: connection closed");
-            return EXIT_FAILURE;
-        }
-        received += res;
+/** Waits for the next message of the reader for CAPABILITIES_TIMEOUT_MS, returns 1 if it has the code, 0 if it has
+ *  another one, left to the reader, or none came, and -1 if the connection failed
+ */
+static int recv_message_of_code(tcp_reader *reader, int code, const char **message, size_t *size) {
+    int res = tcp_reader_wait_next_timeout(reader, message, size, CAPABILITIES_TIMEOUT_MS);
+    if (res != 1) {
+        return res;
     }
-    return EXIT_SUCCESS;
+    uint16_t header;
+    memcpy(&header, *message, sizeof(uint16_t));
+    if (message_code(header) == code) {
+        return 1;
+    }
+    tcp_reader_unread(reader, *size);
+    return 0;
 }
 
-chat_message *recv_chat_message(int sock, uint16_t header) {
-    uint8_t length;
-    int res = recv_tcp(sock, &length, sizeof(uint8_t));
-    RETURN_NULL_IF_NEG_PERROR(res, "recv chat_message length");
-
-    char *message = malloc(length + 1);
-    RETURN_NULL_IF_NULL_PERROR(message, "malloc chat_message message");
-    res = recv_tcp(sock, message, length * sizeof(char));
+int recv_capabilities(tcp_reader *reader, capabilities *caps, uint64_t *token) {
+    const char *message;
+    size_t size;
+    *token = 0;
+    int res = recv_message_of_code(reader, CAPABILITIES_CODE, &message, &size);
     if (res < 0) {
-        perror("recv chat_message message");
-        free(message);
-        return NULL;
+        return EXIT_FAILURE;
     }
-
-    // Allocate memory for the total received message
-    char *total_received = malloc(3 + length);
-    if (total_received == NULL) {
-        perror("malloc chat_message total_received");
-        free(message);
-        return NULL;
+    if (res == 0) {
+        caps->flags = 0;
+        return EXIT_SUCCESS;
     }
+    RETURN_FAILURE_IF_ERROR(read_capabilities(message, size, caps));
 
-    // Copy the header, length and message into the total_received buffer
-    memcpy(total_received, &header, 2);
-    memcpy(total_received + 2, &length, 1);
-    memcpy(total_received + 3, message, length);
-
-    chat_message *msg = server_deserialize_chat_message(total_received);
-
-    if (msg == NULL) {
-        perror("deserialize chat_message");
-        free(total_received);
-        free(message);
-        return NULL;
+    res = recv_message_of_code(reader, SUBSCRIPTION_TOKEN_CODE, &message, &size);
+    if (res < 0) {
+        return EXIT_FAILURE;
     }
-    free(total_received);
-    free(message);
+    return res == 0 ? EXIT_SUCCESS : read_subscription_token(message, size, token);
+}
 
-    return msg;
+int send_keyframe_request(int sock, int id, int eq) {
+    message_header head = {KEYFRAME_REQUEST_CODE, id, eq};
+    uint16_t serialized_head = serialize_message_header(&head);
+    return send_tcp(sock, &serialized_head, sizeof(uint16_t));
 }
 
-u_int16_t recv_header(int sock) {
-    uint16_t header;
-    int res = recv_tcp(sock, &header, sizeof(uint16_t));
-    if (res < 0) {
-        perror("recv header");
-        return 0;
-    }
-    return header;
+int send_unicast_subscription(int sock, const struct sockaddr_in6 *addr, const subscription_message *subscription) {
+    char *serialized = serialize_subscription(subscription);
+    RETURN_FAILURE_IF_NULL(serialized);
+    ssize_t res = sendto(sock, serialized, UDP_SUBSCRIBE_SIZE, 0, (const struct sockaddr *)addr,
+                         sizeof(struct sockaddr_in6));
+    free(serialized);
+    RETURN_FAILURE_IF_NEG_PERROR(res, "sendto subscription");
+    return EXIT_SUCCESS;
 }
@@ -6,14 +6,32 @@
 
 #include "./messages.h"
 #include "./model.h"
+#include "./tcp_reader.h"
 
-int send_initial_connexion_information(int sock, GAME_MODE mode);
+/** Asks to join a game of the mode, with the highest version of the protocol the client supports and its capabilities,
+ *  which can be NULL to announce none
+ */
+int send_initial_connexion_information(int sock, GAME_MODE mode, PROTOCOL_VERSION version, const capabilities *caps);
 int send_ready_connexion_information(int sock, GAME_MODE mode, int id, int eq);
 int send_chat_message(int sock, chat_message_type type, int id, int eq, uint8_t message_length, char *message);
+int send_keyframe_request(int sock, int id, int eq);
+/** Asks the server, at the UDP port addr of the game, for the messages of the game, or only its pings, at the address
+ *  of sock
+ */
+int send_unicast_subscription(int sock, const struct sockaddr_in6 *addr, const subscription_message *subscription);
 
-connection_information *recv_connexion_information(int sock);
+/** Receives the connection information with the reader of the connection, which keeps what is received after it
+ */
+connection_information *recv_connexion_information(tcp_reader *reader);
 
-chat_message *recv_chat_message(int sock, u_int16_t header);
-u_int16_t recv_header(int sock);
+#define CAPABILITIES_TIMEOUT_MS 1000 // The server answers right after the connection information
+
+/** Receives the capabilities chosen by the server, which follow the connection information when the client announced
+ *  its own, and the token of the subscriptions which follows them. A server which does not know them answers nothing:
+ *  if the next message is not capabilities, or none comes within CAPABILITIES_TIMEOUT_MS, the flags of caps are
+ *  cleared and the message is left to the reader. token is 0 when the server sent none. Returns EXIT_FAILURE if the
+ *  connection fails or the capabilities are not valid.
+ */
+int recv_capabilities(tcp_reader *reader, capabilities *caps, uint64_t *token);
 
 #endif // SRC_COMMUNICATION_CLIENT_H_
@@ -1,6 +1,8 @@
 #include "communication_server.h"
+#include "log.h"
 #include "messages.h"
 #include "model.h"
+#include "netem.h"
 #include "utils.h"
 
 #include <netinet/in.h>
@@ -17,7 +19,7 @@ int send_connexion_information_raw(int sock, connection_information_raw *seriali
         int res = send(sock, data + sent, sizeof(connection_information_raw) - sent, 0);
 
         if (res < 0) {
-            perror("send connection_information");
+            LOG_ERRNO("send connection_information");
             return EXIT_FAILURE;
         }
         sent += res;
@@ -25,11 +27,12 @@ int send_connexion_information_raw(int sock, connection_information_raw *seriali
     return EXIT_SUCCESS;
 }
 
-int send_connexion_information(int sock, GAME_MODE mode, int id, int eq, int portudp, int portmdiff,
-                               uint16_t adrmdiff[8]) {
+int send_connexion_information(int sock, GAME_MODE mode, PROTOCOL_VERSION version, int id, int eq, int portudp,
+                               int portmdiff, uint16_t adrmdiff[8]) {
     connection_information *head = malloc(sizeof(connection_information));
     RETURN_FAILURE_IF_NULL_PERROR(head, "malloc connection_information");
     head->game_mode = mode;
+    head->version = version;
     head->id = id;
     head->eq = eq;
     head->portudp = portudp;
@@ -47,64 +50,151 @@ int send_connexion_information(int sock, GAME_MODE mode, int id, int eq, int por
 
     return res;
 }
-int send_string_to_clients_multicast(int sock, struct sockaddr_in6 *addr_mult, char *message, size_t message_length) {
-    int a;
-    if ((a = sendto(sock, message, message_length, 0, (struct sockaddr *)addr_mult, sizeof(struct sockaddr_in6))) < 0) {
+int send_capabilities(int sock, const capabilities *caps) {
+    char *serialized = serialize_capabilities(caps);
+    RETURN_FAILURE_IF_NULL(serialized);
+    unsigned sent = 0;
+    while (sent < CAPABILITIES_SIZE) {
+        int res = send(sock, serialized + sent, CAPABILITIES_SIZE - sent, 0);
+        if (res < 0) {
+            LOG_ERRNO("send capabilities");
+            free(serialized);
+            return EXIT_FAILURE;
+        }
+        sent += res;
+    }
+    free(serialized);
+    return EXIT_SUCCESS;
+}
+
+int send_string_to_clients_multicast(int sock, netem_link *link, struct sockaddr_in6 *addr_mult, char *message,
+                                     size_t message_length) {
+    struct sockaddr *addr = (struct sockaddr *)addr_mult;
+    if (netem_sendto(link, sock, message, message_length, addr, sizeof(struct sockaddr_in6)) < 0) {
         return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
 }
 
-int send_game_board(int sock, struct sockaddr_in6 *addr_mult, uint16_t num, board *board_) {
+int send_string_to_clients_unicast(int sock, netem_link *link, const struct sockaddr_in6 *addrs, unsigned nb,
+                                   char *message, size_t message_length) {
+    int res = netem_sendto_all(link, sock, message, message_length, addrs, nb);
+    if (res < 0) {
+        LOG_ERRNO("sendmmsg unicast");
+    }
+    return res;
+}
+
+int send_strings_to_clients_unicast(int sock, netem_link *link, const struct iovec *messages,
+                                    const struct sockaddr_in6 *addrs, unsigned nb) {
+    int res = netem_sendto_each(link, sock, messages, addrs, nb);
+    if (res < 0) {
+        LOG_ERRNO("sendmmsg unicast");
+    }
+    return res;
+}
+
+static game_board_information *create_game_board_information(uint16_t num, board *board_) {
     game_board_information *head = malloc(sizeof(game_board_information));
-    RETURN_FAILURE_IF_NULL(head);
+    RETURN_NULL_IF_NULL(head);
 
     head->num = num;
     head->width = board_->dim.width;
     head->height = board_->dim.height;
     head->board = malloc(head->width * head->height * sizeof(TILE));
+    if (head->board == NULL) {
+        free(head);
+        return NULL;
+    }
 
     for (unsigned i = 0; i < head->width * head->height; i++) {
         head->board[i] = board_->grid[i];
     }
+    return head;
+}
+
+char *create_game_board(uint16_t num, board *board_, size_t *size) {
+    game_board_information *head = create_game_board_information(num, board_);
+    RETURN_NULL_IF_NULL(head);
 
     char *serialized_head = serialize_game_board(head);
-    free(head->board);
-    free(head);
+    free_game_board_information(head);
+    RETURN_NULL_IF_NULL(serialized_head);
+
+    *size = game_board_size(serialized_head);
+    return serialized_head;
+}
+
+int send_game_board(int sock, struct sockaddr_in6 *addr_mult, uint16_t num, board *board_) {
+    size_t size;
+    char *serialized_head = create_game_board(num, board_, &size);
     RETURN_FAILURE_IF_NULL(serialized_head);
 
-    size_t len_serialized_head = 6 + board_->dim.width * board_->dim.height;
+    int res = send_string_to_clients_multicast(sock, NULL, addr_mult, serialized_head, size);
+    free(serialized_head);
+    return res;
+}
+
+char *create_game_board_keyframe(uint16_t num, board *board_, size_t *size) {
+    game_board_information *head = create_game_board_information(num, board_);
+    RETURN_NULL_IF_NULL(head);
+
+    char *serialized_head = serialize_game_board_keyframe(head);
+    free_game_board_information(head);
+    RETURN_NULL_IF_NULL(serialized_head);
 
-    return send_string_to_clients_multicast(sock, addr_mult, serialized_head, len_serialized_head);
+    *size = game_board_size(serialized_head);
+    return serialized_head;
 }
 
-int send_game_update(int sock, struct sockaddr_in6 *addr_mult, int num, tile_diff *diff, uint8_t nb) {
-    game_board_update *head = malloc(sizeof(game_board_update));
-    RETURN_FAILURE_IF_NULL(head);
+char *create_game_board_region(uint16_t num, board *board_, const interest_window *window, size_t *size) {
+    return serialize_game_board_region(num, board_, window->x, window->y, window->width, window->height, size);
+}
 
-    head->num = num;
-    head->diff = diff;
-    head->nb = nb;
+int send_ping_to_clients(int sock, netem_link *link, const struct sockaddr_in6 *addrs, unsigned nb) {
+    char *ping = serialize_ping(get_wall_time_us());
+    if (ping == NULL) {
+        return -1;
+    }
+    int res = send_string_to_clients_unicast(sock, link, addrs, nb, ping, PING_SIZE);
+    free(ping);
+    return res;
+}
 
-    char *serialized_head = serialize_game_board_update(head);
-    free(head);
+char *create_game_update(uint16_t num, tile_diff *diff, uint16_t nb, size_t *size) {
+    game_board_update head;
+    head.num = num;
+    head.diff = diff;
+    head.nb = nb;
+
+    char *serialized_head = serialize_game_board_update(&head);
+    RETURN_NULL_IF_NULL(serialized_head);
+
+    *size = game_board_update_size(serialized_head);
+    return serialized_head;
+}
+
+int send_game_update(int sock, struct sockaddr_in6 *addr_mult, int num, tile_diff *diff, uint16_t nb) {
+    size_t size;
+    char *serialized_head = create_game_update(num, diff, nb, &size);
     RETURN_FAILURE_IF_NULL(serialized_head);
-    size_t len_serialized_head = 5 + nb * 3;
 
-    return send_string_to_clients_multicast(sock, addr_mult, serialized_head, len_serialized_head);
+    int res = send_string_to_clients_multicast(sock, NULL, addr_mult, serialized_head, size);
+    free(serialized_head);
+    return res;
 }
 
-int send_tcp(int sock, const void *buffer, uint8_t size) {
-    unsigned sent = 0;
+int send_tcp(int sock, const void *buffer, size_t size) {
+    size_t sent = 0;
     while (sent < size) {
         int res = send(sock, (char *)buffer + sent, size - sent, 0);
         if (res < 0) {
-            perror("send tcp");
+            LOG_ERRNO("send tcp");
             return EXIT_FAILURE;
         }
         if (res == 0) {
-            perror("send tcp: connection closed");
+            LOG_ERRNO("send tcp: connection closed");
             return EXIT_FAILURE;
         }
         sent += res;
@@ -112,9 +202,17 @@ int send_tcp(int sock, const void *buffer, uint8_t size) {
     return EXIT_SUCCESS;
 }
 
-int send_chat_message(int sock, chat_message_type type, int id, int eq, uint8_t message_length, char *message) {
+int send_subscription_token(int sock, uint64_t token) {
+    char *serialized = serialize_subscription_token(token);
+    RETURN_FAILURE_IF_NULL(serialized);
+    int res = send_tcp(sock, serialized, SUBSCRIPTION_TOKEN_SIZE);
+    free(serialized);
+    return res;
+}
+
+char *create_chat_message(chat_message_type type, int id, int eq, uint8_t message_length, char *message, size_t *size) {
     chat_message *msg = malloc(sizeof(chat_message));
-    RETURN_FAILURE_IF_NULL_PERROR(msg, "malloc chat_message");
+    RETURN_NULL_IF_NULL_PERROR(msg, "malloc chat_message");
     msg->type = type;
     msg->id = id;
     msg->eq = eq;
@@ -122,37 +220,51 @@ int send_chat_message(int sock, chat_message_type type, int id, int eq, uint8_t
     msg->message = malloc(message_length);
     if (msg->message == NULL) {
         free(msg);
-        perror("malloc chat_message message");
-        return EXIT_FAILURE;
+        LOG_ERRNO("malloc chat_message message");
+        return NULL;
     }
     strncpy(msg->message, message, message_length);
 
     char *serialized_msg = server_serialize_chat_message(msg);
-    if (serialized_msg == NULL) {
-        free(msg->message);
-        free(msg);
-        return EXIT_FAILURE;
-    }
-
-    int res = send_tcp(sock, serialized_msg, 3 + message_length);
     free(msg->message);
     free(msg);
+    RETURN_NULL_IF_NULL(serialized_msg);
+
+    *size = 3 + message_length;
+    return serialized_msg;
+}
+
+int send_chat_message(int sock, chat_message_type type, int id, int eq, uint8_t message_length, char *message) {
+    size_t size;
+    char *serialized_msg = create_chat_message(type, id, eq, message_length, message, &size);
+    RETURN_FAILURE_IF_NULL(serialized_msg);
+
+    int res = send_tcp(sock, serialized_msg, size);
     free(serialized_msg);
     return res;
 }
 
-int send_game_over(int sock, GAME_MODE mode, int id, int eq) {
+char *create_game_over(GAME_MODE mode, int id, int eq, size_t *size) {
     game_end *head = malloc(sizeof(game_end));
-    RETURN_FAILURE_IF_NULL_PERROR(head, "malloc game_end");
+    RETURN_NULL_IF_NULL_PERROR(head, "malloc game_end");
     head->game_mode = mode;
     head->id = id;
     head->eq = eq;
 
     char *serialized_head = serialize_game_end(head);
     free(head);
+    RETURN_NULL_IF_NULL(serialized_head);
+
+    *size = 2;
+    return serialized_head;
+}
+
+int send_game_over(int sock, GAME_MODE mode, int id, int eq) {
+    size_t size;
+    char *serialized_head = create_game_over(mode, id, eq, &size);
     RETURN_FAILURE_IF_NULL(serialized_head);
 
-    int res = send_tcp(sock, serialized_head, 2);
+    int res = send_tcp(sock, serialized_head, size);
     free(serialized_head);
 
     return res;
@@ -163,9 +275,9 @@ connection_header_raw *recv_connexion_header_raw(int sock) {
     RETURN_NULL_IF_NULL_PERROR(head, "malloc connection_header_raw");
     unsigned received = 0;
     while (received < sizeof(connection_header_raw)) {
-        int res = recv(sock, head + received, sizeof(connection_header_raw) - received, 0);
-        if (res < 0) {
-            perror("recv connection_header_raw");
+        int res = recv(sock, (char *)head + received, sizeof(connection_header_raw) - received, 0);
+        if (res <= 0) { // The client left before sending its header when 0
+            LOG_ERRNO("recv connection_header_raw");
             free(head);
             return NULL;
         }
@@ -182,93 +294,27 @@ initial_connection_header *recv_initial_connection_header(int sock) {
     return deserialized_head;
 }
 
-ready_connection_header *recv_ready_connexion_header(int sock) {
-    connection_header_raw *head = recv_connexion_header_raw(sock);
-    RETURN_NULL_IF_NULL(head);
-    ready_connection_header *deserialized_head = deserialize_ready_connection(head);
-    free(head);
-    return deserialized_head;
-}
-
-char *recv_string_udp(int sock, size_t size) {
-    char *res = malloc(size);
-    RETURN_NULL_IF_NULL(res);
-    if (recvfrom(sock, res, size, 0, NULL, 0) < 0) {
-        perror("recvfrom string udp");
-        free(res);
-        return NULL;
-    }
-    return res;
-}
-
-game_action *recv_game_action(int sock) {
-    char *head = recv_string_udp(sock, sizeof(game_action));
-    RETURN_NULL_IF_NULL(head);
-
-    game_action *deserialized_head = deserialize_game_action(head);
-    free(head);
-    return deserialized_head;
-}
-
-int recv_tcp(int sock, void *buffer, int size) {
-    int received = 0;
-    while (received < size) {
-        int res = recv(sock, (char *)buffer + received, size - received, 0);
-        if (res < 0) {
-            perror("recv tcp");
-            return EXIT_FAILURE;
-        }
-        if (res == 0) {
-            perror("recv tcp: connection closed");
+int recv_capabilities_of_client(int sock, capabilities *caps) {
+    char raw[CAPABILITIES_SIZE];
+    unsigned received = 0;
+    while (received < CAPABILITIES_SIZE) {
+        int res = recv(sock, raw + received, CAPABILITIES_SIZE - received, 0);
+        if (res <= 0) {
+            LOG_ERRNO("recv capabilities");
             return EXIT_FAILURE;
         }
         received += res;
     }
-    return EXIT_SUCCESS;
+    return read_capabilities(raw, CAPABILITIES_SIZE, caps);
 }
 
-chat_message *recv_chat_message(int sock) {
-    uint16_t header;
-    int res = recv_tcp(sock, &header, sizeof(uint16_t));
-    RETURN_NULL_IF_NEG_PERROR(res, "recv chat_message header");
-
-    uint8_t length;
-    res = recv_tcp(sock, &length, sizeof(uint8_t));
-    RETURN_NULL_IF_NEG_PERROR(res, "recv chat_message length");
-
-    char *message = malloc(length);
-    RETURN_NULL_IF_NULL_PERROR(message, "malloc chat_message message");
-    res = recv_tcp(sock, message, length * sizeof(char));
-    if (res < 0) {
-        perror("recv chat_message message");
-        free(message);
-        return NULL;
-    }
-
-    // Allocate memory for the total received message
-    char *total_received = malloc(3 + length);
-    if (total_received == NULL) {
-        perror("malloc chat_message total_received");
-        free(message);
+ready_connection_header *recv_ready_connexion_header(tcp_reader *reader) {
+    const char *message;
+    size_t size;
+    if (tcp_reader_wait_next(reader, &message, &size) != 1) {
         return NULL;
     }
-
-    // Copy the header, length and message into the total received message
-    memcpy(total_received, &header, 2);
-    memcpy(total_received + 2, &length, 1);
-    memcpy(total_received + 3, message, length);
-
-    // Deserialize the chat message
-    chat_message *msg = client_deserialize_chat_message(total_received);
-    if (msg == NULL) {
-        perror("deserialize chat_message");
-        free(total_received);
-        free(message);
-        return NULL;
-    }
-
-    free(total_received);
-    free(message);
-
-    return msg;
-}
\ No newline at end of file
+    connection_header_raw head;
+    memcpy(&head, message, sizeof(connection_header_raw));
+    return deserialize_ready_connection(&head);
+}
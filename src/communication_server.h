@@ -4,19 +4,71 @@
 #ifndef SRC_COMMUNICATION_SERVER_H_
 #define SRC_COMMUNICATION_SERVER_H_
 
+#include "./interest.h"
 #include "./messages.h"
 #include "./model.h"
+#include "./netem.h"
+#include "./tcp_reader.h"
+#include "./udp_message.h"
 
-int send_connexion_information(int sock, GAME_MODE mode, int id, int eq, int port_udp, int portmdiff,
-                               uint16_t adrmdiff[8]);
+int send_connexion_information(int sock, GAME_MODE mode, PROTOCOL_VERSION version, int id, int eq, int port_udp,
+                               int portmdiff, uint16_t adrmdiff[8]);
+/** Sends the capabilities chosen for a client, right after its connection information
+ */
+int send_capabilities(int sock, const capabilities *caps);
+/** Sends the token of the subscriptions of a client, right after its capabilities
+ */
+int send_subscription_token(int sock, uint64_t token);
+/** Sends the message to the multicast group through link, which can be NULL
+ */
+int send_string_to_clients_multicast(int sock, netem_link *link, struct sockaddr_in6 *addr_mult, char *message,
+                                     size_t message_length);
+/** Sends the message to each of the nb addresses of players through link, which can be NULL. Returns how many players
+ *  it was sent to, or -1 if it could be sent to none.
+ */
+int send_string_to_clients_unicast(int sock, netem_link *link, const struct sockaddr_in6 *addrs, unsigned nb,
+                                   char *message, size_t message_length);
+/** Sends the message i to the address i of the nb players through link, which can be NULL. Returns how many players
+ *  a message was sent to, or -1 if none could be sent.
+ */
+int send_strings_to_clients_unicast(int sock, netem_link *link, const struct iovec *messages,
+                                    const struct sockaddr_in6 *addrs, unsigned nb);
+/** Returns the board serialized for the multicast group and sets size with the size of the message
+ */
+char *create_game_board(uint16_t num, board *board_, size_t *size);
 int send_game_board(int sock, struct sockaddr_in6 *addr_mult, uint16_t num, board *board_);
-int send_game_update(int sock, struct sockaddr_in6 *addr_mult, int num, tile_diff *diff, uint8_t nb);
+/** Returns the tiles of the window of the board serialized as a region and sets size with the size of the message
+ */
+char *create_game_board_region(uint16_t num, board *board_, const interest_window *window, size_t *size);
+/** Sends a ping with the current time of the wall clock to each of the nb addresses of players through link, which
+ *  can be NULL. Returns how many players it was sent to, or -1 if it could be sent to none.
+ */
+int send_ping_to_clients(int sock, netem_link *link, const struct sockaddr_in6 *addrs, unsigned nb);
+/** Returns the tile_diffs serialized for the multicast group and sets size with the size of the message
+ */
+char *create_game_update(uint16_t num, tile_diff *diff, uint16_t nb, size_t *size);
+int send_game_update(int sock, struct sockaddr_in6 *addr_mult, int num, tile_diff *diff, uint16_t nb);
+
+/** Returns the board serialized as a keyframe for the TCP connections, num is the number of the last update included
+ *  in the board, and sets size with the size of the message
+ */
+char *create_game_board_keyframe(uint16_t num, board *board_, size_t *size);
+/** Returns the chat message serialized for a client and sets size with the size of the message
+ */
+char *create_chat_message(chat_message_type type, int id, int eq, uint8_t message_length, char *message, size_t *size);
 int send_chat_message(int sock, chat_message_type type, int id, int eq, uint8_t message_length, char *message);
+/** Returns the end of the game serialized for a client and sets size with the size of the message
+ */
+char *create_game_over(GAME_MODE mode, int id, int eq, size_t *size);
 int send_game_over(int sock, GAME_MODE mode, int id, int eq);
 
 initial_connection_header *recv_initial_connection_header(int sock);
-ready_connection_header *recv_ready_connexion_header(int sock);
-game_action *recv_game_action(int sock);
-chat_message *recv_chat_message(int sock);
+/** Receives the capabilities a client announces right after its initial header, returns EXIT_FAILURE if they are not
+ *  valid
+ */
+int recv_capabilities_of_client(int sock, capabilities *caps);
+/** Receives the ready header with the reader of the connection, which keeps what is received after it
+ */
+ready_connection_header *recv_ready_connexion_header(tcp_reader *reader);
 
 #endif // SRC_COMMUNICATION_SERVER_H_
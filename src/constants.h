@@ -1,16 +1,20 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 
-#define PLAYER_NUM 4
-#define TMP_GAME_ID 0
+#define PLAYER_NUM 4      // Players of a game of the first version of the protocol
+#define MAX_PLAYER_NUM 16 // Players of the largest game, of the second version of the protocol
 
 #define MIN_GAMEBOARD_WIDTH 10
 #define MIN_GAMEBOARD_HEIGHT 10
+#define MIN_WIDE_GAMEBOARD_WIDTH 17 // With more than PLAYER_NUM players
 #define GAMEBOARD_WIDTH 52
 #define GAMEBOARD_HEIGHT 25
 #define DESTRUCTIBLE_WALL_CHANCE 20
 #define BOMB_LIFETIME 3 // in seconds
 
+// Interface of the multicast groups when none is given, the system chooses one if it does not exist
+#define DEFAULT_MULTICAST_INTERFACE "eth0"
+
 #define TEXT_SIZE 60
 #define MAX_CHAT_HISTORY_LEN 23
 
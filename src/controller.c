@@ -1,4 +1,5 @@
 #include "./controller.h"
+#include "./board_view.h"
 #include "./messages.h"
 #include "./network_client.h"
 #include "./utils.h"
@@ -31,6 +32,8 @@
 #define YELLOW_COLOR "\033[33m"
 
 static board *game_board = NULL;
+static int last_update_num = -1;           // Number of the last update applied, -1 before the first one
+static bool is_keyframe_requested = false; // True until the keyframe asked after missing updates is received
 static pthread_mutex_t game_board_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static chat *client_chat = NULL;
@@ -221,7 +224,7 @@ bool perform_game_action(int c) {
             action->id = player_id;
             action->eq = eq;
             action->message_number = message_number;
-            message_number = (message_number + 1) % (1 << 13);
+            message_number = (message_number + 1) % GAME_ACTION_MESSAGE_NUMBER_LIMIT;
             action->action = a;
 
             send_game_action(action);
@@ -293,21 +296,77 @@ board *get_board() {
     return b;
 }
 
-void update_board(board *b, TILE *grid, int width, int height) {
+/** Gives the board the dimensions width * height, its grid is only reallocated if they change
+ */
+static int resize_board(board *b, int width, int height) {
+    if (b->grid != NULL && b->dim.width == width && b->dim.height == height) {
+        return EXIT_SUCCESS;
+    }
+    char *grid = realloc(b->grid, height * width);
+    RETURN_FAILURE_IF_NULL_PERROR(grid, "realloc board grid");
+    b->grid = grid;
     b->dim.width = width;
     b->dim.height = height;
-    b->grid = malloc(b->dim.height * b->dim.width);
+    return EXIT_SUCCESS;
+}
 
+void update_board(board *b, TILE *grid, int width, int height) {
+    RETURN_IF_ERROR(resize_board(b, width, height));
     for (int i = 0; i < b->dim.height * b->dim.width; i++) {
         b->grid[i] = grid[i];
     }
 }
 
-void update_tile_diff(board *b, tile_diff *diff, int size) {
-    for (int i = 0; i < size; i++) {
-        int pos = diff[i].y * b->dim.width + diff[i].x;
-        b->grid[pos] = diff[i].tile;
+/** Copies the tiles of a game board message, read by read_game_board, in the board
+ */
+static void update_board_from_message(board *b, const char *message, int width, int height) {
+    RETURN_IF_ERROR(resize_board(b, width, height));
+    memcpy(b->grid, message + game_board_header_size(message), height * width);
+}
+
+/** Copies the tiles of a region message, read by read_game_board_region, at their place in the board
+ */
+static void update_region_from_message(board *b, const char *message, int x, int y, int width, int height) {
+    if (x + width > b->dim.width || y + height > b->dim.height) {
+        return;
+    }
+    const char *tiles = message + game_board_header_size(message);
+    for (int row = 0; row < height; row++) {
+        memcpy(b->grid + (y + row) * b->dim.width + x, tiles + row * width, width);
+    }
+}
+
+/** Applies the tile_diffs of a game board update message, read by read_game_board_update, to the board
+ */
+static void update_tile_diff_from_message(board *b, const char *message, uint16_t nb) {
+    for (unsigned i = 0; i < nb; i++) {
+        tile_diff diff = read_game_board_update_diff(message, i);
+        board_set(b, diff.x, diff.y, diff.tile);
+    }
+}
+
+/** Returns true if the update num comes after the last applied one, otherwise it is already included in the board.
+ *  Sets missed to true if some updates between them were lost.
+ */
+bool is_new_update(uint16_t num, bool *missed) {
+    *missed = false;
+    if (last_update_num == -1) {
+        return true;
+    }
+    uint16_t distance = num - last_update_num;
+    if (distance == 0 || distance >= (1 << 15)) {
+        return false;
     }
+    *missed = distance > 1;
+    return true;
+}
+
+void apply_keyframe(game_board_information *info) {
+    pthread_mutex_lock(&game_board_mutex);
+    update_board(game_board, info->board, info->width, info->height);
+    last_update_num = info->num;
+    is_keyframe_requested = false;
+    pthread_mutex_unlock(&game_board_mutex);
 }
 
 /** Updates the game board based on the server MESSAGE*/
@@ -320,43 +379,58 @@ void *game_board_info_thread_function() {
         }
         pthread_mutex_unlock(&game_end_mutex);
 
-        // Check if connection is still alive
-        if (has_server_disconnected_tcp()) {
-            close_socket_tcp();
-            close_socket_udp();
-            close_socket_diff();
-            pthread_mutex_lock(&game_end_mutex);
-            is_game_end = true;
-            pthread_mutex_unlock(&game_end_mutex);
-            break;
-        }
-
-        received_game_message *received_message = recv_game_message();
-        if (received_message == NULL || received_message->message == NULL) {
-            // TODO: Handle error
+        // The chat thread ends the game when the server closes the connection, and the shutdown of the multicast socket
+        // wakes this thread up
+        // The message is applied straight from the receive buffer, which the next call reuses
+        received_game_message received;
+        if (recv_game_message(&received) == EXIT_FAILURE) {
             continue;
         }
-        switch (received_message->type) {
+        uint16_t num;
+        switch (received.type) {
             case GAME_BOARD_INFORMATION:
-                game_board_information *info = deserialize_game_board(received_message->message);
+                uint16_t height, width;
+                if (read_game_board(received.message, received.size, &num, &height, &width) == EXIT_FAILURE) {
+                    continue;
+                }
                 pthread_mutex_lock(&game_board_mutex);
-                update_board(game_board, info->board, info->width, info->height);
+                update_board_from_message(game_board, received.message, width, height);
+                pthread_mutex_unlock(&game_board_mutex);
+                break;
+            case GAME_BOARD_REGION:
+                uint16_t x, y;
+                if (read_game_board_region(received.message, received.size, &num, &x, &y, &width, &height) ==
+                    EXIT_FAILURE) {
+                    continue;
+                }
+                pthread_mutex_lock(&game_board_mutex);
+                update_region_from_message(game_board, received.message, x, y, width, height);
                 pthread_mutex_unlock(&game_board_mutex);
-                free_game_board_information(info);
                 break;
             case GAME_BOARD_UPDATE:
-                game_board_update *update = deserialize_game_board_update(received_message->message);
+                uint16_t nb;
+                if (read_game_board_update(received.message, received.size, &num, &nb) == EXIT_FAILURE) {
+                    continue;
+                }
+                bool missed = false;
+                bool request_keyframe = false;
                 pthread_mutex_lock(&game_board_mutex);
-                update_tile_diff(game_board, update->diff, update->nb);
+                if (is_new_update(num, &missed)) {
+                    update_tile_diff_from_message(game_board, received.message, nb);
+                    last_update_num = num;
+                    // The lost updates are in the keyframe, the next updates are applied on it
+                    request_keyframe = missed && !is_keyframe_requested;
+                    is_keyframe_requested = is_keyframe_requested || request_keyframe;
+                }
                 pthread_mutex_unlock(&game_board_mutex);
-                free_game_board_update(update);
+                if (request_keyframe) {
+                    send_keyframe_request_to_server();
+                }
                 break;
             default:
                 printf("Unknown message type\n");
-                /* TODO: Handle error */
-                break;
+                continue;
         }
-        free(received_message->message);
 
         board *b = get_board();
         pthread_mutex_lock(&view_mutex);
@@ -378,8 +452,9 @@ void *chat_message_thread_function() {
         }
         pthread_mutex_unlock(&game_end_mutex);
 
-        // Check if connection is still alive
-        if (has_server_disconnected_tcp()) {
+        const char *message;
+        size_t size;
+        if (recv_tcp_message_from_server(&message, &size) == EXIT_FAILURE) { // The server closed the connection
             close_socket_tcp();
             close_socket_udp();
             close_socket_diff();
@@ -389,10 +464,7 @@ void *chat_message_thread_function() {
             break;
         }
 
-        u_int16_t header = recv_header_from_server();
-        char *header_char = (char *)&header;
-
-        game_end *game_end_header = deserialize_game_end(header_char);
+        game_end *game_end_header = deserialize_game_end(message);
 
         if (game_end_header != NULL) {
             if (game_end_header->game_mode == game_mode) {
@@ -422,7 +494,20 @@ void *chat_message_thread_function() {
             }
         }
 
-        chat_message *chat_msg = recv_chat_message_from_server(header);
+        uint16_t header;
+        memcpy(&header, message, sizeof(uint16_t));
+        message_header *head = deserialize_message_header(header);
+        bool is_keyframe = head != NULL && head->codereq == KEYFRAME_CODE;
+        free(head);
+        if (is_keyframe) {
+            game_board_information *info = deserialize_game_board_keyframe(message);
+            if (info != NULL) {
+                apply_keyframe(info);
+                free_game_board_information(info);
+            }
+        }
+
+        chat_message *chat_msg = is_keyframe ? NULL : server_deserialize_chat_message(message);
         if (chat_msg != NULL) {
             pthread_mutex_lock(&chat_mutex);
             if (chat_msg->type == GLOBAL_M) {
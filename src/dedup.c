@@ -0,0 +1,25 @@
+#include "./dedup.h"
+
+bool dedup_accept(dedup_window *window, unsigned number, unsigned limit) {
+    if (!window->started) {
+        window->started = true;
+        window->latest = number;
+        window->seen = 1;
+        return true;
+    }
+
+    unsigned ahead = (number + limit - window->latest) % limit;
+    if (ahead > 0 && ahead <= limit / 2) {
+        window->seen = ahead >= DEDUP_WINDOW_SIZE ? 0 : window->seen << ahead;
+        window->seen |= 1;
+        window->latest = number;
+        return true;
+    }
+
+    unsigned behind = (window->latest + limit - number) % limit;
+    if (behind >= DEDUP_WINDOW_SIZE || (window->seen >> behind & 1) != 0) {
+        return false;
+    }
+    window->seen |= (uint64_t)1 << behind;
+    return true;
+}
@@ -0,0 +1,22 @@
+#ifndef SRC_DEDUP_H_
+#define SRC_DEDUP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEDUP_WINDOW_SIZE 64
+
+/** Numbers seen in a sequence numbered modulo a limit, to keep the first copy of each message sent several times as
+ *  an anti-replay window does. A number more than half the limit before the latest one is taken as coming after it.
+ */
+typedef struct dedup_window {
+    bool started;
+    unsigned latest; // Latest number seen
+    uint64_t seen;   // Bit i is set if latest - i was seen
+} dedup_window;
+
+/** Returns true the first time number is seen, false if it was already seen or is too old for the window to know
+ */
+bool dedup_accept(dedup_window *window, unsigned number, unsigned limit);
+
+#endif // SRC_DEDUP_H_
@@ -0,0 +1,46 @@
+#include "./interest.h"
+#include "./board_view.h"
+
+static int clip(int value, int min, int max) {
+    return value < min ? min : value > max ? max : value;
+}
+
+interest_window interest_window_around(coord center, unsigned radius, dimension dim) {
+    int r = (int)radius;
+    interest_window window;
+    window.x = clip(center.x - r, 0, dim.width - 1);
+    window.y = clip(center.y - r, 0, dim.height - 1);
+    window.width = clip(center.x + r, 0, dim.width - 1) - window.x + 1;
+    window.height = clip(center.y + r, 0, dim.height - 1) - window.y + 1;
+    return window;
+}
+
+interest_window interest_window_all(dimension dim) {
+    interest_window window = {0, 0, dim.width, dim.height};
+    return window;
+}
+
+bool interest_window_contains(const interest_window *window, int x, int y) {
+    return x >= window->x && x < window->x + window->width && y >= window->y && y < window->y + window->height;
+}
+
+unsigned interest_filter_diffs(const tile_diff *diffs, unsigned nb, const board *board_, const interest_window *before,
+                               const interest_window *window, tile_diff *out, unsigned max) {
+    unsigned nb_out = 0;
+    // The diffs of the tiles entering the window are in the tiles read from the board
+    for (unsigned i = 0; i < nb && nb_out < max; i++) {
+        if (interest_window_contains(before, diffs[i].x, diffs[i].y) &&
+            interest_window_contains(window, diffs[i].x, diffs[i].y)) {
+            out[nb_out++] = diffs[i];
+        }
+    }
+    for (int y = window->y; y < window->y + window->height; y++) {
+        for (int x = window->x; x < window->x + window->width && nb_out < max; x++) {
+            if (!interest_window_contains(before, x, y)) {
+                tile_diff entered = {x, y, board_get_unchecked(board_, x, y)};
+                out[nb_out++] = entered;
+            }
+        }
+    }
+    return nb_out;
+}
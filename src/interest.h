@@ -0,0 +1,35 @@
+#ifndef SRC_INTEREST_H_
+#define SRC_INTEREST_H_
+
+#include "./model.h"
+
+#include <stdbool.h>
+
+/** Area of interest of a player: the tiles around it, the only ones sent to a client which does not need the whole
+ *  board. A window is a rectangle of the board, clipped to its borders.
+ */
+typedef struct interest_window {
+    int x; // Top left tile
+    int y;
+    int width;
+    int height;
+} interest_window;
+
+/** Returns the window of the tiles at most radius tiles away from center on each axis, clipped to a board of dim
+ */
+interest_window interest_window_around(coord center, unsigned radius, dimension dim);
+
+/** Returns the window of the whole board of dim
+ */
+interest_window interest_window_all(dimension dim);
+
+bool interest_window_contains(const interest_window *window, int x, int y);
+
+/** Writes in out the diffs inside window, and the tiles of the board inside window but outside before, which the
+ *  client has not followed, with their current content. At most max are written, the tiles entering the window are
+ *  left out first. Returns how many are written.
+ */
+unsigned interest_filter_diffs(const tile_diff *diffs, unsigned nb, const board *board_, const interest_window *before,
+                               const interest_window *window, tile_diff *out, unsigned max);
+
+#endif // SRC_INTEREST_H_
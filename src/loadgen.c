@@ -0,0 +1,555 @@
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "messages.h"
+#include "netem.h"
+#include "network_client.h"
+#include "prng.h"
+#include "utils.h"
+
+/** Load generator: simulated players which join games of the server like the client does, then send random game
+ *  actions and chat messages while checking the multicast messages of their game.
+ *  The network layer of the client keeps its connection in globals, so every player is a process of its own. The
+ *  players write their measures in a report shared with the parent, which sums them up once they have all ended.
+ */
+
+#define MAX_PLAYERS 4096
+#define MAX_LATENCY_SAMPLES 512 // Per player
+#define MESSAGE_NUMBER_MODULO 8192 // The message number of a game action is sent on 13 bits
+#define WATCHDOG_MARGIN_S 10
+
+typedef enum player_state { PLAYER_NOT_CONNECTED, PLAYER_CONNECTED, PLAYER_JOINED, PLAYER_PLAYING } player_state;
+
+typedef struct player_report {
+    player_state state;
+    bool game_ended; // By the server, before the end of the duration
+    uint64_t join_us;     // From the connection to the information of the game, when the game is full
+    uint64_t keyframe_us; // From the ready message to the first keyframe
+
+    unsigned actions_sent;
+    unsigned actions_without_diff; // Moves not seen in any update before the next action, blocked by a wall mostly
+    unsigned nb_latencies;
+    uint32_t latencies_us[MAX_LATENCY_SAMPLES]; // From a move to the first update moving the player
+
+    unsigned updates_received;
+    unsigned updates_missed; // Numbers skipped between two updates received
+    unsigned boards_received;
+    unsigned invalid_messages; // Malformed, or with a tile out of the board
+
+    unsigned chats_sent;
+    unsigned chats_received;
+} player_report;
+
+typedef struct loadgen_options {
+    uint16_t port;
+    unsigned players;
+    GAME_MODE mode;
+    unsigned duration_s;
+    unsigned actions_per_s;
+    unsigned chats_per_s;
+    unsigned bomb_percent; // Of the actions, the others are moves
+    unsigned join_timeout_s;
+    uint64_t seed;
+    PROTOCOL_VERSION version; // Asked to the server when joining a game
+    unsigned max_datagram;    // Largest game board update announced to the server
+    unsigned capabilities;    // 0 to announce none, as a client of a server which does not know them
+} loadgen_options;
+
+/** State of the simulated player of the process
+ */
+typedef struct player {
+    const loadgen_options *options;
+    player_report *report;
+    prng rng;
+    int id;
+    int eq;
+    uint16_t height;
+    uint16_t width;
+
+    pthread_mutex_t lock; // For the fields below and the measures of the report
+    uint16_t last_update_num;
+    uint64_t pending_move_us; // Time of the last move not yet seen in an update, 0 if none
+    bool ended;
+} player;
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s -p PORT [-n PLAYERS] [-m MODE] [-d SECONDS] [-a ACTIONS_PER_S] [-c CHATS_PER_S] "
+            "[-b BOMB_PERCENT] [-j JOIN_TIMEOUT_S] [-i INTERFACE] [-s SEED] [-V PROTOCOL_VERSION] "
+            "[-D MAX_DATAGRAM] [-C CAPABILITIES]\n",
+            name);
+}
+
+static int parse_option(const char *str, unsigned minimum, unsigned maximum, unsigned *value, const char *name) {
+    int r = parse_unsigned_within_bounds(str, minimum, maximum);
+    if (r < 0) {
+        fprintf(stderr, "The %s has to be between %u and %u.\n", name, minimum, maximum);
+        return EXIT_FAILURE;
+    }
+    *value = r;
+    return EXIT_SUCCESS;
+}
+
+static int parse_options(int argc, char *argv[], loadgen_options *options) {
+    options->port = 0;
+    options->players = 4;
+    options->mode = SOLO;
+    options->duration_s = 10;
+    options->actions_per_s = 10;
+    options->chats_per_s = 1;
+    options->bomb_percent = 0; // Without bombs, the games last until the end of the duration
+    options->join_timeout_s = 30;
+    options->seed = prng_random_seed();
+    options->version = PROTOCOL_V1;
+    options->max_datagram = UINT16_MAX;
+    options->capabilities = 1;
+
+    unsigned value;
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 >= argc) {
+            return EXIT_FAILURE;
+        }
+        const char *flag = argv[i];
+        const char *arg = argv[i + 1];
+        if (strcmp(flag, "-p") == 0) {
+            RETURN_FAILURE_IF_ERROR(parse_option(arg, MIN_PORT, MAX_PORT, &value, "port"));
+            options->port = value;
+        } else if (strcmp(flag, "-n") == 0) {
+            RETURN_FAILURE_IF_ERROR(parse_option(arg, 1, MAX_PLAYERS, &options->players, "number of players"));
+        } else if (strcmp(flag, "-m") == 0) {
+            RETURN_FAILURE_IF_ERROR(parse_option(arg, 0, 1, &value, "mode"));
+            options->mode = value == 0 ? SOLO : TEAM;
+        } else if (strcmp(flag, "-d") == 0) {
+            RETURN_FAILURE_IF_ERROR(parse_option(arg, 1, 3600, &options->duration_s, "duration"));
+        } else if (strcmp(flag, "-a") == 0) {
+            RETURN_FAILURE_IF_ERROR(parse_option(arg, 0, 1000, &options->actions_per_s, "rate of actions"));
+        } else if (strcmp(flag, "-c") == 0) {
+            RETURN_FAILURE_IF_ERROR(parse_option(arg, 0, 100, &options->chats_per_s, "rate of chat messages"));
+        } else if (strcmp(flag, "-b") == 0) {
+            RETURN_FAILURE_IF_ERROR(parse_option(arg, 0, 100, &options->bomb_percent, "percentage of bombs"));
+        } else if (strcmp(flag, "-j") == 0) {
+            RETURN_FAILURE_IF_ERROR(parse_option(arg, 1, 3600, &options->join_timeout_s, "join timeout"));
+        } else if (strcmp(flag, "-i") == 0) {
+            RETURN_FAILURE_IF_ERROR(set_multicast_interface(arg));
+        } else if (strcmp(flag, "-s") == 0) {
+            options->seed = strtoull(arg, NULL, 10);
+        } else if (strcmp(flag, "-V") == 0) {
+            RETURN_FAILURE_IF_ERROR(parse_option(arg, PROTOCOL_V1, PROTOCOL_V2, &value, "version of the protocol"));
+            options->version = value;
+        } else if (strcmp(flag, "-D") == 0) {
+            RETURN_FAILURE_IF_ERROR(
+                parse_option(arg, MIN_DATAGRAM_SIZE, UINT16_MAX, &options->max_datagram, "largest datagram"));
+        } else if (strcmp(flag, "-C") == 0) {
+            RETURN_FAILURE_IF_ERROR(parse_option(arg, 0, 1, &options->capabilities, "announce of the capabilities"));
+        } else {
+            return EXIT_FAILURE;
+        }
+    }
+    return options->port == 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/** Returns true if the update num follows the last one received, and counts the updates missed in between
+ */
+static bool is_new_update(player *p, uint16_t num) {
+    uint16_t distance = num - p->last_update_num;
+    if (distance == 0 || distance >= UINT16_MAX / 2) {
+        return false;
+    }
+    p->report->updates_missed += distance - 1;
+    p->last_update_num = num;
+    return true;
+}
+
+static void handle_game_update(player *p, const char *message, size_t size, uint64_t received_us) {
+    uint16_t num;
+    uint16_t nb;
+    if (read_game_board_update(message, size, &num, &nb) == EXIT_FAILURE || size > p->options->max_datagram) {
+        p->report->invalid_messages++;
+        return;
+    }
+
+    bool moved = false;
+    for (unsigned i = 0; i < nb; i++) {
+        tile_diff diff = read_game_board_update_diff(message, i);
+        if (diff.x >= p->width || diff.y >= p->height || diff.tile > PLAYER_16) {
+            p->report->invalid_messages++;
+            return;
+        }
+        moved = moved || diff.tile == get_player(p->id);
+    }
+
+    if (!is_new_update(p, num)) {
+        return;
+    }
+    p->report->updates_received++;
+    if (moved && p->pending_move_us != 0) {
+        if (p->report->nb_latencies < MAX_LATENCY_SAMPLES) {
+            p->report->latencies_us[p->report->nb_latencies++] = received_us - p->pending_move_us;
+        }
+        p->pending_move_us = 0;
+    }
+}
+
+static void handle_game_board(player *p, const char *message, size_t size) {
+    uint16_t num;
+    uint16_t height, width;
+    if (read_game_board(message, size, &num, &height, &width) == EXIT_FAILURE || height != p->height ||
+        width != p->width) {
+        p->report->invalid_messages++;
+        return;
+    }
+    p->report->boards_received++;
+}
+
+static void handle_game_board_region(player *p, const char *message, size_t size) {
+    uint16_t num;
+    uint16_t x, y, width, height;
+    if (read_game_board_region(message, size, &num, &x, &y, &width, &height) == EXIT_FAILURE ||
+        x + width > p->width || y + height > p->height) {
+        p->report->invalid_messages++;
+        return;
+    }
+    p->report->boards_received++;
+}
+
+static void *serve_multicast(void *arg) {
+    player *p = (player *)arg;
+    while (true) {
+        received_game_message received;
+        if (recv_game_message(&received) == EXIT_FAILURE) {
+            continue;
+        }
+        uint64_t now_us = get_time_us();
+
+        pthread_mutex_lock(&p->lock);
+        if (received.type == GAME_BOARD_UPDATE) {
+            handle_game_update(p, received.message, received.size, now_us);
+        } else if (received.type == GAME_BOARD_REGION) {
+            handle_game_board_region(p, received.message, received.size);
+        } else {
+            handle_game_board(p, received.message, received.size);
+        }
+        pthread_mutex_unlock(&p->lock);
+    }
+    return NULL;
+}
+
+static int get_codereq(const char *message) {
+    uint16_t header;
+    memcpy(&header, message, sizeof(uint16_t));
+    return message_code(header);
+}
+
+static void *serve_tcp(void *arg) {
+    player *p = (player *)arg;
+    while (true) {
+        const char *message;
+        size_t size;
+        if (recv_tcp_message_from_server(&message, &size) == EXIT_FAILURE) {
+            break;
+        }
+        int codereq = get_codereq(message);
+        if (codereq == 15 || codereq == 16) { // Game end
+            break;
+        }
+        if (codereq != KEYFRAME_CODE) {
+            pthread_mutex_lock(&p->lock);
+            p->report->chats_received++;
+            pthread_mutex_unlock(&p->lock);
+        }
+    }
+
+    pthread_mutex_lock(&p->lock);
+    p->ended = true;
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/** Connects the player, joins a game and waits for its first keyframe
+ */
+static int join_game(player *p) {
+    RETURN_FAILURE_IF_ERROR(init_tcp_socket());
+    set_tcp_port(p->options->port);
+    set_protocol_version(p->options->version);
+    set_max_datagram_size(p->options->max_datagram);
+    set_capabilities_announced(p->options->capabilities == 1);
+    if (try_to_connect_tcp() < 0) {
+        return EXIT_FAILURE;
+    }
+    p->report->state = PLAYER_CONNECTED;
+
+    uint64_t start_us = get_time_us();
+    connection_information *info = start_initialisation_game(p->options->mode);
+    RETURN_FAILURE_IF_NULL(info);
+    p->id = info->id;
+    p->eq = info->eq;
+    free(info);
+    p->report->join_us = get_time_us() - start_us;
+    p->report->state = PLAYER_JOINED;
+
+    start_us = get_time_us();
+    RETURN_FAILURE_IF_ERROR(send_ready_to_play(p->options->mode));
+    // The players of the game which already have their keyframe can be chatting
+    const char *message;
+    size_t size;
+    do {
+        RETURN_FAILURE_IF_ERROR(recv_tcp_message_from_server(&message, &size));
+    } while (get_codereq(message) != KEYFRAME_CODE);
+    game_board_information *keyframe = deserialize_game_board_keyframe(message);
+    RETURN_FAILURE_IF_NULL(keyframe);
+    p->report->keyframe_us = get_time_us() - start_us;
+    p->height = keyframe->height;
+    p->width = keyframe->width;
+    p->last_update_num = keyframe->num;
+    free_game_board_information(keyframe);
+
+    p->report->state = PLAYER_PLAYING;
+    return EXIT_SUCCESS;
+}
+
+static uint64_t min_u64(uint64_t a, uint64_t b) {
+    return a < b ? a : b;
+}
+
+static void send_random_action(player *p, int message_number) {
+    game_action action;
+    action.game_mode = p->options->mode;
+    action.id = p->id;
+    action.eq = p->eq;
+    action.message_number = message_number % MESSAGE_NUMBER_MODULO;
+    bool bomb = prng_range(&p->rng, 100) < p->options->bomb_percent;
+    action.action = bomb ? GAME_PLACE_BOMB : (GAME_ACTION)prng_range(&p->rng, GAME_LEFT + 1);
+
+    pthread_mutex_lock(&p->lock);
+    if (p->pending_move_us != 0) {
+        p->report->actions_without_diff++;
+    }
+    p->pending_move_us = action.action == GAME_PLACE_BOMB ? 0 : get_time_us();
+    pthread_mutex_unlock(&p->lock);
+
+    if (send_game_action(&action) == EXIT_SUCCESS) {
+        p->report->actions_sent++;
+    }
+}
+
+static void send_chat(player *p, unsigned number) {
+    char text[64];
+    int length = snprintf(text, sizeof(text), "loadgen %d %u", p->id, number);
+    if (send_chat_message_to_server(GLOBAL_M, length, text) == EXIT_SUCCESS) {
+        p->report->chats_sent++;
+    }
+}
+
+/** Sends the actions and the chat messages at their rates until the end of the duration or of the game
+ */
+static void play(player *p) {
+    uint64_t action_period_us = p->options->actions_per_s == 0 ? UINT64_MAX : 1000000 / p->options->actions_per_s;
+    uint64_t chat_period_us = p->options->chats_per_s == 0 ? UINT64_MAX : 1000000 / p->options->chats_per_s;
+    uint64_t now_us = get_time_us();
+    uint64_t end_us = now_us + p->options->duration_s * 1000000ULL;
+    // The players of a game do not act all at once
+    uint64_t next_action_us = now_us + prng_range(&p->rng, 50000);
+    uint64_t next_chat_us = now_us + prng_range(&p->rng, 1000000);
+    int message_number = 0;
+    unsigned chat_number = 0;
+
+    while (now_us < end_us) {
+        pthread_mutex_lock(&p->lock);
+        bool ended = p->ended;
+        pthread_mutex_unlock(&p->lock);
+        if (ended) {
+            p->report->game_ended = true;
+            return;
+        }
+
+        if (now_us >= next_action_us) {
+            send_random_action(p, ++message_number);
+            next_action_us += action_period_us;
+        }
+        if (now_us >= next_chat_us) {
+            send_chat(p, ++chat_number);
+            next_chat_us += chat_period_us;
+        }
+
+        uint64_t next_us = min_u64(min_u64(next_action_us, next_chat_us), end_us);
+        now_us = get_time_us();
+        if (next_us > now_us) {
+            usleep(min_u64(next_us - now_us, 10000)); // Checks the end of the game at least every 10 ms
+        }
+        now_us = get_time_us();
+    }
+}
+
+/** Body of the process of a player, which never returns
+ */
+static void run_player(const loadgen_options *options, unsigned index, player_report *report) {
+    // The network layer of the client prints the steps of the connection for humans
+    if (freopen("/dev/null", "w", stdout) == NULL) {
+        _exit(EXIT_FAILURE);
+    }
+    // A game which never fills up, or a server which stops answering, does not block the parent
+    alarm(options->join_timeout_s + options->duration_s + WATCHDOG_MARGIN_S);
+
+    player p;
+    memset(&p, 0, sizeof(player));
+    p.options = options;
+    p.report = report;
+    prng_seed(&p.rng, options->seed + index);
+    // Every player has its own impairment, reproducible from the seed of the configuration
+    const netem_config *netem = netem_get_config();
+    if (netem != NULL) {
+        netem_config player_netem = *netem;
+        player_netem.seed += index;
+        netem_configure(&player_netem);
+    }
+    pthread_mutex_init(&p.lock, NULL);
+
+    if (join_game(&p) == EXIT_FAILURE) {
+        _exit(EXIT_FAILURE);
+    }
+
+    pthread_t multicast_thread, tcp_thread;
+    if (pthread_create(&multicast_thread, NULL, serve_multicast, &p) != 0 ||
+        pthread_create(&tcp_thread, NULL, serve_tcp, &p) != 0) {
+        _exit(EXIT_FAILURE);
+    }
+    play(&p);
+
+    // The threads may be blocked in a receive, the report is complete once the lock is taken
+    pthread_mutex_lock(&p.lock);
+    _exit(EXIT_SUCCESS);
+}
+
+static int compare_uint32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/** Prints the percentiles of values, in milliseconds, and sorts them
+ */
+static void print_percentiles(const char *name, uint32_t *values, size_t nb) {
+    if (nb == 0) {
+        printf("%-26s no sample\n", name);
+        return;
+    }
+    qsort(values, nb, sizeof(uint32_t), compare_uint32);
+    printf("%-26s p50 %8.2f ms  p90 %8.2f ms  p99 %8.2f ms  max %8.2f ms  (%zu samples)\n", name,
+           values[nb * 50 / 100] / 1e3, values[nb * 90 / 100] / 1e3, values[nb * 99 / 100] / 1e3,
+           values[nb - 1] / 1e3, nb);
+}
+
+static int print_summary(const loadgen_options *options, player_report *reports) {
+    unsigned states[PLAYER_PLAYING + 1] = {0};
+    unsigned ended = 0;
+    uint64_t actions = 0, without_diff = 0, received = 0, missed = 0, boards = 0, invalid = 0;
+    uint64_t chats_sent = 0, chats_received = 0;
+    size_t nb_latencies = 0;
+
+    uint32_t *join = malloc(options->players * sizeof(uint32_t));
+    uint32_t *keyframe = malloc(options->players * sizeof(uint32_t));
+    uint32_t *latencies = malloc((size_t)options->players * MAX_LATENCY_SAMPLES * sizeof(uint32_t));
+    if (join == NULL || keyframe == NULL || latencies == NULL) {
+        perror("malloc summary");
+        free(join);
+        free(keyframe);
+        free(latencies);
+        return EXIT_FAILURE;
+    }
+    size_t nb_join = 0, nb_keyframe = 0;
+
+    for (unsigned i = 0; i < options->players; i++) {
+        player_report *r = &reports[i];
+        states[r->state]++;
+        if (r->state >= PLAYER_JOINED) {
+            join[nb_join++] = r->join_us;
+        }
+        if (r->state == PLAYER_PLAYING) {
+            keyframe[nb_keyframe++] = r->keyframe_us;
+        }
+        ended += r->game_ended;
+        actions += r->actions_sent;
+        without_diff += r->actions_without_diff;
+        received += r->updates_received;
+        missed += r->updates_missed;
+        boards += r->boards_received;
+        invalid += r->invalid_messages;
+        chats_sent += r->chats_sent;
+        chats_received += r->chats_received;
+        memcpy(latencies + nb_latencies, r->latencies_us, r->nb_latencies * sizeof(uint32_t));
+        nb_latencies += r->nb_latencies;
+    }
+
+    printf("Players: %u started, %u not connected, %u without a game, %u without a keyframe, %u playing "
+           "(%u until the end of their game)\n",
+           options->players, states[PLAYER_NOT_CONNECTED], states[PLAYER_CONNECTED], states[PLAYER_JOINED],
+           states[PLAYER_PLAYING], ended);
+    print_percentiles("Join latency:", join, nb_join);
+    print_percentiles("Ready to keyframe latency:", keyframe, nb_keyframe);
+    print_percentiles("Action to diff latency:", latencies, nb_latencies);
+    printf("Actions: %" PRIu64 " sent, %" PRIu64 " moves not seen in an update\n", actions, without_diff);
+    printf("Multicast: %" PRIu64 " updates received, %" PRIu64 " missed (%.2f%% loss), %" PRIu64 " boards, %" PRIu64
+           " invalid messages\n",
+           received, missed, received + missed == 0 ? 0 : 100.0 * missed / (received + missed), boards, invalid);
+    printf("Chat: %" PRIu64 " messages sent, %" PRIu64 " received\n", chats_sent, chats_received);
+
+    free(join);
+    free(keyframe);
+    free(latencies);
+    return invalid == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+    loadgen_options options;
+    if (parse_options(argc, argv, &options) == EXIT_FAILURE) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    RETURN_FAILURE_IF_ERROR(netem_configure_from_env());
+    // With the players of the games of the server by default
+    unsigned game_players = options.version == PROTOCOL_V2 ? MAX_PLAYER_NUM : PLAYER_NUM;
+    if (options.players % game_players != 0) {
+        fprintf(stderr, "Warning: the last game is not full, its players wait until the join timeout.\n");
+    }
+
+    size_t reports_size = options.players * sizeof(player_report);
+    player_report *reports = mmap(NULL, reports_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (reports == MAP_FAILED) {
+        perror("mmap reports");
+        return EXIT_FAILURE;
+    }
+    memset(reports, 0, reports_size);
+
+    printf("Starting %u players on port %u (seed %" PRIu64 ").\n", options.players, options.port, options.seed);
+    fflush(stdout);
+    unsigned started = 0;
+    for (; started < options.players; started++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            break;
+        }
+        if (pid == 0) {
+            run_player(&options, started, &reports[started]);
+        }
+    }
+
+    for (unsigned i = 0; i < started; i++) {
+        wait(NULL);
+    }
+
+    int res = print_summary(&options, reports);
+    munmap(reports, reports_size);
+    return res;
+}
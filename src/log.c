@@ -0,0 +1,182 @@
+#include "./log.h"
+#include "./utils.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct log_entry {
+    LOG_LEVEL level;
+    char message[LOG_MESSAGE_SIZE];
+} log_entry;
+
+/** Ring of a thread, written only by its thread and read only with the lock of the rings held
+ */
+typedef struct log_ring {
+    log_entry entries[LOG_RING_SIZE];
+    atomic_uint head; // Next entry written
+    atomic_uint tail; // Next entry printed
+    atomic_uint dropped;
+    atomic_bool closed; // The thread has ended, the ring is freed once printed
+
+    uint64_t window_start_ms; // Rate limit, only used by the thread
+    unsigned window_count;
+
+    struct log_ring *next;
+} log_ring;
+
+static atomic_int min_level = LOG_LEVEL_INFO;
+
+static FILE *out_file = NULL; // stdout and stderr when NULL
+static FILE *err_file = NULL;
+
+static log_ring *rings = NULL;
+static pthread_mutex_t lock_rings = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local log_ring *thread_ring = NULL;
+
+void log_set_level(LOG_LEVEL level) {
+    atomic_store(&min_level, level);
+}
+
+void log_set_files(FILE *out, FILE *err) {
+    pthread_mutex_lock(&lock_rings);
+    out_file = out;
+    err_file = err;
+    pthread_mutex_unlock(&lock_rings);
+}
+
+static void close_ring(void *ring) {
+    atomic_store_explicit(&((log_ring *)ring)->closed, true, memory_order_release);
+}
+
+static void create_ring_key() {
+    pthread_key_create(&ring_key, close_ring);
+}
+
+/** Returns the ring of the calling thread, created at its first message
+ */
+static log_ring *get_thread_ring() {
+    if (thread_ring != NULL) {
+        return thread_ring;
+    }
+    pthread_once(&ring_key_once, create_ring_key);
+
+    log_ring *ring = calloc(1, sizeof(log_ring));
+    RETURN_NULL_IF_NULL(ring);
+    pthread_setspecific(ring_key, ring);
+
+    pthread_mutex_lock(&lock_rings);
+    ring->next = rings;
+    rings = ring;
+    pthread_mutex_unlock(&lock_rings);
+
+    thread_ring = ring;
+    return ring;
+}
+
+/** Returns true if the thread can log one more message in the current second
+ */
+static bool take_rate_token(log_ring *ring) {
+    uint64_t now_ms = get_time_ms();
+    if (now_ms - ring->window_start_ms >= 1000) {
+        ring->window_start_ms = now_ms;
+        ring->window_count = 0;
+    }
+    if (ring->window_count >= LOG_RATE_LIMIT) {
+        return false;
+    }
+    ring->window_count++;
+    return true;
+}
+
+void log_message(LOG_LEVEL level, const char *format, ...) {
+    if ((int)level < atomic_load_explicit(&min_level, memory_order_relaxed)) {
+        return;
+    }
+    log_ring *ring = get_thread_ring();
+    RETURN_IF_NULL(ring);
+
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail == LOG_RING_SIZE || !take_rate_token(ring)) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    log_entry *entry = &ring->entries[head % LOG_RING_SIZE];
+    entry->level = level;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(entry->message, LOG_MESSAGE_SIZE, format, args);
+    va_end(args);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/** Prints the messages of the ring, the lock of the rings has to be held
+ */
+static void print_ring(log_ring *ring, FILE *out, FILE *err) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    for (; tail != head; tail++) {
+        log_entry *entry = &ring->entries[tail % LOG_RING_SIZE];
+        fprintf(entry->level >= LOG_LEVEL_WARNING ? err : out, "%s\n", entry->message);
+    }
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+    unsigned dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+    if (dropped > 0) {
+        fprintf(err, "%u log messages were dropped.\n", dropped);
+    }
+}
+
+void log_flush() {
+    pthread_mutex_lock(&lock_rings);
+    FILE *out = out_file == NULL ? stdout : out_file;
+    FILE *err = err_file == NULL ? stderr : err_file;
+
+    log_ring **cur = &rings;
+    while (*cur != NULL) {
+        log_ring *ring = *cur;
+        // Read before printing, so that a message logged just before the thread ended is printed
+        bool closed = atomic_load_explicit(&ring->closed, memory_order_acquire);
+        print_ring(ring, out, err);
+        if (closed) {
+            *cur = ring->next;
+            free(ring);
+        } else {
+            cur = &ring->next;
+        }
+    }
+    fflush(out);
+    fflush(err);
+    pthread_mutex_unlock(&lock_rings);
+}
+
+static void *serve_log_writer(void *arg) {
+    (void)arg;
+    while (true) {
+        usleep(LOG_WRITE_PERIOD_MS * 1000);
+        log_flush();
+    }
+    return NULL;
+}
+
+int log_start() {
+    if (atexit(log_flush) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    pthread_t t;
+    if (pthread_create(&t, NULL, serve_log_writer, NULL) != 0) {
+        perror("pthread_create log");
+        return EXIT_FAILURE;
+    }
+    pthread_detach(t);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,53 @@
+#ifndef SRC_LOG_H_
+#define SRC_LOG_H_
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/** Logging which never blocks the thread logging: each thread formats its messages in its own ring buffer, and a
+ *  writer thread started by log_start prints them. Without the writer thread, the messages wait in the rings until
+ *  log_flush.
+ *  A thread logging more than LOG_RATE_LIMIT messages in a second, or faster than the writer prints them, loses the
+ *  extra messages, the writer then prints how many were lost.
+ */
+
+#define LOG_RING_SIZE 256
+#define LOG_MESSAGE_SIZE 160
+#define LOG_RATE_LIMIT 100 // Messages per second and per thread
+#define LOG_WRITE_PERIOD_MS 20
+
+typedef enum LOG_LEVEL {
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO = 1,    // Printed on stdout
+    LOG_LEVEL_WARNING = 2, // Printed on stderr, as the next levels
+    LOG_LEVEL_ERROR = 3,
+} LOG_LEVEL;
+
+/** The messages of a lower level are ignored, LOG_LEVEL_INFO by default
+ */
+void log_set_level(LOG_LEVEL);
+
+/** Prints the messages on out and err instead of stdout and stderr
+ */
+void log_set_files(FILE *out, FILE *err);
+
+void log_message(LOG_LEVEL, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/** Starts the thread printing the messages, which are also printed when the program exits
+ */
+int log_start();
+
+/** Prints the messages waiting in the rings of every thread
+ */
+void log_flush();
+
+#define LOG_DEBUG(...) log_message(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) log_message(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARNING(...) log_message(LOG_LEVEL_WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) log_message(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+/** Same as perror, without blocking */
+#define LOG_ERRNO(msg) log_message(LOG_LEVEL_ERROR, "%s: %s", msg, strerror(errno))
+
+#endif // SRC_LOG_H_
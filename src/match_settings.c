@@ -0,0 +1,94 @@
+#include "./match_settings.h"
+#include "./constants.h"
+#include "./utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+match_settings match_settings_default() {
+    match_settings settings = {DEFAULT_TICK_RATE, DEFAULT_SNAPSHOT_MS, BOMB_LIFETIME * 1000,
+                               {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT}};
+    return settings;
+}
+
+static int parse_bounded(const char *str, unsigned minimum, unsigned maximum, unsigned *value) {
+    int r = parse_unsigned_within_bounds(str, minimum, maximum);
+    if (r < 0) {
+        return EXIT_FAILURE;
+    }
+    *value = r;
+    return EXIT_SUCCESS;
+}
+
+static int parse_side(const char *str, unsigned minimum, int *value) {
+    unsigned side;
+    RETURN_FAILURE_IF_ERROR(parse_bounded(str, minimum, UINT16_MAX, &side));
+    *value = side;
+    return EXIT_SUCCESS;
+}
+
+static int parse_field(const char *key, const char *value, match_settings *parsed) {
+    if (strcmp(key, "tick") == 0) {
+        return parse_bounded(value, MIN_TICK_RATE, MAX_TICK_RATE, &parsed->tick_rate);
+    }
+    if (strcmp(key, "snapshot") == 0) {
+        return parse_bounded(value, MIN_SNAPSHOT_MS, MAX_SNAPSHOT_MS, &parsed->snapshot_ms);
+    }
+    if (strcmp(key, "bomb") == 0) {
+        return parse_bounded(value, MIN_BOMB_LIFETIME_MS, MAX_BOMB_LIFETIME_MS, &parsed->bomb_lifetime_ms);
+    }
+    if (strcmp(key, "width") == 0) {
+        return parse_side(value, MIN_GAMEBOARD_WIDTH, &parsed->dim.width);
+    }
+    if (strcmp(key, "height") == 0) {
+        return parse_side(value, MIN_GAMEBOARD_HEIGHT, &parsed->dim.height);
+    }
+    return EXIT_FAILURE;
+}
+
+int match_settings_parse(const char *str, match_settings *settings) {
+    char *copy = strdup(str);
+    RETURN_FAILURE_IF_NULL_PERROR(copy, "strdup match settings");
+
+    match_settings parsed = *settings;
+    int res = EXIT_SUCCESS;
+    char *save;
+    for (char *field = strtok_r(copy, ",", &save); field != NULL; field = strtok_r(NULL, ",", &save)) {
+        char *equal = strchr(field, '=');
+        if (equal == NULL) {
+            res = EXIT_FAILURE;
+            break;
+        }
+        *equal = '\0';
+        if (parse_field(field, equal + 1, &parsed) == EXIT_FAILURE) {
+            res = EXIT_FAILURE;
+            break;
+        }
+    }
+    free(copy);
+    if (res == EXIT_SUCCESS) {
+        *settings = parsed;
+    }
+    return res;
+}
+
+int match_settings_check(const match_settings *settings, PROTOCOL_VERSION version, unsigned nb_players) {
+    dimension dim = settings->dim;
+    if (dim.width < MIN_GAMEBOARD_WIDTH || dim.height < MIN_GAMEBOARD_HEIGHT ||
+        (nb_players > PLAYER_NUM && dim.width < MIN_WIDE_GAMEBOARD_WIDTH)) {
+        return EXIT_FAILURE;
+    }
+    if (version == PROTOCOL_V1) {
+        return dim.width <= MAX_V1_GAMEBOARD_SIDE && dim.height <= MAX_V1_GAMEBOARD_SIDE ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    return match_settings_keyframe_size(settings) <= MAX_UDP_PAYLOAD_SIZE ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+size_t match_settings_keyframe_size(const match_settings *settings) {
+    // The borders are not sent
+    return GAME_BOARD_V2_HEADER_SIZE + (size_t)(settings->dim.width - 2) * (settings->dim.height - 2);
+}
+
+uint64_t match_settings_tick_us(const match_settings *settings) {
+    return 1000000 / settings->tick_rate;
+}
@@ -0,0 +1,57 @@
+#ifndef SRC_MATCH_SETTINGS_H_
+#define SRC_MATCH_SETTINGS_H_
+
+#include "./messages.h"
+#include "./model.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Settings of a match, copied in the game when the server creates it from the ones of its type, a mode and a version
+ *  of the protocol: how many times per second the actions of the players are applied and their changes sent, how
+ *  often the whole board is sent, how long a bomb takes to explode and the dimension of the board given to
+ *  init_model, borders included.
+ */
+
+#define DEFAULT_TICK_RATE 20     // 50 ms between two ticks
+#define DEFAULT_SNAPSHOT_MS 1000 // Between two sends of the whole board
+#define MIN_TICK_RATE 1
+#define MAX_TICK_RATE 100
+#define MIN_SNAPSHOT_MS 100
+#define MAX_SNAPSHOT_MS 10000 // The end of the game is noticed after a snapshot
+#define MIN_BOMB_LIFETIME_MS 100
+#define MAX_BOMB_LIFETIME_MS 60000
+#define MAX_V1_GAMEBOARD_SIDE (UINT8_MAX + 2) // The first version sends each side, without the borders, in a byte
+#define MAX_UDP_PAYLOAD_SIZE 65507            // The whole board is sent in a single datagram
+
+typedef struct match_settings {
+    unsigned tick_rate;
+    unsigned snapshot_ms;
+    unsigned bomb_lifetime_ms;
+    dimension dim;
+} match_settings;
+
+/** Returns the settings of a match when none is chosen, the ones of the constants
+ */
+match_settings match_settings_default();
+
+/** Parses settings written as "tick=30,snapshot=500,bomb=2000,width=41,height=21" over settings, the missing fields
+ *  keep their value. Returns EXIT_FAILURE, leaving settings unchanged, if a field is unknown or its value is out of its
+ *  bounds.
+ */
+int match_settings_parse(const char *str, match_settings *settings);
+
+/** Returns EXIT_FAILURE if the board of settings cannot be used by the games of nb_players with the version of the
+ *  protocol: it is too small for them, or its messages do not fit the protocol
+ */
+int match_settings_check(const match_settings *settings, PROTOCOL_VERSION version, unsigned nb_players);
+
+/** Returns the size of the largest keyframe of the board of the match, in the layout of either version
+ */
+size_t match_settings_keyframe_size(const match_settings *settings);
+
+/** Returns the time in microseconds between two ticks of the match
+ */
+uint64_t match_settings_tick_us(const match_settings *settings);
+
+#endif // SRC_MATCH_SETTINGS_H_
@@ -9,10 +9,47 @@
 
 #define BYTE_SIZE 8
 
-static uint16_t connection_header_value(int codereq, int id, int team_number) {
+/** Returns the header in network byte order, in the layout of the second version if it is the given one or if the id
+ *  does not fit in the layout of the first version
+ */
+static uint16_t versioned_header_value(int codereq, int id, int team_number, PROTOCOL_VERSION version) {
+    if (version == PROTOCOL_V2 || id >= PLAYER_NUM) {
+        return htons(PROTOCOL_V2_FLAG | (codereq << 5) | ((id & 0xF) << 1) | (team_number & 0x1));
+    }
     return htons(((team_number & 0x1)) | ((id & 0x3) << 1) | (codereq << 3));
 }
 
+static uint16_t connection_header_value(int codereq, int id, int team_number) {
+    return versioned_header_value(codereq, id, team_number, PROTOCOL_V1);
+}
+
+/** Reads the header in host byte order, in the layout of either version
+ */
+static message_header read_header(uint16_t header) {
+    message_header res;
+    if (header & PROTOCOL_V2_FLAG) {
+        res.codereq = (header & ~PROTOCOL_V2_FLAG) >> 5;
+        res.id = (header >> 1) & 0xF;
+    } else {
+        res.codereq = header >> 3;
+        res.id = (header >> 1) & 0x3;
+    }
+    res.eq = header & 0x1;
+    return res;
+}
+
+/** Returns true if the message, which starts with its header, is written in the layout of the second version
+ */
+static bool is_v2_layout(const char *message) {
+    return read_be16((const unsigned char *)message) & PROTOCOL_V2_FLAG;
+}
+
+/** Returns true if the tile can be sent to a client, the borders are only drawn by the clients
+ */
+static bool is_sent_tile(TILE tile) {
+    return tile <= PLAYER_4 || (tile >= PLAYER_5 && tile <= PLAYER_16);
+}
+
 connection_header_raw *create_connection_header_raw(int codereq, int id, int team_number) {
     connection_header_raw *connection_req = malloc(sizeof(connection_header_raw));
     RETURN_NULL_IF_NULL_PERROR(connection_req, "malloc");
@@ -34,16 +71,19 @@ connection_header_raw *serialize_initial_connection(const initial_connection_hea
         default:
             return NULL;
     }
-    return create_connection_header_raw(codereq, 0, 0);
+    if (header->version != PROTOCOL_V1 && header->version != PROTOCOL_V2) {
+        return NULL;
+    }
+    return create_connection_header_raw(codereq, header->version - PROTOCOL_V1, header->capabilities);
 }
 
 initial_connection_header *deserialize_initial_connection(const connection_header_raw *header) {
     initial_connection_header *initial_connection = malloc(sizeof(initial_connection_header));
     RETURN_NULL_IF_NULL_PERROR(initial_connection, "malloc");
 
-    uint16_t req = ntohs(header->req);
+    message_header req = read_header(ntohs(header->req));
 
-    switch (req >> 3) {
+    switch (req.codereq) {
         case 1:
             initial_connection->game_mode = SOLO;
             break;
@@ -55,9 +95,32 @@ initial_connection_header *deserialize_initial_connection(const connection_heade
             return NULL;
     }
 
+    // A client of a later version gets the highest one both support
+    initial_connection->version = req.id == 0 ? PROTOCOL_V1 : PROTOCOL_V2;
+    initial_connection->capabilities = req.eq;
     return initial_connection;
 }
 
+char *serialize_capabilities(const capabilities *caps) {
+    unsigned char *serialized = malloc(CAPABILITIES_SIZE);
+    RETURN_NULL_IF_NULL_PERROR(serialized, "malloc");
+    uint16_t header = connection_header_value(CAPABILITIES_CODE, 0, 0);
+    memcpy(serialized, &header, sizeof(uint16_t));
+    write_be16(serialized + 2, caps->flags);
+    write_be16(serialized + 4, caps->max_datagram);
+    return (char *)serialized;
+}
+
+int read_capabilities(const char *message, size_t size, capabilities *caps) {
+    const unsigned char *raw = (const unsigned char *)message;
+    if (size < CAPABILITIES_SIZE || read_header(read_be16(raw)).codereq != CAPABILITIES_CODE) {
+        return EXIT_FAILURE;
+    }
+    caps->flags = read_be16(raw + 2);
+    caps->max_datagram = read_be16(raw + 4);
+    return caps->max_datagram < MIN_DATAGRAM_SIZE ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 connection_header_raw *serialize_ready_connection(const ready_connection_header *header) {
     int codereq = 1;
     switch (header->game_mode) {
@@ -71,7 +134,7 @@ connection_header_raw *serialize_ready_connection(const ready_connection_header
             return NULL;
     }
 
-    if (header->id < 0 || header->id > 3) {
+    if (header->id < 0 || header->id >= MAX_PLAYER_NUM) {
         return NULL;
     }
 
@@ -85,9 +148,9 @@ ready_connection_header *deserialize_ready_connection(const connection_header_ra
     ready_connection_header *ready_connection = malloc(sizeof(ready_connection_header));
     RETURN_NULL_IF_NULL_PERROR(ready_connection, "malloc");
 
-    uint16_t req = ntohs(header->req);
+    message_header req = read_header(ntohs(header->req));
 
-    switch (req >> 3) {
+    switch (req.codereq) {
         case 3:
             ready_connection->game_mode = SOLO;
             break;
@@ -99,8 +162,8 @@ ready_connection_header *deserialize_ready_connection(const connection_header_ra
             return NULL;
     }
 
-    ready_connection->id = (req >> 1) & 0x3; // We only need 2 bits
-    ready_connection->eq = req & 0x1;        // We only need 1 bit
+    ready_connection->id = req.id;
+    ready_connection->eq = req.eq;
     return ready_connection;
 }
 
@@ -117,7 +180,11 @@ connection_information_raw *serialize_connection_information(const connection_in
             return NULL;
     }
 
-    if (info->id < 0 || info->id > 3) {
+    if (info->version != PROTOCOL_V1 && info->version != PROTOCOL_V2) {
+        return NULL;
+    }
+
+    if (info->id < 0 || info->id >= (info->version == PROTOCOL_V2 ? MAX_PLAYER_NUM : PLAYER_NUM)) {
         return NULL;
     }
 
@@ -128,7 +195,7 @@ connection_information_raw *serialize_connection_information(const connection_in
     connection_information_raw *raw = malloc(sizeof(connection_information_raw));
     RETURN_NULL_IF_NULL_PERROR(raw, "malloc");
 
-    raw->header = connection_header_value(codereq, info->id, info->eq);
+    raw->header = versioned_header_value(codereq, info->id, info->eq, info->version);
 
     raw->portudp = htons(info->portudp);
     raw->portmdiff = htons(info->portmdiff);
@@ -142,9 +209,9 @@ connection_information *deserialize_connection_information(const connection_info
     connection_information *connection_info = malloc(sizeof(connection_information));
     RETURN_NULL_IF_NULL_PERROR(connection_info, "malloc");
 
-    uint16_t header = ntohs(info->header);
+    message_header header = read_header(ntohs(info->header));
 
-    switch (header >> 3) {
+    switch (header.codereq) {
         case 9:
             connection_info->game_mode = SOLO;
             break;
@@ -156,8 +223,9 @@ connection_information *deserialize_connection_information(const connection_info
             return NULL;
     }
 
-    connection_info->id = (header >> 1) & 0x3; // We only need 2 bits
-    connection_info->eq = header & 0x1;        // We only need 1 bit
+    connection_info->version = (ntohs(info->header) & PROTOCOL_V2_FLAG) ? PROTOCOL_V2 : PROTOCOL_V1;
+    connection_info->id = header.id;
+    connection_info->eq = header.eq;
 
     connection_info->portudp = ntohs(info->portudp);
     connection_info->portmdiff = ntohs(info->portmdiff);
@@ -200,7 +268,7 @@ char *serialize_game_action(const game_action *game_action) {
             return NULL;
     }
 
-    if (game_action->id < 0 || game_action->id > 3) {
+    if (game_action->id < 0 || game_action->id >= MAX_PLAYER_NUM) {
         free(raw);
         return NULL;
     }
@@ -212,7 +280,7 @@ char *serialize_game_action(const game_action *game_action) {
 
     uint16_t header = connection_header_value(codereq, game_action->id, game_action->eq);
 
-    if (game_action->message_number < 0 || game_action->message_number >= (1 << 13)) {
+    if (game_action->message_number < 0 || game_action->message_number >= GAME_ACTION_MESSAGE_NUMBER_LIMIT) {
         free(raw);
         return NULL;
     }
@@ -240,10 +308,10 @@ game_action *deserialize_game_action(const char *game_action_raw) {
     memcpy(&header, game_action_raw, sizeof(uint16_t));
     memcpy(&action, game_action_raw + sizeof(uint16_t), sizeof(uint16_t));
 
-    header = ntohs(header);
+    message_header fields = read_header(ntohs(header));
     action = ntohs(action);
 
-    switch (header >> 3) {
+    switch (fields.codereq) {
         case 5:
             game_action_->game_mode = SOLO;
             break;
@@ -255,8 +323,8 @@ game_action *deserialize_game_action(const char *game_action_raw) {
             return NULL;
     }
 
-    game_action_->id = (header >> 1) & 0x3; // We only need 2 bits
-    game_action_->eq = header & 0x1;        // We only need 1 bit
+    game_action_->id = fields.id;
+    game_action_->eq = fields.eq;
 
     game_action_->message_number = action >> 3;
     game_action_->action = action & 0x7; // We only need 3 bits
@@ -264,132 +332,424 @@ game_action *deserialize_game_action(const char *game_action_raw) {
     return game_action_;
 }
 
-char *serialize_game_board(const game_board_information *info) {
-    // 6 corresponds to the number of bytes of the header, the
-    // message number and the height and width of the board
-    char *serialized = malloc((info->height * info->width) + 6);
-    RETURN_NULL_IF_NULL_PERROR(serialized, "malloc");
+char *serialize_game_action_batch(const game_action *actions, unsigned nb) {
+    if (nb == 0 || nb > GAME_ACTION_BATCH_MAX) {
+        return NULL;
+    }
+    char *batch = malloc(nb * GAME_ACTION_SIZE);
+    RETURN_NULL_IF_NULL_PERROR(batch, "malloc");
+    for (unsigned i = 0; i < nb; i++) {
+        char *serialized = actions[i].id == actions[0].id ? serialize_game_action(&actions[i]) : NULL;
+        if (serialized == NULL) {
+            free(batch);
+            return NULL;
+        }
+        memcpy(batch + i * GAME_ACTION_SIZE, serialized, GAME_ACTION_SIZE);
+        free(serialized);
+    }
+    return batch;
+}
 
-    uint16_t header = connection_header_value(11, 0, 0);
-    uint16_t num = htons(info->num);
+unsigned deserialize_game_action_batch(const char *batch, size_t size, game_action **actions) {
+    if (size == 0 || size % GAME_ACTION_SIZE != 0 || size > GAME_ACTION_BATCH_MAX * GAME_ACTION_SIZE) {
+        return 0;
+    }
+    unsigned nb = size / GAME_ACTION_SIZE;
+    for (unsigned i = 0; i < nb; i++) {
+        actions[i] = deserialize_game_action(batch + i * GAME_ACTION_SIZE);
+        if (actions[i] == NULL || actions[i]->id != actions[0]->id || actions[i]->game_mode != actions[0]->game_mode) {
+            for (unsigned j = 0; j <= i; j++) {
+                free(actions[j]);
+            }
+            return 0;
+        }
+    }
+    return nb;
+}
 
-    // Split into 2 bytes
-    serialized[0] = header & 0xFF;
-    serialized[1] = header >> 8;
+#define GAME_BOARD_CODE 11
 
-    // Split into 2 bytes
-    serialized[2] = num & 0xFF;
-    serialized[3] = num >> 8;
+/** Returns true if the board needs the layout of the second version, with 16-bit dimensions
+ */
+static bool is_wide_board(const game_board_information *info) {
+    if (info->height > UINT8_MAX || info->width > UINT8_MAX) {
+        return true;
+    }
+    for (int i = 0; i < info->height * info->width; ++i) {
+        if (info->board[i] > PLAYER_4) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static char *serialize_board(const game_board_information *info, int codereq) {
+    bool wide = is_wide_board(info);
+    size_t header_size = wide ? GAME_BOARD_V2_HEADER_SIZE : GAME_BOARD_HEADER_SIZE;
+    unsigned char *serialized = malloc((info->height * info->width) + header_size);
+    RETURN_NULL_IF_NULL_PERROR(serialized, "malloc");
 
-    serialized[4] = info->height;
-    serialized[5] = info->width;
+    // The header, the message number and the height and width of the board
+    uint16_t header = versioned_header_value(codereq, 0, 0, wide ? PROTOCOL_V2 : PROTOCOL_V1);
+    memcpy(serialized, &header, sizeof(uint16_t));
+    write_be16(serialized + 2, info->num);
+    if (wide) {
+        write_be16(serialized + 4, info->height);
+        write_be16(serialized + 6, info->width);
+    } else {
+        serialized[4] = info->height;
+        serialized[5] = info->width;
+    }
 
     for (int i = 0; i < info->height * info->width; ++i) {
-        if (info->board[i] > 8) {
+        if (!is_sent_tile(info->board[i])) {
             free(serialized);
             return NULL;
         }
-        serialized[6 + i] = info->board[i];
+        serialized[header_size + i] = info->board[i];
     }
 
-    return serialized;
+    return (char *)serialized;
 }
 
-game_board_information *deserialize_game_board(const char *info) {
+/** Reads the number and the dimensions of a board or a keyframe, and returns the size of its header
+ */
+static size_t read_board_header(const char *info, uint16_t *num, uint16_t *height, uint16_t *width) {
+    const unsigned char *raw = (const unsigned char *)info;
+    *num = read_be16(raw + 2);
+    if (is_v2_layout(info)) {
+        *height = read_be16(raw + 4);
+        *width = read_be16(raw + 6);
+        return GAME_BOARD_V2_HEADER_SIZE;
+    }
+    *height = raw[4];
+    *width = raw[5];
+    return GAME_BOARD_HEADER_SIZE;
+}
+
+static game_board_information *deserialize_board(const char *info, int codereq) {
+    message_header header = read_header(ntohs(*(uint16_t *)info));
+    if (header.codereq != codereq || header.id != 0 || header.eq != 0) {
+        return NULL;
+    }
+
     game_board_information *game_board_info = malloc(sizeof(game_board_information));
     RETURN_NULL_IF_NULL_PERROR(game_board_info, "malloc");
 
-    uint16_t header = ntohs(*(uint16_t *)info);
+    size_t header_size = read_board_header(info, &game_board_info->num, &game_board_info->height,
+                                           &game_board_info->width);
+    unsigned size = game_board_info->height * game_board_info->width;
 
-    if ((header >> 3) != 11) {
+    game_board_info->board = malloc(size * sizeof(TILE));
+    if (game_board_info->board == NULL) {
         free(game_board_info);
         return NULL;
     }
 
-    if (((header >> 1) & 0x3) != 0) {
-        free(game_board_info);
-        return NULL;
+    for (unsigned i = 0; i < size; ++i) {
+        game_board_info->board[i] = (uint8_t)info[header_size + i];
     }
 
-    if ((header & 0x1) != 0) {
-        free(game_board_info);
+    return game_board_info;
+}
+
+char *serialize_game_board(const game_board_information *info) {
+    return serialize_board(info, GAME_BOARD_CODE);
+}
+
+game_board_information *deserialize_game_board(const char *info) {
+    return deserialize_board(info, GAME_BOARD_CODE);
+}
+
+char *serialize_game_board_keyframe(const game_board_information *info) {
+    return serialize_board(info, KEYFRAME_CODE);
+}
+
+game_board_information *deserialize_game_board_keyframe(const char *info) {
+    return deserialize_board(info, KEYFRAME_CODE);
+}
+
+size_t game_board_size(const char *message) {
+    uint16_t num, height, width;
+    return read_board_header(message, &num, &height, &width) + (size_t)height * width;
+}
+
+size_t game_board_header_size(const char *message) {
+    uint16_t header;
+    memcpy(&header, message, sizeof(uint16_t));
+    if (message_code(header) == GAME_BOARD_REGION_CODE) {
+        return is_v2_layout(message) ? GAME_BOARD_REGION_V2_HEADER_SIZE : GAME_BOARD_REGION_HEADER_SIZE;
+    }
+    return is_v2_layout(message) ? GAME_BOARD_V2_HEADER_SIZE : GAME_BOARD_HEADER_SIZE;
+}
+
+int read_game_board(const char *message, size_t size, uint16_t *num, uint16_t *height, uint16_t *width) {
+    if (size < GAME_BOARD_HEADER_SIZE) {
+        return EXIT_FAILURE;
+    }
+
+    message_header header = read_header(read_be16((const unsigned char *)message));
+    if (header.codereq != GAME_BOARD_CODE || header.id != 0 || header.eq != 0 ||
+        size < game_board_header_size(message)) {
+        return EXIT_FAILURE;
+    }
+
+    size_t header_size = read_board_header(message, num, height, width);
+    if (size < header_size + (size_t)*height * *width) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+char *serialize_game_board_region(uint16_t num, const board *board_, uint16_t x, uint16_t y, uint16_t width,
+                                  uint16_t height, size_t *size) {
+    if (x + width > board_->dim.width || y + height > board_->dim.height) {
         return NULL;
     }
+    bool wide = x > UINT8_MAX || y > UINT8_MAX || width > UINT8_MAX || height > UINT8_MAX;
+    size_t header_size = wide ? GAME_BOARD_REGION_V2_HEADER_SIZE : GAME_BOARD_REGION_HEADER_SIZE;
+    *size = header_size + width * height;
+    unsigned char *serialized = malloc(*size);
+    RETURN_NULL_IF_NULL_PERROR(serialized, "malloc");
 
-    game_board_info->num = ntohs(*(uint16_t *)(info + 2));
-    game_board_info->height = info[4];
-    game_board_info->width = info[5];
+    uint16_t header = versioned_header_value(GAME_BOARD_REGION_CODE, 0, 0, wide ? PROTOCOL_V2 : PROTOCOL_V1);
+    memcpy(serialized, &header, sizeof(uint16_t));
+    write_be16(serialized + 2, num);
+    if (wide) {
+        write_be16(serialized + 4, x);
+        write_be16(serialized + 6, y);
+        write_be16(serialized + 8, width);
+        write_be16(serialized + 10, height);
+    } else {
+        serialized[4] = x;
+        serialized[5] = y;
+        serialized[6] = width;
+        serialized[7] = height;
+    }
 
-    unsigned size = game_board_info->height * game_board_info->width;
+    for (unsigned row = 0; row < height; row++) {
+        memcpy(serialized + header_size + row * width, board_->grid + (y + row) * board_->dim.width + x, width);
+    }
+    return (char *)serialized;
+}
 
-    game_board_info->board = malloc(size * sizeof(TILE));
-    if (game_board_info->board == NULL) {
-        free(game_board_info);
+int read_game_board_region(const char *message, size_t size, uint16_t *num, uint16_t *x, uint16_t *y,
+                           uint16_t *width, uint16_t *height) {
+    if (size < GAME_BOARD_REGION_HEADER_SIZE) {
+        return EXIT_FAILURE;
+    }
+
+    const unsigned char *raw = (const unsigned char *)message;
+    message_header header = read_header(read_be16(raw));
+    size_t header_size = game_board_header_size(message);
+    if (header.codereq != GAME_BOARD_REGION_CODE || header.id != 0 || header.eq != 0 || size < header_size) {
+        return EXIT_FAILURE;
+    }
+
+    *num = read_be16(raw + 2);
+    if (is_v2_layout(message)) {
+        *x = read_be16(raw + 4);
+        *y = read_be16(raw + 6);
+        *width = read_be16(raw + 8);
+        *height = read_be16(raw + 10);
+    } else {
+        *x = raw[4];
+        *y = raw[5];
+        *width = raw[6];
+        *height = raw[7];
+    }
+
+    if (size < header_size + (size_t)*height * *width) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+char *serialize_subscription(const subscription_message *subscription) {
+    if (subscription->id < 0 || subscription->id >= MAX_PLAYER_NUM || subscription->eq < 0 || subscription->eq > 1) {
         return NULL;
     }
+    unsigned char *serialized = malloc(UDP_SUBSCRIBE_SIZE);
+    RETURN_NULL_IF_NULL_PERROR(serialized, "malloc");
+    uint16_t header = connection_header_value(UDP_SUBSCRIBE_CODE, subscription->id, subscription->eq);
+    memcpy(serialized, &header, sizeof(uint16_t));
+    write_be64(serialized + 2, subscription->token);
+    serialized[10] = subscription->unicast;
+    return (char *)serialized;
+}
 
-    for (unsigned i = 0; i < size; ++i) {
-        game_board_info->board[i] = info[6 + i];
+int read_subscription(const char *message, size_t size, subscription_message *subscription) {
+    const unsigned char *raw = (const unsigned char *)message;
+    if (size < UDP_SUBSCRIBE_SIZE) {
+        return EXIT_FAILURE;
     }
+    message_header header = read_header(read_be16(raw));
+    if (header.codereq != UDP_SUBSCRIBE_CODE) {
+        return EXIT_FAILURE;
+    }
+    subscription->id = header.id;
+    subscription->eq = header.eq;
+    subscription->token = read_be64(raw + 2);
+    subscription->unicast = raw[10] != 0;
+    return EXIT_SUCCESS;
+}
 
-    return game_board_info;
+char *serialize_subscription_token(uint64_t token) {
+    unsigned char *serialized = malloc(SUBSCRIPTION_TOKEN_SIZE);
+    RETURN_NULL_IF_NULL_PERROR(serialized, "malloc");
+    uint16_t header = connection_header_value(SUBSCRIPTION_TOKEN_CODE, 0, 0);
+    memcpy(serialized, &header, sizeof(uint16_t));
+    write_be64(serialized + 2, token);
+    return (char *)serialized;
 }
 
-char *serialize_game_board_update(const game_board_update *update) {
-    // 5 corresponds to the number of bytes of the header, the message number
-    // and the number of tile_diffs
-    char *serialized = malloc((update->nb * 3) + 5);
+int read_subscription_token(const char *message, size_t size, uint64_t *token) {
+    const unsigned char *raw = (const unsigned char *)message;
+    if (size < SUBSCRIPTION_TOKEN_SIZE || read_header(read_be16(raw)).codereq != SUBSCRIPTION_TOKEN_CODE) {
+        return EXIT_FAILURE;
+    }
+    *token = read_be64(raw + 2);
+    return EXIT_SUCCESS;
+}
+
+char *serialize_ping(uint64_t sent_us) {
+    unsigned char *serialized = malloc(PING_SIZE);
     RETURN_NULL_IF_NULL_PERROR(serialized, "malloc");
+    write_be16(serialized, PING_CODE << 3);
+    write_be64(serialized + 2, sent_us);
+    return (char *)serialized;
+}
 
-    uint16_t header = connection_header_value(12, 0, 0);
-    uint16_t num = htons(update->num);
+int read_ping(const char *message, size_t size, uint64_t *sent_us) {
+    const unsigned char *raw = (const unsigned char *)message;
+    if (size < PING_SIZE || read_be16(raw) != PING_CODE << 3) {
+        return EXIT_FAILURE;
+    }
+    *sent_us = read_be64(raw + 2);
+    return EXIT_SUCCESS;
+}
 
-    // Split into 2 bytes
-    serialized[0] = header & 0xFF;
-    serialized[1] = header >> 8;
+char *serialize_pong(const pong_message *pong) {
+    if (pong->id < 0 || pong->id >= MAX_PLAYER_NUM || pong->eq < 0 || pong->eq > 1) {
+        return NULL;
+    }
+    unsigned char *serialized = malloc(PONG_SIZE);
+    RETURN_NULL_IF_NULL_PERROR(serialized, "malloc");
+    uint16_t header = connection_header_value(PONG_CODE, pong->id, pong->eq);
+    memcpy(serialized, &header, sizeof(uint16_t));
+    write_be64(serialized + 2, pong->ping_sent_us);
+    write_be64(serialized + 10, pong->ping_received_us);
+    write_be64(serialized + 18, pong->sent_us);
+    return (char *)serialized;
+}
 
-    // Split into 2 bytes
-    serialized[2] = num & 0xFF;
-    serialized[3] = num >> 8;
+int read_pong(const char *message, size_t size, pong_message *pong) {
+    const unsigned char *raw = (const unsigned char *)message;
+    if (size < PONG_SIZE) {
+        return EXIT_FAILURE;
+    }
+    message_header header = read_header(read_be16(raw));
+    if (header.codereq != PONG_CODE) {
+        return EXIT_FAILURE;
+    }
+    pong->id = header.id;
+    pong->eq = header.eq;
+    pong->ping_sent_us = read_be64(raw + 2);
+    pong->ping_received_us = read_be64(raw + 10);
+    pong->sent_us = read_be64(raw + 18);
+    return EXIT_SUCCESS;
+}
+
+#define GAME_BOARD_UPDATE_CODE 12
 
-    serialized[4] = update->nb;
+unsigned max_tile_diffs(PROTOCOL_VERSION version) {
+    return version == PROTOCOL_V2 ? UINT16_MAX : UINT8_MAX;
+}
+
+unsigned max_tile_diffs_in(PROTOCOL_VERSION version, size_t max_size) {
+    // The updates of the second version can have the wider layout
+    size_t header_size = version == PROTOCOL_V2 ? GAME_BOARD_UPDATE_V2_HEADER_SIZE : GAME_BOARD_UPDATE_HEADER_SIZE;
+    size_t diff_size = version == PROTOCOL_V2 ? TILE_DIFF_V2_SIZE : TILE_DIFF_SIZE;
+    if (max_size <= header_size) {
+        return 0;
+    }
+    size_t nb = (max_size - header_size) / diff_size;
+    return nb < max_tile_diffs(version) ? nb : max_tile_diffs(version);
+}
 
+/** Returns true if the update needs the layout of the second version, with 16-bit coordinates and number of diffs
+ */
+static bool is_wide_update(const game_board_update *update) {
+    if (update->nb > UINT8_MAX) {
+        return true;
+    }
     for (int i = 0; i < update->nb; ++i) {
-        if (update->diff[i].tile > 8) {
-            free(serialized);
-            return NULL;
+        if (update->diff[i].x > UINT8_MAX || update->diff[i].y > UINT8_MAX || update->diff[i].tile > PLAYER_4) {
+            return true;
         }
-        serialized[5 + i * 3] = update->diff[i].x;
-        serialized[6 + i * 3] = update->diff[i].y;
-        serialized[7 + i * 3] = update->diff[i].tile;
     }
-
-    return serialized;
+    return false;
 }
 
-game_board_update *deserialize_game_board_update(const char *update) {
-    game_board_update *game_board_update_ = malloc(sizeof(game_board_update));
-    RETURN_NULL_IF_NULL_PERROR(game_board_update_, "malloc");
-
-    uint16_t header = ntohs(*(uint16_t *)update);
+char *serialize_game_board_update(const game_board_update *update) {
+    bool wide = is_wide_update(update);
+    size_t header_size = wide ? GAME_BOARD_UPDATE_V2_HEADER_SIZE : GAME_BOARD_UPDATE_HEADER_SIZE;
+    size_t diff_size = wide ? TILE_DIFF_V2_SIZE : TILE_DIFF_SIZE;
+    unsigned char *serialized = malloc(header_size + update->nb * diff_size);
+    RETURN_NULL_IF_NULL_PERROR(serialized, "malloc");
 
-    if ((header >> 3) != 12) {
-        free(game_board_update_);
-        return NULL;
+    // The header, the message number and the number of tile_diffs
+    uint16_t header = versioned_header_value(GAME_BOARD_UPDATE_CODE, 0, 0, wide ? PROTOCOL_V2 : PROTOCOL_V1);
+    memcpy(serialized, &header, sizeof(uint16_t));
+    write_be16(serialized + 2, update->num);
+    if (wide) {
+        write_be16(serialized + 4, update->nb);
+    } else {
+        serialized[4] = update->nb;
     }
 
-    if (((header >> 1) & 0x1) != 0) {
-        free(game_board_update_);
-        return NULL;
+    for (int i = 0; i < update->nb; ++i) {
+        if (!is_sent_tile(update->diff[i].tile)) {
+            free(serialized);
+            return NULL;
+        }
+        unsigned char *diff = serialized + header_size + i * diff_size;
+        if (wide) {
+            write_be16(diff, update->diff[i].x);
+            write_be16(diff + 2, update->diff[i].y);
+        } else {
+            diff[0] = update->diff[i].x;
+            diff[1] = update->diff[i].y;
+        }
+        diff[diff_size - 1] = update->diff[i].tile;
     }
 
-    if ((header & 0x1) != 0) {
-        free(game_board_update_);
+    return (char *)serialized;
+}
+
+/** Reads the number of the update and its number of tile_diffs, and returns the size of its header
+ */
+static size_t read_update_header(const char *update, uint16_t *num, uint16_t *nb) {
+    const unsigned char *raw = (const unsigned char *)update;
+    *num = read_be16(raw + 2);
+    if (is_v2_layout(update)) {
+        *nb = read_be16(raw + 4);
+        return GAME_BOARD_UPDATE_V2_HEADER_SIZE;
+    }
+    *nb = raw[4];
+    return GAME_BOARD_UPDATE_HEADER_SIZE;
+}
+
+game_board_update *deserialize_game_board_update(const char *update) {
+    message_header header = read_header(ntohs(*(uint16_t *)update));
+    if (header.codereq != GAME_BOARD_UPDATE_CODE || header.id != 0 || header.eq != 0) {
         return NULL;
     }
 
-    game_board_update_->num = ntohs(*(uint16_t *)(update + 2));
-    game_board_update_->nb = update[4];
+    game_board_update *game_board_update_ = malloc(sizeof(game_board_update));
+    RETURN_NULL_IF_NULL_PERROR(game_board_update_, "malloc");
+
+    read_update_header(update, &game_board_update_->num, &game_board_update_->nb);
 
     game_board_update_->diff = malloc(sizeof(tile_diff) * game_board_update_->nb);
 
@@ -399,14 +759,18 @@ game_board_update *deserialize_game_board_update(const char *update) {
     }
 
     for (int i = 0; i < game_board_update_->nb; ++i) {
-        game_board_update_->diff[i].x = update[5 + i * 3];
-        game_board_update_->diff[i].y = update[6 + i * 3];
-        game_board_update_->diff[i].tile = update[7 + i * 3];
+        game_board_update_->diff[i] = read_game_board_update_diff(update, i);
     }
 
     return game_board_update_;
 }
 
+size_t game_board_update_size(const char *message) {
+    uint16_t num, nb;
+    size_t header_size = read_update_header(message, &num, &nb);
+    return header_size + (size_t)nb * (is_v2_layout(message) ? TILE_DIFF_V2_SIZE : TILE_DIFF_SIZE);
+}
+
 static char *serialize_chat_message(const chat_message *message, int initial_codereq) {
     // 2 for the header and 1 for the message length (2+1=3)
     char *serialized = malloc(3 + message->message_length);
@@ -423,7 +787,7 @@ static char *serialize_chat_message(const chat_message *message, int initial_cod
         return NULL;
     }
 
-    if (message->id < 0 || message->id > 3) {
+    if (message->id < 0 || message->id >= MAX_PLAYER_NUM) {
         free(serialized);
         return NULL;
     }
@@ -461,19 +825,19 @@ chat_message *deserialize_chat_message(const char *message, int initial_codereq)
     chat_message *chat_message_ = malloc(sizeof(chat_message));
     RETURN_NULL_IF_NULL_PERROR(chat_message_, "malloc");
 
-    uint16_t header = ntohs(*(uint16_t *)message);
+    message_header header = read_header(ntohs(*(uint16_t *)message));
 
-    if ((header >> 3) == initial_codereq) {
+    if (header.codereq == initial_codereq) {
         chat_message_->type = GLOBAL_M;
-    } else if ((header >> 3) == initial_codereq + 1) {
+    } else if (header.codereq == initial_codereq + 1) {
         chat_message_->type = TEAM_M;
     } else {
         free(chat_message_);
         return NULL;
     }
 
-    chat_message_->id = (header >> 1) & 0x3; // We only need 2 bits
-    chat_message_->eq = header & 0x1;        // We only need 1 bit
+    chat_message_->id = header.id;
+    chat_message_->eq = header.eq;
 
     chat_message_->message_length = message[2];
 
@@ -515,7 +879,7 @@ char *serialize_game_end(const game_end *end) {
             return NULL;
     }
 
-    if (end->game_mode == SOLO && (end->id < 0 || end->id > 3)) {
+    if (end->game_mode == SOLO && (end->id < 0 || end->id >= MAX_PLAYER_NUM)) {
         free(serialized);
         return NULL;
     }
@@ -538,9 +902,9 @@ game_end *deserialize_game_end(const char *end) {
     game_end *game_end_ = malloc(sizeof(game_end));
     RETURN_NULL_IF_NULL_PERROR(game_end_, "malloc");
 
-    uint16_t header = ntohs(*(uint16_t *)end);
+    message_header header = read_header(ntohs(*(uint16_t *)end));
 
-    switch (header >> 3) {
+    switch (header.codereq) {
         case 15:
             game_end_->game_mode = SOLO;
             break;
@@ -552,25 +916,100 @@ game_end *deserialize_game_end(const char *end) {
             return NULL;
     }
 
-    game_end_->id = (header >> 1) & 0x3; // We only need 2 bits
-    game_end_->eq = header & 0x1;        // We only need 1 bit
+    game_end_->id = header.id;
+    game_end_->eq = header.eq;
 
     return game_end_;
 }
 
+int read_game_board_update(const char *message, size_t size, uint16_t *num, uint16_t *nb) {
+    if (size < GAME_BOARD_UPDATE_HEADER_SIZE) {
+        return EXIT_FAILURE;
+    }
+
+    message_header header = read_header(read_be16((const unsigned char *)message));
+    if (header.codereq != GAME_BOARD_UPDATE_CODE || header.id != 0 || header.eq != 0 ||
+        (is_v2_layout(message) && size < GAME_BOARD_UPDATE_V2_HEADER_SIZE)) {
+        return EXIT_FAILURE;
+    }
+
+    read_update_header(message, num, nb);
+    if (size < game_board_update_size(message)) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+tile_diff read_game_board_update_diff(const char *message, unsigned i) {
+    tile_diff res;
+    if (is_v2_layout(message)) {
+        const unsigned char *diff =
+            (const unsigned char *)message + GAME_BOARD_UPDATE_V2_HEADER_SIZE + i * TILE_DIFF_V2_SIZE;
+        res.x = read_be16(diff);
+        res.y = read_be16(diff + 2);
+        res.tile = diff[4];
+        return res;
+    }
+    const unsigned char *diff = (const unsigned char *)message + GAME_BOARD_UPDATE_HEADER_SIZE + i * TILE_DIFF_SIZE;
+    res.x = diff[0];
+    res.y = diff[1];
+    res.tile = diff[2];
+    return res;
+}
+
 message_header *deserialize_message_header(uint16_t header) {
     message_header *message_header_ = malloc(sizeof(message_header));
     RETURN_NULL_IF_NULL_PERROR(message_header_, "malloc");
 
-    uint16_t header_ntoh = ntohs(header);
+    *message_header_ = read_header(ntohs(header));
+    return message_header_;
+}
 
-    message_header_->codereq = header_ntoh >> 3;
-    message_header_->id = (header_ntoh >> 1) & 0x3; // We only need 2 bits
-    message_header_->eq = header_ntoh & 0x1;        // We only need 1 bit
+message_header read_message_header(uint16_t header) {
+    return read_header(ntohs(header));
+}
 
-    return message_header_;
+int message_code(uint16_t header) {
+    return read_header(ntohs(header)).codereq;
 }
 
 uint16_t serialize_message_header(const message_header *header) {
     return connection_header_value(header->codereq, header->id, header->eq);
 }
+
+long message_frame_length(const char *data, size_t size) {
+    if (size < sizeof(uint16_t)) {
+        return 0;
+    }
+    uint16_t header;
+    memcpy(&header, data, sizeof(uint16_t));
+
+    switch (message_code(header)) {
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+            return sizeof(connection_header_raw);
+        case 9:
+        case 10:
+            return sizeof(connection_information_raw);
+        case CLIENT_CHAT_CODE:
+        case CLIENT_CHAT_CODE + 1:
+        case SERVER_CHAT_CODE:
+        case SERVER_CHAT_CODE + 1:
+            return size < 3 ? 0 : 3 + (uint8_t)data[2];
+        case 15:
+        case 16:
+            return 2;
+        case KEYFRAME_CODE:
+            return size < game_board_header_size(data) ? 0 : (long)game_board_size(data);
+        case KEYFRAME_REQUEST_CODE:
+            return 2;
+        case CAPABILITIES_CODE:
+            return CAPABILITIES_SIZE;
+        case SUBSCRIPTION_TOKEN_CODE:
+            return SUBSCRIPTION_TOKEN_SIZE;
+        default:
+            return -1;
+    }
+}
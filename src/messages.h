@@ -2,14 +2,31 @@
 #define MESSAGES_CLIENT_H
 
 #include "./model.h"
+#include <stddef.h>
 #include <stdint.h>
 
+/** Versions of the protocol. The second one has up to MAX_PLAYER_NUM players, 16-bit coordinates and 16-bit numbers of
+ *  tile_diffs: its messages are written in the layout of the first version when their fields fit in it, and otherwise
+ *  in a wider layout flagged by the highest bit of the header, which is never set in the first version. A peer of the
+ *  second version reads both, and a peer of the first version is never sent a message which does not fit, as its games
+ *  have PLAYER_NUM players on boards smaller than 256 tiles and their updates have at most UINT8_MAX tile_diffs.
+ */
+typedef enum PROTOCOL_VERSION { PROTOCOL_V1 = 1, PROTOCOL_V2 = 2 } PROTOCOL_VERSION;
+
+#define PROTOCOL_V2_FLAG 0x8000
+
 typedef struct connection_header_raw {
     uint16_t req;
 } connection_header_raw;
 
+/** The version is the highest one supported by the client, sent in the id of the header of the first version so that a
+ *  server of the first version, which ignores it, still answers. The eq bit of the header tells that the capabilities
+ *  of the client follow it.
+ */
 typedef struct initial_connection_header {
     GAME_MODE game_mode;
+    PROTOCOL_VERSION version;
+    bool capabilities;
 } initial_connection_header;
 
 connection_header_raw *create_connection_header_raw(int codereq, int id, int team_number);
@@ -17,6 +34,34 @@ connection_header_raw *create_connection_header_raw(int codereq, int id, int tea
 connection_header_raw *serialize_initial_connection(const initial_connection_header *header);
 initial_connection_header *deserialize_initial_connection(const connection_header_raw *header);
 
+/** Code of the capabilities a client sends right after its initial header, and the server answers right after the
+ *  connection information with the ones chosen for the client and its game. A client announcing none is sent neither
+ *  batches of actions nor areas, and any datagram.
+ */
+#define CAPABILITIES_CODE 23
+#define CAPABILITIES_SIZE 6
+
+#define CAPABILITY_ACTION_BATCH 0x1 // Several game actions in one datagram
+#define CAPABILITY_AREAS 0x2        // Only the area around its player over unicast, with game board regions
+
+/** Smallest datagram every host receives, the boards are sent whole whatever the datagrams announced
+ */
+#define MIN_DATAGRAM_SIZE 576
+
+typedef struct capabilities {
+    uint16_t flags;        // The unknown ones are ignored, so that a peer can announce the ones of later versions
+    uint16_t max_datagram; // Largest game board update received, at least MIN_DATAGRAM_SIZE
+} capabilities;
+
+/** Returns the capabilities serialized in CAPABILITIES_SIZE bytes
+ */
+char *serialize_capabilities(const capabilities *caps);
+
+/** Reads the capabilities message of size bytes, returns EXIT_FAILURE if it is not one or its largest datagram is
+ *  smaller than MIN_DATAGRAM_SIZE
+ */
+int read_capabilities(const char *message, size_t size, capabilities *caps);
+
 typedef struct ready_connection_header {
     GAME_MODE game_mode;
     int id;
@@ -33,8 +78,11 @@ typedef struct connection_information_raw {
     uint16_t adrmdiff[8];
 } connection_information_raw;
 
+/** The version is the one of the game the client joins, its header is written in the layout of this version
+ */
 typedef struct connection_information {
     GAME_MODE game_mode;
+    PROTOCOL_VERSION version;
     int id;
     int eq;
     int portudp;
@@ -54,14 +102,31 @@ typedef struct game_action {
     GAME_ACTION action;
 } game_action;
 
+#define GAME_ACTION_SIZE 4
+#define GAME_ACTION_MESSAGE_NUMBER_LIMIT (1 << 13)
+/** Most game actions in one datagram: the latest action of a player follows the ones it sent just before, so that an
+ *  action survives the loss of its datagram without being sent again. A single action is a batch of one.
+ */
+#define GAME_ACTION_BATCH_MAX 4
+
 char *serialize_game_action(const game_action *action);
 
 game_action *deserialize_game_action(const char *action);
 
+/** Returns the nb actions of a player serialized one after the other in nb * GAME_ACTION_SIZE bytes, or NULL if one is
+ *  not valid or they are not of the same player
+ */
+char *serialize_game_action_batch(const game_action *actions, unsigned nb);
+
+/** Reads the actions of the batch of size bytes in actions, which has GAME_ACTION_BATCH_MAX places, and returns how
+ *  many there are, or 0 if the batch is not valid
+ */
+unsigned deserialize_game_action_batch(const char *batch, size_t size, game_action **actions);
+
 typedef struct game_board_information {
     uint16_t num;
-    uint8_t height;
-    uint8_t width;
+    uint16_t height;
+    uint16_t width;
     TILE *board;
 } game_board_information;
 
@@ -71,9 +136,98 @@ char *serialize_game_board(const game_board_information *info);
 
 game_board_information *deserialize_game_board(const char *info);
 
+/** Same encoding as serialize_game_board, for the keyframe sent over TCP to a client joining the game or asking for
+ *  it. num is the number of the last game_board_update included in the board.
+ */
+char *serialize_game_board_keyframe(const game_board_information *info);
+
+game_board_information *deserialize_game_board_keyframe(const char *info);
+
+/** Returns the size of a game board or keyframe message serialized by serialize_game_board or
+ *  serialize_game_board_keyframe
+ */
+size_t game_board_size(const char *message);
+
+#define KEYFRAME_CODE 17
+
+/** Code of the message, with only a header, sent by a client to get the keyframe of its game
+ */
+#define KEYFRAME_REQUEST_CODE 18
+
+/** Code of the message sent by a client to the UDP port of its game to receive the messages of the game at the address
+ *  it is sent from instead of through the multicast group, or only the pings. It echoes the token the server sent to
+ *  the client over TCP, so that no one but the client moves where the messages of its player go.
+ */
+#define UDP_SUBSCRIBE_CODE 19
+#define UDP_SUBSCRIBE_SIZE 11
+
+typedef struct subscription_message {
+    int id;
+    int eq;
+    uint64_t token;
+    bool unicast; // False to receive only the pings at the address, with the game still through the multicast group
+} subscription_message;
+
+/** Returns the subscription serialized in UDP_SUBSCRIBE_SIZE bytes, or NULL if its player is not valid
+ */
+char *serialize_subscription(const subscription_message *subscription);
+
+/** Reads the subscription message of size bytes, returns EXIT_FAILURE if it is not one
+ */
+int read_subscription(const char *message, size_t size, subscription_message *subscription);
+
+/** Code of the message the server sends over TCP right after the capabilities it chose for a client, with the token
+ *  of the subscriptions of the client. A client which announces no capabilities gets no token.
+ */
+#define SUBSCRIPTION_TOKEN_CODE 24
+#define SUBSCRIPTION_TOKEN_SIZE 10
+
+/** Returns the token serialized in SUBSCRIPTION_TOKEN_SIZE bytes
+ */
+char *serialize_subscription_token(uint64_t token);
+
+/** Reads the token message of size bytes, returns EXIT_FAILURE if it is not one
+ */
+int read_subscription_token(const char *message, size_t size, uint64_t *token);
+
+/** Code of the ping the server sends over UDP to each player, with the time of its wall clock when it is sent
+ */
+#define PING_CODE 21
+#define PING_SIZE 10
+
+/** Code of the answer of a client to a ping, with the time of the ping, and the times of the wall clock of the client
+ *  when the ping arrived and when it is answered
+ */
+#define PONG_CODE 22
+#define PONG_SIZE 26
+
+typedef struct pong_message {
+    int id;
+    int eq;
+    uint64_t ping_sent_us;
+    uint64_t ping_received_us;
+    uint64_t sent_us;
+} pong_message;
+
+/** Returns the ping sent at sent_us serialized in PING_SIZE bytes
+ */
+char *serialize_ping(uint64_t sent_us);
+
+/** Reads the time the ping message of size bytes was sent, returns EXIT_FAILURE if it is not a ping
+ */
+int read_ping(const char *message, size_t size, uint64_t *sent_us);
+
+/** Returns the pong serialized in PONG_SIZE bytes, or NULL if its player is not valid
+ */
+char *serialize_pong(const pong_message *pong);
+
+/** Reads the pong message of size bytes, returns EXIT_FAILURE if it is not a pong
+ */
+int read_pong(const char *message, size_t size, pong_message *pong);
+
 typedef struct game_board_update {
     uint16_t num;
-    uint8_t nb;
+    uint16_t nb;
     tile_diff *diff;
 } game_board_update;
 
@@ -83,6 +237,64 @@ char *serialize_game_board_update(const game_board_update *update);
 
 game_board_update *deserialize_game_board_update(const char *update);
 
+/** Returns the size of a game board update message serialized by serialize_game_board_update
+ */
+size_t game_board_update_size(const char *message);
+
+#define GAME_BOARD_HEADER_SIZE 6
+#define GAME_BOARD_UPDATE_HEADER_SIZE 5
+#define TILE_DIFF_SIZE 3
+
+// Sizes in the layout of the second version, with 16-bit dimensions, coordinates and numbers of tile_diffs
+#define GAME_BOARD_V2_HEADER_SIZE 8
+#define GAME_BOARD_UPDATE_V2_HEADER_SIZE 6
+#define TILE_DIFF_V2_SIZE 5
+
+/** Most tile_diffs in an update of a game of the version
+ */
+unsigned max_tile_diffs(PROTOCOL_VERSION version);
+
+/** Most tile_diffs in an update of a game of the version which fits in a datagram of max_size bytes
+ */
+unsigned max_tile_diffs_in(PROTOCOL_VERSION version, size_t max_size);
+
+/** Returns the size of the header of the game board, keyframe or region message, which depends on its layout
+ */
+size_t game_board_header_size(const char *message);
+
+/** Reads in place the game board message of size bytes, without copying its tiles which are the height * width bytes
+ *  after game_board_header_size. Returns EXIT_FAILURE if the message is not a whole game board.
+ */
+int read_game_board(const char *message, size_t size, uint16_t *num, uint16_t *height, uint16_t *width);
+
+/** Code of the tiles of a rectangle of the board, numbered like the game boards, sent instead of the whole board to a
+ *  client which only receives the area around its player
+ */
+#define GAME_BOARD_REGION_CODE 20
+#define GAME_BOARD_REGION_HEADER_SIZE 8
+#define GAME_BOARD_REGION_V2_HEADER_SIZE 12
+
+/** Returns the width * height tiles of board_ from (x, y) serialized as a region, and sets size with the size of the
+ *  message. Returns NULL if the region is not inside the board.
+ */
+char *serialize_game_board_region(uint16_t num, const board *board_, uint16_t x, uint16_t y, uint16_t width,
+                                  uint16_t height, size_t *size);
+
+/** Reads in place the region message of size bytes, its tiles are the height * width bytes after
+ *  game_board_header_size, row after row. Returns EXIT_FAILURE if the message is not a whole region.
+ */
+int read_game_board_region(const char *message, size_t size, uint16_t *num, uint16_t *x, uint16_t *y,
+                           uint16_t *width, uint16_t *height);
+
+/** Reads in place the game board update message of size bytes, its tile_diffs are then read by
+ *  read_game_board_update_diff. Returns EXIT_FAILURE if the message is not a whole game board update.
+ */
+int read_game_board_update(const char *message, size_t size, uint16_t *num, uint16_t *nb);
+
+/** Returns the tile_diff i of a game board update checked by read_game_board_update
+ */
+tile_diff read_game_board_update_diff(const char *message, unsigned i);
+
 typedef enum chat_message_type { GLOBAL_M, TEAM_M } chat_message_type;
 
 typedef struct chat_message {
@@ -119,6 +331,19 @@ typedef struct message_header {
 
 message_header *deserialize_message_header(uint16_t header);
 
+/** Returns the fields of the header in network byte order, in the layout of either version
+ */
+message_header read_message_header(uint16_t header);
+
+/** Returns the code of a message from its header in network byte order, in the layout of either version
+ */
+int message_code(uint16_t header);
+
 uint16_t serialize_message_header(const message_header *header);
 
+/** Returns the size of the TCP message which starts with the size bytes of data, 0 if more bytes are needed to know it
+ *  and -1 if it is not a message sent over TCP
+ */
+long message_frame_length(const char *data, size_t size);
+
 #endif // MESSAGES_CLIENT_H
@@ -0,0 +1,258 @@
+#include "./metrics.h"
+#include "./utils.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const uint64_t tick_bucket_bounds_us[METRICS_TICK_BUCKETS] = METRICS_TICK_BUCKET_BOUNDS_US;
+
+static match_metrics *matches = NULL;
+static interface_metrics *interfaces = NULL;
+static pthread_mutex_t lock_matches = PTHREAD_MUTEX_INITIALIZER; // Of the games and of the interfaces
+
+static atomic_int running_threads = 0;
+
+static char *writer_path = NULL;
+
+match_metrics *metrics_register_match(int game_id) {
+    match_metrics *m = calloc(1, sizeof(match_metrics));
+    RETURN_NULL_IF_NULL_PERROR(m, "calloc match_metrics");
+    m->game_id = game_id;
+
+    pthread_mutex_lock(&lock_matches);
+    m->next = matches;
+    matches = m;
+    pthread_mutex_unlock(&lock_matches);
+    return m;
+}
+
+void metrics_unregister_match(match_metrics *m) {
+    RETURN_IF_NULL(m);
+
+    pthread_mutex_lock(&lock_matches);
+    for (match_metrics **cur = &matches; *cur != NULL; cur = &(*cur)->next) {
+        if (*cur == m) {
+            *cur = m->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock_matches);
+    free(m);
+}
+
+interface_metrics *metrics_register_interface(const char *name) {
+    interface_metrics *m = calloc(1, sizeof(interface_metrics));
+    RETURN_NULL_IF_NULL_PERROR(m, "calloc interface_metrics");
+    snprintf(m->name, METRICS_INTERFACE_NAME_SIZE, "%s", name);
+
+    // At the end, so that the interfaces are written in the order of their registration
+    pthread_mutex_lock(&lock_matches);
+    interface_metrics **last = &interfaces;
+    while (*last != NULL) {
+        last = &(*last)->next;
+    }
+    *last = m;
+    pthread_mutex_unlock(&lock_matches);
+    return m;
+}
+
+void metrics_add_tick(match_metrics *m, uint64_t duration_us) {
+    RETURN_IF_NULL(m);
+
+    unsigned bucket = 0;
+    while (bucket < METRICS_TICK_BUCKETS && duration_us > tick_bucket_bounds_us[bucket]) {
+        bucket++;
+    }
+    METRICS_ADD(m, tick_buckets[bucket], 1);
+    METRICS_ADD(m, tick_duration_sum_us, duration_us);
+    METRICS_ADD(m, ticks, 1);
+}
+
+void metrics_set_player_latency(match_metrics *m, int player_id, unsigned samples, uint64_t rtt_us,
+                                int64_t clock_offset_us) {
+    RETURN_IF_NULL(m);
+
+    atomic_store_explicit(&m->player_rtt_us[player_id], rtt_us, memory_order_relaxed);
+    atomic_store_explicit(&m->player_clock_offset_us[player_id], clock_offset_us, memory_order_relaxed);
+    atomic_store_explicit(&m->player_rtt_samples[player_id], samples, memory_order_relaxed);
+}
+
+void metrics_thread_running(bool running) {
+    atomic_fetch_add(&running_threads, running ? 1 : -1);
+}
+
+static uint64_t load(atomic_uint_fast64_t *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static void write_type(FILE *file, const char *name, const char *type, const char *help) {
+    fprintf(file, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/** Writes the counter at offset in match_metrics for every game
+ */
+static void write_match_counter(FILE *file, const char *name, const char *type, const char *help, size_t offset) {
+    write_type(file, name, type, help);
+    for (match_metrics *m = matches; m != NULL; m = m->next) {
+        fprintf(file, "%s{game=\"%d\"} %" PRIuFAST64 "\n", name, m->game_id,
+                load((atomic_uint_fast64_t *)((char *)m + offset)));
+    }
+}
+
+/** Writes the counter at offset in interface_metrics for every interface
+ */
+static void write_interface_counter(FILE *file, const char *name, const char *type, const char *help, size_t offset) {
+    write_type(file, name, type, help);
+    for (interface_metrics *m = interfaces; m != NULL; m = m->next) {
+        fprintf(file, "%s{interface=\"%s\"} %" PRIuFAST64 "\n", name, m->name,
+                load((atomic_uint_fast64_t *)((char *)m + offset)));
+    }
+}
+
+/** Writes a gauge of each player who answered a ping, in seconds
+ */
+static void write_player_gauge(FILE *file, const char *name, const char *help, bool offset) {
+    write_type(file, name, "gauge", help);
+    for (match_metrics *m = matches; m != NULL; m = m->next) {
+        for (int i = 0; i < MAX_PLAYER_NUM; i++) {
+            if (load(&m->player_rtt_samples[i]) == 0) {
+                continue;
+            }
+            double value = offset ? (double)atomic_load_explicit(&m->player_clock_offset_us[i], memory_order_relaxed)
+                                  : (double)load(&m->player_rtt_us[i]);
+            fprintf(file, "%s{game=\"%d\",player=\"%d\"} %g\n", name, m->game_id, i, value / 1e6);
+        }
+    }
+}
+
+static void write_tick_histogram(FILE *file) {
+    const char *name = "bomberman_tick_duration_seconds";
+    write_type(file, name, "histogram", "Time spent applying the actions of a tick and sending its update");
+    for (match_metrics *m = matches; m != NULL; m = m->next) {
+        uint64_t cumulated = 0;
+        for (unsigned i = 0; i <= METRICS_TICK_BUCKETS; i++) {
+            cumulated += load(&m->tick_buckets[i]);
+            if (i < METRICS_TICK_BUCKETS) {
+                fprintf(file, "%s_bucket{game=\"%d\",le=\"%g\"} %" PRIu64 "\n", name, m->game_id,
+                        tick_bucket_bounds_us[i] / 1e6, cumulated);
+            } else {
+                fprintf(file, "%s_bucket{game=\"%d\",le=\"+Inf\"} %" PRIu64 "\n", name, m->game_id, cumulated);
+            }
+        }
+        fprintf(file, "%s_sum{game=\"%d\"} %g\n", name, m->game_id, load(&m->tick_duration_sum_us) / 1e6);
+        fprintf(file, "%s_count{game=\"%d\"} %" PRIuFAST64 "\n", name, m->game_id, load(&m->ticks));
+    }
+}
+
+int metrics_write(FILE *file) {
+    pthread_mutex_lock(&lock_matches);
+
+    unsigned nb_matches = 0;
+    for (match_metrics *m = matches; m != NULL; m = m->next) {
+        nb_matches++;
+    }
+    write_type(file, "bomberman_active_matches", "gauge", "Games being played");
+    fprintf(file, "bomberman_active_matches %u\n", nb_matches);
+    write_type(file, "bomberman_threads", "gauge", "Threads of the games");
+    fprintf(file, "bomberman_threads %d\n", atomic_load(&running_threads));
+
+    write_tick_histogram(file);
+    write_match_counter(file, "bomberman_actions_received_total", "counter", "Game actions received",
+                        offsetof(match_metrics, actions_received));
+    write_match_counter(file, "bomberman_actions_dropped_total", "counter",
+                        "Game actions invalid or replaced by a later one in the same tick",
+                        offsetof(match_metrics, actions_dropped));
+    write_match_counter(file, "bomberman_actions_duplicated_total", "counter",
+                        "Copies of game actions already received, sent again to survive the loss of a datagram",
+                        offsetof(match_metrics, actions_duplicated));
+    write_match_counter(file, "bomberman_actions_limited_total", "counter",
+                        "Game actions over the rate of their player, or over the size of the queue of the tick",
+                        offsetof(match_metrics, actions_limited));
+    write_match_counter(file, "bomberman_datagrams_limited_total", "counter",
+                        "Datagrams over the rate of the address they come from",
+                        offsetof(match_metrics, datagrams_limited));
+    write_match_counter(file, "bomberman_pending_actions", "gauge", "Game actions waiting for the next tick",
+                        offsetof(match_metrics, pending_actions));
+    write_match_counter(file, "bomberman_tile_diffs_total", "counter", "Tiles changed by the ticks",
+                        offsetof(match_metrics, tile_diffs));
+    write_match_counter(file, "bomberman_multicast_packets_total", "counter", "Datagrams sent to the multicast group",
+                        offsetof(match_metrics, multicast_packets));
+    write_match_counter(file, "bomberman_multicast_bytes_total", "counter", "Bytes sent to the multicast group",
+                        offsetof(match_metrics, multicast_bytes));
+    write_match_counter(file, "bomberman_unicast_packets_total", "counter",
+                        "Datagrams sent to the players subscribed over unicast",
+                        offsetof(match_metrics, unicast_packets));
+    write_match_counter(file, "bomberman_unicast_bytes_total", "counter",
+                        "Bytes sent to the players subscribed over unicast", offsetof(match_metrics, unicast_bytes));
+    write_match_counter(file, "bomberman_chat_messages_total", "counter", "Chat messages queued for the clients",
+                        offsetof(match_metrics, chat_messages));
+    write_match_counter(file, "bomberman_chat_bytes_total", "counter", "Bytes of chat messages queued for the clients",
+                        offsetof(match_metrics, chat_bytes));
+    write_match_counter(file, "bomberman_tcp_bytes_total", "counter", "Bytes written to the TCP connections",
+                        offsetof(match_metrics, tcp_bytes));
+    write_match_counter(file, "bomberman_tcp_queued_bytes", "gauge", "Bytes waiting in the TCP output queues",
+                        offsetof(match_metrics, tcp_queued_bytes));
+    write_match_counter(file, "bomberman_tcp_slow_clients_total", "counter", "Clients disconnected for being too slow",
+                        offsetof(match_metrics, tcp_disconnected));
+    write_player_gauge(file, "bomberman_player_rtt_seconds", "Smoothed round-trip time of the player over UDP", false);
+    write_player_gauge(file, "bomberman_player_clock_offset_seconds",
+                       "Smoothed clock of the player minus the clock of the server", true);
+
+    write_interface_counter(file, "bomberman_interface_matches", "gauge", "Games sending on the interface",
+                            offsetof(interface_metrics, matches));
+    write_interface_counter(file, "bomberman_interface_multicast_packets_total", "counter",
+                            "Datagrams sent to the multicast groups through the interface",
+                            offsetof(interface_metrics, multicast_packets));
+    write_interface_counter(file, "bomberman_interface_multicast_bytes_total", "counter",
+                            "Bytes sent to the multicast groups through the interface",
+                            offsetof(interface_metrics, multicast_bytes));
+
+    pthread_mutex_unlock(&lock_matches);
+    return ferror(file) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int write_metrics_file(const char *path) {
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, PATH_MAX, "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "w");
+    RETURN_FAILURE_IF_NULL_PERROR(file, "fopen metrics");
+    int res = metrics_write(file);
+    if (fclose(file) != 0) {
+        res = EXIT_FAILURE;
+    }
+    if (res == EXIT_SUCCESS && rename(tmp_path, path) < 0) {
+        perror("rename metrics");
+        res = EXIT_FAILURE;
+    }
+    return res;
+}
+
+static void *serve_metrics_writer(void *arg) {
+    (void)arg;
+    while (true) {
+        write_metrics_file(writer_path);
+        usleep(METRICS_WRITE_PERIOD_MS * 1000);
+    }
+    return NULL;
+}
+
+int metrics_start_writer(const char *path) {
+    writer_path = strdup(path);
+    RETURN_FAILURE_IF_NULL_PERROR(writer_path, "strdup metrics path");
+
+    pthread_t t;
+    if (pthread_create(&t, NULL, serve_metrics_writer, NULL) != 0) {
+        perror("pthread_create metrics");
+        free(writer_path);
+        writer_path = NULL;
+        return EXIT_FAILURE;
+    }
+    pthread_detach(t);
+    return EXIT_SUCCESS;
+}
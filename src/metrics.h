@@ -0,0 +1,119 @@
+#ifndef SRC_METRICS_H_
+#define SRC_METRICS_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "./constants.h"
+
+/** Counters of the server, written in the Prometheus text format to a file which is rewritten periodically.
+ *  Each game has its own counters, labelled with its id, which are updated without lock by its threads and removed
+ *  from the file when the game ends.
+ */
+
+#define METRICS_WRITE_PERIOD_MS 1000
+
+/** Upper bounds of the buckets of the tick duration histogram, in microseconds, the last bucket is +Inf */
+#define METRICS_TICK_BUCKETS 8
+#define METRICS_TICK_BUCKET_BOUNDS_US {50, 100, 250, 500, 1000, 2500, 5000, 10000}
+
+typedef struct match_metrics {
+    int game_id;
+
+    // Ticks which applied player actions, the duration is the time spent from taking the actions to sending the update
+    atomic_uint_fast64_t tick_buckets[METRICS_TICK_BUCKETS + 1];
+    atomic_uint_fast64_t tick_duration_sum_us;
+    atomic_uint_fast64_t ticks;
+
+    atomic_uint_fast64_t actions_received;
+    atomic_uint_fast64_t actions_dropped; // Of another game mode, or replaced by a later one in the tick
+    atomic_uint_fast64_t actions_duplicated; // Copies of actions already received, sent again with the next ones
+    atomic_uint_fast64_t actions_limited;    // Over the rate of the player, or when too many wait for the tick
+    atomic_uint_fast64_t datagrams_limited;  // Over the rate of the address they come from
+    atomic_uint_fast64_t tile_diffs;
+
+    atomic_uint_fast64_t multicast_packets;
+    atomic_uint_fast64_t multicast_bytes;
+    atomic_uint_fast64_t unicast_packets; // Sent to the players subscribed over unicast, one per player
+    atomic_uint_fast64_t unicast_bytes;
+
+    atomic_uint_fast64_t chat_messages;
+    atomic_uint_fast64_t chat_bytes;
+    atomic_uint_fast64_t tcp_bytes;        // Written to the clients, chat included
+    atomic_uint_fast64_t tcp_queued_bytes; // Waiting in the output queues
+    atomic_uint_fast64_t tcp_disconnected; // Clients disconnected for being too slow
+    atomic_uint_fast64_t pending_actions;  // Received and waiting for the next tick
+
+    // Latency of each player, estimated from the pings answered so far, written only when a sample is added
+    atomic_uint_fast64_t player_rtt_samples[MAX_PLAYER_NUM];
+    atomic_uint_fast64_t player_rtt_us[MAX_PLAYER_NUM];
+    atomic_int_fast64_t player_clock_offset_us[MAX_PLAYER_NUM]; // Clock of the player minus the clock of the server
+
+    struct match_metrics *next;
+} match_metrics;
+
+#define METRICS_INTERFACE_NAME_SIZE 16
+
+/** Counters of a network interface sending the multicast messages of games
+ */
+typedef struct interface_metrics {
+    char name[METRICS_INTERFACE_NAME_SIZE];
+
+    atomic_uint_fast64_t matches; // Games sending on the interface
+    atomic_uint_fast64_t multicast_packets;
+    atomic_uint_fast64_t multicast_bytes;
+
+    struct interface_metrics *next;
+} interface_metrics;
+
+/** Adds n to a counter of the match or interface metrics m, which may be NULL
+ */
+#define METRICS_ADD(m, counter, n)                                                                                     \
+    do {                                                                                                               \
+        if ((m) != NULL) {                                                                                             \
+            atomic_fetch_add_explicit(&(m)->counter, (n), memory_order_relaxed);                                       \
+        }                                                                                                              \
+    } while (0)
+
+#define METRICS_SUB(m, counter, n)                                                                                     \
+    do {                                                                                                               \
+        if ((m) != NULL) {                                                                                             \
+            atomic_fetch_sub_explicit(&(m)->counter, (n), memory_order_relaxed);                                       \
+        }                                                                                                              \
+    } while (0)
+
+/** Adds the counters of a new game, they stay readable until metrics_unregister_match
+ */
+match_metrics *metrics_register_match(int game_id);
+
+/** Removes the counters of a game and frees them, no thread of the game may use them anymore
+ */
+void metrics_unregister_match(match_metrics *);
+
+/** Adds the counters of a network interface, they stay until the server stops
+ */
+interface_metrics *metrics_register_interface(const char *name);
+
+void metrics_add_tick(match_metrics *, uint64_t duration_us);
+
+/** Publishes the latest estimation of the latency of a player
+ */
+void metrics_set_player_latency(match_metrics *, int player_id, unsigned samples, uint64_t rtt_us,
+                                int64_t clock_offset_us);
+
+/** Counts one of the server threads, running is false when it ends
+ */
+void metrics_thread_running(bool running);
+
+/** Writes every counter in the Prometheus text format
+ */
+int metrics_write(FILE *file);
+
+/** Starts a thread which rewrites the file at path every METRICS_WRITE_PERIOD_MS, a temporary file is renamed so that
+ *  a reader never sees a partial file
+ */
+int metrics_start_writer(const char *path);
+
+#endif // SRC_METRICS_H_
@@ -1,8 +1,10 @@
 #include "./model.h"
+#include "./bitboard.h"
+#include "./board_view.h"
+#include "./prng.h"
 
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
 
 #include "./utils.h"
 
@@ -13,7 +15,7 @@ typedef struct player {
 
 typedef struct bomb {
     coord pos;
-    time_t placement_time;
+    uint64_t placement_ms;
 } bomb;
 
 typedef struct bomb_collection {
@@ -24,10 +26,17 @@ typedef struct bomb_collection {
 
 typedef struct game {
     board *game_board;
+    bitboard *tiles; // Kept in sync with game_board by set_grid
+    int8_t *player_at; // Id of the alive player on each tile, -1 if none, even if the tile shows a bomb
+    int *bomb_at;      // Index in all_bombs of the bomb on each tile, -1 if none
     bomb_collection all_bombs;
-    player *players[PLAYER_NUM];
+    player *players[MAX_PLAYER_NUM];
+    unsigned nb_players;
     GAME_MODE game_mode;
     chat *chat;
+    uint64_t seed;
+    prng rng;
+    unsigned bomb_lifetime_ms; // Time between the placement of a bomb and its explosion
 } game;
 
 static game **games = NULL;
@@ -35,8 +44,6 @@ size_t games_size = 0;
 size_t games_capacity = 10;
 #define GROWTH_FACTOR 2
 
-TILE get_player(int);
-
 void free_model(unsigned int game_id);
 
 int add_game(game *g) {
@@ -118,67 +125,86 @@ static game *init_game_struct() {
     }
 
     g->game_board = NULL;
+    g->tiles = NULL;
+    g->player_at = NULL;
+    g->bomb_at = NULL;
     g->all_bombs.arr = NULL;
     g->all_bombs.total_count = 0;
     g->all_bombs.max_capacity = 0;
 
-    for (int i = 0; i < PLAYER_NUM; i++) {
+    for (int i = 0; i < MAX_PLAYER_NUM; i++) {
         g->players[i] = NULL;
     }
+    g->nb_players = PLAYER_NUM;
 
     g->game_mode = SOLO;
 
     g->chat = NULL;
 
+    g->seed = 0;
+    prng_seed(&g->rng, 0);
+
+    g->bomb_lifetime_ms = BOMB_LIFETIME * 1000;
+
     return g;
 }
 
-TILE get_probably_destructible_wall() {
-    if (random() % DESTRUCTIBLE_WALL_CHANCE == 0) {
+TILE get_probably_destructible_wall(prng *rng) {
+    if (prng_range(rng, DESTRUCTIBLE_WALL_CHANCE) == 0) {
         return EMPTY;
     }
     return DESTRUCTIBLE_WALL;
 }
 
+/** Sets the tile (x, y), inside the board of the game, and keeps the bitboard of the game in sync
+ */
+static void set_tile(game *g, int x, int y, TILE v) {
+    int i = board_index(g->game_board, x, y);
+    if (g->tiles != NULL) {
+        bitboard_set_tile(g->tiles, x, y, (TILE)g->game_board->grid[i], v);
+    }
+    g->game_board->grid[i] = v;
+}
+
 int init_game_board_content(unsigned int game_id) {
     RETURN_FAILURE_IF_NULL(games[game_id]);
 
     board *game_board = games[game_id]->game_board;
     RETURN_FAILURE_IF_NULL(game_board);
 
-    srandom(time(NULL));
+    prng *rng = &games[game_id]->rng;
 
     // Indestructible wall part
     for (int c = 1; c < game_board->dim.width - 1; c += 2) {
         for (int l = 1; l < game_board->dim.height - 1; l += 2) {
-            game_board->grid[coord_to_int(c, l, game_id)] = INDESTRUCTIBLE_WALL;
+            board_set_unchecked(game_board, c, l, INDESTRUCTIBLE_WALL);
         }
     }
 
     // Destructible wall part
     for (int c = 3; c < game_board->dim.width - 3; c++) { // Fill the first and last line
-        game_board->grid[coord_to_int(c, 0, game_id)] = get_probably_destructible_wall();
-        game_board->grid[coord_to_int(c, game_board->dim.height - 1, game_id)] = get_probably_destructible_wall();
+        board_set_unchecked(game_board, c, 0, get_probably_destructible_wall(rng));
+        board_set_unchecked(game_board, c, game_board->dim.height - 1, get_probably_destructible_wall(rng));
     }
 
     for (int c = 2; c < game_board->dim.width - 2; c += 2) { // Fill the second and the second last line
-        game_board->grid[coord_to_int(c, 1, game_id)] = get_probably_destructible_wall();
-        game_board->grid[coord_to_int(c, game_board->dim.height - 2, game_id)] = get_probably_destructible_wall();
+        board_set_unchecked(game_board, c, 1, get_probably_destructible_wall(rng));
+        board_set_unchecked(game_board, c, game_board->dim.height - 2, get_probably_destructible_wall(rng));
     }
 
     for (int c = 1; c < game_board->dim.width - 1; c++) { // Fill the third and the third last line
-        game_board->grid[coord_to_int(c, 2, game_id)] = get_probably_destructible_wall();
-        game_board->grid[coord_to_int(c, game_board->dim.height - 3, game_id)] = get_probably_destructible_wall();
+        board_set_unchecked(game_board, c, 2, get_probably_destructible_wall(rng));
+        board_set_unchecked(game_board, c, game_board->dim.height - 3, get_probably_destructible_wall(rng));
     }
 
     for (int l = 3; l < game_board->dim.height - 3; l++) { // Fill the other lines
         if (l % 2 == 0) { // There are no indestructible walls between destructible walls on this line
             for (int c = 0; c < game_board->dim.width; c++) {
-                game_board->grid[coord_to_int(c, l, game_id)] = get_probably_destructible_wall();
+                board_set_unchecked(game_board, c, l, get_probably_destructible_wall(rng));
             }
         } else { // There are indestructible walls between destructible walls on this line
             for (int c = 0; c < game_board->dim.width; c += 2) {
-                game_board->grid[coord_to_int(c, l, game_id)] = get_probably_destructible_wall();
+                board_set_unchecked(game_board, c, l, get_probably_destructible_wall(rng));
             }
         }
     }
@@ -220,29 +246,70 @@ int init_game_board(dimension dim, unsigned int game_id) {
     return EXIT_SUCCESS;
 }
 
+int init_occupancy(unsigned int game_id) {
+    RETURN_FAILURE_IF_NULL(games[game_id]);
+
+    game *g = games[game_id];
+    int nb_tiles = g->game_board->dim.width * g->game_board->dim.height;
+
+    g->player_at = malloc(sizeof(int8_t) * nb_tiles);
+    RETURN_FAILURE_IF_NULL_PERROR(g->player_at, "malloc");
+    g->bomb_at = malloc(sizeof(int) * nb_tiles);
+    RETURN_FAILURE_IF_NULL_PERROR(g->bomb_at, "malloc");
+
+    for (int i = 0; i < nb_tiles; i++) {
+        g->player_at[i] = -1;
+        g->bomb_at[i] = -1;
+    }
+    return EXIT_SUCCESS;
+}
+
+/** Writes in pos where the player i starts: the first four in the corners, the next ones alternately on the first
+ *  and the last lines, at even columns spread over the width
+ */
+static void get_start_position(int i, dimension dim, coord *pos) {
+    if (i < PLAYER_NUM) {
+        pos->y = i < 2 ? 0 : dim.height - 1;
+        pos->x = (dim.width - (i % 2)) % dim.width;
+        return;
+    }
+    int j = (i - PLAYER_NUM) / 2;
+    pos->y = (i - PLAYER_NUM) % 2 == 0 ? 0 : dim.height - 1;
+    pos->x = 2 * ((j + 1) * (dim.width / 2) / ((MAX_PLAYER_NUM - PLAYER_NUM) / 2 + 1));
+}
+
+/** Empties the tiles next to the start of a player which is not in a corner, so that it can move
+ */
+static void clear_start_position(game *g, const coord *pos) {
+    int next_y = pos->y == 0 ? 1 : g->game_board->dim.height - 2;
+    set_tile(g, pos->x - 1, pos->y, EMPTY);
+    set_tile(g, pos->x + 1, pos->y, EMPTY);
+    set_tile(g, pos->x, next_y, EMPTY);
+}
+
 int init_player_positions(unsigned int game_id) {
     RETURN_FAILURE_IF_NULL(games[game_id]);
 
-    player **players = games[game_id]->players;
-    board *game_board = games[game_id]->game_board;
+    game *g = games[game_id];
+    player **players = g->players;
+    board *game_board = g->game_board;
 
-    for (int i = 0; i < 4; i++) {
+    for (unsigned i = 0; i < g->nb_players; i++) {
         players[i] = malloc(sizeof(player));
         RETURN_FAILURE_IF_NULL_PERROR(players[i], "malloc");
 
         players[i]->pos = malloc(sizeof(coord));
         RETURN_FAILURE_IF_NULL_PERROR(players[i]->pos, "malloc");
 
-        if (i < 2) {
-            players[i]->pos->y = 0;
-        } else {
-            players[i]->pos->y = game_board->dim.height - 1;
+        get_start_position(i, game_board->dim, players[i]->pos);
+        if (i >= PLAYER_NUM) {
+            clear_start_position(g, players[i]->pos);
         }
-        players[i]->pos->x = (game_board->dim.width - (i % 2)) % game_board->dim.width;
 
         players[i]->dead = false;
 
-        set_grid(players[i]->pos->x, players[i]->pos->y, get_player(i), game_id);
+        g->player_at[board_index(game_board, players[i]->pos->x, players[i]->pos->y)] = i;
+        set_tile(g, players[i]->pos->x, players[i]->pos->y, get_player(i));
     }
     return EXIT_SUCCESS;
 }
@@ -259,12 +326,28 @@ int init_game_chat(unsigned int game_id) {
 }
 
 int init_model(dimension dim, GAME_MODE game_mode_) {
+    return init_model_with_seed(dim, game_mode_, prng_random_seed());
+}
+
+int init_model_with_seed(dimension dim, GAME_MODE game_mode_, uint64_t seed) {
+    return init_model_with_players(dim, game_mode_, seed, PLAYER_NUM);
+}
+
+int init_model_with_players(dimension dim, GAME_MODE game_mode_, uint64_t seed, unsigned nb_players) {
+    if (nb_players < 2 || nb_players > MAX_PLAYER_NUM ||
+        (nb_players > PLAYER_NUM && dim.width < MIN_WIDE_GAMEBOARD_WIDTH)) {
+        return -1;
+    }
+
     game *g = init_game_struct();
     if (g == NULL) {
         return -1;
     }
 
+    g->nb_players = nb_players;
     g->game_mode = game_mode_;
+    g->seed = seed;
+    prng_seed(&g->rng, seed);
 
     int game_id = add_game(g);
 
@@ -276,6 +359,15 @@ int init_model(dimension dim, GAME_MODE game_mode_) {
         return -1;
     }
 
+    // The content of the board is written directly in the grid, the bitboard starts from it
+    g->tiles = create_bitboard(g->game_board);
+    if (g->tiles == NULL) {
+        return -1;
+    }
+
+    if (init_occupancy(game_id) == EXIT_FAILURE) {
+        return -1;
+    }
     if (init_player_positions(game_id) == EXIT_FAILURE) {
         return -1;
     }
@@ -309,7 +401,7 @@ void free_player_positions(unsigned int game_id) {
     if (games[game_id] == NULL) {
         return;
     }
-    for (int i = 0; i < PLAYER_NUM; i++) {
+    for (int i = 0; i < MAX_PLAYER_NUM; i++) {
         if (games[game_id]->players[i] != NULL) {
             if (games[game_id]->players[i]->pos != NULL) {
                 free(games[game_id]->players[i]->pos);
@@ -323,6 +415,9 @@ void free_player_positions(unsigned int game_id) {
 
 void free_model(unsigned int game_id) {
     free_game_board(game_id);
+    free_bitboard(games[game_id]->tiles);
+    free(games[game_id]->player_at);
+    free(games[game_id]->bomb_at);
     free_chat(games[game_id]->chat);
     games[game_id]->chat = NULL;
     free_player_positions(game_id);
@@ -365,6 +460,9 @@ char tile_to_char(TILE t) {
         case HORIZONTAL_BORDER:
             c = '-';
             break;
+        default: // The players after the fourth
+            c = get_player_id(t) < 9 ? '1' + get_player_id(t) : 'A' + get_player_id(t) - 9;
+            break;
     }
     return c;
 }
@@ -373,25 +471,25 @@ bool is_outside_board(int x, int y, unsigned int game_id) {
     if (games[game_id] == NULL) {
         return true;
     }
-    board *game_board = games[game_id]->game_board;
-    return x < 0 || x >= game_board->dim.width || y < 0 || y >= game_board->dim.height;
+    return !board_contains(games[game_id]->game_board, x, y);
+}
+
+/** Returns true if a player can move to (x, y) of the board, which can be outside it
+ */
+static bool can_move_to(const board *game_board, int x, int y) {
+    TILE t = board_get(game_board, x, y);
+    return t != BOMB && t != INDESTRUCTIBLE_WALL && t != DESTRUCTIBLE_WALL && get_player_id(t) == -1;
 }
 
 bool can_move_to_position(int x, int y, unsigned int game_id) {
-    if (is_outside_board(x, y, game_id)) {
+    if (games[game_id] == NULL) {
         return false;
     }
-    TILE t = get_grid(x, y, game_id);
-    return t != BOMB && t != INDESTRUCTIBLE_WALL && t != DESTRUCTIBLE_WALL && t != PLAYER_1 && t != PLAYER_2 &&
-           t != PLAYER_3 && t != PLAYER_4;
+    return can_move_to(games[game_id]->game_board, x, y);
 }
 
 coord int_to_coord(int n, unsigned int game_id) {
-    board *game_board = games[game_id]->game_board;
-    coord c;
-    c.y = n / game_board->dim.width;
-    c.x = n % game_board->dim.width;
-    return c;
+    return board_coord(games[game_id]->game_board, n);
 }
 
 int coord_to_int_dim(int x, int y, dimension dim) {
@@ -399,8 +497,7 @@ int coord_to_int_dim(int x, int y, dimension dim) {
 }
 
 int coord_to_int(int x, int y, unsigned int game_id) {
-    board *game_board = games[game_id]->game_board;
-    return coord_to_int_dim(x, y, game_board->dim);
+    return board_index(games[game_id]->game_board, x, y);
 }
 
 TILE get_grid(int x, int y, unsigned int game_id) {
@@ -408,7 +505,7 @@ TILE get_grid(int x, int y, unsigned int game_id) {
 
     board *game_board = games[game_id]->game_board;
     if (game_board != NULL) {
-        return game_board->grid[coord_to_int(x, y, game_id)];
+        return board_get_unchecked(game_board, x, y);
     }
     return EXIT_FAILURE;
 }
@@ -416,9 +513,8 @@ TILE get_grid(int x, int y, unsigned int game_id) {
 void set_grid(int x, int y, TILE v, unsigned int game_id) {
     RETURN_IF_NULL(games[game_id]);
 
-    board *game_board = games[game_id]->game_board;
-    if (game_board != NULL) {
-        game_board->grid[coord_to_int(x, y, game_id)] = v;
+    if (games[game_id]->game_board != NULL) {
+        set_tile(games[game_id], x, y, v);
     }
 }
 
@@ -433,7 +529,7 @@ TILE get_player(int player_id) {
         case 3:
             return PLAYER_4;
         default:
-            return EMPTY;
+            return player_id >= PLAYER_NUM && player_id < MAX_PLAYER_NUM ? PLAYER_5 + player_id - PLAYER_NUM : EMPTY;
     }
 }
 
@@ -448,10 +544,14 @@ int get_player_id(TILE t) {
         case PLAYER_4:
             return 3;
         default:
-            return -1;
+            return t >= PLAYER_5 && t <= PLAYER_16 ? PLAYER_NUM + (int)(t - PLAYER_5) : -1;
     }
 }
 
+int get_player_team(int player_id) {
+    return ((player_id + 1) / 2) % 2;
+}
+
 bool is_move(GAME_ACTION action) {
     return action == GAME_LEFT || action == GAME_RIGHT || action == GAME_UP || action == GAME_DOWN ||
            action == GAME_NONE;
@@ -480,35 +580,39 @@ coord get_next_position(GAME_ACTION a, const coord *pos) {
     return c;
 }
 
-void perform_move(GAME_ACTION a, int player_id, unsigned int game_id) {
-    RETURN_IF_NULL(games[game_id]);
-
-    player **players = games[game_id]->players;
-
-    if (players[player_id]->dead) {
+/** Same as perform_move, on the game already looked up
+ */
+static void move_player(game *g, GAME_ACTION a, int player_id) {
+    player *p = g->players[player_id];
+    if (p->dead) {
         return;
     }
 
-    coord *current_pos = players[player_id]->pos;
-    coord old_pos = *current_pos;
-
-    coord c = get_next_position(a, current_pos);
-    if (!can_move_to_position(c.x, c.y, game_id)) {
+    board *game_board = g->game_board;
+    coord old_pos = *p->pos;
+    coord c = get_next_position(a, p->pos);
+    if (!can_move_to(game_board, c.x, c.y)) {
         return;
     }
-    current_pos->x = c.x;
-    current_pos->y = c.y;
-    set_grid(current_pos->x, current_pos->y, get_player(player_id), game_id);
-    if (get_grid(old_pos.x, old_pos.y, game_id) != BOMB) {
-        set_grid(old_pos.x, old_pos.y, EMPTY, game_id);
+    *p->pos = c;
+    int old_i = board_index(game_board, old_pos.x, old_pos.y);
+    g->player_at[old_i] = -1;
+    g->player_at[board_index(game_board, c.x, c.y)] = player_id;
+    set_tile(g, c.x, c.y, get_player(player_id));
+    if (g->bomb_at[old_i] == -1) {
+        set_tile(g, old_pos.x, old_pos.y, EMPTY);
     }
 }
-void place_bomb(int player_id, unsigned int game_id) {
 
+void perform_move(GAME_ACTION a, int player_id, unsigned int game_id) {
     RETURN_IF_NULL(games[game_id]);
 
-    game *g = games[game_id];
+    move_player(games[game_id], a, player_id);
+}
 
+/** Same as place_bomb, on the game already looked up
+ */
+static void add_bomb(game *g, int player_id, uint64_t now_ms) {
     if (g->all_bombs.total_count == g->all_bombs.max_capacity) {
         int new_capacity = (g->all_bombs.max_capacity == 0) ? 4 : g->all_bombs.max_capacity * 2;
         bomb *new_list = realloc(g->all_bombs.arr, new_capacity * sizeof(bomb));
@@ -518,24 +622,29 @@ void place_bomb(int player_id, unsigned int game_id) {
         g->all_bombs.max_capacity = new_capacity;
     }
 
-    player **players = games[game_id]->players;
-
-    coord current_pos = *players[player_id]->pos;
+    coord current_pos = *g->players[player_id]->pos;
 
-    TILE t = get_grid(current_pos.x, current_pos.y, game_id);
-    if (t == BOMB) { // Shouldn't be able to place a bomb on top of an another
+    int i = board_index(g->game_board, current_pos.x, current_pos.y);
+    if (g->bomb_at[i] != -1) { // Shouldn't be able to place a bomb on top of an another
         return;
     }
 
     bomb new_bomb;
     new_bomb.pos.x = current_pos.x;
     new_bomb.pos.y = current_pos.y;
-    new_bomb.placement_time = time(NULL);
+    new_bomb.placement_ms = now_ms;
 
     g->all_bombs.arr[g->all_bombs.total_count] = new_bomb;
+    g->bomb_at[i] = g->all_bombs.total_count;
     g->all_bombs.total_count++;
 
-    set_grid(current_pos.x, current_pos.y, BOMB, game_id);
+    set_tile(g, current_pos.x, current_pos.y, BOMB);
+}
+
+void place_bomb(int player_id, uint64_t now_ms, unsigned int game_id) {
+    RETURN_IF_NULL(games[game_id]);
+
+    add_bomb(games[game_id], player_id, now_ms);
 }
 
 board *get_game_board(unsigned int game_id) {
@@ -566,6 +675,33 @@ GAME_MODE get_game_mode(unsigned int game_id) {
     return games[game_id]->game_mode;
 }
 
+unsigned get_nb_players(unsigned int game_id) {
+    if (games[game_id] == NULL) {
+        return 0;
+    }
+    return games[game_id]->nb_players;
+}
+
+uint64_t get_game_seed(unsigned int game_id) {
+    if (games[game_id] == NULL) {
+        return 0;
+    }
+    return games[game_id]->seed;
+}
+
+void set_bomb_lifetime(unsigned lifetime_ms, unsigned int game_id) {
+    RETURN_IF_NULL(games[game_id]);
+
+    games[game_id]->bomb_lifetime_ms = lifetime_ms;
+}
+
+unsigned get_bomb_lifetime(unsigned int game_id) {
+    if (games[game_id] == NULL) {
+        return 0;
+    }
+    return games[game_id]->bomb_lifetime_ms;
+}
+
 bool is_player_dead(int id, unsigned int game_id) {
     if (games[game_id] == NULL) {
         return true;
@@ -574,141 +710,173 @@ bool is_player_dead(int id, unsigned int game_id) {
     return games[game_id]->players[id]->dead;
 }
 
+coord get_player_position(int player_id, unsigned int game_id) {
+    coord none = {0, 0};
+    if (games[game_id] == NULL) {
+        return none;
+    }
+    return *games[game_id]->players[player_id]->pos;
+}
+
 void set_player_dead(unsigned int game_id, int player_id) {
     if (games[game_id] == NULL) {
         return;
     }
-    for (int i = 0; i < games[game_id]->game_board->dim.width * games[game_id]->game_board->dim.height; i++) {
-        coord c = int_to_coord(i, game_id);
-        if (get_grid(c.x, c.y, game_id) == get_player(player_id)) {
-            set_grid(c.x, c.y, EMPTY, game_id);
-            break;
-        }
+    game *g = games[game_id];
+    player *p = g->players[player_id];
+    if (p->dead) {
+        return;
     }
-    games[game_id]->players[player_id]->dead = true;
-}
 
-bool apply_explosion_effect(int x, int y, unsigned int game_id) {
-    if (is_outside_board(x, y, game_id)) {
-        return false;
+    // The player is not shown if it stands on a bomb
+    if (board_get_unchecked(g->game_board, p->pos->x, p->pos->y) == get_player(player_id)) {
+        set_tile(g, p->pos->x, p->pos->y, EMPTY);
     }
+    g->player_at[board_index(g->game_board, p->pos->x, p->pos->y)] = -1;
+    p->dead = true;
+}
 
-    bool impact_happened = false;
+#define BLAST_RANGE 2
+#define BLAST_SIZE (2 * BLAST_RANGE + 1)
+#define BLAST_CENTER ((uint64_t)1 << BLAST_RANGE)
 
-    player **players = games[game_id]->players;
+/** Returns the tiles of the row y, from x - BLAST_RANGE, which block a blast
+ */
+static uint64_t get_blast_walls(bitboard *tiles, int x, int y) {
+    return bitboard_row_window(tiles, DESTRUCTIBLE_WALL, x - BLAST_RANGE, y) |
+           bitboard_row_window(tiles, INDESTRUCTIBLE_WALL, x - BLAST_RANGE, y);
+}
 
-    TILE t = get_grid(x, y, game_id);
-    int id;
-    switch (t) {
-        case DESTRUCTIBLE_WALL:
-            set_grid(x, y, EMPTY, game_id);
-            impact_happened = true;
-            break;
-        case PLAYER_1:
-        case PLAYER_2:
-        case PLAYER_3:
-        case PLAYER_4:
-            id = get_player_id(t);
-            players[id]->dead = true;
-            set_grid(x, y, EMPTY, game_id);
-            break;
-        case INDESTRUCTIBLE_WALL:
-            impact_happened = true;
-            break;
-        default:
-            break;
-    }
+/** Computes the tiles reached by the blast of a bomb at (x, y), one window of BLAST_SIZE bits per row from y -
+ *  BLAST_RANGE, the bit i being the tile x - BLAST_RANGE + i:
+ *  - the four arms go BLAST_RANGE tiles away, and stop at the first wall which is reached but not crossed
+ *  - the four diagonal tiles are always reached
+ */
+static void get_blast(bitboard *tiles, int x, int y, uint64_t blast[BLAST_SIZE]) {
+    uint64_t center_walls = get_blast_walls(tiles, x, y);
+    uint64_t near_mask = BLAST_CENTER | (BLAST_CENTER << 1) | (BLAST_CENTER >> 1);
 
-    // Check if player standing on a bomb is impacted by an another explosion
-    if (!impact_happened) {
-        coord *player_pos;
-        for (int i = 0; i < PLAYER_NUM; ++i) {
-            player_pos = players[i]->pos;
-            if (player_pos->x == x && player_pos->y == y) {
-                players[i]->dead = true;
-            }
-        }
+    blast[BLAST_RANGE] = near_mask;
+    if (!(center_walls & (BLAST_CENTER << 1))) {
+        blast[BLAST_RANGE] |= BLAST_CENTER << 2;
+    }
+    if (!(center_walls & (BLAST_CENTER >> 1))) {
+        blast[BLAST_RANGE] |= BLAST_CENTER >> 2;
     }
 
-    return impact_happened;
-}
+    blast[BLAST_RANGE - 1] = near_mask;
+    blast[BLAST_RANGE + 1] = near_mask;
+    blast[BLAST_RANGE - 2] = (get_blast_walls(tiles, x, y - 1) & BLAST_CENTER) ? 0 : BLAST_CENTER;
+    blast[BLAST_RANGE + 2] = (get_blast_walls(tiles, x, y + 1) & BLAST_CENTER) ? 0 : BLAST_CENTER;
 
-void update_explosion(bomb b, unsigned int game_id) {
-    RETURN_IF_NULL(games[game_id]);
-
-    player **players = games[game_id]->players;
+    // Columns outside the board
+    uint64_t inside = (((uint64_t)1 << BLAST_SIZE) - 1);
+    if (x - BLAST_RANGE < 0) {
+        inside &= inside << (BLAST_RANGE - x);
+    }
+    if (x + BLAST_RANGE >= tiles->dim.width) {
+        inside &= inside >> (x + BLAST_RANGE - tiles->dim.width + 1);
+    }
+    for (int r = 0; r < BLAST_SIZE; r++) {
+        blast[r] &= inside;
+    }
+}
 
-    int x, y;
+/** Clears the tiles and kills the players reached by the blast of the bomb
+ */
+static void explode_bomb(game *g, bomb b) {
+    board *game_board = g->game_board;
+    int left = b.pos.x - BLAST_RANGE;
+    int top = b.pos.y - BLAST_RANGE;
 
-    x = b.pos.x;
-    y = b.pos.y;
-    for (int i = 0; i < PLAYER_NUM; ++i) {
-        if (players[i]->pos->x == x && players[i]->pos->y == y) {
-            players[i]->dead = true;
-        }
-    }
+    uint64_t blast[BLAST_SIZE];
+    get_blast(g->tiles, b.pos.x, b.pos.y, blast);
 
-    // Vertical center
-    x = b.pos.x;
-    for (int k = 0; k <= 2; ++k) {
-        y = b.pos.y + k;
-        if (apply_explosion_effect(x, y, game_id)) {
-            break;
+    for (int r = 0; r < BLAST_SIZE; r++) {
+        int y = top + r;
+        if (y < 0 || y >= game_board->dim.height) {
+            continue;
         }
-    }
 
-    x = b.pos.x;
-    for (int k = 0; k >= -2; --k) {
-        y = b.pos.y + k;
-        if (apply_explosion_effect(x, y, game_id)) {
-            break;
-        }
-    }
+        uint64_t reached = blast[r];
+        while (reached != 0) {
+            int x = left + __builtin_ctzll(reached);
+            reached &= reached - 1;
 
-    // Horizontal center
-    y = b.pos.y;
-    for (int k = 0; k <= 2; ++k) {
-        x = b.pos.x + k;
-        if (apply_explosion_effect(x, y, game_id)) {
-            break;
-        }
-    }
+            // Players are also hit where they are not shown, like on a bomb
+            int i = board_index(game_board, x, y);
+            if (g->player_at[i] != -1) {
+                g->players[g->player_at[i]]->dead = true;
+                g->player_at[i] = -1;
+            }
 
-    x = b.pos.x;
-    for (int k = 0; k >= -2; --k) {
-        x = b.pos.x + k;
-        if (apply_explosion_effect(x, y, game_id)) {
-            break;
+            TILE t = board_get_unchecked(game_board, x, y);
+            if (t == DESTRUCTIBLE_WALL || get_player_id(t) != -1) {
+                set_tile(g, x, y, EMPTY);
+            }
         }
     }
-
-    // Diagonals
-    x = b.pos.x;
-    y = b.pos.y;
-    apply_explosion_effect(x + 1, y + 1, game_id);
-    apply_explosion_effect(x + 1, y - 1, game_id);
-    apply_explosion_effect(x - 1, y + 1, game_id);
-    apply_explosion_effect(x - 1, y - 1, game_id);
 }
 
-void update_bombs(unsigned int game_id) {
+void update_explosion(bomb b, unsigned int game_id) {
     RETURN_IF_NULL(games[game_id]);
 
-    game *g = games[game_id];
-
-    time_t current_time = time(NULL);
+    explode_bomb(games[game_id], b);
+}
 
+/** Same as update_bombs, on the game already looked up
+ */
+static void explode_bombs(game *g, uint64_t now_ms) {
+    board *game_board = g->game_board;
     for (int i = 0; i < g->all_bombs.total_count; ++i) {
         bomb b = g->all_bombs.arr[i];
-        if (difftime(current_time, b.placement_time) >= BOMB_LIFETIME) {
-            update_explosion(b, game_id);
-            set_grid(b.pos.x, b.pos.y, EMPTY, game_id);
+        if (now_ms >= b.placement_ms && now_ms - b.placement_ms >= g->bomb_lifetime_ms) {
+            explode_bomb(g, b);
+            set_tile(g, b.pos.x, b.pos.y, EMPTY);
 
             // Get rid of the exploded bomb
+            g->bomb_at[board_index(game_board, b.pos.x, b.pos.y)] = -1;
             g->all_bombs.total_count -= 1;
             g->all_bombs.arr[i] = g->all_bombs.arr[g->all_bombs.total_count]; // no need to free memory
+            if (i < g->all_bombs.total_count) {
+                bomb moved = g->all_bombs.arr[i];
+                g->bomb_at[board_index(game_board, moved.pos.x, moved.pos.y)] = i;
+            }
+        }
+    }
+}
+
+void update_bombs(uint64_t now_ms, unsigned int game_id) {
+    RETURN_IF_NULL(games[game_id]);
+
+    explode_bombs(games[game_id], now_ms);
+}
+
+/** Returns the tiles of current_board which differ from previous_board, of the same dimension, and sets
+ *  size_tile_diff with their number
+ */
+static tile_diff *diff_boards(const board *current_board, const board *previous_board, unsigned *size_tile_diff) {
+    int nb_tiles = current_board->dim.width * current_board->dim.height;
+    unsigned nb = 0;
+    for (int i = 0; i < nb_tiles; i++) {
+        nb += current_board->grid[i] != previous_board->grid[i];
+    }
+
+    // At least one, as malloc(0) can return NULL which would be taken for a failure
+    tile_diff *diffs = malloc(sizeof(tile_diff) * (nb == 0 ? 1 : nb));
+    RETURN_NULL_IF_NULL_PERROR(diffs, "malloc");
+    unsigned cmpt = 0;
+    for (int i = 0; cmpt < nb; i++) {
+        if (current_board->grid[i] != previous_board->grid[i]) {
+            coord c = board_coord(current_board, i);
+            diffs[cmpt].x = c.x;
+            diffs[cmpt].y = c.y;
+            diffs[cmpt].tile = (TILE)current_board->grid[i];
+            cmpt++;
         }
     }
+    *size_tile_diff = nb;
+    return diffs;
 }
 
 tile_diff *get_diff_with_board(unsigned game_id, board *different_board, unsigned *size_tile_diff) {
@@ -717,45 +885,28 @@ tile_diff *get_diff_with_board(unsigned game_id, board *different_board, unsigne
         current_board->dim.width != different_board->dim.width || size_tile_diff == NULL) {
         return NULL;
     }
-    unsigned cmpt = 0;
-    tile_diff diffs[current_board->dim.width * current_board->dim.height];
-    for (int i = 0; i < current_board->dim.height * current_board->dim.width; i++) {
-        if (current_board->grid[i] != different_board->grid[i]) {
-            coord c = int_to_coord(i, game_id);
-
-            tile_diff diff;
-            diff.x = c.x;
-            diff.y = c.y;
-            diff.tile = current_board->grid[i];
-
-            diffs[cmpt] = diff;
-            cmpt++;
-        }
-    }
-    tile_diff *res_diffs = malloc(sizeof(tile_diff) * cmpt);
-    RETURN_NULL_IF_NULL(res_diffs);
-    memmove(res_diffs, diffs, sizeof(tile_diff) * cmpt);
-    *size_tile_diff = cmpt;
-    return res_diffs;
+    return diff_boards(current_board, different_board, size_tile_diff);
 }
 
-tile_diff *update_game_board(unsigned game_id, player_action *actions, size_t nb_game_actions,
+tile_diff *update_game_board(unsigned game_id, player_action *actions, size_t nb_game_actions, uint64_t now_ms,
                              unsigned *size_tile_diff) {
     RETURN_NULL_IF_NULL(size_tile_diff);
 
-    board *current_board = get_game_board(game_id);
-    RETURN_NULL_IF_NULL(current_board);
+    RETURN_NULL_IF_NULL(games[game_id]);
+    game *g = games[game_id];
+    board *previous_board = get_game_board(game_id);
+    RETURN_NULL_IF_NULL(previous_board);
 
     for (unsigned i = 0; i < nb_game_actions; i++) {
         if (actions[i].action == GAME_PLACE_BOMB) {
-            place_bomb(actions[i].id, game_id);
+            add_bomb(g, actions[i].id, now_ms);
         } else {
-            perform_move(actions[i].action, actions[i].id, game_id);
+            move_player(g, actions[i].action, actions[i].id);
         }
     }
-    update_bombs(game_id);
-    tile_diff *diffs = get_diff_with_board(game_id, current_board, size_tile_diff);
-    free(current_board);
+    explode_bombs(g, now_ms);
+    tile_diff *diffs = diff_boards(g->game_board, previous_board, size_tile_diff);
+    free_board(previous_board);
     return diffs;
 }
 
@@ -769,7 +920,7 @@ bool is_game_over(unsigned int game_id) {
 
     if (game_mode == SOLO) {
         int alive_count = 0;
-        for (int i = 0; i < PLAYER_NUM; ++i) {
+        for (unsigned i = 0; i < games[game_id]->nb_players; ++i) {
             if (!players[i]->dead) {
                 alive_count++;
             }
@@ -778,12 +929,18 @@ bool is_game_over(unsigned int game_id) {
     }
 
     // In team mode, the game is over when all players of a team are dead
-    // The teams are always 0-3 and 1-2
-
-    bool team1_dead = players[0]->dead && players[3]->dead;
-    bool team2_dead = players[1]->dead && players[2]->dead;
+    return get_winner_team(game_id) != -1;
+}
 
-    return team1_dead || team2_dead;
+/** Returns true if all the players of the team are dead
+ */
+static bool is_team_dead(unsigned int game_id, int team) {
+    for (unsigned i = 0; i < games[game_id]->nb_players; i++) {
+        if (get_player_team(i) == team && !games[game_id]->players[i]->dead) {
+            return false;
+        }
+    }
+    return true;
 }
 
 int get_winner_solo(unsigned int game_id) {
@@ -793,8 +950,9 @@ int get_winner_solo(unsigned int game_id) {
 
     player **players = games[game_id]->players;
 
-    for (int i = 0; i < PLAYER_NUM; i++) {
-        for (int j = 0; j < PLAYER_NUM; j++) {
+    int nb_players = games[game_id]->nb_players;
+    for (int i = 0; i < nb_players; i++) {
+        for (int j = 0; j < nb_players; j++) {
             if (i != j && !players[i]->dead && players[j]->dead) {
                 return i;
             }
@@ -809,13 +967,11 @@ int get_winner_team(unsigned int game_id) {
         return -1;
     }
 
-    player **players = games[game_id]->players;
-
-    if (players[0]->dead && players[3]->dead) {
+    if (is_team_dead(game_id, 0)) {
         return 1;
     }
 
-    if (players[1]->dead && players[2]->dead) {
+    if (is_team_dead(game_id, 1)) {
         return 0;
     }
 
@@ -41,7 +41,9 @@ typedef enum TILE {
     PLAYER_3 = 7,
     PLAYER_4 = 8,
     VERTICAL_BORDER = 9,
-    HORIZONTAL_BORDER = 10
+    HORIZONTAL_BORDER = 10,
+    PLAYER_5 = 11, // The players after the fourth only play the second version of the protocol
+    PLAYER_16 = PLAYER_5 + MAX_PLAYER_NUM - PLAYER_NUM - 1
 } TILE;
 
 typedef enum GAME_MODE { TEAM, SOLO } GAME_MODE;
@@ -67,8 +69,8 @@ typedef struct player_action {
 } player_action;
 
 typedef struct tile_diff {
-    uint8_t x;
-    uint8_t y;
+    uint16_t x;
+    uint16_t y;
     TILE tile;
 } tile_diff;
 
@@ -80,6 +82,16 @@ typedef struct tile_diff {
  */
 int init_model(dimension dim, GAME_MODE mode);
 
+/** Same as init_model but the content of the board is generated from the given seed, the same seed always gives the
+ *  same board
+ */
+int init_model_with_seed(dimension dim, GAME_MODE mode, uint64_t seed);
+
+/** Same as init_model_with_seed with nb_players players instead of PLAYER_NUM, at most MAX_PLAYER_NUM. The players
+ *  after the fourth start on the first and the last lines, which needs a board at least MIN_WIDE_GAMEBOARD_WIDTH wide.
+ */
+int init_model_with_players(dimension dim, GAME_MODE mode, uint64_t seed, unsigned nb_players);
+
 /** Removes all the games
  */
 void reset_games();
@@ -110,6 +122,19 @@ int coord_to_int_dim(int, int, dimension);
  */
 int coord_to_int(int, int, unsigned int game_id);
 
+/** Returns the tile of the player, EMPTY if the id is not one of a player
+ */
+TILE get_player(int player_id);
+
+/** Returns the id of the player of the tile, -1 if the tile is not a player
+ */
+int get_player_id(TILE);
+
+/** Returns the team of the player in team mode, 0 or 1. The teams are 0-3 and 1-2 with four players, then they
+ *  alternate by pairs so that an even number of players makes two teams of the same size.
+ */
+int get_player_team(int player_id);
+
 /** Returns the tile at the position (x, y) of game_board
  */
 TILE get_grid(int, int, unsigned int game_id);
@@ -131,8 +156,10 @@ void perform_move(GAME_ACTION, int player_id, unsigned int game_id);
 /**
  * Places a bomb at the current player's position, resizing the bomb array if full.
  * Updates the game grid and increments bomb count.
+ * now_ms is the current time of the game in milliseconds, the model never reads the clock itself so that a game can be
+ * replayed.
  */
-void place_bomb(int player_id, unsigned int game_id);
+void place_bomb(int player_id, uint64_t now_ms, unsigned int game_id);
 
 /** Returns a copy of the game board
  */
@@ -142,20 +169,45 @@ board *get_game_board(unsigned int game_id);
  */
 GAME_MODE get_game_mode(unsigned int game_id);
 
+/** Returns the number of players of the game
+ */
+unsigned get_nb_players(unsigned int game_id);
+
+/** Returns the seed used to generate the board of the game
+ */
+uint64_t get_game_seed(unsigned int game_id);
+
+/** Makes the bombs of the game explode lifetime_ms after being placed, instead of BOMB_LIFETIME seconds
+ */
+void set_bomb_lifetime(unsigned lifetime_ms, unsigned int game_id);
+
+/** Returns the time in milliseconds between the placement of a bomb of the game and its explosion
+ */
+unsigned get_bomb_lifetime(unsigned int game_id);
+
 bool is_player_dead(int, unsigned int game_id);
 
+/** Returns the position of the player, where it died if it is dead
+ */
+coord get_player_position(int player_id, unsigned int game_id);
+
 void set_player_dead(unsigned int game_id, int player_id);
 
-/** Iterates over all bombs, removing any that have exceeded their lifetime.
+/** Iterates over all bombs, removing any that have exceeded their lifetime at now_ms.
  */
-void update_bombs(unsigned int game_id);
+void update_bombs(uint64_t now_ms, unsigned int game_id);
 
 /** Returns the tiles of the board of game_id after actions modication, which differates with current board, and change
  * size_tile_diff with the size of the result
  */
-tile_diff *update_game_board(unsigned game_id, player_action *actions, size_t nb_game_actions,
+tile_diff *update_game_board(unsigned game_id, player_action *actions, size_t nb_game_actions, uint64_t now_ms,
                              unsigned *size_tile_diff);
 
+/** Returns the tiles of the board of game_id which differ from different_board, and change size_tile_diff with the size
+ * of the result
+ */
+tile_diff *get_diff_with_board(unsigned game_id, board *different_board, unsigned *size_tile_diff);
+
 /** Returns true if the game is over
  */
 bool is_game_over(unsigned int game_id);
@@ -0,0 +1,457 @@
+#define _GNU_SOURCE // sendmmsg
+
+#include "./netem.h"
+#include "./prng.h"
+#include "./utils.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_PERCENT 100.0
+#define MAX_DELAY_MS 60000
+#define SENDMMSG_BATCH 64
+
+typedef struct netem_packet {
+    uint64_t due_us;
+    netem_link *link;
+    int sock; // Only for the datagrams sent
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    size_t size;
+    struct netem_packet *next;
+    char data[];
+} netem_packet;
+
+struct netem_link {
+    netem_config config;
+    prng rng;
+    netem_packet *received; // Received and delayed, sorted by due time, only used by the thread receiving
+    char *buffer;           // Datagram taken from the socket
+    size_t buffer_size;
+};
+
+static netem_config config;
+static bool configured = false;
+
+// Datagrams sent late by the thread of the delayed datagrams, sorted by due time
+static netem_packet *delayed = NULL;
+static pthread_mutex_t lock_delayed = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond_delayed;
+static pthread_once_t sender_once = PTHREAD_ONCE_INIT;
+static bool sender_started = false;
+
+static int parse_percent(const char *str, double *value) {
+    char *end;
+    errno = 0;
+    *value = strtod(str, &end);
+    if (errno != 0 || end == str || *end != '\0' || *value < 0 || *value > MAX_PERCENT) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static int parse_delay(const char *str, unsigned *value) {
+    int r = parse_unsigned_within_bounds(str, 0, MAX_DELAY_MS);
+    if (r < 0) {
+        return EXIT_FAILURE;
+    }
+    *value = r;
+    return EXIT_SUCCESS;
+}
+
+static int parse_seed(const char *str, uint64_t *value) {
+    char *end;
+    errno = 0;
+    *value = strtoull(str, &end, 10);
+    if (errno != 0 || end == str || *end != '\0' || *str == '-') {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static int parse_field(const char *key, const char *value, netem_config *parsed) {
+    if (strcmp(key, "loss") == 0) {
+        return parse_percent(value, &parsed->loss_percent);
+    }
+    if (strcmp(key, "duplicate") == 0) {
+        return parse_percent(value, &parsed->duplicate_percent);
+    }
+    if (strcmp(key, "reorder") == 0) {
+        return parse_percent(value, &parsed->reorder_percent);
+    }
+    if (strcmp(key, "delay") == 0) {
+        return parse_delay(value, &parsed->delay_ms);
+    }
+    if (strcmp(key, "jitter") == 0) {
+        return parse_delay(value, &parsed->jitter_ms);
+    }
+    if (strcmp(key, "seed") == 0) {
+        return parse_seed(value, &parsed->seed);
+    }
+    return EXIT_FAILURE;
+}
+
+int netem_parse_config(const char *str, netem_config *parsed) {
+    memset(parsed, 0, sizeof(netem_config));
+    char *copy = strdup(str);
+    RETURN_FAILURE_IF_NULL_PERROR(copy, "strdup netem config");
+
+    int res = EXIT_SUCCESS;
+    char *save;
+    for (char *field = strtok_r(copy, ",", &save); field != NULL; field = strtok_r(NULL, ",", &save)) {
+        char *equal = strchr(field, '=');
+        if (equal == NULL) {
+            res = EXIT_FAILURE;
+            break;
+        }
+        *equal = '\0';
+        if (parse_field(field, equal + 1, parsed) == EXIT_FAILURE) {
+            res = EXIT_FAILURE;
+            break;
+        }
+    }
+    free(copy);
+    return res;
+}
+
+void netem_configure(const netem_config *new_config) {
+    config = *new_config;
+    configured = true;
+}
+
+int netem_configure_from_env() {
+    const char *str = getenv(NETEM_ENV);
+    if (str == NULL) {
+        return EXIT_SUCCESS;
+    }
+    netem_config parsed;
+    if (netem_parse_config(str, &parsed) == EXIT_FAILURE) {
+        fprintf(stderr, "The %s environment variable is not valid.\n", NETEM_ENV);
+        return EXIT_FAILURE;
+    }
+    netem_configure(&parsed);
+    return EXIT_SUCCESS;
+}
+
+const netem_config *netem_get_config() {
+    return configured ? &config : NULL;
+}
+
+netem_link *netem_create_link(uint64_t salt) {
+    if (!configured) {
+        return NULL;
+    }
+    netem_link *link = calloc(1, sizeof(netem_link));
+    RETURN_NULL_IF_NULL_PERROR(link, "calloc netem_link");
+    link->config = config;
+    prng_seed(&link->rng, config.seed + salt * 0x9E3779B97F4A7C15ULL);
+    return link;
+}
+
+static void free_packets(netem_packet *packet) {
+    while (packet != NULL) {
+        netem_packet *next = packet->next;
+        free(packet);
+        packet = next;
+    }
+}
+
+void netem_drop_delayed(netem_link *link) {
+    RETURN_IF_NULL(link);
+
+    pthread_mutex_lock(&lock_delayed);
+    netem_packet **cur = &delayed;
+    while (*cur != NULL) {
+        netem_packet *packet = *cur;
+        if (packet->link == link) {
+            *cur = packet->next;
+            free(packet);
+        } else {
+            cur = &packet->next;
+        }
+    }
+    pthread_mutex_unlock(&lock_delayed);
+}
+
+void netem_free_link(netem_link *link) {
+    RETURN_IF_NULL(link);
+
+    netem_drop_delayed(link);
+    free_packets(link->received);
+    free(link->buffer);
+    free(link);
+}
+
+static bool chance(netem_link *link, double percent) {
+    return percent > 0 && prng_next(&link->rng) / 4294967296.0 * MAX_PERCENT < percent;
+}
+
+/** Returns how many copies of a datagram go through the link (0 if it is lost), and the due time of each
+ */
+static unsigned impair(netem_link *link, uint64_t now_us, uint64_t due_us[2]) {
+    if (chance(link, link->config.loss_percent)) {
+        return 0;
+    }
+    unsigned copies = chance(link, link->config.duplicate_percent) ? 2 : 1;
+    for (unsigned i = 0; i < copies; i++) {
+        int64_t delay_us = link->config.delay_ms * 1000LL;
+        if (link->config.jitter_ms > 0) {
+            int64_t jitter_us = link->config.jitter_ms * 1000LL;
+            delay_us += (int64_t)prng_range(&link->rng, 2 * jitter_us + 1) - jitter_us;
+        }
+        if (chance(link, link->config.reorder_percent)) {
+            delay_us += NETEM_REORDER_DELAY_MS * 1000LL;
+        }
+        due_us[i] = now_us + (delay_us > 0 ? delay_us : 0);
+    }
+    return copies;
+}
+
+/** Inserts the packet after the packets due before or at the same time, so that equal delays keep the order
+ */
+static void insert_packet(netem_packet **list, netem_packet *packet) {
+    while (*list != NULL && (*list)->due_us <= packet->due_us) {
+        list = &(*list)->next;
+    }
+    packet->next = *list;
+    *list = packet;
+}
+
+static netem_packet *create_packet(netem_link *link, uint64_t due_us, const void *data, size_t size) {
+    netem_packet *packet = malloc(sizeof(netem_packet) + size);
+    RETURN_NULL_IF_NULL_PERROR(packet, "malloc netem_packet");
+    packet->due_us = due_us;
+    packet->link = link;
+    packet->sock = -1;
+    packet->addr_len = 0;
+    packet->size = size;
+    packet->next = NULL;
+    memcpy(packet->data, data, size);
+    return packet;
+}
+
+static void *serve_delayed_packets(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&lock_delayed);
+    while (true) {
+        if (delayed == NULL) {
+            pthread_cond_wait(&cond_delayed, &lock_delayed);
+            continue;
+        }
+        uint64_t now_us = get_time_us();
+        if (delayed->due_us > now_us) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            uint64_t wake_ns = ts.tv_nsec + (delayed->due_us - now_us) * 1000;
+            ts.tv_sec += wake_ns / 1000000000;
+            ts.tv_nsec = wake_ns % 1000000000;
+            pthread_cond_timedwait(&cond_delayed, &lock_delayed, &ts);
+            continue;
+        }
+        // Sent with the lock held, so that the socket is not used once netem_drop_delayed has returned
+        netem_packet *packet = delayed;
+        delayed = packet->next;
+        sendto(packet->sock, packet->data, packet->size, 0, (struct sockaddr *)&packet->addr, packet->addr_len);
+        free(packet);
+    }
+    return NULL;
+}
+
+static void start_sender() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond_delayed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_t t;
+    if (pthread_create(&t, NULL, serve_delayed_packets, NULL) != 0) {
+        perror("pthread_create netem");
+        return;
+    }
+    pthread_detach(t);
+    sender_started = true;
+}
+
+ssize_t netem_sendto(netem_link *link, int sock, const void *message, size_t size, const struct sockaddr *addr,
+                     socklen_t addr_len) {
+    if (link == NULL) {
+        return sendto(sock, message, size, 0, addr, addr_len);
+    }
+
+    uint64_t now_us = get_time_us();
+    uint64_t due_us[2];
+    unsigned copies = impair(link, now_us, due_us);
+    for (unsigned i = 0; i < copies; i++) {
+        if (due_us[i] <= now_us) {
+            if (sendto(sock, message, size, 0, addr, addr_len) < 0) {
+                return -1;
+            }
+            continue;
+        }
+
+        pthread_once(&sender_once, start_sender);
+        if (!sender_started || addr_len > sizeof(struct sockaddr_storage)) {
+            return -1;
+        }
+        netem_packet *packet = create_packet(link, due_us[i], message, size);
+        if (packet == NULL) {
+            return -1;
+        }
+        packet->sock = sock;
+        memcpy(&packet->addr, addr, addr_len);
+        packet->addr_len = addr_len;
+
+        pthread_mutex_lock(&lock_delayed);
+        insert_packet(&delayed, packet);
+        pthread_cond_signal(&cond_delayed);
+        pthread_mutex_unlock(&lock_delayed);
+    }
+    return size;
+}
+
+/** Sends the message i, or the only message if same is true, to the address i of the nb addresses
+ */
+static int sendto_many(netem_link *link, int sock, const struct iovec *messages, bool same,
+                       const struct sockaddr_in6 *addrs, unsigned nb) {
+    unsigned sent = 0;
+    if (link != NULL) {
+        for (; sent < nb; sent++) {
+            const struct iovec *message = same ? &messages[0] : &messages[sent];
+            if (netem_sendto(link, sock, message->iov_base, message->iov_len, (const struct sockaddr *)&addrs[sent],
+                             sizeof(struct sockaddr_in6)) < 0) {
+                break;
+            }
+        }
+        return sent == 0 && nb > 0 ? -1 : (int)sent;
+    }
+
+    struct mmsghdr msgs[SENDMMSG_BATCH];
+    while (sent < nb) {
+        unsigned batch = nb - sent < SENDMMSG_BATCH ? nb - sent : SENDMMSG_BATCH;
+        memset(msgs, 0, batch * sizeof(struct mmsghdr));
+        for (unsigned i = 0; i < batch; i++) {
+            msgs[i].msg_hdr.msg_name = (void *)&addrs[sent + i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+            msgs[i].msg_hdr.msg_iov = (struct iovec *)(same ? &messages[0] : &messages[sent + i]);
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int res = sendmmsg(sock, msgs, batch, 0);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            break;
+        }
+        sent += res;
+    }
+    return sent == 0 && nb > 0 ? -1 : (int)sent;
+}
+
+int netem_sendto_all(netem_link *link, int sock, const void *message, size_t size, const struct sockaddr_in6 *addrs,
+                     unsigned nb) {
+    struct iovec iov = {(void *)message, size};
+    return sendto_many(link, sock, &iov, true, addrs, nb);
+}
+
+int netem_sendto_each(netem_link *link, int sock, const struct iovec *messages, const struct sockaddr_in6 *addrs,
+                      unsigned nb) {
+    return sendto_many(link, sock, messages, false, addrs, nb);
+}
+
+/** Takes every datagram waiting in the socket, so that the delay of each one starts when it arrived.
+ *  Returns 1 once the socket is empty, or the result of recv if the socket is closed or failed.
+ */
+static ssize_t take_received(netem_link *link, int sock, size_t size) {
+    while (true) {
+        ssize_t res = recv(sock, link->buffer, size, MSG_DONTWAIT);
+        if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 1;
+        }
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return res;
+        }
+
+        uint64_t now_us = get_time_us();
+        uint64_t due_us[2];
+        unsigned copies = impair(link, now_us, due_us);
+        for (unsigned i = 0; i < copies; i++) {
+            netem_packet *packet = create_packet(link, due_us[i], link->buffer, res);
+            if (packet == NULL) {
+                return -1;
+            }
+            insert_packet(&link->received, packet);
+        }
+    }
+}
+
+/** Waits at most timeout_ms for the socket to be readable, returns -1 with errno set to EAGAIN when it is not
+ */
+static int wait_readable(int sock, int timeout_ms) {
+    struct pollfd p;
+    p.fd = sock;
+    p.events = POLLIN;
+    int res = poll(&p, 1, timeout_ms);
+    if (res == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return res < 0 && errno != EINTR ? -1 : 0;
+}
+
+ssize_t netem_recv(netem_link *link, int sock, void *buffer, size_t size, int timeout_ms) {
+    uint64_t deadline_us = get_time_us() + (timeout_ms < 0 ? 0 : timeout_ms * 1000ULL);
+    if (link == NULL) {
+        if (timeout_ms >= 0 && wait_readable(sock, timeout_ms) < 0) {
+            return -1;
+        }
+        return recv(sock, buffer, size, 0);
+    }
+    if (link->buffer_size < size) {
+        char *new_buffer = realloc(link->buffer, size);
+        if (new_buffer == NULL) {
+            perror("realloc netem buffer");
+            return -1;
+        }
+        link->buffer = new_buffer;
+        link->buffer_size = size;
+    }
+
+    while (true) {
+        ssize_t res = take_received(link, sock, size);
+        if (res <= 0) {
+            return res;
+        }
+
+        uint64_t now_us = get_time_us();
+        netem_packet *packet = link->received;
+        if (packet != NULL && packet->due_us <= now_us) {
+            link->received = packet->next;
+            size_t received = packet->size < size ? packet->size : size;
+            memcpy(buffer, packet->data, received);
+            free(packet);
+            return received;
+        }
+
+        if (timeout_ms >= 0 && now_us >= deadline_us) {
+            errno = EAGAIN;
+            return -1;
+        }
+        uint64_t wake_us = packet == NULL ? UINT64_MAX : packet->due_us;
+        if (timeout_ms >= 0 && deadline_us < wake_us) {
+            wake_us = deadline_us;
+        }
+        int wait_ms = wake_us == UINT64_MAX ? -1 : (int)((wake_us - now_us + 999) / 1000);
+        if (wait_readable(sock, wait_ms) < 0 && errno != EAGAIN) {
+            return -1;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef SRC_NETEM_H_
+#define SRC_NETEM_H_
+
+#include <stdbool.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/** Impairment of the datagrams sent and received over UDP, to test the games on a bad link without external tools.
+ *  Each datagram going through a link can be lost, duplicated, delayed or held back behind the next ones. The
+ *  decisions come from a prng seeded by the configuration and the salt of the link, so a run is reproducible.
+ *  A NULL link sends and receives the datagrams unchanged.
+ */
+
+#define NETEM_ENV "BOMBERMAN_NETEM"
+#define NETEM_REORDER_DELAY_MS 100 // Added to the delay of a datagram held back, so that the next ones overtake it
+
+typedef struct netem_config {
+    double loss_percent;
+    double duplicate_percent;
+    double reorder_percent;
+    unsigned delay_ms;
+    unsigned jitter_ms; // The delay of each datagram is in [delay - jitter, delay + jitter]
+    uint64_t seed;
+} netem_config;
+
+typedef struct netem_link netem_link;
+
+/** Parses a configuration written as "loss=5,duplicate=1,reorder=10,delay=30,jitter=10,seed=42", the missing fields
+ *  are 0. Returns EXIT_FAILURE if a field is unknown or its value is not valid.
+ */
+int netem_parse_config(const char *str, netem_config *config);
+
+/** Impairs the links created from now on with config
+ */
+void netem_configure(const netem_config *config);
+
+/** Configures the impairment from the environment variable NETEM_ENV, if it is set. Returns EXIT_FAILURE if it is not
+ *  a valid configuration.
+ */
+int netem_configure_from_env();
+
+/** Returns the configuration of the impairment, or NULL if there is none
+ */
+const netem_config *netem_get_config();
+
+/** Returns a new link impaired as configured, its decisions are seeded by the seed of the configuration and salt.
+ *  Returns NULL when no impairment is configured.
+ */
+netem_link *netem_create_link(uint64_t salt);
+
+/** Drops the datagrams the link still delays, to call before closing the sockets it sends on
+ */
+void netem_drop_delayed(netem_link *link);
+
+/** Frees the link, after dropping the datagrams it still delays
+ */
+void netem_free_link(netem_link *link);
+
+/** Same as sendto, through the link. A datagram lost or delayed counts as sent.
+ */
+ssize_t netem_sendto(netem_link *link, int sock, const void *message, size_t size, const struct sockaddr *addr,
+                     socklen_t addr_len);
+
+/** Sends the same datagram to each of the nb addresses through the link, with as few system calls as possible when the
+ *  link is NULL. Returns how many datagrams were sent, a datagram lost or delayed counts as sent, or -1 if none could.
+ */
+int netem_sendto_all(netem_link *link, int sock, const void *message, size_t size, const struct sockaddr_in6 *addrs,
+                     unsigned nb);
+
+/** Same as netem_sendto_all, with the message i sent to the address i
+ */
+int netem_sendto_each(netem_link *link, int sock, const struct iovec *messages, const struct sockaddr_in6 *addrs,
+                      unsigned nb);
+
+/** Same as recv, through the link: the datagrams received are delayed in the link before being returned. A link is
+ *  used by one thread at a time. Waits at most timeout_ms for a datagram, or forever if it is negative, and returns -1
+ *  with errno set to EAGAIN when none came.
+ */
+ssize_t netem_recv(netem_link *link, int sock, void *buffer, size_t size, int timeout_ms);
+
+#endif // SRC_NETEM_H_
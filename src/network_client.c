@@ -1,22 +1,33 @@
 #include "network_client.h"
 #include "communication_client.h"
+#include "constants.h"
 #include "messages.h"
+#include "netem.h"
+#include "tcp_reader.h"
 #include "utils.h"
 
 #include <arpa/inet.h>
 #include <net/if.h>
 #include <netinet/in.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 static const char *IP_SERVER = "::1";
 
-static int message_gameboard_max_size = GAMEBOARD_WIDTH * GAMEBOARD_HEIGHT + 6;
+// Largest datagram, so that no message is truncated whatever the board and the version of the protocol are
+#define GAME_MESSAGE_MAX_SIZE UINT16_MAX
+static char *game_message_buffer = NULL; // Reused for every message of the multicast socket
 
 static int sock_tcp = -1;
+static tcp_reader *reader_tcp = NULL; // Everything received from the server over TCP after the connection
 static int sock_udp = -1;
 static int sock_diff = -1;
 
@@ -24,17 +35,63 @@ static uint16_t port_tcp = 0;
 static uint16_t port_udp = 0;
 static uint16_t port_diff = 0;
 
+// Without any multicast message this long after the first keyframe, the messages of the game are asked over unicast
+#define MULTICAST_FALLBACK_MS 3000
+// The subscription over unicast is sent again after this long without any message of the game, in case it was lost
+#define UNICAST_SUBSCRIBE_PERIOD_MS 1000
+
+// Each game action is sent again with the next ones sent within this delay, later it would be applied too late
+#define GAME_ACTION_REDUNDANCY_MS 250
+
+// Latest game actions sent, the oldest first, only used by the thread sending them
+static game_action recent_actions[GAME_ACTION_BATCH_MAX - 1];
+static uint64_t recent_actions_ms[GAME_ACTION_BATCH_MAX - 1];
+static unsigned nb_recent_actions = 0;
+
+// The messages of the game are received on sock_udp once subscribed over unicast, on sock_diff otherwise
+static bool unicast = false;
+static bool multicast_received = false;
+static uint64_t subscription_token = 0; // Echoed by the subscriptions, 0 when the server sent none
+// The address of the client is subscribed to the pings again until one comes, in case the subscription was lost
+static bool ping_received = false;
+static uint64_t subscribed_ms = 0;
+static atomic_uint_fast64_t keyframe_ms = 0; // When the first keyframe was received, 0 before
+
+// Impair the game actions sent and the messages of the game received when BOMBERMAN_NETEM is set, NULL otherwise
+#define NETEM_SALT_UDP 1
+#define NETEM_SALT_DIFF 2
+static netem_link *netem_udp = NULL;
+static netem_link *netem_diff = NULL;
+
 static struct sockaddr_in6 *addr_udp;
 static struct sockaddr_in6 *addr_diff;
 
 static uint16_t adrmdiff[8];
 
+static const char *multicast_interface = DEFAULT_MULTICAST_INTERFACE;
+
 static int id;
 static int eq;
+static PROTOCOL_VERSION protocol_version = PROTOCOL_V1; // Asked to the server when joining a game
+// Announced to the server when joining a game, which answers with the ones chosen for the game
+static capabilities announced_capabilities = {CAPABILITY_ACTION_BATCH | CAPABILITY_AREAS, GAME_MESSAGE_MAX_SIZE};
+static capabilities game_capabilities = {0, GAME_MESSAGE_MAX_SIZE};
+static bool announces_capabilities = true;
+
+// The chat messages and the keyframe requests are sent by different threads
+static pthread_mutex_t send_tcp_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 void free_internal_info() {
     free(addr_udp);
     free(addr_diff);
+    free_tcp_reader(reader_tcp);
+    reader_tcp = NULL;
+    free(game_message_buffer);
+    game_message_buffer = NULL;
+    netem_free_link(netem_udp);
+    netem_udp = NULL;
+    netem_free_link(netem_diff);
+    netem_diff = NULL;
 }
 
 void close_socket(int sock) {
@@ -114,6 +171,27 @@ void set_tcp_port(uint16_t port) {
     port_tcp = htons(port);
 }
 
+void set_protocol_version(PROTOCOL_VERSION version) {
+    protocol_version = version;
+}
+
+void set_max_datagram_size(uint16_t size) {
+    announced_capabilities.max_datagram = size;
+}
+
+void set_capabilities_announced(bool announced) {
+    announces_capabilities = announced;
+}
+
+int set_multicast_interface(const char *name) {
+    if (if_nametoindex(name) == 0) {
+        fprintf(stderr, "The interface %s does not exist.\n", name);
+        return EXIT_FAILURE;
+    }
+    multicast_interface = name;
+    return EXIT_SUCCESS;
+}
+
 struct sockaddr_in6 *prepare_address(int port) {
     struct sockaddr_in6 *addrsock = malloc(sizeof(struct sockaddr_in6));
     RETURN_NULL_IF_NULL_PERROR(addrsock, "malloc addrsock");
@@ -166,11 +244,8 @@ int init_diff_info(connection_information *head) {
     }
 
     /* initialisation de l'interface locale autorisant le multicast IPv6 */
-    int ifindex = if_nametoindex("eth0");
-    if (ifindex == 0) {
-        perror("if_nametoindex");
-        exit(1);
-    }
+    // 0 lets the system choose the interface when there is no DEFAULT_MULTICAST_INTERFACE
+    unsigned ifindex = if_nametoindex(multicast_interface);
 
     /* s'abonner au groupe multicast */
     struct ipv6_mreq group;
@@ -191,6 +266,11 @@ int init_diff_info(connection_information *head) {
 int init_udp_info(connection_information *head) {
     port_udp = htons(head->portudp);
     init_udp_socket();
+    int option = 1;
+    // The time the pings arrive, received while waiting on the multicast group
+    if (setsockopt(sock_udp, SOL_SOCKET, SO_TIMESTAMP, &option, sizeof(option)) < 0) {
+        perror("setsockopt timestamp");
+    }
     addr_udp = prepare_address(port_udp);
 
     if (addr_udp == NULL) {
@@ -198,9 +278,31 @@ int init_udp_info(connection_information *head) {
         exit(1);
     }
 
+    netem_udp = netem_create_link(NETEM_SALT_UDP);
     return EXIT_SUCCESS;
 }
 
+static bool has_multicast_group() {
+    for (unsigned i = 0; i < 8; i++) {
+        if (adrmdiff[i] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Asks the server for the messages of the game over unicast, or only for the pings, at the address of sock_udp. Only
+ *  a client which got the token of its subscriptions can subscribe.
+ */
+static void subscribe(bool over_unicast) {
+    if (subscription_token == 0) {
+        return;
+    }
+    subscription_message subscription = {id, eq, subscription_token, over_unicast};
+    send_unicast_subscription(sock_udp, addr_udp, &subscription);
+    subscribed_ms = get_time_ms();
+}
+
 int set_server_informations(connection_information *head) {
     id = head->id;
     eq = head->eq;
@@ -208,19 +310,33 @@ int set_server_informations(connection_information *head) {
         adrmdiff[i] = head->adrmdiff[i];
     }
 
-    RETURN_FAILURE_IF_ERROR(init_diff_info(head));
+    // A server without multicast sends no group, and the messages of the game once subscribed over unicast
+    unicast = !has_multicast_group();
+    if (!unicast) {
+        RETURN_FAILURE_IF_ERROR(init_diff_info(head));
+    }
     RETURN_FAILURE_IF_ERROR(init_udp_info(head));
+    netem_diff = netem_create_link(NETEM_SALT_DIFF);
+    subscribe(unicast);
 
     return EXIT_SUCCESS;
 }
 
 connection_information *start_initialisation_game(GAME_MODE mode) {
-    if (send_initial_connexion_information(sock_tcp, mode) == EXIT_FAILURE) {
+    const capabilities *caps = announces_capabilities ? &announced_capabilities : NULL;
+    if (send_initial_connexion_information(sock_tcp, mode, protocol_version, caps) == EXIT_FAILURE) {
         return NULL;
     }
     printf("You have to wait for other players.\n");
-    connection_information *head = recv_connexion_information(sock_tcp);
+    reader_tcp = create_tcp_reader(sock_tcp);
+    RETURN_NULL_IF_NULL(reader_tcp);
+    connection_information *head = recv_connexion_information(reader_tcp);
     RETURN_NULL_IF_NULL(head);
+    if (announces_capabilities &&
+        recv_capabilities(reader_tcp, &game_capabilities, &subscription_token) == EXIT_FAILURE) {
+        free(head);
+        return NULL;
+    }
 
     RETURN_NULL_IF_ERROR(set_server_informations(head));
     printf("The server is ready.\n");
@@ -231,83 +347,179 @@ int send_ready_to_play(GAME_MODE mode) {
     return send_ready_connexion_information(sock_tcp, mode, id, eq);
 }
 
-received_game_message *recv_game_message() {
-    received_game_message *recieved = malloc(sizeof(received_game_message));
-    RETURN_NULL_IF_NULL_PERROR(recieved, "malloc received_game_message");
+/** Returns true if no multicast message came long enough after the first keyframe for the group not to reach the client
+ */
+static bool multicast_lost() {
+    uint64_t keyframe = atomic_load(&keyframe_ms);
+    return !multicast_received && keyframe != 0 && get_time_ms() - keyframe >= MULTICAST_FALLBACK_MS;
+}
+
+/** Answers the ping of size bytes which arrived at received_us on the wall clock, returns EXIT_FAILURE if it is not a
+ *  ping
+ */
+static int answer_ping(const char *message, size_t size, uint64_t received_us) {
+    pong_message pong = {id, eq, 0, received_us, 0};
+    RETURN_FAILURE_IF_ERROR(read_ping(message, size, &pong.ping_sent_us));
+    pong.sent_us = get_wall_time_us();
+    char *serialized = serialize_pong(&pong);
+    RETURN_FAILURE_IF_NULL(serialized);
+    ssize_t res = netem_sendto(netem_udp, sock_udp, serialized, PONG_SIZE, (struct sockaddr *)addr_udp,
+                               sizeof(struct sockaddr_in6));
+    free(serialized);
+    RETURN_FAILURE_IF_NEG_PERROR(res, "sendto pong");
+    ping_received = true;
+    return EXIT_SUCCESS;
+}
 
-    char *message = malloc(sizeof(char) * message_gameboard_max_size);
-    memset(message, 0, sizeof(char) * message_gameboard_max_size);
-    int res = recvfrom(sock_diff, message, message_gameboard_max_size, 0, NULL, 0);
+/** Answers the pings waiting on the UDP socket while the messages of the game come from the multicast group. The time
+ *  the kernel received each one is used, so that the time spent waiting for the multicast messages is not counted in
+ *  the round trip.
+ */
+static void answer_waiting_pings() {
+    char ping[PING_SIZE];
+    char control[CMSG_SPACE(sizeof(struct timeval))];
+    while (true) {
+        struct iovec iov = {ping, PING_SIZE};
+        struct msghdr msg = {0};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t res = recvmsg(sock_udp, &msg, MSG_DONTWAIT);
+        if (res < 0) {
+            return;
+        }
+        uint64_t received_us = get_wall_time_us();
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c != NULL; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMP) {
+                struct timeval tv;
+                memcpy(&tv, CMSG_DATA(c), sizeof(struct timeval));
+                received_us = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+            }
+        }
+        answer_ping(ping, res, received_us);
+    }
+}
 
-    if (res < 0) {
-        free(message);
-        free(recieved);
-        return NULL;
-    } else if (res < 5) {
-        free(message);
-        free(recieved);
-        return NULL;
+/** Receives the next datagram of the game in game_message_buffer, from the multicast group or over unicast once the
+ *  group is found not to reach the client. The pings of the server are answered on the way.
+ */
+static ssize_t recv_game_datagram() {
+    while (true) {
+        if (!unicast) {
+            answer_waiting_pings();
+            if (!ping_received && get_time_ms() - subscribed_ms >= UNICAST_SUBSCRIBE_PERIOD_MS) {
+                subscribe(false);
+            }
+        }
+        ssize_t res = netem_recv(netem_diff, unicast ? sock_udp : sock_diff, game_message_buffer,
+                                 GAME_MESSAGE_MAX_SIZE, UNICAST_SUBSCRIBE_PERIOD_MS);
+        if (res >= 0 && unicast && answer_ping(game_message_buffer, res, get_wall_time_us()) == EXIT_SUCCESS) {
+            continue;
+        }
+        if (res >= 0 || errno != EAGAIN) {
+            multicast_received = multicast_received || (!unicast && res > 0);
+            return res;
+        }
+        if (unicast || multicast_lost()) {
+            unicast = true;
+            subscribe(true);
+        }
     }
+}
 
-    uint16_t codereq = ntohs(*(uint16_t *)message) >> 3;
+int recv_game_message(received_game_message *received) {
+    if (game_message_buffer == NULL) {
+        game_message_buffer = malloc(GAME_MESSAGE_MAX_SIZE);
+        RETURN_FAILURE_IF_NULL_PERROR(game_message_buffer, "malloc game_message_buffer");
+    }
 
-    switch (codereq) {
+    ssize_t res = recv_game_datagram();
+    if (res < GAME_BOARD_UPDATE_HEADER_SIZE) {
+        return EXIT_FAILURE;
+    }
+
+    uint16_t header;
+    memcpy(&header, game_message_buffer, sizeof(uint16_t));
+    switch (message_code(header)) {
         case 11:
-            RETURN_NULL_IF_NULL(message);
-            uint8_t height = message[4];
-            uint8_t width = message[5];
-
-            if (6 + height * width > message_gameboard_max_size) {
-                message_gameboard_max_size = 7 + height * width;
-                free(message);
-                return NULL;
-            }
-            recieved->type = GAME_BOARD_INFORMATION;
+            received->type = GAME_BOARD_INFORMATION;
             break;
         case 12:
-            recieved->type = GAME_BOARD_UPDATE;
+            received->type = GAME_BOARD_UPDATE;
+            break;
+        case GAME_BOARD_REGION_CODE:
+            received->type = GAME_BOARD_REGION;
             break;
         default:
-            free(message);
-            free(recieved);
-            return NULL;
+            return EXIT_FAILURE;
     }
 
-    recieved->message = message;
+    received->message = game_message_buffer;
+    received->size = res;
+    return EXIT_SUCCESS;
+}
 
-    return recieved;
+/** Keeps the action sent, to send it again with the next ones
+ */
+static void add_recent_action(const game_action *action, uint64_t now_ms) {
+    if (nb_recent_actions == GAME_ACTION_BATCH_MAX - 1) {
+        memmove(recent_actions, recent_actions + 1, (nb_recent_actions - 1) * sizeof(game_action));
+        memmove(recent_actions_ms, recent_actions_ms + 1, (nb_recent_actions - 1) * sizeof(uint64_t));
+        nb_recent_actions--;
+    }
+    recent_actions[nb_recent_actions] = *action;
+    recent_actions_ms[nb_recent_actions] = now_ms;
+    nb_recent_actions++;
 }
 
 int send_game_action(game_action *action) {
-    char *serialized = serialize_game_action(action);
-
-    int res = sendto(sock_udp, serialized, 4, 0, (struct sockaddr *)addr_udp, sizeof(struct sockaddr_in6));
-    if (res < 0) {
-        perror("sendto action");
-        free(serialized);
-        return EXIT_FAILURE;
+    // The datagram also carries the latest actions sent, in case theirs were lost, if the server reads batches
+    game_action batch[GAME_ACTION_BATCH_MAX];
+    unsigned nb = 0;
+    uint64_t now_ms = get_time_ms();
+    bool batched = game_capabilities.flags & CAPABILITY_ACTION_BATCH;
+    for (unsigned i = 0; batched && i < nb_recent_actions; i++) {
+        if (now_ms - recent_actions_ms[i] < GAME_ACTION_REDUNDANCY_MS) {
+            batch[nb++] = recent_actions[i];
+        }
     }
+    batch[nb++] = *action;
+
+    char *serialized = serialize_game_action_batch(batch, nb);
+    RETURN_FAILURE_IF_NULL(serialized);
+    int res = netem_sendto(netem_udp, sock_udp, serialized, nb * GAME_ACTION_SIZE, (struct sockaddr *)addr_udp,
+                           sizeof(struct sockaddr_in6));
+    free(serialized);
+    RETURN_FAILURE_IF_NEG_PERROR(res, "sendto action");
 
+    add_recent_action(action, now_ms);
     return EXIT_SUCCESS;
 }
 
 int send_chat_message_to_server(chat_message_type type, uint8_t message_length, char *message) {
-    return send_chat_message(sock_tcp, type, id, eq, message_length, message);
-}
-
-chat_message *recv_chat_message_from_server(u_int16_t header) {
-    return recv_chat_message(sock_tcp, header);
+    pthread_mutex_lock(&send_tcp_mutex);
+    int res = send_chat_message(sock_tcp, type, id, eq, message_length, message);
+    pthread_mutex_unlock(&send_tcp_mutex);
+    return res;
 }
 
-u_int16_t recv_header_from_server() {
-    return recv_header(sock_tcp);
+int send_keyframe_request_to_server() {
+    pthread_mutex_lock(&send_tcp_mutex);
+    int res = send_keyframe_request(sock_tcp, id, eq);
+    pthread_mutex_unlock(&send_tcp_mutex);
+    return res;
 }
 
-bool has_server_disconnected_tcp() {
-    char buffer[1];
-    int res = recv(sock_tcp, buffer, 1, MSG_PEEK | MSG_DONTWAIT);
-    if (res == 0) {
-        return true;
+int recv_tcp_message_from_server(const char **message, size_t *size) {
+    if (tcp_reader_wait_next(reader_tcp, message, size) != 1) {
+        return EXIT_FAILURE;
     }
-    return false;
+    uint16_t header;
+    memcpy(&header, *message, sizeof(uint16_t));
+    if (message_code(header) == KEYFRAME_CODE && atomic_load(&keyframe_ms) == 0) {
+        atomic_store(&keyframe_ms, get_time_ms());
+    }
+    return EXIT_SUCCESS;
 }
+
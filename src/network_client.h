@@ -14,6 +14,25 @@ void close_socket_udp();
 void close_socket_diff();
 void shutdown_tcp_on_write();
 void set_tcp_port(uint16_t port);
+
+/** Asks the server for games of the version of the protocol, PROTOCOL_V1 by default. A server of the first version
+ *  answers with the first one.
+ */
+void set_protocol_version(PROTOCOL_VERSION version);
+
+/** Announces to the server that the client receives no game board update larger than size, at least MIN_DATAGRAM_SIZE,
+ *  instead of the largest datagram
+ */
+void set_max_datagram_size(uint16_t size);
+
+/** Makes the client announce no capabilities when it joins a game, to join a server which does not know them
+ */
+void set_capabilities_announced(bool announced);
+
+/** Joins the multicast group of the game on the network interface name instead of DEFAULT_MULTICAST_INTERFACE,
+ *  returns EXIT_FAILURE if it does not exist
+ */
+int set_multicast_interface(const char *name);
 int try_to_connect_tcp();
 connection_information *start_initialisation_game(GAME_MODE mode);
 int send_ready_to_play(GAME_MODE mode);
@@ -21,22 +40,31 @@ int send_ready_to_play(GAME_MODE mode);
 typedef enum game_message_type {
     GAME_BOARD_INFORMATION,
     GAME_BOARD_UPDATE,
+    GAME_BOARD_REGION,
 } game_message_type;
 
+/** Message received on the multicast socket, message points to the receive buffer until the next recv_game_message
+ */
 typedef struct received_game_message {
-    char *message;
+    const char *message;
+    size_t size;
     game_message_type type;
 } received_game_message;
 
 void free_internal_info();
 
-received_game_message *recv_game_message();
+int recv_game_message(received_game_message *received);
 int send_game_action(game_action *action);
 
 int send_chat_message_to_server(chat_message_type type, uint8_t message_length, char *message);
-chat_message *recv_chat_message_from_server(u_int16_t header);
-u_int16_t recv_header_from_server();
 
-bool has_server_disconnected_tcp();
+/** Asks the server for the current board of the game, which is received as a message over TCP
+ */
+int send_keyframe_request_to_server();
+
+/** Receives the next message of the server over TCP, message points to it until the next call.
+ *  Returns EXIT_FAILURE if the connection is closed or if the server sent something else than a message.
+ */
+int recv_tcp_message_from_server(const char **message, size_t *size);
 
 #endif // SRC_NETWORK_CLIENT_H__H_
@@ -1,10 +1,20 @@
+#define _GNU_SOURCE // POLLRDHUP
+
 #include "network_server.h"
+#include "log.h"
 #include "messages.h"
 #include "model.h"
+#include "netem.h"
+#include "prng.h"
+#include "source_limit.h"
+#include "token_bucket.h"
+#include "trace.h"
 #include "utils.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <net/if.h>
 #include <netinet/in.h>
 #include <poll.h>
@@ -16,8 +26,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/poll.h>
-#include <sys/select.h>
+#include <sys/random.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
 #define MAX_PORT_TRY 250
@@ -25,12 +36,15 @@
 
 #define ERROR_ADDRINUSE 2
 
-#define LIMIT_LAST_NUM_MESSAGE_MULT ((1 << 15) - 1)   // 2^16
+#define LIMIT_LAST_NUM_MESSAGE_MULT (1 << 16)         // 2^16
 #define LIMIT_LAST_NUM_MESSAGE_CLIENT ((1 << 12) - 1) // 2^13
 
-#define FREQ 50000 // 100 00 us = 10 ms
 #define INITIAL_GAME_ACTIONS_SIZE 4
+#define MAX_PENDING_GAME_ACTIONS 256 // Queued for a tick, so that a flood of actions cannot make it longer
+#define DEFAULT_ACTION_RATE 40       // Game actions accepted per second from each player
+#define DATAGRAMS_PER_ACTION 2       // Datagrams accepted from an address per action, for the pongs and subscriptions
 #define INITIAL_POLL_FD_SIZE 9
+#define TCP_POLL_TIMEOUT_MS 1000 // To notice the end of the game
 
 typedef struct tcp_thread_data {
     unsigned id;
@@ -41,6 +55,8 @@ typedef struct tcp_thread_data {
 
     int last_num_message;
 
+    tcp_reader *reader; // Messages received from the client after the initial connection header
+
     bool *finished_flag;
     unsigned *nb_players_left;
 
@@ -68,6 +84,10 @@ typedef struct udp_thread_data {
     bool *finished_flag;
     unsigned *nb_stopped_udp_threads;
 
+    // Rate limits applied before queuing the actions, only used by the thread receiving them
+    token_bucket action_limits[MAX_PLAYER_NUM];
+    source_limits source_limits;
+
     pthread_mutex_t lock_game_actions;
     pthread_mutex_t lock_send_udp;
     pthread_mutex_t *lock_finished_flag;
@@ -85,45 +105,288 @@ static uint16_t port_tcp = -1;
 
 static pthread_t game_threads[3];
 
-static server_information *solo_waiting_server;
-static int connected_solo_players = 0;
-static tcp_thread_data *solo_tcp_threads_data_players[PLAYER_NUM];
+/** Game created for the players connecting in a mode with a version of the protocol, until all its players are there
+ */
+typedef struct waiting_game {
+    server_information *server;
+    unsigned nb_connected;
+    tcp_thread_data *players[MAX_PLAYER_NUM];
+} waiting_game;
 
-static server_information *team_waiting_server;
-static int connected_team_players = 0;
-static tcp_thread_data *team_tcp_threads_data_players[PLAYER_NUM];
+// Indexed by the mode and the version of the protocol minus one, only used by the connection thread
+static waiting_game waiting_games[SOLO + 1][PROTOCOL_V2];
+static unsigned wide_game_players = MAX_PLAYER_NUM;
+// Indexed as the waiting games, the settings of the next game created for each
+static match_settings game_settings[SOLO + 1][PROTOCOL_V2];
 
 static int connection_port;
 
 static pthread_mutex_t *lock_game_model;
 
-void init_state(uint16_t connection_port_) {
-    solo_waiting_server = NULL;
-    team_waiting_server = NULL;
+// Only used by the connection thread to pick ports and multicast addresses
+static prng network_rng;
 
-    connected_solo_players = 0;
-    connected_team_players = 0;
+static bool has_fixed_game_seed = false;
+static uint64_t fixed_game_seed = 0;
+
+static const char *record_directory = NULL;
+
+// Only used by the connection thread, except the metrics of the interfaces
+static multicast_interface multicast_interfaces[MAX_MULTICAST_INTERFACES];
+static unsigned nb_multicast_interfaces = 0;
+static unsigned next_multicast_interface = 0;
+
+static bool unicast_delivery = false;
+static unsigned interest_radius = 0;
+static unsigned action_rate = DEFAULT_ACTION_RATE;
+
+void init_state(uint16_t connection_port_) {
+    memset(waiting_games, 0, sizeof(waiting_games));
+    for (GAME_MODE mode = TEAM; mode <= SOLO; mode++) {
+        for (int version = PROTOCOL_V1; version <= PROTOCOL_V2; version++) {
+            game_settings[mode][version - 1] = match_settings_default();
+        }
+    }
 
     connection_port = connection_port_;
+
+    prng_seed(&network_rng, prng_random_seed());
+}
+
+/** Locks the model of all the games, the time waited for the lock is traced as an event of the game
+ */
+static void lock_game_model_traced(int game_id) {
+    uint64_t start = trace_begin();
+    pthread_mutex_lock(lock_game_model);
+    trace_end("wait lock_game_model", game_id, start);
+}
+
+static void name_game_thread(const char *role, int game_id) {
+    char name[32];
+    snprintf(name, sizeof(name), "game %d %s", game_id, role);
+    trace_thread_name(name);
+}
+
+void set_fixed_game_seed(uint64_t seed) {
+    has_fixed_game_seed = true;
+    fixed_game_seed = seed;
+}
+
+void set_record_directory(const char *directory) {
+    record_directory = directory;
+}
+
+static int add_multicast_interface(const char *name, unsigned index) {
+    if (nb_multicast_interfaces == MAX_MULTICAST_INTERFACES) {
+        LOG_ERROR("There are more than %d multicast interfaces.", MAX_MULTICAST_INTERFACES);
+        return EXIT_FAILURE;
+    }
+    multicast_interface *interface = &multicast_interfaces[nb_multicast_interfaces];
+    interface->index = index;
+    interface->metrics = metrics_register_interface(name);
+    RETURN_FAILURE_IF_NULL(interface->metrics);
+    nb_multicast_interfaces++;
+    return EXIT_SUCCESS;
+}
+
+int set_multicast_interfaces(const char *names) {
+    char *copy = strdup(names);
+    RETURN_FAILURE_IF_NULL_PERROR(copy, "strdup multicast interfaces");
+
+    int res = EXIT_SUCCESS;
+    char *save;
+    for (char *name = strtok_r(copy, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+        unsigned index = if_nametoindex(name);
+        if (index == 0) {
+            LOG_ERROR("The interface %s does not exist.", name);
+            res = EXIT_FAILURE;
+            break;
+        }
+        if (add_multicast_interface(name, index) == EXIT_FAILURE) {
+            res = EXIT_FAILURE;
+            break;
+        }
+    }
+    free(copy);
+    if (res == EXIT_SUCCESS && nb_multicast_interfaces == 0) {
+        LOG_ERROR("No multicast interface is given.");
+        res = EXIT_FAILURE;
+    }
+    return res;
+}
+
+void set_unicast_delivery(bool unicast) {
+    unicast_delivery = unicast;
+}
+
+void set_interest_radius(unsigned radius) {
+    interest_radius = radius;
+}
+
+void set_action_rate_limit(unsigned rate) {
+    action_rate = rate;
+}
+
+int set_wide_game_players(unsigned nb) {
+    if (nb < 2 || nb > MAX_PLAYER_NUM) {
+        return EXIT_FAILURE;
+    }
+    wide_game_players = nb;
+    return EXIT_SUCCESS;
+}
+
+/** Reads the games selected by a token of the prefix of set_match_settings, a mode or a version of the protocol, in
+ *  modes and versions. Returns EXIT_FAILURE if the token is neither.
+ */
+static int parse_selected_games(const char *token, bool modes[SOLO + 1], bool versions[PROTOCOL_V2]) {
+    if (strcmp(token, "solo") == 0 || strcmp(token, "team") == 0) {
+        memset(modes, 0, (SOLO + 1) * sizeof(bool));
+        modes[strcmp(token, "solo") == 0 ? SOLO : TEAM] = true;
+    } else if (strcmp(token, "v1") == 0 || strcmp(token, "v2") == 0) {
+        memset(versions, 0, PROTOCOL_V2 * sizeof(bool));
+        versions[token[1] - '1'] = true;
+    } else {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int set_match_settings(const char *str) {
+    char *copy = strdup(str);
+    RETURN_FAILURE_IF_NULL_PERROR(copy, "strdup match settings");
+
+    bool modes[SOLO + 1] = {true, true};
+    bool versions[PROTOCOL_V2] = {true, true};
+    const char *fields = copy;
+    int res = EXIT_SUCCESS;
+    char *colon = strchr(copy, ':');
+    if (colon != NULL) {
+        *colon = '\0';
+        fields = colon + 1;
+        char *save;
+        for (char *token = strtok_r(copy, ".", &save); token != NULL; token = strtok_r(NULL, ".", &save)) {
+            if (parse_selected_games(token, modes, versions) == EXIT_FAILURE) {
+                LOG_ERROR("The games %s of the settings are neither a mode nor a version of the protocol.", token);
+                res = EXIT_FAILURE;
+                break;
+            }
+        }
+    }
+
+    // Checked for every game before changing any
+    match_settings parsed[SOLO + 1][PROTOCOL_V2];
+    memcpy(parsed, game_settings, sizeof(game_settings));
+    for (GAME_MODE mode = TEAM; res == EXIT_SUCCESS && mode <= SOLO; mode++) {
+        for (int version = PROTOCOL_V1; res == EXIT_SUCCESS && version <= PROTOCOL_V2; version++) {
+            if (!modes[mode] || !versions[version - 1]) {
+                continue;
+            }
+            match_settings *settings = &parsed[mode][version - 1];
+            unsigned nb_players = version == PROTOCOL_V2 ? wide_game_players : PLAYER_NUM;
+            if (match_settings_parse(fields, settings) == EXIT_FAILURE) {
+                LOG_ERROR("The match settings %s are not valid.", fields);
+                res = EXIT_FAILURE;
+            } else if (match_settings_check(settings, version, nb_players) == EXIT_FAILURE) {
+                LOG_ERROR("The board of %dx%d does not suit the games of %u players of the version %d of the protocol.",
+                          settings->dim.width, settings->dim.height, nb_players, version);
+                res = EXIT_FAILURE;
+            }
+        }
+    }
+    if (res == EXIT_SUCCESS) {
+        memcpy(game_settings, parsed, sizeof(game_settings));
+    }
+    free(copy);
+    return res;
+}
+
+/** Most actions accepted at once from a player, enough for a few batches
+ */
+static unsigned get_action_burst() {
+    return action_rate / 2 + GAME_ACTION_BATCH_MAX;
+}
+
+/** Uses DEFAULT_MULTICAST_INTERFACE, or the interface chosen by the system, if no interface has been set
+ */
+static int init_default_multicast_interface() {
+    if (nb_multicast_interfaces > 0) {
+        return EXIT_SUCCESS;
+    }
+    unsigned index = if_nametoindex(DEFAULT_MULTICAST_INTERFACE);
+    if (index == 0) {
+        LOG_WARNING("There is no interface %s, the system chooses the interface of the multicast messages.",
+                    DEFAULT_MULTICAST_INTERFACE);
+        return add_multicast_interface("default", 0);
+    }
+    return add_multicast_interface(DEFAULT_MULTICAST_INTERFACE, index);
+}
+
+/** Draws the tokens of the subscriptions of the players, which no other host can guess
+ */
+static int draw_subscription_tokens(server_information *server) {
+    ssize_t res = getrandom(server->subscription_tokens, sizeof(server->subscription_tokens), 0);
+    if (res != (ssize_t)sizeof(server->subscription_tokens)) {
+        LOG_ERRNO("getrandom subscription tokens");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < MAX_PLAYER_NUM; i++) {
+        // 0 is the token of the clients which got none
+        if (server->subscription_tokens[i] == 0) {
+            server->subscription_tokens[i] = 1;
+        }
+    }
+    return EXIT_SUCCESS;
 }
 
-server_information *create_server_information() {
+server_information *create_server_information(PROTOCOL_VERSION version, const match_settings *settings) {
     server_information *server = malloc(sizeof(server_information));
     if (server == NULL) {
-        perror("malloc server_information");
+        LOG_ERRNO("malloc server_information");
+        return NULL;
+    }
+    if (draw_subscription_tokens(server) == EXIT_FAILURE) {
+        free(server);
         return NULL;
     }
 
     server->sock_udp = -1;
     server->sock_mult = -1;
-    for (int i = 0; i < PLAYER_NUM; i++) {
+    server->version = version;
+    server->settings = *settings;
+    server->nb_players = version == PROTOCOL_V2 ? wide_game_players : PLAYER_NUM;
+    for (int i = 0; i < MAX_PLAYER_NUM; i++) {
         server->sock_clients[i] = -1;
+        server->capabilities[i] = 0;
+        server->announced_capabilities[i] = false;
     }
+    server->max_datagram = UINT16_MAX;
 
     server->port_udp = 0;
     server->port_mult = 0;
 
     server->addr_mult = NULL;
+    server->mult_interface = NULL;
+    // The clients start from the keyframe of the whole board
+    for (int i = 0; i < MAX_PLAYER_NUM; i++) {
+        server->has_player_addr[i] = false;
+        server->unicast_subscribed[i] = false;
+        server->interest_windows[i] = interest_window_all(settings->dim);
+        memset(&server->rtt[i], 0, sizeof(rtt_estimator));
+        memset(&server->action_windows[i], 0, sizeof(dedup_window));
+    }
+
+    server->output = NULL;
+
+    server->recorder = NULL;
+
+    server->metrics = NULL;
+
+    server->netem_mult = NULL;
+
+    server->keyframe = NULL;
+    server->keyframe_size = 0;
+    server->keyframe_num = 0;
+    server->keyframe_stale = true;
 
     return server;
 }
@@ -144,13 +407,15 @@ void close_socket_udp(server_information *server) {
 }
 
 void close_socket_mult(server_information *server) {
+    netem_drop_delayed(server->netem_mult);
     shutdown(server->sock_mult, SHUT_RD);
     close_socket(server->sock_mult);
 }
 
 void close_socket_client(server_information *server, int id) {
-    if (id >= 0 && id < PLAYER_NUM) {
+    if (id >= 0 && id < MAX_PLAYER_NUM) {
         if (server->sock_clients[id] != -1) {
+            tcp_output_remove_socket(server->output, id);
             close(server->sock_clients[id]);
             server->sock_clients[id] = -1; // Mark socket as closed
         }
@@ -164,20 +429,20 @@ int init_socket(int *sock, bool is_tcp) {
         *sock = socket(PF_INET6, SOCK_DGRAM, 0);
     }
     if (*sock < 0) {
-        perror("socket creation");
+        LOG_ERRNO("socket creation");
         *sock = -1;
         return EXIT_FAILURE;
     }
     int option = 0; // Option value for setsockopt
     if (setsockopt(*sock, IPPROTO_IPV6, IPV6_V6ONLY, &option, sizeof(option)) < 0) {
-        perror("setsockopt polymorphism");
+        LOG_ERRNO("setsockopt polymorphism");
         close_socket(*sock);
         *sock = -1;
         return EXIT_FAILURE;
     }
     option = 1;
     if (setsockopt(*sock, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option)) < 0) {
-        perror("setsockopt reuseaddr");
+        LOG_ERRNO("setsockopt reuseaddr");
         close(*sock);
         *sock = -1;
         return EXIT_FAILURE;
@@ -199,7 +464,7 @@ int try_to_bind_port_on_socket(int sock, struct sockaddr_in6 adrsock, uint16_t p
 }
 
 uint16_t get_random_port() {
-    return htons(MIN_PORT + (random() % (MAX_PORT - MIN_PORT)));
+    return htons(MIN_PORT + prng_range(&network_rng, MAX_PORT - MIN_PORT));
 }
 
 int try_to_bind_random_port_on_socket(int sock) {
@@ -252,7 +517,7 @@ int init_socket_mult(server_information *server) {
 void print_ip_of_client(struct sockaddr_in6 client_addr) {
     char client_ip[INET6_ADDRSTRLEN];
     inet_ntop(AF_INET6, &(client_addr.sin6_addr), client_ip, INET6_ADDRSTRLEN);
-    printf("New player connected: %s\n", client_ip);
+    LOG_INFO("New player connected: %s", client_ip);
 }
 
 uint16_t get_port_tcp() {
@@ -290,7 +555,7 @@ int init_random_adrmdiff(server_information *server) {
 
     unsigned size_2_bytes = 65536;
     for (unsigned i = 1; i < 8; i++) {
-        server->adrmdiff[i] = random() % size_2_bytes;
+        server->adrmdiff[i] = prng_range(&network_rng, size_2_bytes);
     }
 
     return EXIT_SUCCESS;
@@ -317,30 +582,38 @@ int init_addr_mult(server_information *server) {
 
     if (res < 0) {
         free_addr_mult(server);
-        perror("inet_pton addr_mult");
+        LOG_ERRNO("inet_pton addr_mult");
         return EXIT_FAILURE;
     }
 
-    int ifindex = if_nametoindex("eth0");
-    if (ifindex < 0) {
+    if (init_default_multicast_interface() == EXIT_FAILURE) {
         free_addr_mult(server);
-        perror("if_nametoindex eth0");
         return EXIT_FAILURE;
     }
+    // The games are spread over the interfaces, so that the multicast traffic grows with their number
+    server->mult_interface = &multicast_interfaces[next_multicast_interface];
+    next_multicast_interface = (next_multicast_interface + 1) % nb_multicast_interfaces;
 
-    server->addr_mult->sin6_scope_id = ifindex;
+    unsigned index = server->mult_interface->index;
+    if (index != 0 && setsockopt(server->sock_mult, IPPROTO_IPV6, IPV6_MULTICAST_IF, &index, sizeof(index)) < 0) {
+        free_addr_mult(server);
+        LOG_ERRNO("setsockopt IPV6_MULTICAST_IF");
+        return EXIT_FAILURE;
+    }
+    server->addr_mult->sin6_scope_id = index;
     return EXIT_SUCCESS;
 }
 
-server_information *init_server_network(uint16_t connexion_port) {
-    server_information *server = create_server_information();
+server_information *init_server_network(uint16_t connexion_port, int game_id, PROTOCOL_VERSION version,
+                                        const match_settings *settings) {
+    server_information *server = create_server_information(version, settings);
     RETURN_NULL_IF_NULL(server);
     RETURN_NULL_IF_ERROR(init_socket_udp(server));
     RETURN_NULL_IF_ERROR(init_socket_mult(server));
 
     if (connexion_port >= MIN_PORT && connexion_port <= MAX_PORT) {
         if (try_to_bind_port_on_socket_tcp(connexion_port) != EXIT_SUCCESS) {
-            fprintf(stderr, "The connexion port not works, try another one.\n");
+            LOG_WARNING("The connexion port not works, try another one.");
             goto exit_closing_sockets;
         }
     }
@@ -351,15 +624,37 @@ server_information *init_server_network(uint16_t connexion_port) {
     if (init_random_port_on_socket_mult(server) != EXIT_SUCCESS) {
         goto exit_closing_sockets;
     }
-    if (init_random_adrmdiff(server) == EXIT_FAILURE) {
+    if (unicast_delivery) {
+        // The clients see that there is no group and subscribe over unicast
+        memset(server->adrmdiff, 0, sizeof(server->adrmdiff));
+    } else {
+        if (init_random_adrmdiff(server) == EXIT_FAILURE) {
+            goto exit_closing_sockets;
+        }
+        if (init_addr_mult(server) == EXIT_FAILURE) {
+            goto exit_closing_sockets;
+        }
+    }
+    server->metrics = metrics_register_match(game_id);
+    if (server->metrics == NULL) {
+        free_addr_mult(server);
         goto exit_closing_sockets;
     }
-    if (init_addr_mult(server) == EXIT_FAILURE) {
+    // A client asking for a keyframe again while the first one is queued is not disconnected, whatever the board
+    size_t max_queued = TCP_OUTPUT_MAX_QUEUED + 2 * match_settings_keyframe_size(&server->settings);
+    server->output = tcp_output_start(max_queued, server->metrics);
+    if (server->output == NULL) {
+        free_addr_mult(server);
         goto exit_closing_sockets;
     }
+    server->netem_mult = netem_create_link(game_id);
+    if (server->mult_interface != NULL) {
+        METRICS_ADD(server->mult_interface->metrics, matches, 1);
+    }
     return server;
 
 exit_closing_sockets:
+    metrics_unregister_match(server->metrics);
     close_socket_tcp();
     close_socket_udp(server);
     close_socket_mult(server);
@@ -368,8 +663,8 @@ exit_closing_sockets:
 }
 
 int listen_players() {
-    if (listen(sock_tcp, 0) < 0) {
-        perror("listen sock_tcp");
+    if (listen(sock_tcp, SOMAXCONN) < 0) {
+        LOG_ERRNO("listen sock_tcp");
         return EXIT_FAILURE;
     }
     return EXIT_SUCCESS;
@@ -384,7 +679,7 @@ void free_tcp_threads_data(tcp_thread_data **data_thread, unsigned nb_data) {
     }
 }
 
-int init_tcp_threads_data(server_information *server, GAME_MODE mode, int game_id) {
+int init_tcp_threads_data(server_information *server, GAME_MODE mode, int game_id, tcp_thread_data **players) {
     unsigned *ready_player_number = malloc(sizeof(unsigned));
     *ready_player_number = 0;
     unsigned *connected_players = malloc(sizeof(unsigned));
@@ -436,78 +731,36 @@ int init_tcp_threads_data(server_information *server, GAME_MODE mode, int game_i
         return EXIT_FAILURE;
     }
 
-    for (unsigned i = 0; i < PLAYER_NUM; i++) {
-        // TODO: refactor
-        switch (mode) {
-            case SOLO:
-                solo_tcp_threads_data_players[i] = malloc(sizeof(tcp_thread_data));
-                if (solo_tcp_threads_data_players[i] == NULL) {
-                    perror("malloc tcp_thread_data");
-                    for (unsigned j = 0; j < i; j++) {
-                        free(solo_tcp_threads_data_players[j]);
-                    }
-                    return EXIT_FAILURE;
-                }
-                memset(solo_tcp_threads_data_players[i], 0, sizeof(tcp_thread_data));
-
-                solo_tcp_threads_data_players[i]->ready_player_number = ready_player_number;
-                solo_tcp_threads_data_players[i]->connected_players = connected_players;
-                solo_tcp_threads_data_players[i]->finished_flag = finished_flag;
-                solo_tcp_threads_data_players[i]->nb_players_left = nb_players_left;
-
-                solo_tcp_threads_data_players[i]->lock_waiting_all_players_join = lock_waiting_all_players_join;
-                solo_tcp_threads_data_players[i]->lock_all_players_ready = lock_all_players_ready;
-                solo_tcp_threads_data_players[i]->lock_waiting_the_game_finish = lock_waiting_the_game_finish;
-                solo_tcp_threads_data_players[i]->lock_finished_flag = lock_finished_flag;
-                solo_tcp_threads_data_players[i]->lock_nb_players_left = lock_nb_players_left;
-                solo_tcp_threads_data_players[i]->lock_all_tcp_threads_closed = lock_all_tcp_threads_closed;
-                solo_tcp_threads_data_players[i]->cond_lock_waiting_all_players_join =
-                    cond_lock_waiting_all_players_join;
-                solo_tcp_threads_data_players[i]->cond_lock_all_players_ready = cond_lock_all_players_ready;
-                solo_tcp_threads_data_players[i]->cond_lock_waiting_the_game_finish = cond_lock_waiting_the_game_finish;
-                solo_tcp_threads_data_players[i]->cond_lock_all_tcp_threads_closed = cond_lock_all_tcp_threads_closed;
-
-                solo_tcp_threads_data_players[i]->game_id = game_id;
-                solo_tcp_threads_data_players[i]->eq = 0;
-                solo_tcp_threads_data_players[i]->server = server;
-                break;
-
-            case TEAM:
-                team_tcp_threads_data_players[i] = malloc(sizeof(tcp_thread_data));
-
-                if (team_tcp_threads_data_players[i] == NULL) {
-                    perror("malloc tcp_thread_data");
-                    for (unsigned j = 0; j < i; j++) {
-                        free(team_tcp_threads_data_players[j]);
-                    }
-                    return EXIT_FAILURE;
-                }
-
-                memset(team_tcp_threads_data_players[i], 0, sizeof(tcp_thread_data));
-
-                team_tcp_threads_data_players[i]->ready_player_number = ready_player_number;
-                team_tcp_threads_data_players[i]->connected_players = connected_players;
-                team_tcp_threads_data_players[i]->finished_flag = finished_flag;
-                team_tcp_threads_data_players[i]->nb_players_left = nb_players_left;
-
-                team_tcp_threads_data_players[i]->lock_waiting_all_players_join = lock_waiting_all_players_join;
-                team_tcp_threads_data_players[i]->lock_all_players_ready = lock_all_players_ready;
-                team_tcp_threads_data_players[i]->lock_waiting_the_game_finish = lock_waiting_the_game_finish;
-                team_tcp_threads_data_players[i]->lock_finished_flag = lock_finished_flag;
-                team_tcp_threads_data_players[i]->lock_nb_players_left = lock_nb_players_left;
-                team_tcp_threads_data_players[i]->lock_all_tcp_threads_closed = lock_all_tcp_threads_closed;
-                team_tcp_threads_data_players[i]->cond_lock_waiting_all_players_join =
-                    cond_lock_waiting_all_players_join;
-                team_tcp_threads_data_players[i]->cond_lock_all_players_ready = cond_lock_all_players_ready;
-                team_tcp_threads_data_players[i]->cond_lock_waiting_the_game_finish = cond_lock_waiting_the_game_finish;
-                team_tcp_threads_data_players[i]->cond_lock_all_tcp_threads_closed = cond_lock_all_tcp_threads_closed;
-
-                team_tcp_threads_data_players[i]->game_id = game_id;
-                team_tcp_threads_data_players[i]->server = server;
-                break;
-            default:
-                return EXIT_FAILURE;
+    for (unsigned i = 0; i < server->nb_players; i++) {
+        tcp_thread_data *data = malloc(sizeof(tcp_thread_data));
+        if (data == NULL) {
+            LOG_ERRNO("malloc tcp_thread_data");
+            free_tcp_threads_data(players, i);
+            return EXIT_FAILURE;
         }
+        memset(data, 0, sizeof(tcp_thread_data));
+
+        data->ready_player_number = ready_player_number;
+        data->connected_players = connected_players;
+        data->finished_flag = finished_flag;
+        data->nb_players_left = nb_players_left;
+
+        data->lock_waiting_all_players_join = lock_waiting_all_players_join;
+        data->lock_all_players_ready = lock_all_players_ready;
+        data->lock_waiting_the_game_finish = lock_waiting_the_game_finish;
+        data->lock_finished_flag = lock_finished_flag;
+        data->lock_nb_players_left = lock_nb_players_left;
+        data->lock_all_tcp_threads_closed = lock_all_tcp_threads_closed;
+        data->cond_lock_waiting_all_players_join = cond_lock_waiting_all_players_join;
+        data->cond_lock_all_players_ready = cond_lock_all_players_ready;
+        data->cond_lock_waiting_the_game_finish = cond_lock_waiting_the_game_finish;
+        data->cond_lock_all_tcp_threads_closed = cond_lock_all_tcp_threads_closed;
+
+        data->id = i;
+        data->game_id = game_id;
+        data->eq = mode == TEAM ? get_player_team(i) : 0;
+        data->server = server;
+        players[i] = data;
     }
 
     return EXIT_SUCCESS;
@@ -529,42 +782,255 @@ initial_connection_header *recv_initial_connection_header_of_client(int sock) {
     return recv_initial_connection_header(sock);
 }
 
-ready_connection_header *recv_ready_connexion_header_of_client(int sock) {
-    return recv_ready_connexion_header(sock);
+ready_connection_header *recv_ready_connexion_header_of_client(tcp_thread_data *tcp_data) {
+    return recv_ready_connexion_header(tcp_data->reader);
 }
 
-game_action *recv_game_action_of_clients(server_information *server) {
-    return recv_game_action(server->sock_udp);
+int recv_udp_message_of_clients(server_information *server, udp_message *message) {
+    return recv_udp_message(server->sock_udp, server->version, server->nb_players, message);
 }
 
-chat_message *recv_chat_message_of_client(server_information *server, int id) {
-    if (server->sock_clients[id] == -1) {
-        return NULL;
+int send_connexion_information_of_client(server_information *server, int id, int eq) {
+    return send_connexion_information(server->sock_clients[id], SOLO, server->version, id, eq,
+                                      ntohs(server->port_udp), ntohs(server->port_mult), server->adrmdiff);
+}
+
+/** Sends to the player the capabilities chosen for it and the token of its subscriptions, if it announced its own.
+ *  They are sent once every player joined the game, when its largest datagram is known.
+ */
+static int send_capabilities_of_client(server_information *server, int id) {
+    if (!server->announced_capabilities[id]) {
+        return EXIT_SUCCESS;
     }
+    capabilities caps = {server->capabilities[id], server->max_datagram};
+    RETURN_FAILURE_IF_ERROR(send_capabilities(server->sock_clients[id], &caps));
+    return send_subscription_token(server->sock_clients[id], server->subscription_tokens[id]);
+}
 
-    return recv_chat_message(server->sock_clients[id]);
+static int send_message_multicast(server_information *server, char *message, size_t size) {
+    int res = send_string_to_clients_multicast(server->sock_mult, server->netem_mult, server->addr_mult, message, size);
+    RETURN_FAILURE_IF_ERROR(res);
+    METRICS_ADD(server->metrics, multicast_packets, 1);
+    METRICS_ADD(server->metrics, multicast_bytes, size);
+    METRICS_ADD(server->mult_interface->metrics, multicast_packets, 1);
+    METRICS_ADD(server->mult_interface->metrics, multicast_bytes, size);
+    return EXIT_SUCCESS;
 }
 
-int send_connexion_information_of_client(server_information *server, int id, int eq) {
-    return send_connexion_information(server->sock_clients[id], SOLO, id, eq, ntohs(server->port_udp),
-                                      ntohs(server->port_mult), server->adrmdiff);
+/** Reads the positions of the players of the game, the lock of the game model has to be held
+ */
+static void get_player_positions(int game_id, coord positions[MAX_PLAYER_NUM]) {
+    for (unsigned i = 0; i < get_nb_players(game_id); i++) {
+        positions[i] = get_player_position(i, game_id);
+    }
+}
+
+/** Returns true if the player only receives the area around it over unicast
+ */
+static bool receives_area(const server_information *server, unsigned id) {
+    return interest_radius > 0 && server->unicast_subscribed[id] && (server->capabilities[id] & CAPABILITY_AREAS);
+}
+
+/** Returns the most tile_diffs in a game board update of the game
+ */
+static unsigned max_update_diffs(const server_information *server) {
+    return max_tile_diffs_in(server->version, server->max_datagram);
+}
+
+/** Sends the message to every player subscribed over unicast which does not only receive the area around it, the lock
+ *  sending over UDP has to be held
+ */
+static int send_message_unicast(server_information *server, char *message, size_t size) {
+    struct sockaddr_in6 addrs[MAX_PLAYER_NUM];
+    unsigned nb = 0;
+    for (unsigned i = 0; i < server->nb_players; i++) {
+        if (server->unicast_subscribed[i] && !receives_area(server, i)) {
+            addrs[nb++] = server->player_addrs[i];
+        }
+    }
+    if (nb == 0) {
+        return EXIT_SUCCESS;
+    }
+    int sent = send_string_to_clients_unicast(server->sock_udp, server->netem_mult, addrs, nb, message, size);
+    RETURN_FAILURE_IF_ERROR(sent);
+    METRICS_ADD(server->metrics, unicast_packets, sent);
+    METRICS_ADD(server->metrics, unicast_bytes, sent * size);
+    return (unsigned)sent == nb ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-int send_game_board_for_clients(server_information *server, uint16_t num, board *board_) {
-    return send_game_board(server->sock_mult, server->addr_mult, num, board_);
+/** Sends the message i to the address i in one batch and frees the messages
+ */
+static int send_messages_unicast(server_information *server, struct iovec *messages, struct sockaddr_in6 *addrs,
+                                 unsigned nb) {
+    int sent = nb == 0 ? 0 : send_strings_to_clients_unicast(server->sock_udp, server->netem_mult, messages, addrs, nb);
+    for (unsigned i = 0; i < nb; i++) {
+        if ((int)i < sent) {
+            METRICS_ADD(server->metrics, unicast_packets, 1);
+            METRICS_ADD(server->metrics, unicast_bytes, messages[i].iov_len);
+        }
+        free(messages[i].iov_base);
+    }
+    return sent == (int)nb ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/** Sends the serialized message to the multicast group and to the players subscribed over unicast, unless they only
+ *  receive the area around them, and frees it. The lock sending over UDP has to be held.
+ */
+int send_message_for_clients(server_information *server, int game_id, char *message, size_t size) {
+    uint64_t start = trace_begin();
+    int res = EXIT_SUCCESS;
+    if (server->addr_mult != NULL && send_message_multicast(server, message, size) == EXIT_FAILURE) {
+        res = EXIT_FAILURE;
+    }
+    if (send_message_unicast(server, message, size) == EXIT_FAILURE) {
+        res = EXIT_FAILURE;
+    }
+    trace_end("send", game_id, start);
+    free(message);
+    return res;
 }
 
-int send_game_update_for_clients(server_information *server, uint16_t num, tile_diff *diff, uint8_t nb) {
-    return send_game_update(server->sock_mult, server->addr_mult, num, diff, nb);
+/** Sends to each player subscribed over unicast the region of the board around it, the lock sending over UDP has to be
+ *  held
+ */
+static int send_game_board_areas(server_information *server, int game_id, uint16_t num, board *board_,
+                                 const coord positions[MAX_PLAYER_NUM]) {
+    uint64_t start = trace_begin();
+    struct iovec messages[MAX_PLAYER_NUM];
+    struct sockaddr_in6 addrs[MAX_PLAYER_NUM];
+    unsigned nb = 0;
+    int res = EXIT_SUCCESS;
+    for (unsigned i = 0; i < server->nb_players; i++) {
+        if (!receives_area(server, i)) {
+            continue;
+        }
+        interest_window window = interest_window_around(positions[i], interest_radius, board_->dim);
+        size_t size;
+        char *message = create_game_board_region(num, board_, &window, &size);
+        if (message == NULL) {
+            res = EXIT_FAILURE;
+            continue;
+        }
+        server->interest_windows[i] = window;
+        messages[nb].iov_base = message;
+        messages[nb].iov_len = size;
+        addrs[nb++] = server->player_addrs[i];
+    }
+    if (send_messages_unicast(server, messages, addrs, nb) == EXIT_FAILURE) {
+        res = EXIT_FAILURE;
+    }
+    trace_end("send areas", game_id, start);
+    return res;
+}
+
+/** Sends to each player subscribed over unicast the diffs in the area around it, and the tiles entering this area
+ *  since the last message it received, read from board_. The lock sending over UDP has to be held.
+ */
+static int send_game_update_areas(server_information *server, int game_id, uint16_t num, tile_diff *diffs,
+                                  uint16_t nb_diffs, const board *board_, const coord positions[MAX_PLAYER_NUM]) {
+    uint64_t start = trace_begin();
+    struct iovec messages[MAX_PLAYER_NUM];
+    struct sockaddr_in6 addrs[MAX_PLAYER_NUM];
+    // The diffs in the area of a player and the tiles entering it are at most the diffs and the tiles of the board
+    unsigned max_diffs = max_update_diffs(server);
+    unsigned nb_tiles = board_->dim.width * board_->dim.height;
+    if (nb_diffs + nb_tiles < max_diffs) {
+        max_diffs = nb_diffs + nb_tiles;
+    }
+    tile_diff *area_diffs = malloc(sizeof(tile_diff) * max_diffs);
+    RETURN_FAILURE_IF_NULL_PERROR(area_diffs, "malloc area_diffs");
+    unsigned nb = 0;
+    int res = EXIT_SUCCESS;
+    for (unsigned i = 0; i < server->nb_players; i++) {
+        if (!receives_area(server, i)) {
+            continue;
+        }
+        // Sent even without any diff, so that the client does not take the update for a lost one
+        interest_window window = interest_window_around(positions[i], interest_radius, board_->dim);
+        unsigned nb_area = interest_filter_diffs(diffs, nb_diffs, board_, &server->interest_windows[i], &window,
+                                                 area_diffs, max_diffs);
+        size_t size;
+        char *message = create_game_update(num, area_diffs, nb_area, &size);
+        if (message == NULL) {
+            res = EXIT_FAILURE;
+            continue;
+        }
+        server->interest_windows[i] = window;
+        messages[nb].iov_base = message;
+        messages[nb].iov_len = size;
+        addrs[nb++] = server->player_addrs[i];
+    }
+    if (send_messages_unicast(server, messages, addrs, nb) == EXIT_FAILURE) {
+        res = EXIT_FAILURE;
+    }
+    free(area_diffs);
+    trace_end("send areas", game_id, start);
+    return res;
+}
+
+/** Sends the board to the clients, positions are the ones of the players on it, which can be NULL when no player
+ *  only receives the area around it
+ */
+int send_game_board_for_clients(server_information *server, int game_id, uint16_t num, board *board_,
+                                const coord *positions) {
+    uint64_t start = trace_begin();
+    size_t size;
+    char *message = create_game_board(num, board_, &size);
+    trace_end("serialize board", game_id, start);
+    RETURN_FAILURE_IF_NULL(message);
+    int res = send_message_for_clients(server, game_id, message, size);
+    if (interest_radius > 0 && positions != NULL &&
+        send_game_board_areas(server, game_id, num, board_, positions) == EXIT_FAILURE) {
+        res = EXIT_FAILURE;
+    }
+    return res;
+}
+
+/** Sends the diffs to the clients, board_ and positions are the board and the players after the diffs, which can be
+ *  NULL when no player only receives the area around it
+ */
+int send_game_update_for_clients(server_information *server, int game_id, uint16_t num, tile_diff *diff, uint16_t nb,
+                                 const board *board_, const coord *positions) {
+    uint64_t start = trace_begin();
+    size_t size;
+    char *message = create_game_update(num, diff, nb, &size);
+    trace_end("serialize update", game_id, start);
+    RETURN_FAILURE_IF_NULL(message);
+    int res = send_message_for_clients(server, game_id, message, size);
+    if (interest_radius > 0 && board_ != NULL && positions != NULL &&
+        send_game_update_areas(server, game_id, num, diff, nb, board_, positions) == EXIT_FAILURE) {
+        res = EXIT_FAILURE;
+    }
+    return res;
 }
 
 int send_chat_message_to_client(server_information *server, int id, chat_message_type type, int sender_id, int eq,
                                 uint8_t message_length, char *message) {
-    return send_chat_message(server->sock_clients[id], type, sender_id, eq, message_length, message);
+    size_t size;
+    char *serialized_msg = create_chat_message(type, sender_id, eq, message_length, message, &size);
+    RETURN_FAILURE_IF_NULL(serialized_msg);
+
+    int res = tcp_output_send(server->output, id, serialized_msg, size);
+    free(serialized_msg);
+    if (res == EXIT_SUCCESS) {
+        METRICS_ADD(server->metrics, chat_messages, 1);
+        METRICS_ADD(server->metrics, chat_bytes, size);
+    }
+    return res;
+}
+
+int send_game_over_to_client(server_information *server, int id, GAME_MODE mode, int winner_id, int winner_eq) {
+    size_t size;
+    char *serialized_head = create_game_over(mode, winner_id, winner_eq, &size);
+    RETURN_FAILURE_IF_NULL(serialized_head);
+
+    int res = tcp_output_send(server->output, id, serialized_head, size);
+    free(serialized_head);
+    return res;
 }
 
 void handle_chat_message_global(server_information *server, int sender_id, chat_message *msg) {
-    for (int i = 0; i < PLAYER_NUM; i++) {
+    for (int i = 0; i < (int)server->nb_players; i++) {
         if (i == sender_id) {
             continue; // Don't send the message to the sender
         }
@@ -572,49 +1038,44 @@ void handle_chat_message_global(server_information *server, int sender_id, chat_
             continue; // Don't send the message to the client if it is not connected
         }
 
-        if (send_chat_message_to_client(server, i, msg->type, sender_id, msg->eq, msg->message_length, msg->message) <
-            0) {
-            perror("send_chat_message_to_client");
-        }
+        // A client which can't receive the message is disconnected, the others still get it
+        send_chat_message_to_client(server, i, msg->type, sender_id, msg->eq, msg->message_length, msg->message);
     }
 }
 
 void handle_chat_message_team(server_information *server, int sender_id, chat_message *msg) {
-    for (int i = 0; i < PLAYER_NUM; i++) {
+    for (int i = 0; i < (int)server->nb_players; i++) {
         if (i == sender_id) {
             continue; // Don't send the message to the sender or to the other team
         }
 
-        if ((sender_id == 0 || sender_id == 3) && (i == 1 || i == 2)) {
-            continue; // If the sender is in the first team, don't send the message to the second team
-        }
-
-        if ((sender_id == 1 || sender_id == 2) && (i == 0 || i == 3)) {
-            continue; // If the sender is in the second team, don't send the message to the first team
+        if (get_player_team(i) != get_player_team(sender_id)) {
+            continue; // Don't send the message to the other team
         }
 
         if (server->sock_clients[i] == -1) {
             continue; // Don't send the message to the client if it is not connected
         }
 
-        if (send_chat_message_to_client(server, i, msg->type, sender_id, msg->eq, msg->message_length, msg->message) <
-            0) {
-            perror("send_chat_message_to_client");
-        }
+        send_chat_message_to_client(server, i, msg->type, sender_id, msg->eq, msg->message_length, msg->message);
     }
 }
 
-void handle_chat_message(server_information *server, int sender_id, chat_message *msg) {
-    if (get_game_mode(TMP_GAME_ID) == SOLO) {
+void handle_chat_message(server_information *server, int game_id, int sender_id, chat_message *msg) {
+    lock_game_model_traced(game_id);
+    GAME_MODE mode = get_game_mode(game_id);
+    pthread_mutex_unlock(lock_game_model);
+
+    if (mode == SOLO) {
         handle_chat_message_global(server, sender_id, msg);
-    } else if (get_game_mode(TMP_GAME_ID) == TEAM) {
+    } else if (mode == TEAM) {
         if (msg->type == GLOBAL_M) {
             handle_chat_message_global(server, sender_id, msg);
         } else if (msg->type == TEAM_M) {
             handle_chat_message_team(server, sender_id, msg);
         }
     } else {
-        perror("Unknown game mode");
+        LOG_ERROR("Unknown game mode");
     }
 }
 
@@ -628,26 +1089,27 @@ void handle_game_over(server_information *server, int game_id) {
         pthread_mutex_lock(lock_game_model);
         int winner_player = get_winner_solo(game_id);
         pthread_mutex_unlock(lock_game_model);
-        for (int i = 0; i < PLAYER_NUM; i++) {
+        for (int i = 0; i < (int)server->nb_players; i++) {
             if (server->sock_clients[i] != -1) {
-                if (send_game_over(server->sock_clients[i], SOLO, winner_player, 0) < 0) {
-                    perror("send_game_over");
-                }
+                send_game_over_to_client(server, i, SOLO, winner_player, 0);
             }
         }
     } else if (mode == TEAM) {
         pthread_mutex_lock(lock_game_model);
         int winner_team = get_winner_team(game_id);
         pthread_mutex_unlock(lock_game_model);
-        for (int i = 0; i < PLAYER_NUM; i++) {
+        for (int i = 0; i < (int)server->nb_players; i++) {
             if (server->sock_clients[i] != -1) {
-                if (send_game_over(server->sock_clients[i], TEAM, 0, winner_team) < 0) {
-                    perror("send_game_over");
-                }
+                send_game_over_to_client(server, i, TEAM, 0, winner_team);
             }
         }
     } else {
-        perror("Unknown game mode");
+        LOG_ERROR("Unknown game mode");
+    }
+
+    // The end of the game is sent before the sockets are closed
+    if (tcp_output_flush(server->output, TCP_OUTPUT_STALL_MS) == EXIT_FAILURE) {
+        LOG_WARNING("Some clients did not receive the end of the game.");
     }
 }
 
@@ -659,25 +1121,29 @@ struct pollfd *init_polls_connexion(int sock) {
     return polls;
 }
 
+/** Returns the polls with sock added at the end, reallocated if they are full, or NULL if the reallocation failed
+ */
 struct pollfd *add_polls_to_poll(struct pollfd *polls, unsigned *nb, unsigned *s, int sock) {
     if (*nb == *s) {
         struct pollfd *n = (struct pollfd *)realloc(polls, 4 * (*s) * sizeof(struct pollfd));
+        RETURN_NULL_IF_NULL_PERROR(n, "realloc polls");
+        polls = n;
         *s *= 4;
-        *nb += 1;
-        return n;
-    } else {
-        polls[*nb].fd = sock;
-        polls[*nb].events = POLL_IN;
-        *nb += 1;
-        return polls;
     }
+    polls[*nb].fd = sock;
+    polls[*nb].events = POLL_IN;
+    polls[*nb].revents = 0;
+    *nb += 1;
+    return polls;
 }
 
+/** Replaces the poll i by the last one
+ */
 void remove_polls_to_poll(struct pollfd *polls, unsigned *nb, unsigned i) {
     if (i >= *nb) {
         return;
     }
-    polls[i].fd = polls[0].fd;
+    polls[i] = polls[*nb - 1];
     *nb -= 1;
 }
 
@@ -686,27 +1152,154 @@ int try_to_init_socket_of_client() {
     int client_addr_len = sizeof(client_addr);
     int res = accept(sock_tcp, (struct sockaddr *)&client_addr, (socklen_t *)&client_addr_len);
     if (res < 0) {
-        perror("client acceptance");
-        return EXIT_FAILURE;
+        LOG_ERRNO("client acceptance");
+        return -1;
     }
 
     print_ip_of_client(client_addr);
     return res;
 }
 
-int init_game_model(GAME_MODE mode) {
-    dimension dim;
-    dim.width = GAMEBOARD_WIDTH;
-    dim.height = GAMEBOARD_HEIGHT;
+int init_game_model(GAME_MODE mode, PROTOCOL_VERSION version) {
+    const match_settings *settings = &game_settings[mode][version - 1];
+    uint64_t seed = has_fixed_game_seed ? fixed_game_seed : prng_random_seed();
 
     pthread_mutex_lock(lock_game_model);
-    int game_id = init_model(dim, mode);
+    unsigned nb_players = version == PROTOCOL_V2 ? wide_game_players : PLAYER_NUM;
+    int game_id = init_model_with_players(settings->dim, mode, seed, nb_players);
+    if (game_id != -1) {
+        set_bomb_lifetime(settings->bomb_lifetime_ms, game_id);
+    }
     pthread_mutex_unlock(lock_game_model);
 
+    if (game_id != -1) {
+        LOG_INFO("Game %d created with seed %" PRIu64 ", a board of %dx%d, %u ticks per second, a whole board every "
+                 "%u ms and bombs of %u ms.",
+                 game_id, seed, settings->dim.width, settings->dim.height, settings->tick_rate, settings->snapshot_ms,
+                 settings->bomb_lifetime_ms);
+    }
     return game_id;
 }
 
+void init_game_recorder(server_information *server, int game_id) {
+    if (record_directory == NULL) {
+        return;
+    }
+
+    record_header header;
+    header.dim = server->settings.dim;
+    pthread_mutex_lock(lock_game_model);
+    header.game_mode = get_game_mode(game_id);
+    header.seed = get_game_seed(game_id);
+    header.nb_players = get_nb_players(game_id);
+    header.bomb_lifetime_ms = get_bomb_lifetime(game_id);
+    pthread_mutex_unlock(lock_game_model);
+
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, "%s/game_%ld_%d.bmr", record_directory, (long)time(NULL), game_id);
+
+    server->recorder = recorder_open(path, &header, get_time_ms());
+    if (server->recorder != NULL) {
+        LOG_INFO("Game %d recorded in %s.", game_id, path);
+    }
+}
+
+void set_player_dead_of_client(tcp_thread_data *tcp_data) {
+    lock_game_model_traced(tcp_data->game_id);
+    if (!is_player_dead(tcp_data->id, tcp_data->game_id)) {
+        record_player_dead(tcp_data->server->recorder, get_time_ms(), tcp_data->id);
+        set_player_dead(tcp_data->game_id, tcp_data->id);
+        tcp_data->server->keyframe_stale = true;
+    }
+    pthread_mutex_unlock(lock_game_model);
+}
+
+/** Marks the keyframe as older than the board of the game, whose last update is num, the lock of the game model has to
+ *  be held
+ */
+static void mark_keyframe_stale(server_information *server, uint16_t num) {
+    server->keyframe_num = num;
+    server->keyframe_stale = true;
+}
+
+/** Serializes the current board of the game as the keyframe of the server if it changed since the last one, the lock
+ *  of the game model has to be held
+ */
+static int refresh_keyframe(server_information *server, unsigned game_id) {
+    if (!server->keyframe_stale && server->keyframe != NULL) {
+        return EXIT_SUCCESS;
+    }
+    uint64_t start = trace_begin();
+    board *game_board = get_game_board(game_id);
+    RETURN_FAILURE_IF_NULL(game_board);
+
+    size_t size;
+    char *keyframe = create_game_board_keyframe(server->keyframe_num, game_board, &size);
+    free_board(game_board);
+    RETURN_FAILURE_IF_NULL(keyframe);
+
+    free(server->keyframe);
+    server->keyframe = keyframe;
+    server->keyframe_size = size;
+    server->keyframe_stale = false;
+    trace_end("keyframe", game_id, start);
+    return EXIT_SUCCESS;
+}
+
+int send_keyframe_to_client(server_information *server, int game_id, int id) {
+    // The keyframe is copied in the output queue, nothing is sent while the lock of the model is held
+    lock_game_model_traced(game_id);
+    int res = refresh_keyframe(server, game_id) == EXIT_FAILURE
+                  ? EXIT_FAILURE
+                  : tcp_output_send(server->output, id, server->keyframe, server->keyframe_size);
+    pthread_mutex_unlock(lock_game_model);
+    return res;
+}
+
+/** Handles a message received from the client, returns EXIT_FAILURE if the client has to be disconnected
+ */
+int handle_client_message(tcp_thread_data *tcp_data, const char *message) {
+    uint16_t header;
+    memcpy(&header, message, sizeof(uint16_t));
+    message_header *head = deserialize_message_header(header);
+    RETURN_FAILURE_IF_NULL(head);
+    int codereq = head->codereq;
+    free(head);
+
+    if (codereq == KEYFRAME_REQUEST_CODE) {
+        send_keyframe_to_client(tcp_data->server, tcp_data->game_id, tcp_data->id);
+        return EXIT_SUCCESS;
+    }
+
+    chat_message *msg = client_deserialize_chat_message(message);
+    RETURN_FAILURE_IF_NULL(msg);
+    handle_chat_message(tcp_data->server, tcp_data->game_id, tcp_data->id, msg);
+    free(msg->message);
+    free(msg);
+    return EXIT_SUCCESS;
+}
+
+/** Receives what the client sent and handles all the complete messages, returns EXIT_FAILURE if the client has to be
+ *  disconnected
+ */
+int handle_client_messages(tcp_thread_data *tcp_data) {
+    if (tcp_reader_fill(tcp_data->reader) <= 0) {
+        return EXIT_FAILURE;
+    }
+
+    const char *message;
+    size_t size;
+    int res;
+    while ((res = tcp_reader_next(tcp_data->reader, &message, &size)) == 1) {
+        RETURN_FAILURE_IF_ERROR(handle_client_message(tcp_data, message));
+    }
+    return res == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int add_game_action_to_thread_data(udp_thread_data *data, game_action *action) {
+    if (data->nb_game_actions >= MAX_PENDING_GAME_ACTIONS) {
+        return EXIT_FAILURE;
+    }
     if (data->size_game_actions == 0) {
         data->size_game_actions = INITIAL_GAME_ACTIONS_SIZE;
         data->game_actions = malloc(sizeof(game_action *) * data->size_game_actions);
@@ -737,8 +1330,121 @@ void free_game_actions(game_action **game_actions, size_t nb_game_actions) {
     free(game_actions);
 }
 
+/** Returns true if the datagram comes from the address of its player, only known once the player subscribed
+ */
+static bool is_from_player_address(const server_information *server, const udp_message *message) {
+    // Only written by this thread
+    return server->has_player_addr[message->id] &&
+           memcmp(&server->player_addrs[message->id], &message->from, sizeof(struct sockaddr_in6)) == 0;
+}
+
+/** Keeps the address the subscription of the player comes from, where its pings are sent, and the messages of the game
+ *  once it subscribes over unicast. A subscription which does not echo the token sent to the player over TCP is
+ *  ignored, so that no other host has the messages of the game sent to an address or takes them from the player.
+ */
+void update_player_address(udp_thread_data *data, const udp_message *message) {
+    server_information *server = data->server;
+    int id = message->id;
+    if (message->subscription.token != server->subscription_tokens[id]) {
+        LOG_DEBUG("Subscription of the player %d of the game %d without its token.", id, data->game_id);
+        return;
+    }
+    // Only written by this thread
+    bool subscribed = server->unicast_subscribed[id] || !message->subscription.unicast;
+    if (subscribed && is_from_player_address(server, message)) {
+        return;
+    }
+    if (!server->unicast_subscribed[id] && message->subscription.unicast) {
+        LOG_INFO("The player %d of the game %d receives the game over unicast.", id, data->game_id);
+    }
+    pthread_mutex_lock(&data->lock_send_udp);
+    server->player_addrs[id] = message->from;
+    server->has_player_addr[id] = true;
+    server->unicast_subscribed[id] = server->unicast_subscribed[id] || message->subscription.unicast;
+    pthread_mutex_unlock(&data->lock_send_udp);
+}
+
+/** Adds the round trip of a ping answered by a player to its latency
+ */
+static void add_rtt_sample(server_information *server, const udp_message *message) {
+    const pong_message *pong = &message->pong;
+    rtt_estimator *rtt = &server->rtt[message->id];
+    if (rtt_add_sample(rtt, pong->ping_sent_us, pong->ping_received_us, pong->sent_us, message->received_us) ==
+        EXIT_FAILURE) {
+        LOG_DEBUG("Incoherent pong of the player %d.", message->id);
+        return;
+    }
+    metrics_set_player_latency(server->metrics, message->id, rtt->samples, rtt->srtt_us, rtt->offset_us);
+}
+
+bool get_player_latency(const server_information *server, int id, uint64_t *rtt_us, int64_t *clock_offset_us) {
+    match_metrics *metrics = server->metrics;
+    if (metrics == NULL || id < 0 || id >= (int)server->nb_players ||
+        atomic_load_explicit(&metrics->player_rtt_samples[id], memory_order_relaxed) == 0) {
+        return false;
+    }
+    *rtt_us = atomic_load_explicit(&metrics->player_rtt_us[id], memory_order_relaxed);
+    *clock_offset_us = atomic_load_explicit(&metrics->player_clock_offset_us[id], memory_order_relaxed);
+    return true;
+}
+
+/** Sends a ping to every player whose address is known, the lock sending over UDP has to be held
+ */
+static int send_ping_for_clients(server_information *server) {
+    struct sockaddr_in6 addrs[MAX_PLAYER_NUM];
+    unsigned nb = 0;
+    for (unsigned i = 0; i < server->nb_players; i++) {
+        if (server->has_player_addr[i]) {
+            addrs[nb++] = server->player_addrs[i];
+        }
+    }
+    if (nb == 0) {
+        return EXIT_SUCCESS;
+    }
+    int sent = send_ping_to_clients(server->sock_udp, server->netem_mult, addrs, nb);
+    RETURN_FAILURE_IF_ERROR(sent);
+    METRICS_ADD(server->metrics, unicast_packets, sent);
+    METRICS_ADD(server->metrics, unicast_bytes, sent * PING_SIZE);
+    return (unsigned)sent == nb ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/** Queues for the next tick the actions of the batch not received yet, within the rate of the player and the size of
+ *  the queue, and frees the others
+ */
+static void queue_game_actions(udp_thread_data *data, udp_message *message, uint64_t now_us) {
+    server_information *server = data->server;
+    lock_game_model_traced(data->game_id);
+    GAME_MODE game_mode = get_game_mode(data->game_id);
+    pthread_mutex_unlock(lock_game_model);
+
+    pthread_mutex_lock(&data->lock_game_actions);
+    for (unsigned i = 0; i < message->nb_actions; i++) {
+        game_action *action = message->actions[i];
+        // Only used by this thread
+        if (!dedup_accept(&server->action_windows[action->id], action->message_number,
+                          GAME_ACTION_MESSAGE_NUMBER_LIMIT)) {
+            METRICS_ADD(server->metrics, actions_duplicated, 1);
+            free(action);
+            continue;
+        }
+        METRICS_ADD(server->metrics, actions_received, 1);
+        if (action->game_mode != game_mode) {
+            METRICS_ADD(server->metrics, actions_dropped, 1);
+            free(action);
+        } else if (!token_bucket_take(&data->action_limits[action->id], now_us) ||
+                   add_game_action_to_thread_data(data, action) == EXIT_FAILURE) {
+            METRICS_ADD(server->metrics, actions_limited, 1);
+            free(action);
+        }
+    }
+    atomic_store(&server->metrics->pending_actions, data->nb_game_actions);
+    pthread_mutex_unlock(&data->lock_game_actions);
+}
+
 void *serv_client_recv_game_action(void *arg_udp_thread_data) {
     udp_thread_data *data = (udp_thread_data *)arg_udp_thread_data;
+    metrics_thread_running(true);
+    name_game_thread("actions", data->game_id);
     while (true) {
         pthread_mutex_lock(data->lock_finished_flag);
         if (*data->finished_flag) {
@@ -747,15 +1453,30 @@ void *serv_client_recv_game_action(void *arg_udp_thread_data) {
         }
         pthread_mutex_unlock(data->lock_finished_flag);
 
-        game_action *action = recv_game_action_of_clients(data->server);
-        pthread_mutex_lock(lock_game_model);
-        GAME_MODE game_mode = get_game_mode(data->game_id);
-        pthread_mutex_unlock(lock_game_model);
-        if (action != NULL && action->game_mode == game_mode) {
-            pthread_mutex_lock(&data->lock_game_actions);
-            add_game_action_to_thread_data(data, action);
-            pthread_mutex_unlock(&data->lock_game_actions);
+        udp_message message;
+        if (recv_udp_message_of_clients(data->server, &message) == EXIT_FAILURE) {
+            continue;
+        }
+        uint64_t now_us = get_time_us();
+        // Before anything is done with the datagram
+        if (!source_limits_take(&data->source_limits, &message.from, now_us)) {
+            METRICS_ADD(data->server->metrics, datagrams_limited, 1);
+            for (unsigned i = 0; i < message.nb_actions; i++) {
+                free(message.actions[i]);
+            }
+            continue;
+        }
+        if (message.type == UDP_SUBSCRIPTION) {
+            update_player_address(data, &message);
         }
+        // A pong from another address does not answer a ping of the server
+        if (message.type == UDP_PONG && is_from_player_address(data->server, &message)) {
+            add_rtt_sample(data->server, &message);
+        }
+        if (message.type != UDP_GAME_ACTION) {
+            continue;
+        }
+        queue_game_actions(data, &message, now_us);
     }
 
     sleep(2); // Wait for the other thread to finish
@@ -769,33 +1490,69 @@ void *serv_client_recv_game_action(void *arg_udp_thread_data) {
         unlock_mutex_for_everyone(data->lock_all_udp_threads_closed, data->cond_lock_all_udp_threads_closed);
     }
 
+    metrics_thread_running(false);
     return NULL;
 }
 
 void increment_last_num_message(int *last_num_message) {
-    *last_num_message = *last_num_message + 1 % LIMIT_LAST_NUM_MESSAGE_MULT;
+    *last_num_message = (*last_num_message + 1) % LIMIT_LAST_NUM_MESSAGE_MULT;
+}
+
+/** Sleeps until the end of the period of period_us starting at *deadline_us, which is moved to it, so that the work
+ *  done in each period does not delay the next ones. A thread late by a whole period starts again from now instead of
+ *  catching up.
+ */
+static void wait_next_period(uint64_t *deadline_us, uint64_t period_us) {
+    *deadline_us += period_us;
+    uint64_t now_us = get_time_us();
+    if (now_us >= *deadline_us) {
+        if (now_us - *deadline_us >= period_us) {
+            *deadline_us = now_us;
+        }
+        return;
+    }
+    uint64_t wait_us = *deadline_us - now_us;
+    struct timespec wait = {wait_us / 1000000, (wait_us % 1000000) * 1000};
+    while (nanosleep(&wait, &wait) == -1 && errno == EINTR) {
+    }
 }
 
 void *serve_clients_send_mult_sec(void *arg_udp_thread_data) {
     udp_thread_data *data = (udp_thread_data *)arg_udp_thread_data;
 
+    metrics_thread_running(true);
+    name_game_thread("board", data->game_id);
     int last_num_sec_message = 1;
+    uint64_t snapshot_us = (uint64_t)data->server->settings.snapshot_ms * 1000;
+    uint64_t deadline_us = get_time_us();
     while (true) {
-        sleep(1);
-        pthread_mutex_lock(lock_game_model);
-        update_bombs(data->game_id);
+        wait_next_period(&deadline_us, snapshot_us);
+        uint64_t snapshot_start = trace_begin();
+        lock_game_model_traced(data->game_id);
+        uint64_t start = trace_begin();
+        uint64_t now_ms = get_time_ms();
+        record_bombs(data->server->recorder, now_ms);
+        update_bombs(now_ms, data->game_id);
+        data->server->keyframe_stale = true;
+        trace_end("update_bombs", data->game_id, start);
         pthread_mutex_unlock(lock_game_model);
 
-        pthread_mutex_lock(lock_game_model);
+        lock_game_model_traced(data->game_id);
+        start = trace_begin();
         board *game_board = get_game_board(data->game_id);
+        coord positions[MAX_PLAYER_NUM];
+        get_player_positions(data->game_id, positions);
+        trace_end("copy board", data->game_id, start);
         pthread_mutex_unlock(lock_game_model);
         RETURN_NULL_IF_NULL(game_board);
 
         pthread_mutex_lock(&data->lock_send_udp);
-        send_game_board_for_clients(data->server, last_num_sec_message, game_board);
+        send_game_board_for_clients(data->server, data->game_id, last_num_sec_message, game_board, positions);
+        send_ping_for_clients(data->server);
         pthread_mutex_unlock(&data->lock_send_udp);
         increment_last_num_message(&last_num_sec_message);
-        free(game_board);
+        free_board(game_board);
+        trace_end("snapshot", data->game_id, snapshot_start);
         // TODO manage errors
 
         pthread_mutex_lock(lock_game_model);
@@ -819,8 +1576,21 @@ void *serve_clients_send_mult_sec(void *arg_udp_thread_data) {
 
             pthread_mutex_lock(lock_game_model);
             remove_game(data->game_id);
+            recorder_close(data->server->recorder);
+            data->server->recorder = NULL;
+            free(data->server->keyframe);
+            data->server->keyframe = NULL;
             pthread_mutex_unlock(lock_game_model);
 
+            // Every other thread of the game has ended
+            metrics_unregister_match(data->server->metrics);
+            data->server->metrics = NULL;
+            netem_free_link(data->server->netem_mult);
+            data->server->netem_mult = NULL;
+            if (data->server->mult_interface != NULL) {
+                METRICS_SUB(data->server->mult_interface->metrics, matches, 1);
+            }
+
             pthread_mutex_destroy(data->lock_finished_flag);
             free(data->lock_finished_flag);
 
@@ -848,6 +1618,7 @@ void *serve_clients_send_mult_sec(void *arg_udp_thread_data) {
     }
     free(data);
 
+    metrics_thread_running(false);
     return NULL;
 }
 
@@ -871,7 +1642,7 @@ void game_action_swap(game_action **game_actions, unsigned i, unsigned j) {
     game_actions[i] = current_action;
 }
 
-unsigned game_action_partition(game_action **game_actions, int start, int end, int last_num_message[PLAYER_NUM]) {
+unsigned game_action_partition(game_action **game_actions, int start, int end, int last_num_message[MAX_PLAYER_NUM]) {
     game_action *pivot = game_actions[end];
     unsigned j = start;
 
@@ -896,7 +1667,7 @@ unsigned game_action_partition(game_action **game_actions, int start, int end, i
     return j;
 }
 
-void game_action_quick_sort(game_action **game_actions, int start, int end, int last_num_message[PLAYER_NUM]) {
+void game_action_quick_sort(game_action **game_actions, int start, int end, int last_num_message[MAX_PLAYER_NUM]) {
     if (start >= end) {
         return;
     }
@@ -906,7 +1677,7 @@ void game_action_quick_sort(game_action **game_actions, int start, int end, int
     game_action_quick_sort(game_actions, pivot + 1, end, last_num_message);
 }
 
-void game_actions_sort(game_action **game_actions, size_t nb_game_actions, int last_num_message[PLAYER_NUM]) {
+void game_actions_sort(game_action **game_actions, size_t nb_game_actions, int last_num_message[MAX_PLAYER_NUM]) {
     game_action_quick_sort(game_actions, 0, nb_game_actions - 1, last_num_message);
 }
 
@@ -920,35 +1691,35 @@ player_action *merge_player_moves_and_place_bomb(player_action *player_moves, un
     RETURN_NULL_IF_NULL_PERROR(res, "malloc player_action");
 
     memcpy(res, player_moves, sizeof(player_action) * nb_player_moves);
-    memcpy(res + sizeof(player_action) * nb_player_moves, player_place_bomb, sizeof(player_action) * nb_place_bomb);
+    memcpy(res + nb_player_moves, player_place_bomb, sizeof(player_action) * nb_place_bomb);
 
     *nb_player_actions = nb_player_moves + nb_place_bomb;
     return res;
 }
 
 player_action *get_player_actions(game_action **game_actions, size_t nb_game_actions,
-                                  int last_num_received_message[PLAYER_NUM], unsigned *nb_player_actions) {
+                                  int last_num_received_message[MAX_PLAYER_NUM], unsigned *nb_player_actions) {
     if (game_actions == NULL) {
         return NULL;
     }
-    player_action *player_moves = malloc(sizeof(player_action) * PLAYER_NUM);
+    player_action *player_moves = malloc(sizeof(player_action) * MAX_PLAYER_NUM);
     RETURN_NULL_IF_NULL_PERROR(player_moves, "malloc player_moves");
-    player_action *player_place_bomb = malloc(sizeof(player_action) * PLAYER_NUM);
+    player_action *player_place_bomb = malloc(sizeof(player_action) * MAX_PLAYER_NUM);
     RETURN_NULL_IF_NULL_PERROR(player_place_bomb, "malloc player_place_bomb");
 
     unsigned nb_player_moves = 0;
     unsigned nb_place_bomb = 0;
 
-    bool already_move[PLAYER_NUM];
-    bool already_place_bomb[PLAYER_NUM];
-    for (unsigned i = 0; i < PLAYER_NUM; i++) {
+    bool already_move[MAX_PLAYER_NUM];
+    bool already_place_bomb[MAX_PLAYER_NUM];
+    for (unsigned i = 0; i < MAX_PLAYER_NUM; i++) {
         already_move[i] = false;
         already_place_bomb[i] = false;
     }
 
     for (int i = nb_game_actions - 1; i >= 0; i--) {
         // Other actions were sent before those kept
-        if (nb_player_moves == PLAYER_NUM && nb_place_bomb == PLAYER_NUM) {
+        if (nb_player_moves == MAX_PLAYER_NUM && nb_place_bomb == MAX_PLAYER_NUM) {
             break;
         }
         // Message ignored
@@ -1022,14 +1793,18 @@ game_action **copy_game_actions(game_action **game_actions, size_t nb_game_actio
 
 void *serve_clients_send_mult_freq(void *arg_udp_thread_data) {
     udp_thread_data *data = (udp_thread_data *)arg_udp_thread_data;
-    int last_num_received_messages[PLAYER_NUM];
-    for (unsigned i = 0; i < PLAYER_NUM; i++) {
+    int last_num_received_messages[MAX_PLAYER_NUM];
+    for (unsigned i = 0; i < MAX_PLAYER_NUM; i++) {
         last_num_received_messages[i] = LIMIT_LAST_NUM_MESSAGE_CLIENT - 1;
     }
 
+    metrics_thread_running(true);
+    name_game_thread("tick", data->game_id);
     int last_num_freq_message = 0;
+    uint64_t tick_us = match_settings_tick_us(&data->server->settings);
+    uint64_t deadline_us = get_time_us();
     while (true) {
-        usleep(FREQ);
+        wait_next_period(&deadline_us, tick_us);
 
         // Check if the game is over
         pthread_mutex_lock(data->lock_finished_flag);
@@ -1046,40 +1821,78 @@ void *serve_clients_send_mult_freq(void *arg_udp_thread_data) {
             pthread_mutex_unlock(&data->lock_game_actions);
             continue;
         }
+        uint64_t tick_start_us = get_time_us();
+        uint64_t tick_start = trace_begin();
         game_action **game_actions = copy_game_actions(data->game_actions, nb_game_actions);
         RETURN_NULL_IF_NULL(game_actions);
         empty_game_actions(data);
+        atomic_store(&data->server->metrics->pending_actions, 0);
         pthread_mutex_unlock(&data->lock_game_actions);
+        trace_end("drain actions", data->game_id, tick_start);
 
+        uint64_t start = trace_begin();
         game_actions_sort(game_actions, data->nb_game_actions, last_num_received_messages);
 
         // Get player actions
         unsigned nb_player_actions;
         player_action *player_actions =
             get_player_actions(game_actions, nb_game_actions, last_num_received_messages, &nb_player_actions);
+        free_game_actions(game_actions, nb_game_actions);
+        trace_end("select actions", data->game_id, start);
         if (player_actions == NULL) {
+            METRICS_ADD(data->server->metrics, actions_dropped, nb_game_actions);
+            trace_end("tick", data->game_id, tick_start);
             continue;
         }
+        METRICS_ADD(data->server->metrics, actions_dropped, nb_game_actions - nb_player_actions);
         // Update the board with player actions and get the tile differences
         unsigned size_tile_diff = 0;
 
-        pthread_mutex_lock(lock_game_model);
-        tile_diff *diffs = update_game_board(data->game_id, player_actions, nb_player_actions, &size_tile_diff);
+        lock_game_model_traced(data->game_id);
+        start = trace_begin();
+        uint64_t now_ms = get_time_ms();
+        record_tick(data->server->recorder, now_ms, player_actions, nb_player_actions);
+        tile_diff *diffs =
+            update_game_board(data->game_id, player_actions, nb_player_actions, now_ms, &size_tile_diff);
+        if (size_tile_diff > max_update_diffs(data->server)) {
+            // The other diffs reach the clients with the next board
+            LOG_WARNING("%u tile_diffs of the game %u do not fit in an update.", size_tile_diff, data->game_id);
+            size_tile_diff = max_update_diffs(data->server);
+        }
+        trace_end("update_game_board", data->game_id, start);
+        if (size_tile_diff > 0) {
+            mark_keyframe_stale(data->server, last_num_freq_message);
+        }
+        // The tiles entering the area around a player are read from the board after the tick
+        board *area_board = NULL;
+        coord positions[MAX_PLAYER_NUM];
+        if (interest_radius > 0 && size_tile_diff > 0) {
+            area_board = get_game_board(data->game_id);
+            get_player_positions(data->game_id, positions);
+        }
         pthread_mutex_unlock(lock_game_model);
+        free(player_actions);
         RETURN_NULL_IF_NULL(diffs);
 
         if (size_tile_diff == 0) {
+            free(diffs);
+            metrics_add_tick(data->server->metrics, get_time_us() - tick_start_us);
+            trace_end("tick", data->game_id, tick_start);
             continue;
         }
 
         // Send the differences
         pthread_mutex_lock(&data->lock_send_udp);
-        send_game_update_for_clients(data->server, last_num_freq_message, diffs, size_tile_diff);
+        send_game_update_for_clients(data->server, data->game_id, last_num_freq_message, diffs, size_tile_diff,
+                                     area_board, positions);
         pthread_mutex_unlock(&data->lock_send_udp);
 
         // Last free
         free(diffs);
-        free_game_actions(game_actions, nb_game_actions);
+        free_board(area_board);
+        METRICS_ADD(data->server->metrics, tile_diffs, size_tile_diff);
+        metrics_add_tick(data->server->metrics, get_time_us() - tick_start_us);
+        trace_end("tick", data->game_id, tick_start);
 
         // Prepare new message
         increment_last_num_message(&last_num_freq_message);
@@ -1096,6 +1909,7 @@ void *serve_clients_send_mult_freq(void *arg_udp_thread_data) {
         unlock_mutex_for_everyone(data->lock_all_udp_threads_closed, data->cond_lock_all_udp_threads_closed);
     }
 
+    metrics_thread_running(false);
     return NULL;
 }
 
@@ -1109,6 +1923,12 @@ int init_game_threads(server_information *server, bool *finished_flag, pthread_m
     udp_thread_data_game->game_actions = NULL;
     udp_thread_data_game->size_game_actions = 0;
     udp_thread_data_game->nb_game_actions = 0;
+    uint64_t now_us = get_time_us();
+    for (int i = 0; i < MAX_PLAYER_NUM; i++) {
+        token_bucket_init(&udp_thread_data_game->action_limits[i], action_rate, get_action_burst(), now_us);
+    }
+    source_limits_init(&udp_thread_data_game->source_limits, prng_random_seed(), action_rate * DATAGRAMS_PER_ACTION,
+                       get_action_burst() * DATAGRAMS_PER_ACTION, now_us);
     udp_thread_data_game->nb_stopped_udp_threads = malloc(sizeof(unsigned));
     RETURN_FAILURE_IF_NULL(udp_thread_data_game->nb_stopped_udp_threads);
     *udp_thread_data_game->nb_stopped_udp_threads = 0;
@@ -1178,8 +1998,11 @@ void wait_all_clients_not_ready(server_information *server, bool *finished_flag,
     } else {
         pthread_mutex_lock(lock_game_model);
         board *game_board = get_game_board(game_id);
+        // No update has been sent yet, the first one has the number 0
+        mark_keyframe_stale(server, LIMIT_LAST_NUM_MESSAGE_MULT - 1);
         pthread_mutex_unlock(lock_game_model);
-        send_game_board_for_clients(server, 0, game_board); // Initial game_board send
+        // Initial game_board send, before any player subscribed over unicast
+        send_game_board_for_clients(server, game_id, 0, game_board, NULL);
         free_board(game_board);
         init_game_threads(server, finished_flag, lock_finished_flag, lock_all_tcp_threads_closed,
                           cond_lock_all_tcp_threads_closed, game_id); // TODO MANAGE ERRORS
@@ -1192,10 +2015,9 @@ void wait_all_clients_not_ready(server_information *server, bool *finished_flag,
 
 void handle_tcp_communication(tcp_thread_data *tcp_data) {
     int client_sock = tcp_data->server->sock_clients[tcp_data->id];
-    char buffer[1];
-    fd_set read_fds;
-    struct timeval tv;
-    int retval;
+    struct pollfd p;
+    p.fd = client_sock;
+    p.events = POLLIN | POLLRDHUP;
 
     while (true) {
         if (client_sock == -1) {
@@ -1208,52 +2030,31 @@ void handle_tcp_communication(tcp_thread_data *tcp_data) {
         }
         pthread_mutex_unlock(tcp_data->lock_finished_flag);
 
-        if (recv(client_sock, buffer, 1, MSG_PEEK | MSG_DONTWAIT) == 0) {
-            pthread_mutex_lock(lock_game_model);
-            set_player_dead(tcp_data->game_id, tcp_data->id);
-            pthread_mutex_unlock(lock_game_model);
+        int res = poll(&p, 1, TCP_POLL_TIMEOUT_MS);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERRNO("poll client");
             break;
         }
+        if (res == 0) {
+            continue;
+        }
 
-        FD_ZERO(&read_fds);
-        FD_SET(client_sock, &read_fds);
-
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
-
-        retval = select(client_sock + 1, &read_fds, NULL, NULL, &tv);
-
-        if (retval == -1) {
-            perror("select");
+        // The messages sent by the client before leaving are handled first
+        if ((p.revents & POLLIN) && handle_client_messages(tcp_data) == EXIT_FAILURE) {
+            set_player_dead_of_client(tcp_data);
+            break;
+        }
+        if (p.revents & (POLLRDHUP | POLLHUP | POLLERR)) {
+            set_player_dead_of_client(tcp_data);
             break;
-        } else if (retval > 0) {
-            if (FD_ISSET(client_sock, &read_fds)) {
-                chat_message *msg = recv_chat_message_of_client(tcp_data->server, tcp_data->id);
-
-                if (msg != NULL) {
-                    // Check if sending a message to the client is possible
-                    if (send(client_sock, buffer, 0, MSG_NOSIGNAL) < 0) {
-                        pthread_mutex_lock(lock_game_model);
-                        set_player_dead(tcp_data->game_id, tcp_data->id);
-                        pthread_mutex_unlock(lock_game_model);
-                        break;
-                    }
-
-                    handle_chat_message(tcp_data->server, tcp_data->id, msg);
-                    free(msg->message);
-                    free(msg);
-                } else {
-                    pthread_mutex_lock(lock_game_model);
-                    set_player_dead(tcp_data->game_id, tcp_data->id);
-                    pthread_mutex_unlock(lock_game_model);
-                    break;
-                }
-            }
         }
     }
 
     pthread_mutex_lock(tcp_data->lock_nb_players_left);
-    if (*tcp_data->nb_players_left == PLAYER_NUM - 1) {
+    if (*tcp_data->nb_players_left == tcp_data->server->nb_players - 1) {
 
         handle_game_over(tcp_data->server, tcp_data->game_id);
 
@@ -1292,7 +2093,9 @@ void handle_tcp_communication(tcp_thread_data *tcp_data) {
         }
 
         // Close all sockets
-        for (int i = 0; i < PLAYER_NUM; i++) {
+        tcp_output_stop(tcp_data->server->output);
+        tcp_data->server->output = NULL;
+        for (int i = 0; i < (int)tcp_data->server->nb_players; i++) {
             close_socket_client(tcp_data->server, i);
         }
 
@@ -1310,12 +2113,16 @@ void handle_tcp_communication(tcp_thread_data *tcp_data) {
 
 void *serve_client_tcp(void *arg_tcp_thread_data) {
     tcp_thread_data *tcp_data = (tcp_thread_data *)arg_tcp_thread_data;
+    metrics_thread_running(true);
+    name_game_thread("tcp", tcp_data->game_id);
     pthread_mutex_lock(tcp_data->lock_waiting_all_players_join);
     *(tcp_data->connected_players) += 1;
-    bool is_everyone_connected = *tcp_data->connected_players == PLAYER_NUM;
+    bool is_everyone_connected = *tcp_data->connected_players == tcp_data->server->nb_players;
     wait_all_clients_connected(tcp_data->lock_waiting_all_players_join, tcp_data->cond_lock_waiting_all_players_join,
                                is_everyone_connected, tcp_data->connected_players);
     send_connexion_information_of_client(tcp_data->server, tcp_data->id, tcp_data->eq);
+    send_capabilities_of_client(tcp_data->server, tcp_data->id);
+    tcp_data->reader = create_tcp_reader(tcp_data->server->sock_clients[tcp_data->id]);
 
     // TODO verify ready_informations
     struct pollfd p[1];
@@ -1324,103 +2131,99 @@ void *serve_client_tcp(void *arg_tcp_thread_data) {
     int timeout_ml = 60000;
 
     int res = poll(p, 1, timeout_ml); // if -1
-    if (res <= 0 || !(p[0].revents & POLL_IN)) {
-        pthread_mutex_lock(lock_game_model);
-        set_player_dead(tcp_data->game_id, tcp_data->id);
-        pthread_mutex_unlock(lock_game_model);
+    if (res <= 0 || !(p[0].revents & POLL_IN) || tcp_data->reader == NULL) {
+        set_player_dead_of_client(tcp_data);
         shutdown(tcp_data->server->sock_clients[tcp_data->id], SHUT_RD);
-        close(tcp_data->server->sock_clients[tcp_data->id]);
-        tcp_data->server->sock_clients[tcp_data->id] = -1;
+        close_socket_client(tcp_data->server, tcp_data->id);
     } else {
-        ready_connection_header *ready_informations =
-            recv_ready_connexion_header_of_client(tcp_data->server->sock_clients[tcp_data->id]);
+        ready_connection_header *ready_informations = recv_ready_connexion_header_of_client(tcp_data);
         free(ready_informations);
     }
     pthread_mutex_lock(tcp_data->lock_all_players_ready);
     *(tcp_data->ready_player_number) += 1;
-    bool is_ready = *tcp_data->ready_player_number == PLAYER_NUM;
+    bool is_ready = *tcp_data->ready_player_number == tcp_data->server->nb_players;
     wait_all_clients_not_ready(tcp_data->server, tcp_data->finished_flag, tcp_data->lock_finished_flag,
                                tcp_data->lock_all_tcp_threads_closed, tcp_data->cond_lock_all_tcp_threads_closed,
                                tcp_data->lock_all_players_ready, tcp_data->cond_lock_all_players_ready, is_ready,
                                tcp_data->ready_player_number, tcp_data->game_id);
 
+    // The initial board on the multicast group can be missed by a client joining it late
+    send_keyframe_to_client(tcp_data->server, tcp_data->game_id, tcp_data->id);
+
     handle_tcp_communication(tcp_data);
 
+    free_tcp_reader(tcp_data->reader);
     free(tcp_data);
 
     sleep(3); // Just in case
 
+    metrics_thread_running(false);
     return NULL;
 }
 
+/** Returns the capabilities the server chooses for the players which announce them, the unknown ones are of later
+ *  versions and the areas are only sent with a radius around the players
+ */
+static uint16_t supported_capabilities() {
+    return CAPABILITY_ACTION_BATCH | (interest_radius > 0 ? CAPABILITY_AREAS : 0);
+}
+
 int connect_one_player_to_game(int sock) {
     initial_connection_header *head = recv_initial_connection_header_of_client(sock);
+    if (head == NULL) {
+        close(sock);
+        return EXIT_FAILURE;
+    }
 
-    // TODO: refactor
-    if (head->game_mode == SOLO) {
-        if (connected_solo_players == 0) {
-            int game_id = init_game_model(SOLO);
-            if (game_id == -1) {
-                return EXIT_FAILURE;
-            }
-            solo_waiting_server = init_server_network(connection_port);
-            RETURN_FAILURE_IF_NULL(solo_waiting_server);
-            init_tcp_threads_data(solo_waiting_server, SOLO, game_id);
-        }
-        solo_waiting_server->sock_clients[connected_solo_players] = sock;
-        solo_tcp_threads_data_players[connected_solo_players]->id = connected_solo_players;
-        *(solo_tcp_threads_data_players[connected_solo_players]->connected_players) = connected_solo_players;
-        connected_solo_players++;
-
-        pthread_t t;
-        if (pthread_create(&t, NULL, serve_client_tcp, solo_tcp_threads_data_players[connected_solo_players - 1]) < 0) {
-            perror("thread creation");
+    capabilities caps = {0, UINT16_MAX};
+    if ((head->game_mode != SOLO && head->game_mode != TEAM) ||
+        (head->capabilities && recv_capabilities_of_client(sock, &caps) == EXIT_FAILURE)) {
+        free(head);
+        close(sock);
+        return EXIT_FAILURE;
+    }
+    waiting_game *waiting = &waiting_games[head->game_mode][head->version - 1];
+    if (waiting->nb_connected == 0) {
+        int game_id = init_game_model(head->game_mode, head->version);
+        if (game_id == -1) {
+            free(head);
             return EXIT_FAILURE;
         }
-
-    } else if (head->game_mode == TEAM) {
-        if (connected_team_players == 0) {
-            int game_id = init_game_model(TEAM);
-            if (game_id == -1) {
-                return EXIT_FAILURE;
-            }
-            team_waiting_server = init_server_network(connection_port);
-            RETURN_FAILURE_IF_NULL(team_waiting_server);
-            if (game_id == 0 || game_id == 3) { // 0 and 3 are in the same team
-                init_tcp_threads_data(team_waiting_server, TEAM, 0);
-            } else {
-                init_tcp_threads_data(team_waiting_server, TEAM, 1);
-            }
-        }
-        team_waiting_server->sock_clients[connected_team_players] = sock;
-        team_tcp_threads_data_players[connected_team_players]->id = connected_team_players;
-
-        if (connected_team_players == 0 || connected_team_players == 3) {
-            team_tcp_threads_data_players[connected_team_players]->eq = 0;
-        } else {
-            team_tcp_threads_data_players[connected_team_players]->eq = 1;
-        }
-
-        *(team_tcp_threads_data_players[connected_team_players]->connected_players) = connected_team_players;
-        connected_team_players++;
-
-        pthread_t t;
-        if (pthread_create(&t, NULL, serve_client_tcp, team_tcp_threads_data_players[connected_team_players - 1]) < 0) {
-            perror("thread creation");
+        waiting->server = init_server_network(connection_port, game_id, head->version,
+                                              &game_settings[head->game_mode][head->version - 1]);
+        if (waiting->server == NULL) {
+            free(head);
             return EXIT_FAILURE;
         }
+        init_game_recorder(waiting->server, game_id);
+        init_tcp_threads_data(waiting->server, head->game_mode, game_id, waiting->players);
+        LOG_INFO("Game %d waits for %u players with the version %d of the protocol.", game_id,
+                 waiting->server->nb_players, head->version);
+    }
+
+    unsigned id = waiting->nb_connected;
+    waiting->server->sock_clients[id] = sock;
+    waiting->server->announced_capabilities[id] = head->capabilities;
+    waiting->server->capabilities[id] = caps.flags & supported_capabilities();
+    if (caps.max_datagram < waiting->server->max_datagram) {
+        waiting->server->max_datagram = caps.max_datagram;
     }
     free(head);
+    tcp_output_set_socket(waiting->server->output, id, sock);
+    waiting->nb_connected = (id + 1) % waiting->server->nb_players;
 
-    connected_solo_players %= PLAYER_NUM;
-    connected_team_players %= PLAYER_NUM;
+    pthread_t t;
+    if (pthread_create(&t, NULL, serve_client_tcp, waiting->players[id]) < 0) {
+        LOG_ERRNO("thread creation");
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
 
 int connect_players_to_game() {
     listen_players();
-    printf("Waiting players on %u port.\n", get_port_tcp());
+    LOG_INFO("Waiting players on %u port.", get_port_tcp());
 
     struct pollfd *polls = init_polls_connexion(sock_tcp);
     unsigned nbfds = 1;
@@ -1429,23 +2232,28 @@ int connect_players_to_game() {
     while (1) {
         poll(polls, nbfds, -1);
 
-        for (unsigned i = 1; i < nbfds; i++) {
+        // From the end, so that the poll moved in place of a removed one has already been handled
+        for (unsigned i = nbfds - 1; i >= 1; i--) {
             if (polls[i].revents & POLL_IN) {
                 connect_one_player_to_game(polls[i].fd);
                 remove_polls_to_poll(polls, &nbfds, i);
-            }
-            if (polls[i].revents & POLL_HUP) {
+            } else if (polls[i].revents & POLL_HUP) {
                 close(polls[i].fd);
                 remove_polls_to_poll(polls, &nbfds, i);
             }
         }
         if (polls[0].revents & POLL_IN) {
             int sock = try_to_init_socket_of_client();
-            add_polls_to_poll(polls, &nbfds, &s, sock);
+            struct pollfd *n = sock == -1 ? polls : add_polls_to_poll(polls, &nbfds, &s, sock);
+            if (n == NULL) {
+                close(sock);
+            } else {
+                polls = n;
+            }
         }
     }
 
-    printf("All players are connected.\n");
+    LOG_INFO("All players are connected.");
     return EXIT_SUCCESS;
 }
 
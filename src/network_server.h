@@ -2,26 +2,136 @@
 #define SRC_NETWORK_SERVER_H_
 
 #include "communication_server.h"
+#include "dedup.h"
+#include "interest.h"
+#include "match_settings.h"
+#include "metrics.h"
+#include "netem.h"
+#include "recorder.h"
+#include "rtt.h"
+#include "tcp_output.h"
 
 #define MIN_PORT 1024
 #define MAX_PORT 49151
 
+#define MAX_MULTICAST_INTERFACES 16
+#define MAX_ACTION_RATE 10000 // Game actions per second from a player
+
+/** Network interface sending the multicast messages of some games
+ */
+typedef struct multicast_interface {
+    unsigned index; // 0 for the interface chosen by the system
+    interface_metrics *metrics;
+} multicast_interface;
+
 /** Parameter for a server managing a single game */
 typedef struct server_information {
     int sock_udp;
     int sock_mult;
 
-    int sock_clients[PLAYER_NUM]; // socket TCP to send game informations
+    unsigned nb_players;      // Players of the game, at most PLAYER_NUM with the first version of the protocol
+    PROTOCOL_VERSION version; // Of every message of the game, asked by the players in their initial connection
+    match_settings settings;  // Of the mode and the version of the game when it was created
+    // Capabilities chosen for each player when it joins, none for a player which announced none. The game board
+    // updates fit in the smallest datagram its players announced.
+    uint16_t capabilities[MAX_PLAYER_NUM];
+    bool announced_capabilities[MAX_PLAYER_NUM];
+    uint16_t max_datagram;
+
+    int sock_clients[MAX_PLAYER_NUM]; // socket TCP to send game informations
+    tcp_output *output;               // Every message to the clients over TCP after the connection information
 
     uint16_t port_udp;
     uint16_t port_mult;
 
-    uint16_t adrmdiff[8]; // Multicast address
-    struct sockaddr_in6 *addr_mult;
+    uint16_t adrmdiff[8];           // Multicast address, 0 when the game has no multicast group
+    struct sockaddr_in6 *addr_mult; // NULL when the game has no multicast group
+    multicast_interface *mult_interface; // Shared with the other games sending on the same interface, or NULL
+
+    // Address the latest subscription of each player came from, where its pings are sent. The players subscribed over
+    // unicast, because the game has no multicast group or the group does not reach them, receive the messages of the
+    // game there. Written by the thread receiving the datagrams of the players with the lock sending over UDP held.
+    struct sockaddr_in6 player_addrs[MAX_PLAYER_NUM];
+    bool has_player_addr[MAX_PLAYER_NUM];
+    bool unicast_subscribed[MAX_PLAYER_NUM];
+    // Random token sent over TCP to each player which announced its capabilities, which its subscriptions echo
+    uint64_t subscription_tokens[MAX_PLAYER_NUM];
+    // Latency of each player, from the pongs answering the ping sent with each board. Only used by the thread
+    // receiving the datagrams of the players, the metrics of the game publish it.
+    rtt_estimator rtt[MAX_PLAYER_NUM];
+    // Message numbers of the game actions received from each player, the same action comes in several datagrams. Only
+    // used by the thread receiving the datagrams of the players.
+    dedup_window action_windows[MAX_PLAYER_NUM];
+    // Tiles each player subscribed over unicast is kept up to date on, when they only receive the area around them.
+    // Protected by the lock sending over UDP.
+    interest_window interest_windows[MAX_PLAYER_NUM];
+
+    recorder *recorder; // NULL if the game is not recorded
+
+    match_metrics *metrics;
+
+    netem_link *netem_mult; // Impairs the messages sent over UDP when BOMBERMAN_NETEM is set, NULL otherwise
+
+    // Board of the game serialized for the TCP connections, so that a client joining the game or missing updates gets
+    // a coherent board at once. It is only serialized when a client needs it and the board changed since, which
+    // keyframe_stale tells. keyframe_num is the number of the last update applied to the board. All are protected by
+    // the lock of the game model.
+    char *keyframe;
+    size_t keyframe_size;
+    uint16_t keyframe_num;
+    bool keyframe_stale;
 } server_information;
 
 int init_socket_tcp();
 void init_state(uint16_t connexion_port);
+
+/** Makes every new game generate its board from this seed instead of a random one, to reproduce a layout
+ */
+void set_fixed_game_seed(uint64_t seed);
+
+/** Records every new game in a file of the directory, to replay it later with the replay program
+ */
+void set_record_directory(const char *directory);
+
+/** Sends the multicast messages of the new games through the network interfaces of names, separated by commas, one
+ *  interface after the other. Without it, the games use DEFAULT_MULTICAST_INTERFACE, or the interface chosen by the
+ *  system if there is none of this name. Returns EXIT_FAILURE if an interface does not exist.
+ */
+int set_multicast_interfaces(const char *names);
+
+/** Makes the new games send their messages to each player at the address it subscribes from, without a multicast
+ *  group, for the networks which drop multicast
+ */
+void set_unicast_delivery(bool unicast);
+
+/** Makes the players subscribed over unicast receive only the tiles at most radius tiles away from them on each axis,
+ *  instead of the whole board, 0 to send them the whole board
+ */
+void set_interest_radius(unsigned radius);
+
+/** Makes each game accept at most rate game actions per second from each player, in bursts of half as many, and twice
+ *  as many datagrams from each address. The others are dropped before being queued for a tick.
+ */
+void set_action_rate_limit(unsigned rate);
+
+/** Makes the new games of the second version of the protocol wait for nb players, between 2 and MAX_PLAYER_NUM,
+ *  instead of MAX_PLAYER_NUM. Returns EXIT_FAILURE if nb is not valid.
+ */
+int set_wide_game_players(unsigned nb);
+
+/** Sets the settings of the new games, parsed by match_settings_parse from str written as "[GAMES:]SETTINGS". The
+ *  settings are kept per type of game, a mode and a version of the protocol, and every match of a type has them. GAMES
+ *  restricts them to the games of a mode, solo or team, of a version of the protocol, v1 or v2, or of both, as in
+ *  "team.v2", instead of every game. Each call changes the settings left by the previous ones, so that the last one
+ *  wins. Returns EXIT_FAILURE if str is not valid or a board of the settings does not suit its games, with
+ *  match_settings_check for the number of players chosen so far.
+ */
+int set_match_settings(const char *str);
+
+/** Reads the latest estimation of the latency of a player of the game, from any thread. Returns false if the player has
+ *  not answered a ping yet.
+ */
+bool get_player_latency(const server_information *server, int id, uint64_t *rtt_us, int64_t *clock_offset_us);
 int game_loop_server();
 
 #endif // SRC_NETWORK_SERVER_H__H_
@@ -0,0 +1,58 @@
+#include "./prng.h"
+
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+static atomic_uint_fast64_t seed_counter = 0;
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint32_t rotl(uint32_t x, int k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+void prng_seed(prng *p, uint64_t seed) {
+    // splitmix64 never gives an all zero state, which is the only invalid state of xoshiro
+    uint64_t x = seed;
+    uint64_t a = splitmix64(&x);
+    uint64_t b = splitmix64(&x);
+    p->s[0] = a & 0xFFFFFFFF;
+    p->s[1] = a >> 32;
+    p->s[2] = b & 0xFFFFFFFF;
+    p->s[3] = b >> 32;
+}
+
+uint32_t prng_next(prng *p) {
+    uint32_t *s = p->s;
+    uint32_t result = rotl(s[1] * 5, 7) * 9;
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 11);
+
+    return result;
+}
+
+uint32_t prng_range(prng *p, uint32_t bound) {
+    // Lemire's multiply-shift, the bias is negligible for the small bounds used here
+    return ((uint64_t)prng_next(p) * bound) >> 32;
+}
+
+uint64_t prng_random_seed() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    uint64_t x = ((uint64_t)ts.tv_sec << 30) ^ ts.tv_nsec ^ ((uint64_t)getpid() << 48);
+    x ^= atomic_fetch_add(&seed_counter, 1);
+    return splitmix64(&x);
+}
@@ -0,0 +1,30 @@
+#ifndef SRC_PRNG_H_
+#define SRC_PRNG_H_
+
+#include <stdint.h>
+
+/** State of a xoshiro128** pseudo random number generator.
+ *  Every owner (a game, the network layer, ...) keeps its own state, so no lock is needed and a sequence can be
+ *  reproduced from its seed.
+ */
+typedef struct prng {
+    uint32_t s[4];
+} prng;
+
+/** Initializes the state from a seed, any value (including 0) is valid
+ */
+void prng_seed(prng *, uint64_t seed);
+
+/** Returns the next pseudo random 32 bits value
+ */
+uint32_t prng_next(prng *);
+
+/** Returns a pseudo random value in [0, bound[, bound has to be greater than 0
+ */
+uint32_t prng_range(prng *, uint32_t bound);
+
+/** Returns a new seed, different between two calls even within the same second
+ */
+uint64_t prng_random_seed();
+
+#endif // SRC_PRNG_H_
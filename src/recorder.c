@@ -0,0 +1,201 @@
+#include "./recorder.h"
+#include "./utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORD_PREFIX_SIZE 5 // type and time
+#define RECORD_BUFFER_SIZE (RECORD_PREFIX_SIZE + 1 + 2 * RECORD_MAX_ACTIONS)
+
+void write_record_header(unsigned char *buf, const char *magic, uint8_t version, const record_header *header) {
+    memcpy(buf, magic, 4);
+    buf[4] = version;
+    buf[5] = header->game_mode;
+    write_be16(buf + 6, header->dim.width);
+    write_be16(buf + 8, header->dim.height);
+    write_be64(buf + 10, header->seed);
+    buf[18] = header->nb_players;
+    write_be32(buf + 19, header->bomb_lifetime_ms);
+}
+
+int read_record_header(const unsigned char *buf, const char *magic, uint8_t version, record_header *header) {
+    if (memcmp(buf, magic, 4) != 0 || buf[4] != version || (buf[5] != SOLO && buf[5] != TEAM) ||
+        buf[18] > MAX_PLAYER_NUM) {
+        return EXIT_FAILURE;
+    }
+    header->game_mode = buf[5];
+    header->dim.width = read_be16(buf + 6);
+    header->dim.height = read_be16(buf + 8);
+    header->seed = read_be64(buf + 10);
+    header->nb_players = buf[18];
+    header->bomb_lifetime_ms = read_be32(buf + 19);
+    return EXIT_SUCCESS;
+}
+
+recorder *recorder_open(const char *path, const record_header *header, uint64_t start_ms) {
+    recorder *r = malloc(sizeof(recorder));
+    RETURN_NULL_IF_NULL_PERROR(r, "malloc recorder");
+
+    r->file = fopen(path, "wb");
+    if (r->file == NULL) {
+        perror("fopen record");
+        free(r);
+        return NULL;
+    }
+    r->start_ms = start_ms;
+
+    unsigned char buf[RECORD_HEADER_SIZE];
+    write_record_header(buf, RECORD_MAGIC, RECORD_VERSION, header);
+
+    if (fwrite(buf, RECORD_HEADER_SIZE, 1, r->file) != 1) {
+        perror("fwrite record header");
+        recorder_close(r);
+        return NULL;
+    }
+    return r;
+}
+
+void recorder_close(recorder *r) {
+    RETURN_IF_NULL(r);
+    fclose(r->file);
+    free(r);
+}
+
+static size_t write_record_prefix(recorder *r, unsigned char *buf, RECORD_TYPE type, uint64_t now_ms) {
+    buf[0] = type;
+    write_be32(buf + 1, now_ms >= r->start_ms ? now_ms - r->start_ms : 0);
+    return RECORD_PREFIX_SIZE;
+}
+
+static int write_record(recorder *r, const unsigned char *buf, size_t size) {
+    if (fwrite(buf, size, 1, r->file) != 1) {
+        perror("fwrite record");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int record_tick(recorder *r, uint64_t now_ms, const player_action *actions, unsigned nb_actions) {
+    RETURN_FAILURE_IF_NULL(r);
+    if (nb_actions > RECORD_MAX_ACTIONS) {
+        return EXIT_FAILURE;
+    }
+
+    unsigned char buf[RECORD_BUFFER_SIZE];
+    size_t size = write_record_prefix(r, buf, RECORD_TICK, now_ms);
+    buf[size++] = nb_actions;
+    for (unsigned i = 0; i < nb_actions; i++) {
+        buf[size++] = actions[i].id;
+        buf[size++] = actions[i].action;
+    }
+    return write_record(r, buf, size);
+}
+
+int record_bombs(recorder *r, uint64_t now_ms) {
+    RETURN_FAILURE_IF_NULL(r);
+
+    unsigned char buf[RECORD_BUFFER_SIZE];
+    size_t size = write_record_prefix(r, buf, RECORD_BOMBS, now_ms);
+    RETURN_FAILURE_IF_ERROR(write_record(r, buf, size));
+
+    // Called with each board sent by the server, so that a record is almost complete even if the server is killed
+    if (fflush(r->file) != 0) {
+        perror("fflush record");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int record_player_dead(recorder *r, uint64_t now_ms, int player_id) {
+    RETURN_FAILURE_IF_NULL(r);
+
+    unsigned char buf[RECORD_BUFFER_SIZE];
+    size_t size = write_record_prefix(r, buf, RECORD_PLAYER_DEAD, now_ms);
+    buf[size++] = player_id;
+    return write_record(r, buf, size);
+}
+
+record_reader *record_reader_open(const char *path, record_header *header) {
+    record_reader *reader = malloc(sizeof(record_reader));
+    RETURN_NULL_IF_NULL_PERROR(reader, "malloc record_reader");
+
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) {
+        perror("fopen record");
+        free(reader);
+        return NULL;
+    }
+
+    unsigned char buf[RECORD_HEADER_SIZE];
+    if (fread(buf, RECORD_HEADER_SIZE, 1, reader->file) != 1 ||
+        read_record_header(buf, RECORD_MAGIC, RECORD_VERSION, header) == EXIT_FAILURE) {
+        fprintf(stderr, "%s is not a valid record.\n", path);
+        record_reader_close(reader);
+        return NULL;
+    }
+    reader->nb_players = header->nb_players;
+    return reader;
+}
+
+void record_reader_close(record_reader *reader) {
+    RETURN_IF_NULL(reader);
+    fclose(reader->file);
+    free(reader);
+}
+
+int record_reader_next(record_reader *reader, record *rec) {
+    unsigned char buf[RECORD_BUFFER_SIZE];
+    if (fread(buf, RECORD_PREFIX_SIZE, 1, reader->file) != 1) {
+        return EXIT_FAILURE;
+    }
+    rec->type = buf[0];
+    rec->time_ms = read_be32(buf + 1);
+    rec->nb_actions = 0;
+    rec->player_id = -1;
+
+    switch (rec->type) {
+        case RECORD_TICK:
+            if (fread(buf, 1, 1, reader->file) != 1 || buf[0] > RECORD_MAX_ACTIONS) {
+                return EXIT_FAILURE;
+            }
+            rec->nb_actions = buf[0];
+            if (rec->nb_actions > 0 && fread(buf, 2 * rec->nb_actions, 1, reader->file) != 1) {
+                return EXIT_FAILURE;
+            }
+            for (unsigned i = 0; i < rec->nb_actions; i++) {
+                rec->actions[i].id = buf[2 * i];
+                rec->actions[i].action = buf[2 * i + 1];
+                if ((unsigned)rec->actions[i].id >= reader->nb_players) {
+                    return EXIT_FAILURE;
+                }
+            }
+            return EXIT_SUCCESS;
+        case RECORD_BOMBS:
+            return EXIT_SUCCESS;
+        case RECORD_PLAYER_DEAD:
+            if (fread(buf, 1, 1, reader->file) != 1 || buf[0] >= reader->nb_players) {
+                return EXIT_FAILURE;
+            }
+            rec->player_id = buf[0];
+            return EXIT_SUCCESS;
+        default:
+            return EXIT_FAILURE;
+    }
+}
+
+tile_diff *apply_record(unsigned game_id, const record *rec, unsigned *size_tile_diff) {
+    *size_tile_diff = 0;
+    switch (rec->type) {
+        case RECORD_TICK:
+            return update_game_board(game_id, (player_action *)rec->actions, rec->nb_actions, rec->time_ms,
+                                     size_tile_diff);
+        case RECORD_BOMBS:
+            update_bombs(rec->time_ms, game_id);
+            break;
+        case RECORD_PLAYER_DEAD:
+            set_player_dead(game_id, rec->player_id);
+            break;
+    }
+    return NULL;
+}
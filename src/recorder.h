@@ -0,0 +1,93 @@
+#ifndef SRC_RECORDER_H_
+#define SRC_RECORDER_H_
+
+#include "./model.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** A match record is an append-only binary log of everything that changes the model of a game:
+ *  - a header with the game mode, the dimension given to init_model, the seed of the board, the number of players and
+ *    the lifetime of the bombs
+ *  - one record per model update, with its time relative to the start of the match
+ *
+ *  Replaying the records on a model created from the header gives back exactly the same boards and tile_diffs.
+ *  All the integers are stored in network byte order.
+ */
+
+#define RECORD_MAGIC "BMRC"
+#define RECORD_VERSION 3
+#define RECORD_HEADER_SIZE 23
+
+/** Maximum number of actions in a tick, a move and a bomb per player */
+#define RECORD_MAX_ACTIONS (2 * MAX_PLAYER_NUM)
+
+typedef enum RECORD_TYPE {
+    RECORD_TICK = 0,        // update_game_board with the selected player actions
+    RECORD_BOMBS = 1,       // update_bombs without any action
+    RECORD_PLAYER_DEAD = 2, // set_player_dead, when a player leaves
+} RECORD_TYPE;
+
+typedef struct record_header {
+    GAME_MODE game_mode;
+    dimension dim;
+    uint64_t seed;
+    unsigned nb_players;
+    unsigned bomb_lifetime_ms;
+} record_header;
+
+/** Writes the header in buf (RECORD_HEADER_SIZE bytes), with the magic (4 chars) and the version of the file format
+ */
+void write_record_header(unsigned char *buf, const char *magic, uint8_t version, const record_header *header);
+
+/** Reads a header written by write_record_header, returns EXIT_FAILURE if the magic or the version are not the expected
+ *  ones
+ */
+int read_record_header(const unsigned char *buf, const char *magic, uint8_t version, record_header *header);
+
+typedef struct record {
+    RECORD_TYPE type;
+    uint32_t time_ms; // Since the start of the match
+    unsigned nb_actions;
+    player_action actions[RECORD_MAX_ACTIONS];
+    int player_id;
+} record;
+
+typedef struct recorder {
+    FILE *file;
+    uint64_t start_ms;
+} recorder;
+
+/** Creates the file at path and writes the header, start_ms is the time of the beginning of the match
+ */
+recorder *recorder_open(const char *path, const record_header *header, uint64_t start_ms);
+
+/** Flushes and closes the record
+ */
+void recorder_close(recorder *);
+
+int record_tick(recorder *, uint64_t now_ms, const player_action *actions, unsigned nb_actions);
+int record_bombs(recorder *, uint64_t now_ms);
+int record_player_dead(recorder *, uint64_t now_ms, int player_id);
+
+typedef struct record_reader {
+    FILE *file;
+    unsigned nb_players; // Of the header, the records of other players are invalid
+} record_reader;
+
+/** Opens the record at path and reads its header
+ */
+record_reader *record_reader_open(const char *path, record_header *header);
+
+void record_reader_close(record_reader *);
+
+/** Reads the next record, returns EXIT_FAILURE at the end of the file or if the record is invalid
+ */
+int record_reader_next(record_reader *, record *);
+
+/** Applies a record to the model of game_id, like the server did when it was recorded.
+ *  Returns the tile_diffs of a tick (NULL otherwise) and sets size_tile_diff
+ */
+tile_diff *apply_record(unsigned game_id, const record *, unsigned *size_tile_diff);
+
+#endif // SRC_RECORDER_H_
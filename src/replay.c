@@ -0,0 +1,151 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "model.h"
+#include "recorder.h"
+#include "replay_file.h"
+#include "utils.h"
+
+#define LIMIT_NUM_MESSAGE (1 << 16)
+
+/** Adds the changes of the board since previous_board to the replay file
+ */
+int write_replay_update(replay_writer *writer, unsigned game_id, board *previous_board, uint32_t time_ms) {
+    unsigned size_tile_diff = 0;
+    tile_diff *diffs = get_diff_with_board(game_id, previous_board, &size_tile_diff);
+    RETURN_FAILURE_IF_NULL(diffs);
+
+    int res = EXIT_SUCCESS;
+    if (size_tile_diff > 0) {
+        board *current_board = get_game_board(game_id);
+        res = current_board == NULL ? EXIT_FAILURE
+                                    : replay_writer_add_update(writer, time_ms, diffs, size_tile_diff, current_board);
+        free_board(current_board);
+    }
+    free(diffs);
+    return res;
+}
+
+/** Replays a match record and prints the tile_diffs the server sent for it, one update per block:
+ *      update <num> <time_ms> <nb>
+ *      <x> <y> <tile>
+ *  If output is not NULL, every change of the board is also written to the replay file output.
+ */
+int replay(const char *path, const char *output) {
+    record_header header;
+    record_reader *reader = record_reader_open(path, &header);
+    RETURN_FAILURE_IF_NULL(reader);
+
+    int game_id = init_model_with_players(header.dim, header.game_mode, header.seed, header.nb_players);
+    if (game_id == -1) {
+        record_reader_close(reader);
+        return EXIT_FAILURE;
+    }
+    set_bomb_lifetime(header.bomb_lifetime_ms, game_id);
+
+    replay_writer *writer = NULL;
+    if (output != NULL) {
+        board *initial_board = get_game_board(game_id);
+        writer = initial_board == NULL ? NULL : replay_writer_open(output, &header, initial_board);
+        free_board(initial_board);
+        if (writer == NULL) {
+            record_reader_close(reader);
+            reset_games();
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("# mode %s, dimension %dx%d, seed %" PRIu64 ", %u players, bombs of %u ms\n",
+           header.game_mode == SOLO ? "SOLO" : "TEAM", header.dim.width, header.dim.height, header.seed,
+           header.nb_players, header.bomb_lifetime_ms);
+
+    unsigned nb_records = 0;
+    unsigned num = 0;
+    int res = EXIT_SUCCESS;
+    record rec;
+    while (res == EXIT_SUCCESS && record_reader_next(reader, &rec) == EXIT_SUCCESS) {
+        nb_records++;
+
+        // The server only sends the changes of the ticks, the replay file keeps every change of the board
+        board *previous_board = writer == NULL ? NULL : get_game_board(game_id);
+
+        unsigned size_tile_diff = 0;
+        tile_diff *diffs = apply_record(game_id, &rec, &size_tile_diff);
+        if (size_tile_diff > 0) {
+            printf("update %u %" PRIu32 " %u\n", num, rec.time_ms, size_tile_diff);
+            for (unsigned i = 0; i < size_tile_diff; i++) {
+                printf("%u %u %u\n", diffs[i].x, diffs[i].y, diffs[i].tile);
+            }
+            num = (num + 1) % LIMIT_NUM_MESSAGE;
+        }
+        free(diffs);
+
+        if (writer != NULL) {
+            res = previous_board == NULL ? EXIT_FAILURE
+                                         : write_replay_update(writer, game_id, previous_board, rec.time_ms);
+            free_board(previous_board);
+        }
+    }
+
+    fprintf(stderr, "%u records replayed, %u updates.\n", nb_records, num);
+
+    if (writer != NULL) {
+        if (res == EXIT_SUCCESS) {
+            fprintf(stderr, "%" PRIu32 " ticks written to %s.\n", writer->nb_ticks, output);
+        }
+        if (replay_writer_close(writer) == EXIT_FAILURE) {
+            res = EXIT_FAILURE;
+        }
+    }
+    record_reader_close(reader);
+    reset_games();
+    return res;
+}
+
+/** Prints the board of a replay file after tick updates
+ */
+int print_board_at(const char *path, uint32_t tick) {
+    replay_file *f = replay_file_open(path);
+    RETURN_FAILURE_IF_NULL(f);
+
+    uint32_t time_ms = 0;
+    board *b = replay_file_board_at(f, tick, &time_ms);
+    if (b == NULL) {
+        fprintf(stderr, "No tick %" PRIu32 " in %s, it has %" PRIu32 " ticks.\n", tick, path, f->nb_ticks);
+        replay_file_close(f);
+        return EXIT_FAILURE;
+    }
+
+    printf("# tick %" PRIu32 "/%" PRIu32 " at %" PRIu32 " ms\n", tick, f->nb_ticks, time_ms);
+    for (int y = 0; y < b->dim.height; y++) {
+        for (int x = 0; x < b->dim.width; x++) {
+            putchar(tile_to_char(b->grid[coord_to_int_dim(x, y, b->dim)]));
+        }
+        putchar('\n');
+    }
+
+    free_board(b);
+    replay_file_close(f);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 2) {
+        return replay(argv[1], NULL);
+    }
+    if (argc == 4 && strcmp(argv[1], "-o") == 0) {
+        return replay(argv[3], argv[2]);
+    }
+    if (argc == 4 && strcmp(argv[1], "-t") == 0) {
+        int tick = parse_unsigned_within_bounds(argv[2], 0, INT32_MAX);
+        if (tick >= 0) {
+            return print_board_at(argv[3], tick);
+        }
+    }
+
+    fprintf(stderr, "Usage: %s [-o REPLAY_FILE] RECORD\n", argv[0]);
+    fprintf(stderr, "       %s -t TICK REPLAY_FILE\n", argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,363 @@
+#include "./replay_file.h"
+#include "./messages.h"
+#include "./utils.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REPLAY_TRAILER_MAGIC "BMRI"
+#define REPLAY_FRAME_HEADER_SIZE 13 // kind, tick, time and payload length
+#define REPLAY_INDEX_ENTRY_SIZE 16
+#define REPLAY_TRAILER_SIZE 20
+#define MAX_DIFFS_PER_UPDATE 255 // Of a game of the first version of the protocol
+
+static int write_bytes(replay_writer *w, const void *buf, size_t size) {
+    if (fwrite(buf, size, 1, w->file) != 1) {
+        perror("fwrite replay");
+        return EXIT_FAILURE;
+    }
+    w->offset += size;
+    return EXIT_SUCCESS;
+}
+
+static int write_frame(replay_writer *w, REPLAY_FRAME_KIND kind, uint32_t time_ms, const char *payload,
+                       uint32_t size) {
+    unsigned char buf[REPLAY_FRAME_HEADER_SIZE];
+    buf[0] = kind;
+    write_be32(buf + 1, w->nb_ticks);
+    write_be32(buf + 5, time_ms);
+    write_be32(buf + 9, size);
+    RETURN_FAILURE_IF_ERROR(write_bytes(w, buf, REPLAY_FRAME_HEADER_SIZE));
+    return write_bytes(w, payload, size);
+}
+
+static int write_keyframe(replay_writer *w, uint32_t time_ms, const board *b) {
+    if (b->dim.width > UINT16_MAX || b->dim.height > UINT16_MAX) {
+        return EXIT_FAILURE;
+    }
+
+    if (w->nb_keyframes == w->capacity) {
+        unsigned capacity = w->capacity == 0 ? 16 : w->capacity * 2;
+        replay_keyframe *keyframes = realloc(w->keyframes, capacity * sizeof(replay_keyframe));
+        RETURN_FAILURE_IF_NULL_PERROR(keyframes, "realloc keyframes");
+        w->keyframes = keyframes;
+        w->capacity = capacity;
+    }
+
+    unsigned size = b->dim.width * b->dim.height;
+    game_board_information info = {w->nb_ticks, b->dim.height, b->dim.width, malloc(size * sizeof(TILE))};
+    RETURN_FAILURE_IF_NULL_PERROR(info.board, "malloc keyframe");
+    for (unsigned i = 0; i < size; i++) {
+        info.board[i] = b->grid[i];
+    }
+    char *serialized = serialize_game_board(&info);
+    free(info.board);
+    RETURN_FAILURE_IF_NULL(serialized);
+
+    replay_keyframe keyframe = {w->nb_ticks, time_ms, w->offset};
+    int res = write_frame(w, REPLAY_KEYFRAME, time_ms, serialized, game_board_size(serialized));
+    free(serialized);
+    RETURN_FAILURE_IF_ERROR(res);
+
+    w->keyframes[w->nb_keyframes++] = keyframe;
+    return EXIT_SUCCESS;
+}
+
+replay_writer *replay_writer_open(const char *path, const record_header *header, const board *initial_board) {
+    replay_writer *w = malloc(sizeof(replay_writer));
+    RETURN_NULL_IF_NULL_PERROR(w, "malloc replay_writer");
+
+    w->file = fopen(path, "wb");
+    if (w->file == NULL) {
+        perror("fopen replay");
+        free(w);
+        return NULL;
+    }
+    w->offset = 0;
+    w->nb_ticks = 0;
+    w->keyframes = NULL;
+    w->nb_keyframes = 0;
+    w->capacity = 0;
+
+    unsigned char buf[RECORD_HEADER_SIZE];
+    write_record_header(buf, REPLAY_FILE_MAGIC, REPLAY_FILE_VERSION, header);
+    if (write_bytes(w, buf, RECORD_HEADER_SIZE) == EXIT_FAILURE ||
+        write_keyframe(w, 0, initial_board) == EXIT_FAILURE) {
+        replay_writer_close(w);
+        return NULL;
+    }
+    return w;
+}
+
+int replay_writer_add_update(replay_writer *w, uint32_t time_ms, const tile_diff *diffs, unsigned nb_diffs,
+                             const board *current_board) {
+    RETURN_FAILURE_IF_NULL(w);
+
+    // The updates are written in the layout of the second version when their tiles or coordinates need it
+    unsigned nb_messages = (nb_diffs + MAX_DIFFS_PER_UPDATE - 1) / MAX_DIFFS_PER_UPDATE;
+    uint32_t max_size = nb_messages * GAME_BOARD_UPDATE_V2_HEADER_SIZE + nb_diffs * TILE_DIFF_V2_SIZE;
+    char *payload = malloc(max_size);
+    RETURN_FAILURE_IF_NULL_PERROR(payload, "malloc update");
+
+    w->nb_ticks++;
+    uint32_t written = 0;
+    for (unsigned i = 0; i < nb_diffs; i += MAX_DIFFS_PER_UPDATE) {
+        unsigned nb = min(nb_diffs - i, MAX_DIFFS_PER_UPDATE);
+        game_board_update update = {w->nb_ticks, nb, (tile_diff *)diffs + i};
+        char *serialized = serialize_game_board_update(&update);
+        if (serialized == NULL) {
+            free(payload);
+            return EXIT_FAILURE;
+        }
+        size_t size = game_board_update_size(serialized);
+        memcpy(payload + written, serialized, size);
+        written += size;
+        free(serialized);
+    }
+
+    int res = write_frame(w, REPLAY_UPDATE, time_ms, payload, written);
+    free(payload);
+    RETURN_FAILURE_IF_ERROR(res);
+
+    if (w->nb_ticks % REPLAY_KEYFRAME_INTERVAL == 0) {
+        return write_keyframe(w, time_ms, current_board);
+    }
+    return EXIT_SUCCESS;
+}
+
+int replay_writer_close(replay_writer *w) {
+    RETURN_FAILURE_IF_NULL(w);
+
+    int res = EXIT_SUCCESS;
+    uint64_t index_offset = w->offset;
+    for (unsigned i = 0; i < w->nb_keyframes && res == EXIT_SUCCESS; i++) {
+        unsigned char buf[REPLAY_INDEX_ENTRY_SIZE];
+        write_be32(buf, w->keyframes[i].tick);
+        write_be32(buf + 4, w->keyframes[i].time_ms);
+        write_be64(buf + 8, w->keyframes[i].offset);
+        res = write_bytes(w, buf, REPLAY_INDEX_ENTRY_SIZE);
+    }
+
+    if (res == EXIT_SUCCESS) {
+        unsigned char buf[REPLAY_TRAILER_SIZE];
+        write_be64(buf, index_offset);
+        write_be32(buf + 8, w->nb_keyframes);
+        write_be32(buf + 12, w->nb_ticks);
+        memcpy(buf + 16, REPLAY_TRAILER_MAGIC, 4);
+        res = write_bytes(w, buf, REPLAY_TRAILER_SIZE);
+    }
+
+    if (fclose(w->file) != 0) {
+        perror("fclose replay");
+        res = EXIT_FAILURE;
+    }
+    free(w->keyframes);
+    free(w);
+    return res;
+}
+
+static replay_keyframe get_keyframe(const replay_file *f, uint32_t i) {
+    const unsigned char *entry = f->data + f->index_offset + i * REPLAY_INDEX_ENTRY_SIZE;
+    replay_keyframe keyframe = {read_be32(entry), read_be32(entry + 4), read_be64(entry + 8)};
+    return keyframe;
+}
+
+static int check_index(const replay_file *f) {
+    if (f->nb_keyframes == 0 ||
+        f->index_offset + (uint64_t)f->nb_keyframes * REPLAY_INDEX_ENTRY_SIZE + REPLAY_TRAILER_SIZE != f->size) {
+        return EXIT_FAILURE;
+    }
+    for (uint32_t i = 0; i < f->nb_keyframes; i++) {
+        replay_keyframe keyframe = get_keyframe(f, i);
+        if (keyframe.offset < RECORD_HEADER_SIZE || keyframe.offset >= f->index_offset ||
+            keyframe.tick > f->nb_ticks || (i == 0 && keyframe.tick != 0) ||
+            (i > 0 && keyframe.tick <= get_keyframe(f, i - 1).tick)) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+replay_file *replay_file_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    RETURN_NULL_IF_NEG_PERROR(fd, "open replay");
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("fstat replay");
+        close(fd);
+        return NULL;
+    }
+    if ((size_t)st.st_size < RECORD_HEADER_SIZE + REPLAY_TRAILER_SIZE) {
+        fprintf(stderr, "%s is not a valid replay file.\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("mmap replay");
+        return NULL;
+    }
+
+    replay_file *f = malloc(sizeof(replay_file));
+    if (f == NULL) {
+        perror("malloc replay_file");
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    f->data = data;
+    f->size = st.st_size;
+
+    const unsigned char *trailer = f->data + f->size - REPLAY_TRAILER_SIZE;
+    f->index_offset = read_be64(trailer);
+    f->nb_keyframes = read_be32(trailer + 8);
+    f->nb_ticks = read_be32(trailer + 12);
+
+    if (read_record_header(f->data, REPLAY_FILE_MAGIC, REPLAY_FILE_VERSION, &f->header) == EXIT_FAILURE ||
+        memcmp(trailer + 16, REPLAY_TRAILER_MAGIC, 4) != 0 || check_index(f) == EXIT_FAILURE) {
+        fprintf(stderr, "%s is not a valid replay file.\n", path);
+        replay_file_close(f);
+        return NULL;
+    }
+    return f;
+}
+
+void replay_file_close(replay_file *f) {
+    RETURN_IF_NULL(f);
+    munmap((void *)f->data, f->size);
+    free(f);
+}
+
+typedef struct replay_frame {
+    REPLAY_FRAME_KIND kind;
+    uint32_t tick;
+    uint32_t time_ms;
+    uint32_t size;
+    const char *payload;
+} replay_frame;
+
+/** Reads the frame at offset, returns EXIT_FAILURE if it goes beyond the frames
+ */
+static int read_frame(const replay_file *f, uint64_t offset, replay_frame *frame) {
+    if (offset + REPLAY_FRAME_HEADER_SIZE > f->index_offset) {
+        return EXIT_FAILURE;
+    }
+    const unsigned char *buf = f->data + offset;
+    frame->kind = buf[0];
+    frame->tick = read_be32(buf + 1);
+    frame->time_ms = read_be32(buf + 5);
+    frame->size = read_be32(buf + 9);
+    frame->payload = (const char *)buf + REPLAY_FRAME_HEADER_SIZE;
+    if (offset + REPLAY_FRAME_HEADER_SIZE + frame->size > f->index_offset) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static board *decode_keyframe(const replay_frame *frame) {
+    uint16_t num, height, width;
+    if (frame->kind != REPLAY_KEYFRAME ||
+        read_game_board(frame->payload, frame->size, &num, &height, &width) == EXIT_FAILURE ||
+        frame->size != game_board_size(frame->payload)) {
+        return NULL;
+    }
+
+    game_board_information *info = deserialize_game_board(frame->payload);
+    RETURN_NULL_IF_NULL(info);
+
+    board *b = malloc(sizeof(board));
+    if (b == NULL) {
+        perror("malloc board");
+        free_game_board_information(info);
+        return NULL;
+    }
+    b->dim.width = width;
+    b->dim.height = height;
+    b->grid = malloc(width * height);
+    if (b->grid == NULL) {
+        perror("malloc grid");
+        free(b);
+        free_game_board_information(info);
+        return NULL;
+    }
+    for (unsigned i = 0; i < width * height; i++) {
+        b->grid[i] = info->board[i];
+    }
+    free_game_board_information(info);
+    return b;
+}
+
+static int apply_update(const replay_frame *frame, board *b) {
+    uint32_t read = 0;
+    while (read < frame->size) {
+        uint16_t num, nb;
+        if (read_game_board_update(frame->payload + read, frame->size - read, &num, &nb) == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+        game_board_update *update = deserialize_game_board_update(frame->payload + read);
+        RETURN_FAILURE_IF_NULL(update);
+
+        for (unsigned i = 0; i < update->nb; i++) {
+            tile_diff d = update->diff[i];
+            if (d.x >= b->dim.width || d.y >= b->dim.height) {
+                free_game_board_update(update);
+                return EXIT_FAILURE;
+            }
+            b->grid[coord_to_int_dim(d.x, d.y, b->dim)] = d.tile;
+        }
+        read += game_board_update_size(frame->payload + read);
+        free_game_board_update(update);
+    }
+    return EXIT_SUCCESS;
+}
+
+board *replay_file_board_at(const replay_file *f, uint32_t tick, uint32_t *time_ms) {
+    if (tick > f->nb_ticks) {
+        return NULL;
+    }
+
+    // Last keyframe at or before tick, the first one is always at tick 0
+    uint32_t low = 0;
+    uint32_t high = f->nb_keyframes - 1;
+    while (low < high) {
+        uint32_t mid = low + (high - low + 1) / 2;
+        if (get_keyframe(f, mid).tick <= tick) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    replay_keyframe keyframe = get_keyframe(f, low);
+
+    replay_frame frame;
+    RETURN_NULL_IF_ERROR(read_frame(f, keyframe.offset, &frame));
+    board *b = decode_keyframe(&frame);
+    RETURN_NULL_IF_NULL(b);
+    *time_ms = frame.time_ms;
+
+    uint64_t offset = keyframe.offset + REPLAY_FRAME_HEADER_SIZE + frame.size;
+    while (offset < f->index_offset) {
+        if (read_frame(f, offset, &frame) == EXIT_FAILURE) {
+            free_board(b);
+            return NULL;
+        }
+        if (frame.tick > tick) {
+            break;
+        }
+        if (frame.kind == REPLAY_UPDATE) {
+            if (apply_update(&frame, b) == EXIT_FAILURE) {
+                free_board(b);
+                return NULL;
+            }
+            *time_ms = frame.time_ms;
+        }
+        offset += REPLAY_FRAME_HEADER_SIZE + frame.size;
+    }
+    return b;
+}
@@ -0,0 +1,81 @@
+#ifndef SRC_REPLAY_FILE_H_
+#define SRC_REPLAY_FILE_H_
+
+#include "./model.h"
+#include "./recorder.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** A replay file holds every board of a match, and is made to be read at any tick without decoding it from the start:
+ *  - the header of the record it was built from, with its own magic
+ *  - frames, each made of a kind, a tick, a time since the start of the match, a payload length and a payload:
+ *      - a keyframe holds the whole board after `tick` updates, encoded by serialize_game_board
+ *      - an update holds the tile_diffs of the update number `tick`, encoded by serialize_game_board_update, in as
+ *        many messages as needed since a message holds at most 255 tile_diffs
+ *    The first frame is the keyframe of the initial board, then there is a keyframe every REPLAY_KEYFRAME_INTERVAL
+ *    updates.
+ *  - an index with the tick, the time and the offset of every keyframe, sorted by tick
+ *  - a trailer with the offset of the index, the number of keyframes, the number of updates and a magic
+ *  All the integers are stored in network byte order.
+ */
+
+#define REPLAY_FILE_MAGIC "BMRV"
+#define REPLAY_FILE_VERSION 3
+#define REPLAY_KEYFRAME_INTERVAL 64
+
+typedef enum REPLAY_FRAME_KIND {
+    REPLAY_KEYFRAME = 0,
+    REPLAY_UPDATE = 1,
+} REPLAY_FRAME_KIND;
+
+typedef struct replay_keyframe {
+    uint32_t tick;
+    uint32_t time_ms;
+    uint64_t offset;
+} replay_keyframe;
+
+typedef struct replay_writer {
+    FILE *file;
+    uint64_t offset;
+    uint32_t nb_ticks;
+    replay_keyframe *keyframes;
+    unsigned nb_keyframes;
+    unsigned capacity;
+} replay_writer;
+
+/** Creates the file at path, writes the header and the keyframe of the initial board
+ */
+replay_writer *replay_writer_open(const char *path, const record_header *header, const board *initial_board);
+
+/** Writes the next update, current_board is the board after it, used when a keyframe is due
+ */
+int replay_writer_add_update(replay_writer *, uint32_t time_ms, const tile_diff *diffs, unsigned nb_diffs,
+                             const board *current_board);
+
+/** Writes the index and closes the file, the file is not valid if it fails
+ */
+int replay_writer_close(replay_writer *);
+
+typedef struct replay_file {
+    const unsigned char *data; // The whole file, mapped in memory
+    size_t size;
+    record_header header;
+    uint32_t nb_ticks;
+    uint32_t nb_keyframes;
+    uint64_t index_offset;
+} replay_file;
+
+/** Maps the replay file at path and checks its header and its index
+ */
+replay_file *replay_file_open(const char *path);
+
+void replay_file_close(replay_file *);
+
+/** Returns the board after `tick` updates (to free with free_board) and sets time_ms to the time of this update.
+ *  Only the updates since the nearest keyframe before tick are decoded.
+ */
+board *replay_file_board_at(const replay_file *, uint32_t tick, uint32_t *time_ms);
+
+#endif // SRC_REPLAY_FILE_H_
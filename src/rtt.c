@@ -0,0 +1,27 @@
+#include "./rtt.h"
+
+#include <stdlib.h>
+
+int rtt_add_sample(rtt_estimator *estimator, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4) {
+    if (t4 < t1 || t3 < t2) {
+        return EXIT_FAILURE;
+    }
+    int64_t rtt_us = (int64_t)(t4 - t1) - (int64_t)(t3 - t2);
+    if (rtt_us < 0 || rtt_us > RTT_MAX_SAMPLE_US) {
+        return EXIT_FAILURE;
+    }
+    int64_t offset_us = ((int64_t)(t2 - t1) + ((int64_t)t3 - (int64_t)t4)) / 2;
+
+    if (estimator->samples == 0) {
+        estimator->srtt_us = rtt_us;
+        estimator->rttvar_us = rtt_us / 2;
+        estimator->offset_us = offset_us;
+    } else {
+        int64_t deviation = estimator->srtt_us > rtt_us ? estimator->srtt_us - rtt_us : rtt_us - estimator->srtt_us;
+        estimator->rttvar_us = (3 * estimator->rttvar_us + deviation) / 4;
+        estimator->srtt_us = (7 * estimator->srtt_us + rtt_us) / 8;
+        estimator->offset_us = (7 * estimator->offset_us + offset_us) / 8;
+    }
+    estimator->samples++;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,23 @@
+#ifndef SRC_RTT_H_
+#define SRC_RTT_H_
+
+#include <stdint.h>
+
+#define RTT_MAX_SAMPLE_US 10000000 // A longer round trip is an answer to a ping of a previous connection
+
+/** Round-trip time and clock offset of a peer, estimated from timestamped pings as NTP does: the ping leaves at t1 on
+ *  the local clock, reaches the peer at t2 and is answered at t3 on the clock of the peer, and the answer comes back
+ *  at t4 on the local clock. The time the peer took to answer is not part of the round trip.
+ */
+typedef struct rtt_estimator {
+    unsigned samples;
+    int64_t srtt_us;   // Smoothed round-trip time, as RFC 6298 does
+    int64_t rttvar_us; // Smoothed deviation of the round-trip time
+    int64_t offset_us; // Smoothed clock of the peer minus the local clock
+} rtt_estimator;
+
+/** Adds the sample of one ping, returns EXIT_FAILURE if its times are not coherent
+ */
+int rtt_add_sample(rtt_estimator *estimator, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4);
+
+#endif // SRC_RTT_H_
@@ -1,15 +1,33 @@
+#include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/poll.h>
-#include <time.h>
 #include <unistd.h>
 
+#include "log.h"
+#include "metrics.h"
+#include "netem.h"
 #include "network_server.h"
+#include "trace.h"
 #include "utils.h"
 
+#define MAX_MATCH_SETTINGS_FLAGS 16
+
 typedef struct flags {
     char *connexion_port;
+    char *seed;
+    char *record_directory;
+    char *metrics_path;
+    char *trace_path;
+    char *multicast_interfaces;
+    char *delivery;
+    char *interest_radius;
+    char *action_rate;
+    char *wide_game_players;
+    char *match_settings[MAX_MATCH_SETTINGS_FLAGS]; // In the order of the command line, each one over the previous ones
+    unsigned nb_match_settings;
 } flags;
 
 static flags *server_flags;
@@ -18,6 +36,16 @@ int init_server_flags() {
     server_flags = malloc(sizeof(flags));
     RETURN_FAILURE_IF_NULL_PERROR(server_flags, "malloc server_flags");
     server_flags->connexion_port = NULL;
+    server_flags->seed = NULL;
+    server_flags->record_directory = NULL;
+    server_flags->metrics_path = NULL;
+    server_flags->trace_path = NULL;
+    server_flags->multicast_interfaces = NULL;
+    server_flags->delivery = NULL;
+    server_flags->interest_radius = NULL;
+    server_flags->action_rate = NULL;
+    server_flags->wide_game_players = NULL;
+    server_flags->nb_match_settings = 0;
 
     return EXIT_SUCCESS;
 }
@@ -26,12 +54,50 @@ void parse_client_flags(int argc, char *argv[]) {
     for (int i = 2; i < argc; i++) {
         if (strcmp(argv[i - 1], "-p") == 0) {
             server_flags->connexion_port = argv[i];
+        } else if (strcmp(argv[i - 1], "-s") == 0) {
+            server_flags->seed = argv[i];
+        } else if (strcmp(argv[i - 1], "-r") == 0) {
+            server_flags->record_directory = argv[i];
+        } else if (strcmp(argv[i - 1], "-M") == 0) {
+            server_flags->metrics_path = argv[i];
+        } else if (strcmp(argv[i - 1], "-T") == 0) {
+            server_flags->trace_path = argv[i];
+        } else if (strcmp(argv[i - 1], "-i") == 0) {
+            server_flags->multicast_interfaces = argv[i];
+        } else if (strcmp(argv[i - 1], "-d") == 0) {
+            server_flags->delivery = argv[i];
+        } else if (strcmp(argv[i - 1], "-A") == 0) {
+            server_flags->interest_radius = argv[i];
+        } else if (strcmp(argv[i - 1], "-R") == 0) {
+            server_flags->action_rate = argv[i];
+        } else if (strcmp(argv[i - 1], "-P") == 0) {
+            server_flags->wide_game_players = argv[i];
+        } else if (strcmp(argv[i - 1], "-G") == 0 && server_flags->nb_match_settings < MAX_MATCH_SETTINGS_FLAGS) {
+            server_flags->match_settings[server_flags->nb_match_settings++] = argv[i];
+        }
+    }
+}
+
+int parse_seed(const char *str, uint64_t *seed) {
+    if (*str == '\0') {
+        return EXIT_FAILURE;
+    }
+    for (const char *c = str; *c != '\0'; c++) {
+        if (!isdigit((unsigned char)*c)) {
+            return EXIT_FAILURE;
         }
     }
+    // A seed larger than the largest one would be clamped to it, and the match logged with another seed
+    errno = 0;
+    unsigned long long parsed = strtoull(str, NULL, 10);
+    if (errno == ERANGE) {
+        return EXIT_FAILURE;
+    }
+    *seed = parsed;
+    return EXIT_SUCCESS;
 }
 
 int main(int argc, char *argv[]) {
-    srandom(time(NULL));
     RETURN_FAILURE_IF_ERROR(init_server_flags());
     parse_client_flags(argc, argv);
     uint16_t connexion_port = 0;
@@ -45,10 +111,92 @@ int main(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
     }
+    init_state(connexion_port);
+
+    if (server_flags->seed != NULL) {
+        uint64_t seed;
+        if (parse_seed(server_flags->seed, &seed) == EXIT_FAILURE) {
+            fprintf(stderr, "The seed is not valid.\n");
+            free(server_flags);
+            return EXIT_FAILURE;
+        }
+        set_fixed_game_seed(seed);
+    }
+    if (server_flags->record_directory != NULL) {
+        set_record_directory(server_flags->record_directory);
+    }
+    if (netem_configure_from_env() == EXIT_FAILURE) {
+        free(server_flags);
+        return EXIT_FAILURE;
+    }
+    // Before any other thread is created, so that they all leave SIGUSR1 to the thread writing the trace
+    if (server_flags->trace_path != NULL) {
+        if (trace_dump_on_signal(server_flags->trace_path) == EXIT_FAILURE) {
+            free(server_flags);
+            return EXIT_FAILURE;
+        }
+        trace_enable();
+    }
+    if (log_start() == EXIT_FAILURE) {
+        free(server_flags);
+        return EXIT_FAILURE;
+    }
+    if (server_flags->multicast_interfaces != NULL &&
+        set_multicast_interfaces(server_flags->multicast_interfaces) == EXIT_FAILURE) {
+        free(server_flags);
+        return EXIT_FAILURE;
+    }
+    if (server_flags->delivery != NULL) {
+        if (strcmp(server_flags->delivery, "unicast") == 0) {
+            set_unicast_delivery(true);
+        } else if (strcmp(server_flags->delivery, "multicast") != 0) {
+            fprintf(stderr, "The delivery has to be multicast or unicast.\n");
+            free(server_flags);
+            return EXIT_FAILURE;
+        }
+    }
+    if (server_flags->interest_radius != NULL) {
+        int radius = parse_unsigned_within_bounds(server_flags->interest_radius, 0, UINT8_MAX);
+        if (radius < 0) {
+            fprintf(stderr, "The radius of the area of interest is not valid.\n");
+            free(server_flags);
+            return EXIT_FAILURE;
+        }
+        set_interest_radius(radius);
+    }
+    if (server_flags->action_rate != NULL) {
+        int rate = parse_unsigned_within_bounds(server_flags->action_rate, 1, MAX_ACTION_RATE);
+        if (rate < 0) {
+            fprintf(stderr, "The rate of game actions is not valid.\n");
+            free(server_flags);
+            return EXIT_FAILURE;
+        }
+        set_action_rate_limit(rate);
+    }
+    if (server_flags->wide_game_players != NULL) {
+        int nb = parse_unsigned_within_bounds(server_flags->wide_game_players, 2, MAX_PLAYER_NUM);
+        if (nb < 0 || set_wide_game_players(nb) == EXIT_FAILURE) {
+            fprintf(stderr, "The number of players of the games of the second version is not valid.\n");
+            free(server_flags);
+            return EXIT_FAILURE;
+        }
+    }
+    // After the number of players, which the boards are checked for
+    for (unsigned i = 0; i < server_flags->nb_match_settings; i++) {
+        if (set_match_settings(server_flags->match_settings[i]) == EXIT_FAILURE) {
+            fprintf(stderr, "-G [GAMES:]SETTINGS sets the settings of every match of the types of games GAMES, solo, "
+                            "team, v1, v2 or both as team.v2, with SETTINGS as tick=30,snapshot=500,bomb=2000,"
+                            "width=41,height=21.\n");
+            free(server_flags);
+            return EXIT_FAILURE;
+        }
+    }
+    if (server_flags->metrics_path != NULL && metrics_start_writer(server_flags->metrics_path) == EXIT_FAILURE) {
+        free(server_flags);
+        return EXIT_FAILURE;
+    }
     free(server_flags);
 
     RETURN_FAILURE_IF_ERROR(init_socket_tcp());
-
-    init_state(connexion_port);
     RETURN_FAILURE_IF_ERROR(game_loop_server());
 }
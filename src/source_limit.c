@@ -0,0 +1,36 @@
+#include "./source_limit.h"
+
+#include <string.h>
+
+/** Mixes the bits of x, the finalizer of MurmurHash3
+ */
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static token_bucket *bucket_of(source_limits *limits, const struct sockaddr_in6 *from) {
+    uint64_t prefix;
+    uint64_t interface;
+    memcpy(&prefix, from->sin6_addr.s6_addr, sizeof(uint64_t));
+    memcpy(&interface, from->sin6_addr.s6_addr + sizeof(uint64_t), sizeof(uint64_t));
+    uint64_t hash = mix(limits->key ^ prefix);
+    hash = mix(hash ^ interface);
+    hash = mix(hash ^ from->sin6_port);
+    return &limits->buckets[hash % SOURCE_LIMIT_BUCKETS];
+}
+
+void source_limits_init(source_limits *limits, uint64_t key, unsigned rate, unsigned burst, uint64_t now_us) {
+    limits->key = key;
+    for (unsigned i = 0; i < SOURCE_LIMIT_BUCKETS; i++) {
+        token_bucket_init(&limits->buckets[i], rate, burst, now_us);
+    }
+}
+
+bool source_limits_take(source_limits *limits, const struct sockaddr_in6 *from, uint64_t now_us) {
+    return token_bucket_take(bucket_of(limits, from), now_us);
+}
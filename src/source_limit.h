@@ -0,0 +1,30 @@
+#ifndef SRC_SOURCE_LIMIT_H_
+#define SRC_SOURCE_LIMIT_H_
+
+#include "./token_bucket.h"
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Rate limits of the datagrams coming to a game from each source, an address and a port. The sources share a fixed
+ *  table of buckets, the bucket of a source being chosen by a keyed hash of it, so that a host sending from ever new
+ *  sources only gets the tokens left in the buckets they fall on instead of a full burst for each one.
+ */
+
+#define SOURCE_LIMIT_BUCKETS 256 // Two players fall on the same bucket once in 256, and then share its rate
+
+typedef struct source_limits {
+    uint64_t key; // Of the hash, so that a host cannot choose sources falling on the bucket of a player
+    token_bucket buckets[SOURCE_LIMIT_BUCKETS];
+} source_limits;
+
+/** Starts every bucket full at now_us, letting through rate datagrams per second in bursts of up to burst
+ */
+void source_limits_init(source_limits *limits, uint64_t key, unsigned rate, unsigned burst, uint64_t now_us);
+
+/** Returns true and takes a token from the bucket of the source from if it has one at now_us
+ */
+bool source_limits_take(source_limits *limits, const struct sockaddr_in6 *from, uint64_t now_us);
+
+#endif // SRC_SOURCE_LIMIT_H_
@@ -0,0 +1,334 @@
+#include "./tcp_output.h"
+#include "./log.h"
+#include "./utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TCP_OUTPUT_IOV_MAX 64
+#define TCP_OUTPUT_POLL_MS 1000
+
+static void free_queue_messages(tcp_output *out, tcp_output_queue *q) {
+    tcp_output_message *m = q->head;
+    while (m != NULL) {
+        tcp_output_message *next = m->next;
+        free(m->data);
+        free(m);
+        m = next;
+    }
+    METRICS_SUB(out->metrics, tcp_queued_bytes, q->queued);
+    q->head = NULL;
+    q->tail = NULL;
+    q->head_offset = 0;
+    q->queued = 0;
+}
+
+/** Shuts the socket of the client down, its TCP thread sees the connection closed and the socket is closed there
+ */
+static void disconnect_queue(tcp_output *out, tcp_output_queue *q) {
+    if (q->sock != -1) {
+        shutdown(q->sock, SHUT_RDWR);
+        q->sock = -1;
+        METRICS_ADD(out->metrics, tcp_disconnected, 1);
+    }
+    free_queue_messages(out, q);
+}
+
+static void wake_thread(tcp_output *out) {
+    char c = 0;
+    if (write(out->wake_pipe[1], &c, 1) < 0 && errno != EAGAIN) {
+        LOG_ERRNO("write tcp_output wake pipe");
+    }
+}
+
+static bool are_queues_empty(tcp_output *out) {
+    for (int i = 0; i < MAX_PLAYER_NUM; i++) {
+        if (out->queues[i].head != NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Writes as much of the queue as the socket accepts without blocking, the lock has to be held
+ */
+static void write_queue(tcp_output *out, tcp_output_queue *q, uint64_t now_ms) {
+    struct iovec iov[TCP_OUTPUT_IOV_MAX];
+    int nb_iov = 0;
+    for (tcp_output_message *m = q->head; m != NULL && nb_iov < TCP_OUTPUT_IOV_MAX; m = m->next) {
+        size_t offset = nb_iov == 0 ? q->head_offset : 0;
+        iov[nb_iov].iov_base = m->data + offset;
+        iov[nb_iov].iov_len = m->size - offset;
+        nb_iov++;
+    }
+    if (nb_iov == 0) {
+        return;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = nb_iov;
+
+    ssize_t res = sendmsg(q->sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (res < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            LOG_ERRNO("sendmsg tcp_output");
+            disconnect_queue(out, q);
+        }
+        return;
+    }
+
+    q->queued -= res;
+    q->last_progress_ms = now_ms;
+    METRICS_SUB(out->metrics, tcp_queued_bytes, res);
+    METRICS_ADD(out->metrics, tcp_bytes, res);
+    while (res > 0) {
+        size_t left = q->head->size - q->head_offset;
+        if ((size_t)res < left) {
+            q->head_offset += res;
+            break;
+        }
+        res -= left;
+        tcp_output_message *m = q->head;
+        q->head = m->next;
+        q->head_offset = 0;
+        free(m->data);
+        free(m);
+    }
+    if (q->head == NULL) {
+        q->tail = NULL;
+    }
+}
+
+static void *serve_tcp_output(void *arg) {
+    tcp_output *out = (tcp_output *)arg;
+    struct pollfd polls[MAX_PLAYER_NUM + 1];
+    int ids[MAX_PLAYER_NUM + 1];
+
+    while (true) {
+        pthread_mutex_lock(&out->lock);
+        if (out->stopping) {
+            pthread_mutex_unlock(&out->lock);
+            break;
+        }
+        unsigned nb_polls = 1;
+        polls[0].fd = out->wake_pipe[0];
+        polls[0].events = POLLIN;
+        for (int i = 0; i < MAX_PLAYER_NUM; i++) {
+            if (out->queues[i].sock != -1 && out->queues[i].head != NULL) {
+                polls[nb_polls].fd = out->queues[i].sock;
+                polls[nb_polls].events = POLLOUT;
+                ids[nb_polls] = i;
+                nb_polls++;
+            }
+        }
+        pthread_mutex_unlock(&out->lock);
+
+        // The timeout is only needed to notice the stalled clients
+        if (poll(polls, nb_polls, nb_polls > 1 ? TCP_OUTPUT_POLL_MS : -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERRNO("poll tcp_output");
+            break;
+        }
+
+        if (polls[0].revents & POLLIN) {
+            char buffer[64];
+            while (read(out->wake_pipe[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+
+        pthread_mutex_lock(&out->lock);
+        uint64_t now_ms = get_time_ms();
+        for (unsigned p = 1; p < nb_polls; p++) {
+            tcp_output_queue *q = &out->queues[ids[p]];
+            // The socket may have been removed while polling
+            if (q->sock == polls[p].fd && (polls[p].revents & (POLLOUT | POLLERR | POLLHUP))) {
+                write_queue(out, q, now_ms);
+            }
+        }
+        for (int i = 0; i < MAX_PLAYER_NUM; i++) {
+            tcp_output_queue *q = &out->queues[i];
+            if (q->head != NULL && now_ms - q->last_progress_ms >= TCP_OUTPUT_STALL_MS) {
+                LOG_WARNING("Client %d does not read its messages, it is disconnected.", i);
+                disconnect_queue(out, q);
+            }
+        }
+        if (are_queues_empty(out)) {
+            pthread_cond_broadcast(&out->cond_flushed);
+        }
+        pthread_mutex_unlock(&out->lock);
+    }
+    return NULL;
+}
+
+static int init_wake_pipe(tcp_output *out) {
+    RETURN_FAILURE_IF_NEG_PERROR(pipe(out->wake_pipe), "pipe tcp_output");
+    for (int i = 0; i < 2; i++) {
+        int flags = fcntl(out->wake_pipe[i], F_GETFL);
+        if (flags < 0 || fcntl(out->wake_pipe[i], F_SETFL, flags | O_NONBLOCK) < 0) {
+            LOG_ERRNO("fcntl tcp_output");
+            close(out->wake_pipe[0]);
+            close(out->wake_pipe[1]);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+tcp_output *tcp_output_start(size_t max_queued, match_metrics *metrics) {
+    tcp_output *out = malloc(sizeof(tcp_output));
+    RETURN_NULL_IF_NULL_PERROR(out, "malloc tcp_output");
+
+    for (int i = 0; i < MAX_PLAYER_NUM; i++) {
+        out->queues[i].sock = -1;
+        out->queues[i].head = NULL;
+        out->queues[i].tail = NULL;
+        out->queues[i].head_offset = 0;
+        out->queues[i].queued = 0;
+        out->queues[i].last_progress_ms = 0;
+    }
+    out->max_queued = max_queued;
+    out->metrics = metrics;
+    out->stopping = false;
+
+    if (init_wake_pipe(out) == EXIT_FAILURE) {
+        free(out);
+        return NULL;
+    }
+    pthread_mutex_init(&out->lock, NULL);
+    pthread_cond_init(&out->cond_flushed, NULL);
+
+    if (pthread_create(&out->thread, NULL, serve_tcp_output, out) != 0) {
+        LOG_ERRNO("pthread_create tcp_output");
+        close(out->wake_pipe[0]);
+        close(out->wake_pipe[1]);
+        pthread_mutex_destroy(&out->lock);
+        pthread_cond_destroy(&out->cond_flushed);
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+void tcp_output_stop(tcp_output *out) {
+    RETURN_IF_NULL(out);
+
+    pthread_mutex_lock(&out->lock);
+    out->stopping = true;
+    pthread_mutex_unlock(&out->lock);
+    wake_thread(out);
+    pthread_join(out->thread, NULL);
+
+    for (int i = 0; i < MAX_PLAYER_NUM; i++) {
+        free_queue_messages(out, &out->queues[i]);
+    }
+    close(out->wake_pipe[0]);
+    close(out->wake_pipe[1]);
+    pthread_mutex_destroy(&out->lock);
+    pthread_cond_destroy(&out->cond_flushed);
+    free(out);
+}
+
+void tcp_output_set_socket(tcp_output *out, int id, int sock) {
+    RETURN_IF_NULL(out);
+    if (id < 0 || id >= MAX_PLAYER_NUM) {
+        return;
+    }
+
+    pthread_mutex_lock(&out->lock);
+    free_queue_messages(out, &out->queues[id]);
+    out->queues[id].sock = sock;
+    pthread_mutex_unlock(&out->lock);
+}
+
+void tcp_output_remove_socket(tcp_output *out, int id) {
+    RETURN_IF_NULL(out);
+    if (id < 0 || id >= MAX_PLAYER_NUM) {
+        return;
+    }
+
+    pthread_mutex_lock(&out->lock);
+    free_queue_messages(out, &out->queues[id]);
+    out->queues[id].sock = -1;
+    pthread_mutex_unlock(&out->lock);
+}
+
+int tcp_output_send(tcp_output *out, int id, const char *data, size_t size) {
+    RETURN_FAILURE_IF_NULL(out);
+    if (id < 0 || id >= MAX_PLAYER_NUM) {
+        return EXIT_FAILURE;
+    }
+
+    tcp_output_message *m = malloc(sizeof(tcp_output_message));
+    RETURN_FAILURE_IF_NULL_PERROR(m, "malloc tcp_output_message");
+    m->data = malloc(size);
+    if (m->data == NULL) {
+        LOG_ERRNO("malloc tcp_output_message data");
+        free(m);
+        return EXIT_FAILURE;
+    }
+    memcpy(m->data, data, size);
+    m->size = size;
+    m->next = NULL;
+
+    pthread_mutex_lock(&out->lock);
+    tcp_output_queue *q = &out->queues[id];
+    if (q->sock == -1 || q->queued + size > out->max_queued) {
+        if (q->sock != -1) {
+            LOG_WARNING("Client %d has too many messages waiting, it is disconnected.", id);
+            disconnect_queue(out, q);
+        }
+        pthread_mutex_unlock(&out->lock);
+        free(m->data);
+        free(m);
+        return EXIT_FAILURE;
+    }
+
+    if (q->head == NULL) {
+        q->head = m;
+        q->last_progress_ms = get_time_ms();
+    } else {
+        q->tail->next = m;
+    }
+    q->tail = m;
+    q->queued += size;
+    METRICS_ADD(out->metrics, tcp_queued_bytes, size);
+    pthread_mutex_unlock(&out->lock);
+
+    wake_thread(out);
+    return EXIT_SUCCESS;
+}
+
+int tcp_output_flush(tcp_output *out, int timeout_ms) {
+    RETURN_FAILURE_IF_NULL(out);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    int res = EXIT_SUCCESS;
+    pthread_mutex_lock(&out->lock);
+    while (!are_queues_empty(out)) {
+        if (pthread_cond_timedwait(&out->cond_flushed, &out->lock, &deadline) == ETIMEDOUT) {
+            res = are_queues_empty(out) ? EXIT_SUCCESS : EXIT_FAILURE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&out->lock);
+    return res;
+}
@@ -0,0 +1,72 @@
+#ifndef SRC_TCP_OUTPUT_H_
+#define SRC_TCP_OUTPUT_H_
+
+#include "./constants.h"
+#include "./metrics.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Output queues of the TCP connections of a game: a message to a client is copied in the queue of the client and
+ *  written by the thread of the queues when the socket is writable, so that a client which does not read its socket
+ *  never blocks the thread sending to it.
+ *  A client is disconnected (its socket is shut down, not closed) when its queue grows over max_queued bytes or when
+ *  nothing could be written to it during TCP_OUTPUT_STALL_MS. The games add to TCP_OUTPUT_MAX_QUEUED the room of the
+ *  keyframes of their board, which can be as large as a datagram.
+ */
+
+#define TCP_OUTPUT_MAX_QUEUED (64 * 1024)
+#define TCP_OUTPUT_STALL_MS 5000
+
+typedef struct tcp_output_message {
+    char *data;
+    size_t size;
+    struct tcp_output_message *next;
+} tcp_output_message;
+
+typedef struct tcp_output_queue {
+    int sock; // -1 if there is no client or if it was disconnected
+    tcp_output_message *head;
+    tcp_output_message *tail;
+    size_t head_offset; // Bytes of the head already written
+    size_t queued;      // Bytes left to write
+    uint64_t last_progress_ms;
+} tcp_output_queue;
+
+typedef struct tcp_output {
+    tcp_output_queue queues[MAX_PLAYER_NUM];
+    size_t max_queued;
+    match_metrics *metrics; // NULL if the game has no metrics
+    bool stopping;
+    int wake_pipe[2];
+    pthread_mutex_t lock;
+    pthread_cond_t cond_flushed;
+    pthread_t thread;
+} tcp_output;
+
+/** Creates the queues without any client and starts their thread, the queued and written bytes are counted in metrics
+ *  if it is not NULL
+ */
+tcp_output *tcp_output_start(size_t max_queued, match_metrics *metrics);
+
+/** Stops the thread and frees the queues, the messages not written yet are lost and the sockets are not closed
+ */
+void tcp_output_stop(tcp_output *);
+
+void tcp_output_set_socket(tcp_output *, int id, int sock);
+
+/** Forgets the socket of the client and its queue, to call before closing the socket
+ */
+void tcp_output_remove_socket(tcp_output *, int id);
+
+/** Queues a copy of the message for the client, returns EXIT_FAILURE if the client is not connected or was too slow
+ */
+int tcp_output_send(tcp_output *, int id, const char *data, size_t size);
+
+/** Waits until all the queues are empty or timeout_ms has passed, returns EXIT_FAILURE on timeout
+ */
+int tcp_output_flush(tcp_output *, int timeout_ms);
+
+#endif // SRC_TCP_OUTPUT_H_
@@ -0,0 +1,134 @@
+#include "./tcp_reader.h"
+#include "./messages.h"
+#include "./utils.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#define TCP_READER_INITIAL_CAPACITY 4096
+
+tcp_reader *create_tcp_reader(int sock) {
+    tcp_reader *reader = malloc(sizeof(tcp_reader));
+    RETURN_NULL_IF_NULL_PERROR(reader, "malloc tcp_reader");
+
+    reader->buffer = malloc(TCP_READER_INITIAL_CAPACITY);
+    if (reader->buffer == NULL) {
+        perror("malloc tcp_reader buffer");
+        free(reader);
+        return NULL;
+    }
+    reader->sock = sock;
+    reader->capacity = TCP_READER_INITIAL_CAPACITY;
+    reader->start = 0;
+    reader->end = 0;
+    return reader;
+}
+
+void free_tcp_reader(tcp_reader *reader) {
+    RETURN_IF_NULL(reader);
+    free(reader->buffer);
+    free(reader);
+}
+
+/** Moves the pending bytes to the start of the buffer, and makes it large enough for the pending message
+ */
+static int make_room(tcp_reader *reader) {
+    size_t pending = reader->end - reader->start;
+    if (reader->start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start, pending);
+        reader->start = 0;
+        reader->end = pending;
+    }
+
+    size_t needed = pending + 1;
+    long length = message_frame_length(reader->buffer, pending);
+    if (length > 0 && (size_t)length > needed) {
+        needed = length;
+    }
+    if (needed <= reader->capacity) {
+        return EXIT_SUCCESS;
+    }
+
+    size_t capacity = reader->capacity;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    char *buffer = realloc(reader->buffer, capacity);
+    RETURN_FAILURE_IF_NULL_PERROR(buffer, "realloc tcp_reader buffer");
+    reader->buffer = buffer;
+    reader->capacity = capacity;
+    return EXIT_SUCCESS;
+}
+
+ssize_t tcp_reader_fill(tcp_reader *reader) {
+    if (make_room(reader) == EXIT_FAILURE) {
+        return -1;
+    }
+
+    ssize_t res;
+    do {
+        res = recv(reader->sock, reader->buffer + reader->end, reader->capacity - reader->end, 0);
+    } while (res < 0 && errno == EINTR);
+
+    if (res > 0) {
+        reader->end += res;
+    }
+    return res;
+}
+
+int tcp_reader_next(tcp_reader *reader, const char **message, size_t *size) {
+    size_t pending = reader->end - reader->start;
+    long length = message_frame_length(reader->buffer + reader->start, pending);
+    if (length < 0) {
+        return -1;
+    }
+    if (length == 0 || (size_t)length > pending) {
+        return 0;
+    }
+
+    *message = reader->buffer + reader->start;
+    *size = length;
+    reader->start += length;
+    return 1;
+}
+
+int tcp_reader_wait_next(tcp_reader *reader, const char **message, size_t *size) {
+    while (true) {
+        int res = tcp_reader_next(reader, message, size);
+        if (res != 0) {
+            return res;
+        }
+        if (tcp_reader_fill(reader) <= 0) {
+            return -1;
+        }
+    }
+}
+
+int tcp_reader_wait_next_timeout(tcp_reader *reader, const char **message, size_t *size, int timeout_ms) {
+    uint64_t deadline_ms = get_time_ms() + timeout_ms;
+    while (true) {
+        int res = tcp_reader_next(reader, message, size);
+        if (res != 0) {
+            return res;
+        }
+        uint64_t now_ms = get_time_ms();
+        if (now_ms >= deadline_ms) {
+            return 0;
+        }
+        struct pollfd p = {reader->sock, POLLIN, 0};
+        int ready = poll(&p, 1, deadline_ms - now_ms);
+        if (ready < 0 && errno != EINTR) {
+            return -1;
+        }
+        if (ready > 0 && tcp_reader_fill(reader) <= 0) {
+            return -1;
+        }
+    }
+}
+
+void tcp_reader_unread(tcp_reader *reader, size_t size) {
+    reader->start -= size;
+}
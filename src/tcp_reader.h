@@ -0,0 +1,48 @@
+#ifndef SRC_TCP_READER_H_
+#define SRC_TCP_READER_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/** Read buffer of a TCP connection: a single recv reads everything available on the socket, and the complete messages
+ *  are then taken from the buffer one by one, without copy, using message_frame_length to find where they end.
+ */
+typedef struct tcp_reader {
+    int sock;
+    char *buffer;
+    size_t capacity;
+    size_t start; // First byte of the next message
+    size_t end;   // End of the received bytes
+} tcp_reader;
+
+tcp_reader *create_tcp_reader(int sock);
+
+void free_tcp_reader(tcp_reader *);
+
+/** Receives what is available on the socket with a single recv, which blocks if nothing is available.
+ *  Returns the number of bytes received, 0 if the connection is closed and -1 on error.
+ */
+ssize_t tcp_reader_fill(tcp_reader *);
+
+/** Takes the next message of the buffer: message points to it in the buffer, until the next tcp_reader_fill, and size
+ *  is set to its size.
+ *  Returns 1 if there was a complete message, 0 if more bytes are needed and -1 if the bytes are not a message.
+ */
+int tcp_reader_next(tcp_reader *, const char **message, size_t *size);
+
+/** Same as tcp_reader_next but receives bytes until there is a complete message, returns -1 if the connection is
+ *  closed before
+ */
+int tcp_reader_wait_next(tcp_reader *, const char **message, size_t *size);
+
+/** Same as tcp_reader_wait_next but waits at most timeout_ms for the bytes of the message, returns 0 if they did not
+ *  all come in time
+ */
+int tcp_reader_wait_next_timeout(tcp_reader *, const char **message, size_t *size, int timeout_ms);
+
+/** Gives back the message of size bytes taken last, the next call takes it again. Only valid before the next
+ *  tcp_reader_fill.
+ */
+void tcp_reader_unread(tcp_reader *, size_t size);
+
+#endif // SRC_TCP_READER_H_
@@ -0,0 +1,28 @@
+#include "./token_bucket.h"
+
+#define TOKEN 1000000
+
+void token_bucket_init(token_bucket *bucket, unsigned rate, unsigned burst, uint64_t now_us) {
+    bucket->rate = rate;
+    bucket->burst = burst;
+    bucket->tokens = (uint64_t)burst * TOKEN;
+    bucket->last_us = now_us;
+}
+
+bool token_bucket_take(token_bucket *bucket, uint64_t now_us) {
+    uint64_t max = (uint64_t)bucket->burst * TOKEN;
+    if (now_us > bucket->last_us) {
+        uint64_t elapsed_us = now_us - bucket->last_us;
+        // rate tokens per second are rate millionths of a token per microsecond
+        bucket->tokens = elapsed_us >= max ? max : bucket->tokens + elapsed_us * bucket->rate;
+        if (bucket->tokens > max) {
+            bucket->tokens = max;
+        }
+        bucket->last_us = now_us;
+    }
+    if (bucket->tokens < TOKEN) {
+        return false;
+    }
+    bucket->tokens -= TOKEN;
+    return true;
+}
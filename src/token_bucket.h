@@ -0,0 +1,24 @@
+#ifndef SRC_TOKEN_BUCKET_H_
+#define SRC_TOKEN_BUCKET_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Rate limit letting through rate events per second on average, at least 1, and bursts of up to burst events
+ */
+typedef struct token_bucket {
+    unsigned rate;
+    unsigned burst;
+    uint64_t tokens; // In millionths of a token, so that a few microseconds add some
+    uint64_t last_us;
+} token_bucket;
+
+/** Starts the bucket full at now_us
+ */
+void token_bucket_init(token_bucket *bucket, unsigned rate, unsigned burst, uint64_t now_us);
+
+/** Returns true and takes a token if the bucket has one at now_us, never earlier than the previous call
+ */
+bool token_bucket_take(token_bucket *bucket, uint64_t now_us);
+
+#endif // SRC_TOKEN_BUCKET_H_
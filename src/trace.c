@@ -0,0 +1,164 @@
+#include "./trace.h"
+#include "./utils.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAX_THREADS 1024
+#define TRACE_THREAD_NAME_SIZE 32
+
+typedef struct trace_event {
+    atomic_uint_fast64_t seq; // Index of the event plus one once it is complete, 0 while it is written
+    const char *name;
+    int game_id;
+    int thread_id;
+    uint64_t start_us;
+    uint64_t duration_us;
+} trace_event;
+
+static atomic_bool enabled = false;
+
+static trace_event ring[TRACE_RING_SIZE];
+static atomic_uint_fast64_t next_event = 0;
+
+static atomic_int next_thread_id = 0;
+static _Thread_local int thread_id = -1;
+static char thread_names[TRACE_MAX_THREADS][TRACE_THREAD_NAME_SIZE];
+
+static char *dump_path = NULL;
+
+void trace_enable() {
+    atomic_store(&enabled, true);
+}
+
+static int get_thread_id() {
+    if (thread_id == -1) {
+        thread_id = atomic_fetch_add(&next_thread_id, 1);
+    }
+    return thread_id;
+}
+
+void trace_thread_name(const char *name) {
+    if (!atomic_load_explicit(&enabled, memory_order_relaxed)) {
+        return;
+    }
+    int id = get_thread_id();
+    if (id < TRACE_MAX_THREADS) {
+        snprintf(thread_names[id], TRACE_THREAD_NAME_SIZE, "%s", name);
+    }
+}
+
+uint64_t trace_begin() {
+    if (!atomic_load_explicit(&enabled, memory_order_relaxed)) {
+        return 0;
+    }
+    return get_time_us();
+}
+
+void trace_end(const char *name, int game_id, uint64_t start_us) {
+    if (start_us == 0) {
+        return;
+    }
+    uint64_t now_us = get_time_us();
+
+    uint64_t index = atomic_fetch_add_explicit(&next_event, 1, memory_order_relaxed);
+    trace_event *event = &ring[index % TRACE_RING_SIZE];
+    atomic_store_explicit(&event->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    event->name = name;
+    event->game_id = game_id;
+    event->thread_id = get_thread_id();
+    event->start_us = start_us;
+    event->duration_us = now_us - start_us;
+    atomic_store_explicit(&event->seq, index + 1, memory_order_release);
+}
+
+int trace_write(FILE *file) {
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+
+    int nb_threads = atomic_load(&next_thread_id);
+    for (int i = 0; i < nb_threads && i < TRACE_MAX_THREADS; i++) {
+        if (thread_names[i][0] == '\0') {
+            continue;
+        }
+        fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",", i, thread_names[i]);
+        first = false;
+    }
+
+    uint64_t end = atomic_load(&next_event);
+    uint64_t begin = end > TRACE_RING_SIZE ? end - TRACE_RING_SIZE : 0;
+    for (uint64_t index = begin; index < end; index++) {
+        trace_event *event = &ring[index % TRACE_RING_SIZE];
+        if (atomic_load_explicit(&event->seq, memory_order_acquire) != index + 1) {
+            continue; // Being written, or already replaced by a newer event
+        }
+        trace_event copy;
+        copy.name = event->name;
+        copy.game_id = event->game_id;
+        copy.thread_id = event->thread_id;
+        copy.start_us = event->start_us;
+        copy.duration_us = event->duration_us;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&event->seq, memory_order_relaxed) != index + 1) {
+            continue;
+        }
+
+        fprintf(file,
+                "%s\n{\"name\":\"%s\",\"cat\":\"game\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%" PRIu64
+                ",\"dur\":%" PRIu64 ",\"args\":{\"game\":%d}}",
+                first ? "" : ",", copy.name, copy.thread_id, copy.start_us, copy.duration_us, copy.game_id);
+        first = false;
+    }
+
+    fprintf(file, "\n]}\n");
+    return ferror(file) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void *serve_trace_dump(void *arg) {
+    sigset_t *set = (sigset_t *)arg;
+    while (true) {
+        int sig;
+        if (sigwait(set, &sig) != 0) {
+            continue;
+        }
+        FILE *file = fopen(dump_path, "w");
+        if (file == NULL) {
+            perror("fopen trace");
+            continue;
+        }
+        trace_write(file);
+        fclose(file);
+        printf("Trace written in %s.\n", dump_path);
+    }
+    return NULL;
+}
+
+int trace_dump_on_signal(const char *path) {
+    static sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) {
+        perror("pthread_sigmask trace");
+        return EXIT_FAILURE;
+    }
+
+    dump_path = strdup(path);
+    RETURN_FAILURE_IF_NULL_PERROR(dump_path, "strdup trace path");
+
+    pthread_t t;
+    if (pthread_create(&t, NULL, serve_trace_dump, &set) != 0) {
+        perror("pthread_create trace");
+        free(dump_path);
+        dump_path = NULL;
+        return EXIT_FAILURE;
+    }
+    pthread_detach(t);
+    return EXIT_SUCCESS;
+}
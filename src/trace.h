@@ -0,0 +1,39 @@
+#ifndef SRC_TRACE_H_
+#define SRC_TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** Tracing of the phases of the game threads, in a ring buffer keeping the last TRACE_RING_SIZE events.
+ *  The events are written in the Chrome trace-event format (JSON), to open them in chrome://tracing or Perfetto.
+ *  When tracing is not enabled, trace_begin returns 0 and trace_end does nothing.
+ */
+
+#define TRACE_RING_SIZE (1 << 16)
+
+/** Starts recording the events
+ */
+void trace_enable();
+
+/** Blocks SIGUSR1 in the calling thread and the threads it creates later, and starts a thread writing the ring buffer
+ *  to the file at path each time the server receives SIGUSR1. To call before creating any other thread.
+ */
+int trace_dump_on_signal(const char *path);
+
+/** Names the calling thread in the trace
+ */
+void trace_thread_name(const char *name);
+
+/** Returns the start time of an event, in microseconds, or 0 if tracing is not enabled
+ */
+uint64_t trace_begin();
+
+/** Records an event of the game started at start_us by trace_begin and ending now, name has to be a constant string
+ */
+void trace_end(const char *name, int game_id, uint64_t start_us);
+
+/** Writes the events of the ring buffer, from the oldest, as a trace-event JSON object
+ */
+int trace_write(FILE *file);
+
+#endif // SRC_TRACE_H_
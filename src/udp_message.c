@@ -0,0 +1,47 @@
+#include "./udp_message.h"
+#include "./log.h"
+#include "./utils.h"
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#define UDP_MESSAGE_MAX_SIZE PONG_SIZE // The longest datagram of a player, longer than a batch of actions
+_Static_assert(GAME_ACTION_BATCH_MAX * GAME_ACTION_SIZE <= UDP_MESSAGE_MAX_SIZE, "batch of actions truncated");
+_Static_assert(UDP_SUBSCRIBE_SIZE <= UDP_MESSAGE_MAX_SIZE, "subscription truncated");
+
+int recv_udp_message(int sock, PROTOCOL_VERSION version, unsigned nb_players, udp_message *message) {
+    char raw[UDP_MESSAGE_MAX_SIZE];
+    socklen_t from_len = sizeof(struct sockaddr_in6);
+    ssize_t res = recvfrom(sock, raw, sizeof(raw), 0, (struct sockaddr *)&message->from, &from_len);
+    message->received_us = get_wall_time_us();
+    if (res < 0) {
+        LOG_ERRNO("recvfrom udp message");
+        return EXIT_FAILURE;
+    }
+    if (res < (ssize_t)sizeof(uint16_t) || message->from.sin6_family != AF_INET6) {
+        return EXIT_FAILURE;
+    }
+
+    uint16_t raw_header;
+    memcpy(&raw_header, raw, sizeof(uint16_t));
+    message_header header = read_message_header(raw_header);
+    message->id = header.id;
+    message->nb_actions = 0;
+    // The id indexes the arrays of the players of the game
+    if (header.id >= (int)nb_players || (version == PROTOCOL_V1 && (ntohs(raw_header) & PROTOCOL_V2_FLAG))) {
+        return EXIT_FAILURE;
+    }
+    if (header.codereq == UDP_SUBSCRIBE_CODE) {
+        message->type = UDP_SUBSCRIPTION;
+        return read_subscription(raw, res, &message->subscription);
+    }
+    if (header.codereq == PONG_CODE) {
+        message->type = UDP_PONG;
+        return read_pong(raw, res, &message->pong);
+    }
+    message->type = UDP_GAME_ACTION;
+    message->nb_actions = deserialize_game_action_batch(raw, res, message->actions);
+    return message->nb_actions == 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
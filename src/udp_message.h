@@ -0,0 +1,30 @@
+#ifndef SRC_UDP_MESSAGE_H_
+#define SRC_UDP_MESSAGE_H_
+
+#include "./messages.h"
+
+#include <netinet/in.h>
+#include <stdint.h>
+
+typedef enum udp_message_type { UDP_GAME_ACTION, UDP_SUBSCRIPTION, UDP_PONG } udp_message_type;
+
+/** Datagram received from a player on the UDP port of a game
+ */
+typedef struct udp_message {
+    udp_message_type type;
+    game_action *actions[GAME_ACTION_BATCH_MAX]; // Only for UDP_GAME_ACTION, to free, the latest one last
+    unsigned nb_actions;
+    pong_message pong;                 // Only for UDP_PONG
+    subscription_message subscription; // Only for UDP_SUBSCRIPTION
+    int id;                            // Player who sent the datagram
+    struct sockaddr_in6 from;
+    uint64_t received_us; // Wall clock
+} udp_message;
+
+/** Receives the next datagram of a player of a game of nb_players with the version of the protocol, returns
+ *  EXIT_FAILURE if it could not be received or is not valid. A datagram of an id the game does not have, or in the
+ *  layout of the second version in a game of the first one, is not valid.
+ */
+int recv_udp_message(int sock, PROTOCOL_VERSION version, unsigned nb_players, udp_message *message);
+
+#endif // SRC_UDP_MESSAGE_H_
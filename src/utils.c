@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 int min(int a, int b) {
     return a < b ? a : b;
@@ -61,3 +62,48 @@ exit_freeing_addr_string:
     perror("sprintf addr_string");
     return NULL;
 }
+
+uint64_t get_time_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64_t get_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t get_wall_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void write_be16(unsigned char *buf, uint16_t v) {
+    buf[0] = v >> 8;
+    buf[1] = v & 0xFF;
+}
+
+void write_be32(unsigned char *buf, uint32_t v) {
+    write_be16(buf, v >> 16);
+    write_be16(buf + 2, v & 0xFFFF);
+}
+
+void write_be64(unsigned char *buf, uint64_t v) {
+    write_be32(buf, v >> 32);
+    write_be32(buf + 4, v & 0xFFFFFFFF);
+}
+
+uint16_t read_be16(const unsigned char *buf) {
+    return (buf[0] << 8) | buf[1];
+}
+
+uint32_t read_be32(const unsigned char *buf) {
+    return ((uint32_t)read_be16(buf) << 16) | read_be16(buf + 2);
+}
+
+uint64_t read_be64(const unsigned char *buf) {
+    return ((uint64_t)read_be32(buf) << 32) | read_be32(buf + 4);
+}
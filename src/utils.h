@@ -97,4 +97,25 @@ int parse_unsigned_within_bounds(const char *, unsigned, unsigned);
 
 char *convert_adrmdif_into_string(uint16_t adrmdiff_[8]);
 
+/** Returns the time of a monotonic clock in milliseconds
+ */
+uint64_t get_time_ms();
+
+/** Returns the time of a monotonic clock in microseconds
+ */
+uint64_t get_time_us();
+
+/** Returns the time of the wall clock in microseconds, the clock compared between two machines
+ */
+uint64_t get_wall_time_us();
+
+/** Writes and reads integers in network byte order (big-endian) at any address, aligned or not
+ */
+void write_be16(unsigned char *buf, uint16_t);
+void write_be32(unsigned char *buf, uint32_t);
+void write_be64(unsigned char *buf, uint64_t);
+uint16_t read_be16(const unsigned char *buf);
+uint32_t read_be32(const unsigned char *buf);
+uint64_t read_be64(const unsigned char *buf);
+
 #endif // SRC_UTILS_H_
@@ -19,6 +19,9 @@
 #define PADDING_PLAYABLE_TOP 2
 #define PADDING_PLAYABLE_LEFT 4
 
+// Define the minimum width left to the chat window by the game window of a wide board
+#define MIN_CHAT_WINDOW_WIDTH 40
+
 typedef struct window_context {
     dimension dim;
     int start_y;
@@ -38,16 +41,19 @@ static window_context *chat_input_wc;
 
 static const padding SCREEN_PADDING = {PADDING_SCREEN_TOP, PADDING_SCREEN_LEFT};
 
+// Dimension of the board the windows are laid out for, they are laid out again when the board received changes
+static dimension layout_dim;
+
 static void get_height_width_terminal(dimension *);
 static bool is_valid_terminal_size();
 
 // Helper functions for managing windows
-static int init_windows();
+static int init_windows(dimension);
 static void del_window(window_context *);
 static void del_all_windows();
 
 // Helper functions for splitting the terminal window
-static int split_terminal_window(window_context *, window_context *);
+static int split_terminal_window(window_context *, window_context *, dimension);
 static int split_chat_window(window_context *, window_context *, window_context *);
 
 // Helper functions for refreshing the game and chat windows
@@ -111,7 +117,9 @@ int init_view() {
         return EXIT_FAILURE;
     }
 
-    RETURN_FAILURE_IF_ERROR(init_windows()); // Initialize the windows
+    // Initialize the windows for the default board until the first board is received
+    dimension board_dim = {GAMEBOARD_WIDTH - 3, GAMEBOARD_HEIGHT - 2};
+    RETURN_FAILURE_IF_ERROR(init_windows(board_dim));
 
     return EXIT_SUCCESS;
 }
@@ -128,10 +136,11 @@ void get_height_width_terminal(dimension *dim) {
     }
 }
 
-void get_height_width_playable(dimension *dim, dimension scr_dim) {
+void get_height_width_playable(dimension *dim, dimension scr_dim, dimension board_dim) {
     if (dim != NULL) {
         dim->height = min(scr_dim.height, scr_dim.width); // 2/3 of the terminal height is customizable
-        dim->width = GAMEBOARD_WIDTH + 5;                 // 2:1 aspect ratio (ncurses characters are not square)
+        // The board, its borders and the box of the window, with some margin, leaving room for the chat window
+        dim->width = min(board_dim.width + 2 * PADDING_PLAYABLE_LEFT, scr_dim.width - MIN_CHAT_WINDOW_WIDTH);
     }
 }
 
@@ -142,21 +151,34 @@ void add_padding(dimension *dim, padding pad) {
     }
 }
 
-void get_computed_board_dimension(dimension *dim) {
+void get_computed_board_dimension(dimension *dim, dimension board_dim) {
     if (dim != NULL) {
         dimension scr_dim;
         get_height_width_terminal(&scr_dim);
-        get_height_width_playable(dim, scr_dim);
+        get_height_width_playable(dim, scr_dim, board_dim);
         padding pad;
-        pad.left = (dim->width - GAMEBOARD_WIDTH) / 2;
-        pad.top = (dim->height - GAMEBOARD_HEIGHT) / 2;
+        pad.left = (dim->width - board_dim.width) / 2;
+        pad.top = (dim->height - board_dim.height) / 2;
         add_padding(dim, pad);
         // add_padding(dim, PLAYABLE_PADDING);
         add_padding(dim, SCREEN_PADDING);
     }
 }
 
+/** Lays out the windows again for the board if its dimension changed since they were laid out
+ */
+static int layout_for_board(const board *b) {
+    if (b->dim.width == layout_dim.width && b->dim.height == layout_dim.height) {
+        return EXIT_SUCCESS;
+    }
+    del_all_windows();
+    erase(); // The windows of the previous layout are not drawn over everywhere
+    refresh();
+    return init_windows(b->dim);
+}
+
 void refresh_game(GAME_MODE game_mode, board *b, chat *c, int player_id) {
+    RETURN_IF_ERROR(layout_for_board(b));
     toggle_focus(c, game_wc, chat_history_wc, chat_input_wc);
     print_game(b, game_wc);
     wrefresh(game_wc->win); // Refresh the game window
@@ -180,14 +202,15 @@ bool is_valid_terminal_size() {
     return true;
 }
 
-int init_windows() {
+int init_windows(dimension board_dim) {
     game_wc = malloc(sizeof(window_context));
     chat_wc = malloc(sizeof(window_context));
     chat_history_wc = malloc(sizeof(window_context));
     chat_input_wc = malloc(sizeof(window_context));
 
-    RETURN_FAILURE_IF_ERROR(split_terminal_window(game_wc, chat_wc));
+    RETURN_FAILURE_IF_ERROR(split_terminal_window(game_wc, chat_wc, board_dim));
     RETURN_FAILURE_IF_ERROR(split_chat_window(chat_wc, chat_history_wc, chat_input_wc));
+    layout_dim = board_dim;
 
     return EXIT_SUCCESS;
 }
@@ -197,6 +220,10 @@ void del_all_windows() {
     del_window(chat_history_wc);
     del_window(chat_input_wc);
     del_window(chat_wc);
+    game_wc = NULL;
+    chat_wc = NULL;
+    chat_history_wc = NULL;
+    chat_input_wc = NULL;
 }
 
 void del_window(window_context *wc) {
@@ -208,14 +235,14 @@ void del_window(window_context *wc) {
     free(wc);
 }
 
-int split_terminal_window(window_context *game_wc, window_context *chat_wc) {
+int split_terminal_window(window_context *game_wc, window_context *chat_wc, dimension board_dim) {
     dimension scr_dim;
     get_height_width_terminal(&scr_dim);
     padding pad = {PADDING_SCREEN_TOP, PADDING_SCREEN_LEFT};
     add_padding(&scr_dim, pad);
     // Game window is a square occupying maximum right side of the terminal
     dimension game_dim;
-    get_height_width_playable(&game_dim, scr_dim);
+    get_height_width_playable(&game_dim, scr_dim, board_dim);
     game_wc->dim.height = game_dim.height;
     game_wc->dim.width = game_dim.width;
     game_wc->start_y = pad.top + (scr_dim.height - game_wc->dim.height) / 2; // Center the window vertically
@@ -321,6 +348,12 @@ void activate_color_for_tile(window_context *wc, TILE tile) {
             break;
         case EXPLOSION:
             break;
+        default:
+            // The players after the fourth take the colors of the first ones again
+            if (get_player_id(tile) != -1) {
+                wattron(wc->win, COLOR_PAIR(4 + get_player_id(tile) % PLAYER_NUM));
+            }
+            break;
     }
 }
 
@@ -355,6 +388,12 @@ void deactivate_color_for_tile(window_context *wc, TILE tile) {
             break;
         case EXPLOSION:
             break;
+        default:
+            // The players after the fourth take the colors of the first ones again
+            if (get_player_id(tile) != -1) {
+                wattroff(wc->win, COLOR_PAIR(4 + get_player_id(tile) % PLAYER_NUM));
+            }
+            break;
     }
 }
 
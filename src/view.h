@@ -14,12 +14,12 @@ int init_view();
 void end_view();
 
 /**
- * Replaces the values pointed by the arguments with the computed board dimension
+ * Replaces the values pointed by the arguments with the computed board dimension for a board of the given dimension
  * Does nothing if the pointer is NULL
  */
-void get_computed_board_dimension(dimension *);
+void get_computed_board_dimension(dimension *, dimension);
 
-/** Updates terminal display with board data
+/** Updates terminal display with board data, laying out the windows again when the dimension of the board changes
  */
 void refresh_game(GAME_MODE, board *, chat *, int);
 
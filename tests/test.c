@@ -1,8 +1,12 @@
 #include "test.h"
 
-#define TEST_NUM 4
+#define TEST_NUM 20
 
-test tests[TEST_NUM] = {serialization_connection, serialization_game, serialization_chat, game_table};
+test tests[TEST_NUM] = {serialization_connection, serialization_game,   serialization_chat, game_table,
+                        model,                    match_record,         replay_file_tests,  tcp_output_tests,
+                        tcp_reader_tests,         metrics_tests,        trace_tests,        log_tests,
+                        netem_tests,              interest_tests,       rtt_tests,          dedup_tests,
+                        token_bucket_tests,       match_settings_tests, udp_message_tests,  source_limit_tests};
 
 int main(int argc, char *argv[]) {
     return cinta_main(argc, argv, tests, TEST_NUM);
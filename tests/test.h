@@ -7,5 +7,25 @@ test_info *serialization_connection();
 test_info *serialization_game();
 test_info *serialization_chat();
 test_info *game_table();
+test_info *model();
+test_info *match_record();
+test_info *replay_file_tests();
+test_info *tcp_output_tests();
+test_info *tcp_reader_tests();
+test_info *metrics_tests();
+test_info *trace_tests();
+test_info *log_tests();
+test_info *netem_tests();
+test_info *interest_tests();
+test_info *rtt_tests();
+test_info *dedup_tests();
+test_info *token_bucket_tests();
+test_info *match_settings_tests();
+test_info *udp_message_tests();
+test_info *source_limit_tests();
+
+/** Creates an empty temporary file and returns its path
+ */
+char *create_record_path();
 
 #endif // TEST_H
@@ -0,0 +1,65 @@
+#include "../src/dedup.h"
+#include "test.h"
+
+void test_first_copy_accepted(test_info *);
+void test_late_copy_accepted_once(test_info *);
+void test_too_old_rejected(test_info *);
+void test_wrap_around(test_info *);
+
+#define NUMBER_TESTS 4
+
+#define LIMIT 8192
+
+test_info *dedup_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Only the first copy is accepted", test_first_copy_accepted),
+        QUICK_CASE("Number arriving late is accepted once", test_late_copy_accepted_once),
+        QUICK_CASE("Number older than the window is rejected", test_too_old_rejected),
+        QUICK_CASE("Numbers wrap around the limit", test_wrap_around),
+    };
+
+    return cinta_run_cases("Deduplication tests", cases, NUMBER_TESTS);
+}
+
+void test_first_copy_accepted(test_info *info) {
+    dedup_window window = {0};
+    // Batches of the last 3 numbers
+    for (unsigned latest = 10; latest < 20; latest++) {
+        for (unsigned number = latest - 2; number <= latest; number++) {
+            CINTA_ASSERT(dedup_accept(&window, number, LIMIT) == (latest == 10 || number == latest), info);
+        }
+    }
+}
+
+void test_late_copy_accepted_once(test_info *info) {
+    dedup_window window = {0};
+    CINTA_ASSERT(dedup_accept(&window, 100, LIMIT), info);
+    CINTA_ASSERT(dedup_accept(&window, 103, LIMIT), info);
+    CINTA_ASSERT(dedup_accept(&window, 101, LIMIT), info);
+    CINTA_ASSERT(!dedup_accept(&window, 101, LIMIT), info);
+    CINTA_ASSERT(dedup_accept(&window, 102, LIMIT), info);
+    CINTA_ASSERT(!dedup_accept(&window, 100, LIMIT), info);
+    CINTA_ASSERT(!dedup_accept(&window, 103, LIMIT), info);
+}
+
+void test_too_old_rejected(test_info *info) {
+    dedup_window window = {0};
+    CINTA_ASSERT(dedup_accept(&window, 1000, LIMIT), info);
+    CINTA_ASSERT(!dedup_accept(&window, 1000 - DEDUP_WINDOW_SIZE, LIMIT), info);
+    CINTA_ASSERT(dedup_accept(&window, 1000 - DEDUP_WINDOW_SIZE + 1, LIMIT), info);
+    // A jump forward forgets the numbers seen
+    CINTA_ASSERT(dedup_accept(&window, 2000, LIMIT), info);
+    CINTA_ASSERT(!dedup_accept(&window, 1000, LIMIT), info);
+    CINTA_ASSERT(dedup_accept(&window, 1999, LIMIT), info);
+}
+
+void test_wrap_around(test_info *info) {
+    dedup_window window = {0};
+    CINTA_ASSERT(dedup_accept(&window, LIMIT - 2, LIMIT), info);
+    CINTA_ASSERT(dedup_accept(&window, 1, LIMIT), info);
+    CINTA_ASSERT(dedup_accept(&window, LIMIT - 1, LIMIT), info);
+    CINTA_ASSERT(dedup_accept(&window, 0, LIMIT), info);
+    CINTA_ASSERT(!dedup_accept(&window, LIMIT - 2, LIMIT), info);
+    CINTA_ASSERT(!dedup_accept(&window, 1, LIMIT), info);
+    CINTA_ASSERT(dedup_accept(&window, 2, LIMIT), info);
+}
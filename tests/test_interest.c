@@ -0,0 +1,117 @@
+#include "../src/interest.h"
+#include "test.h"
+
+void test_window_around(test_info *);
+void test_window_clipped(test_info *);
+void test_diffs_filtered(test_info *);
+void test_entered_tiles_added(test_info *);
+void test_diffs_limited(test_info *);
+
+#define NUMBER_TESTS 5
+
+#define WIDTH 20
+#define HEIGHT 10
+
+test_info *interest_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Window is around the center", test_window_around),
+        QUICK_CASE("Window is clipped to the board", test_window_clipped),
+        QUICK_CASE("Diffs outside the window are filtered", test_diffs_filtered),
+        QUICK_CASE("Tiles entering the window are added", test_entered_tiles_added),
+        QUICK_CASE("Diffs are limited", test_diffs_limited),
+    };
+
+    return cinta_run_cases("Area of interest tests", cases, NUMBER_TESTS);
+}
+
+static board *create_numbered_board() {
+    board *b = malloc(sizeof(board));
+    b->dim.width = WIDTH;
+    b->dim.height = HEIGHT;
+    b->grid = malloc(WIDTH * HEIGHT);
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+        b->grid[i] = i % (HORIZONTAL_BORDER + 1);
+    }
+    return b;
+}
+
+void test_window_around(test_info *info) {
+    dimension dim = {WIDTH, HEIGHT};
+    coord center = {10, 5};
+    interest_window window = interest_window_around(center, 2, dim);
+    CINTA_ASSERT_INT(window.x, 8, info);
+    CINTA_ASSERT_INT(window.y, 3, info);
+    CINTA_ASSERT_INT(window.width, 5, info);
+    CINTA_ASSERT_INT(window.height, 5, info);
+
+    CINTA_ASSERT(interest_window_contains(&window, 8, 3), info);
+    CINTA_ASSERT(interest_window_contains(&window, 12, 7), info);
+    CINTA_ASSERT(!interest_window_contains(&window, 13, 7), info);
+    CINTA_ASSERT(!interest_window_contains(&window, 12, 8), info);
+}
+
+void test_window_clipped(test_info *info) {
+    dimension dim = {WIDTH, HEIGHT};
+    coord corner = {0, HEIGHT - 1};
+    interest_window window = interest_window_around(corner, 3, dim);
+    CINTA_ASSERT_INT(window.x, 0, info);
+    CINTA_ASSERT_INT(window.y, HEIGHT - 4, info);
+    CINTA_ASSERT_INT(window.width, 4, info);
+    CINTA_ASSERT_INT(window.height, 4, info);
+
+    interest_window all = interest_window_around(corner, 100, dim);
+    CINTA_ASSERT_INT(all.x, 0, info);
+    CINTA_ASSERT_INT(all.y, 0, info);
+    CINTA_ASSERT_INT(all.width, WIDTH, info);
+    CINTA_ASSERT_INT(all.height, HEIGHT, info);
+}
+
+void test_diffs_filtered(test_info *info) {
+    board *b = create_numbered_board();
+    coord center = {10, 5};
+    interest_window window = interest_window_around(center, 2, b->dim);
+    tile_diff diffs[3] = {{10, 5, PLAYER_1}, {0, 0, BOMB}, {12, 3, EXPLOSION}};
+
+    tile_diff out[3];
+    CINTA_ASSERT_INT(interest_filter_diffs(diffs, 3, b, &window, &window, out, 3), 2, info);
+    CINTA_ASSERT_INT(out[0].x, 10, info);
+    CINTA_ASSERT_INT(out[0].tile, PLAYER_1, info);
+    CINTA_ASSERT_INT(out[1].x, 12, info);
+    CINTA_ASSERT_INT(out[1].tile, EXPLOSION, info);
+
+    free_board(b);
+}
+
+void test_entered_tiles_added(test_info *info) {
+    board *b = create_numbered_board();
+    coord before_center = {10, 5};
+    coord center = {11, 5};
+    interest_window before = interest_window_around(before_center, 2, b->dim);
+    interest_window window = interest_window_around(center, 2, b->dim);
+    tile_diff diffs[2] = {{11, 5, PLAYER_1}, {13, 4, BOMB}}; // The second is in the column entering the window
+
+    tile_diff out[10];
+    unsigned nb = interest_filter_diffs(diffs, 2, b, &before, &window, out, 10);
+    CINTA_ASSERT_INT(nb, 6, info);
+    CINTA_ASSERT_INT(out[0].x, 11, info);
+    for (unsigned i = 1; i < nb; i++) {
+        CINTA_ASSERT_INT(out[i].x, 13, info);
+        CINTA_ASSERT_INT(out[i].y, 2 + i, info);
+        CINTA_ASSERT_INT(out[i].tile, b->grid[out[i].y * WIDTH + 13], info);
+    }
+
+    free_board(b);
+}
+
+void test_diffs_limited(test_info *info) {
+    board *b = create_numbered_board();
+    interest_window before = {0, 0, 1, 1};
+    interest_window all = interest_window_all(b->dim);
+
+    tile_diff out[10];
+    CINTA_ASSERT_INT(interest_filter_diffs(NULL, 0, b, &before, &all, out, 10), 10, info);
+    CINTA_ASSERT_INT(out[0].x, 1, info);
+    CINTA_ASSERT_INT(out[0].y, 0, info);
+
+    free_board(b);
+}
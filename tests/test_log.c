@@ -0,0 +1,106 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/log.h"
+#include "test.h"
+
+void test_messages_printed_by_level(test_info *);
+void test_lower_level_ignored(test_info *);
+void test_rate_limited_thread(test_info *);
+
+#define NUMBER_TESTS 3
+
+test_info *log_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Messages are printed by level", test_messages_printed_by_level),
+        QUICK_CASE("Lower level is ignored", test_lower_level_ignored),
+        QUICK_CASE("Thread logging too much is rate limited", test_rate_limited_thread),
+    };
+
+    return cinta_run_cases("Log tests", cases, NUMBER_TESTS);
+}
+
+/** Prints the waiting messages in out and err, to free
+ */
+static void flush_to(char **out, char **err) {
+    size_t out_size = 0;
+    size_t err_size = 0;
+    FILE *out_file = open_memstream(out, &out_size);
+    FILE *err_file = open_memstream(err, &err_size);
+    log_set_files(out_file, err_file);
+    log_flush();
+    log_set_files(NULL, NULL);
+    fclose(out_file);
+    fclose(err_file);
+}
+
+/** Forgets the messages logged by the previous tests
+ */
+static void discard_messages() {
+    char *out;
+    char *err;
+    flush_to(&out, &err);
+    free(out);
+    free(err);
+}
+
+void test_messages_printed_by_level(test_info *info) {
+    discard_messages();
+    LOG_INFO("Game %d created.", 1);
+    errno = EBADF;
+    LOG_ERRNO("recvfrom");
+    LOG_INFO("Game %d ended.", 1);
+
+    char *out;
+    char *err;
+    flush_to(&out, &err);
+    CINTA_ASSERT_STRING(out, "Game 1 created.\nGame 1 ended.\n", info);
+    CINTA_ASSERT_STRING(err, "recvfrom: Bad file descriptor\n", info);
+    free(out);
+    free(err);
+}
+
+void test_lower_level_ignored(test_info *info) {
+    discard_messages();
+    log_set_level(LOG_LEVEL_WARNING);
+    LOG_INFO("ignored");
+    LOG_WARNING("kept");
+    log_set_level(LOG_LEVEL_INFO);
+
+    char *out;
+    char *err;
+    flush_to(&out, &err);
+    CINTA_ASSERT_STRING(out, "", info);
+    CINTA_ASSERT_STRING(err, "kept\n", info);
+    free(out);
+    free(err);
+}
+
+static void *log_too_much(void *arg) {
+    (void)arg;
+    for (unsigned i = 0; i < LOG_RATE_LIMIT + 10; i++) {
+        LOG_WARNING("storm %u", i);
+    }
+    return NULL;
+}
+
+void test_rate_limited_thread(test_info *info) {
+    discard_messages();
+    pthread_t t;
+    CINTA_ASSERT_INT(pthread_create(&t, NULL, log_too_much, NULL), 0, info);
+    pthread_join(t, NULL);
+
+    char *out;
+    char *err;
+    flush_to(&out, &err);
+    unsigned lines = 0;
+    for (char *c = err; *c != '\0'; c++) {
+        lines += *c == '\n';
+    }
+    CINTA_ASSERT_INT(lines, LOG_RATE_LIMIT + 1, info);
+    CINTA_ASSERT(strncmp(err, "storm 0\n", 8) == 0, info);
+    CINTA_ASSERT(strstr(err, "10 log messages were dropped.\n") != NULL, info);
+    free(out);
+    free(err);
+}
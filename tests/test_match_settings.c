@@ -0,0 +1,88 @@
+#include "../src/match_settings.h"
+#include "test.h"
+
+void test_default_settings(test_info *);
+void test_settings_parsed(test_info *);
+void test_invalid_settings_rejected(test_info *);
+void test_board_checked_for_version(test_info *);
+
+#define NUMBER_TESTS 4
+
+test_info *match_settings_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Default settings are the constants", test_default_settings),
+        QUICK_CASE("Settings are parsed over the previous ones", test_settings_parsed),
+        QUICK_CASE("Invalid settings are rejected", test_invalid_settings_rejected),
+        QUICK_CASE("Board is checked for the version of the protocol", test_board_checked_for_version),
+    };
+
+    return cinta_run_cases("Match settings tests", cases, NUMBER_TESTS);
+}
+
+void test_default_settings(test_info *info) {
+    match_settings settings = match_settings_default();
+    CINTA_ASSERT_INT(settings.tick_rate, DEFAULT_TICK_RATE, info);
+    CINTA_ASSERT_INT(settings.snapshot_ms, DEFAULT_SNAPSHOT_MS, info);
+    CINTA_ASSERT_INT(settings.bomb_lifetime_ms, BOMB_LIFETIME * 1000, info);
+    CINTA_ASSERT_INT(settings.dim.width, GAMEBOARD_WIDTH, info);
+    CINTA_ASSERT_INT(settings.dim.height, GAMEBOARD_HEIGHT, info);
+    CINTA_ASSERT_INT(match_settings_tick_us(&settings), 50000, info);
+    CINTA_ASSERT_INT(match_settings_keyframe_size(&settings),
+                     GAME_BOARD_V2_HEADER_SIZE + (GAMEBOARD_WIDTH - 2) * (GAMEBOARD_HEIGHT - 2), info);
+}
+
+void test_settings_parsed(test_info *info) {
+    match_settings settings = match_settings_default();
+    CINTA_ASSERT_INT(match_settings_parse("tick=30,snapshot=500,bomb=2000,width=41,height=21", &settings),
+                     EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(settings.tick_rate, 30, info);
+    CINTA_ASSERT_INT(settings.snapshot_ms, 500, info);
+    CINTA_ASSERT_INT(settings.bomb_lifetime_ms, 2000, info);
+    CINTA_ASSERT_INT(settings.dim.width, 41, info);
+    CINTA_ASSERT_INT(settings.dim.height, 21, info);
+    CINTA_ASSERT_INT(match_settings_tick_us(&settings), 33333, info);
+
+    // The missing fields keep their value
+    CINTA_ASSERT_INT(match_settings_parse("tick=10", &settings), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(settings.tick_rate, 10, info);
+    CINTA_ASSERT_INT(settings.snapshot_ms, 500, info);
+    CINTA_ASSERT_INT(settings.dim.width, 41, info);
+}
+
+void test_invalid_settings_rejected(test_info *info) {
+    match_settings settings = match_settings_default();
+    CINTA_ASSERT_INT(match_settings_parse("tick=0", &settings), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(match_settings_parse("tick=101", &settings), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(match_settings_parse("snapshot=50", &settings), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(match_settings_parse("width=9", &settings), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(match_settings_parse("rate=30", &settings), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(match_settings_parse("tick", &settings), EXIT_FAILURE, info);
+
+    // Nothing is changed by settings rejected after a valid field
+    CINTA_ASSERT_INT(match_settings_parse("tick=30,bomb=10ms", &settings), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(settings.tick_rate, DEFAULT_TICK_RATE, info);
+}
+
+void test_board_checked_for_version(test_info *info) {
+    match_settings settings = match_settings_default();
+    CINTA_ASSERT_INT(match_settings_check(&settings, PROTOCOL_V1, PLAYER_NUM), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(match_settings_check(&settings, PROTOCOL_V2, MAX_PLAYER_NUM), EXIT_SUCCESS, info);
+
+    // The first version sends each side of the board without its borders in a byte
+    settings.dim.width = MAX_V1_GAMEBOARD_SIDE;
+    CINTA_ASSERT_INT(match_settings_check(&settings, PROTOCOL_V1, PLAYER_NUM), EXIT_SUCCESS, info);
+    settings.dim.width = MAX_V1_GAMEBOARD_SIDE + 1;
+    CINTA_ASSERT_INT(match_settings_check(&settings, PROTOCOL_V1, PLAYER_NUM), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(match_settings_check(&settings, PROTOCOL_V2, MAX_PLAYER_NUM), EXIT_SUCCESS, info);
+
+    // The second version sends the whole board in a datagram
+    settings.dim.width = 300;
+    settings.dim.height = 300;
+    CINTA_ASSERT_INT(match_settings_check(&settings, PROTOCOL_V2, MAX_PLAYER_NUM), EXIT_FAILURE, info);
+
+    // More than PLAYER_NUM players need a wide board
+    settings.dim.width = MIN_WIDE_GAMEBOARD_WIDTH - 1;
+    settings.dim.height = GAMEBOARD_HEIGHT;
+    CINTA_ASSERT_INT(match_settings_check(&settings, PROTOCOL_V2, PLAYER_NUM), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(match_settings_check(&settings, PROTOCOL_V2, MAX_PLAYER_NUM), EXIT_FAILURE, info);
+}
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../src/metrics.h"
+#include "../src/tcp_output.h"
+#include "test.h"
+
+void test_match_counters_written(test_info *);
+void test_unregistered_match_not_written(test_info *);
+void test_tcp_output_counts_bytes(test_info *);
+void test_interface_counters_written(test_info *);
+void test_player_latency_written(test_info *);
+void test_counter_macros_in_if_else(test_info *);
+
+#define NUMBER_TESTS 6
+
+test_info *metrics_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Match counters are written", test_match_counters_written),
+        QUICK_CASE("Unregistered match is not written", test_unregistered_match_not_written),
+        QUICK_CASE("TCP output counts its bytes", test_tcp_output_counts_bytes),
+        QUICK_CASE("Interface counters are written", test_interface_counters_written),
+        QUICK_CASE("Latency of the players is written", test_player_latency_written),
+        QUICK_CASE("Counter macros are single statements", test_counter_macros_in_if_else),
+    };
+
+    return cinta_run_cases("Metrics tests", cases, NUMBER_TESTS);
+}
+
+/** Returns the metrics in the Prometheus text format, to free
+ */
+static char *write_metrics() {
+    char *text = NULL;
+    size_t size = 0;
+    FILE *file = open_memstream(&text, &size);
+    if (file == NULL) {
+        return NULL;
+    }
+    metrics_write(file);
+    fclose(file);
+    return text;
+}
+
+void test_match_counters_written(test_info *info) {
+    match_metrics *m = metrics_register_match(42);
+    CINTA_ASSERT_NOT_NULL(m, info);
+
+    METRICS_ADD(m, actions_received, 5);
+    METRICS_ADD(m, multicast_bytes, 1306);
+    metrics_add_tick(m, 80);
+    metrics_add_tick(m, 20000);
+
+    char *text = write_metrics();
+    CINTA_ASSERT_NOT_NULL(text, info);
+    CINTA_ASSERT(strstr(text, "bomberman_actions_received_total{game=\"42\"} 5\n") != NULL, info);
+    CINTA_ASSERT(strstr(text, "bomberman_multicast_bytes_total{game=\"42\"} 1306\n") != NULL, info);
+    CINTA_ASSERT(strstr(text, "bomberman_tick_duration_seconds_bucket{game=\"42\",le=\"5e-05\"} 0\n") != NULL, info);
+    CINTA_ASSERT(strstr(text, "bomberman_tick_duration_seconds_bucket{game=\"42\",le=\"0.0001\"} 1\n") != NULL, info);
+    CINTA_ASSERT(strstr(text, "bomberman_tick_duration_seconds_bucket{game=\"42\",le=\"0.01\"} 1\n") != NULL, info);
+    CINTA_ASSERT(strstr(text, "bomberman_tick_duration_seconds_bucket{game=\"42\",le=\"+Inf\"} 2\n") != NULL, info);
+    CINTA_ASSERT(strstr(text, "bomberman_tick_duration_seconds_count{game=\"42\"} 2\n") != NULL, info);
+    CINTA_ASSERT(strstr(text, "# TYPE bomberman_tick_duration_seconds histogram\n") != NULL, info);
+
+    free(text);
+    metrics_unregister_match(m);
+}
+
+void test_unregistered_match_not_written(test_info *info) {
+    match_metrics *m = metrics_register_match(7);
+    CINTA_ASSERT_NOT_NULL(m, info);
+    metrics_unregister_match(m);
+
+    char *text = write_metrics();
+    CINTA_ASSERT_NOT_NULL(text, info);
+    CINTA_ASSERT(strstr(text, "game=\"7\"") == NULL, info);
+    CINTA_ASSERT(strstr(text, "bomberman_active_matches 0\n") != NULL, info);
+    free(text);
+}
+
+void test_tcp_output_counts_bytes(test_info *info) {
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0, info);
+
+    match_metrics *m = metrics_register_match(0);
+    CINTA_ASSERT_NOT_NULL(m, info);
+    tcp_output *out = tcp_output_start(TCP_OUTPUT_MAX_QUEUED, m);
+    CINTA_ASSERT_NOT_NULL(out, info);
+    tcp_output_set_socket(out, 0, socks[0]);
+
+    CINTA_ASSERT_INT(tcp_output_send(out, 0, "abcdef", 6), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(tcp_output_flush(out, 1000), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(atomic_load(&m->tcp_bytes), 6, info);
+    CINTA_ASSERT_INT(atomic_load(&m->tcp_queued_bytes), 0, info);
+
+    tcp_output_stop(out);
+    metrics_unregister_match(m);
+    close(socks[0]);
+    close(socks[1]);
+}
+
+void test_interface_counters_written(test_info *info) {
+    interface_metrics *m = metrics_register_interface("test0");
+    CINTA_ASSERT_NOT_NULL(m, info);
+
+    METRICS_ADD(m, matches, 2);
+    METRICS_SUB(m, matches, 1);
+    METRICS_ADD(m, multicast_packets, 3);
+    METRICS_ADD(m, multicast_bytes, 1500);
+
+    char *text = write_metrics();
+    CINTA_ASSERT_NOT_NULL(text, info);
+    CINTA_ASSERT(strstr(text, "bomberman_interface_matches{interface=\"test0\"} 1\n") != NULL, info);
+    CINTA_ASSERT(strstr(text, "bomberman_interface_multicast_packets_total{interface=\"test0\"} 3\n") != NULL, info);
+    CINTA_ASSERT(strstr(text, "bomberman_interface_multicast_bytes_total{interface=\"test0\"} 1500\n") != NULL, info);
+    free(text);
+}
+
+void test_player_latency_written(test_info *info) {
+    match_metrics *m = metrics_register_match(43);
+    CINTA_ASSERT_NOT_NULL(m, info);
+
+    metrics_set_player_latency(m, 2, 3, 25000, -1500);
+
+    char *text = write_metrics();
+    CINTA_ASSERT_NOT_NULL(text, info);
+    CINTA_ASSERT(strstr(text, "bomberman_player_rtt_seconds{game=\"43\",player=\"2\"} 0.025\n") != NULL, info);
+    CINTA_ASSERT(strstr(text, "bomberman_player_clock_offset_seconds{game=\"43\",player=\"2\"} -0.0015\n") != NULL,
+                 info);
+    // No ping answered yet
+    CINTA_ASSERT(strstr(text, "player=\"0\"") == NULL, info);
+
+    free(text);
+    metrics_unregister_match(m);
+}
+
+void test_counter_macros_in_if_else(test_info *info) {
+    match_metrics *m = metrics_register_match(43);
+    CINTA_ASSERT_NOT_NULL(m, info);
+
+    // Each macro is one statement, the else belongs to the if written here
+    for (int i = 0; i < 2; i++) {
+        if (i == 0)
+            METRICS_ADD(m, actions_received, 3);
+        else
+            METRICS_SUB(m, actions_received, 1);
+    }
+    CINTA_ASSERT_INT(atomic_load(&m->actions_received), 2, info);
+
+    metrics_unregister_match(m);
+}
@@ -0,0 +1,294 @@
+#include "../src/bitboard.h"
+#include "../src/board_view.h"
+#include "../src/model.h"
+#include "test.h"
+
+void test_same_seed_same_board(test_info *);
+void test_different_seed_different_board(test_info *);
+void test_game_seed(test_info *);
+void test_bitboard_row_window(test_info *);
+void test_bomb_blast(test_info *);
+void test_bomb_lifetime(test_info *);
+void test_set_player_dead(test_info *);
+void test_sixteen_players(test_info *);
+void test_teams_of_eight_players(test_info *);
+void test_board_view(test_info *);
+void test_move_diffs(test_info *);
+
+#define NUMBER_TESTS 11
+
+test_info *model() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Same seed gives the same board", test_same_seed_same_board),
+        QUICK_CASE("Different seeds give different boards", test_different_seed_different_board),
+        QUICK_CASE("Game keeps its seed", test_game_seed),
+        QUICK_CASE("Bitboard row window", test_bitboard_row_window),
+        QUICK_CASE("Bomb blast", test_bomb_blast),
+        QUICK_CASE("Bombs explode after the lifetime of their game", test_bomb_lifetime),
+        QUICK_CASE("Dead player leaves the board", test_set_player_dead),
+        QUICK_CASE("Sixteen players start apart", test_sixteen_players),
+        QUICK_CASE("Teams of eight players", test_teams_of_eight_players),
+        QUICK_CASE("Board view", test_board_view),
+        QUICK_CASE("A move gives the diffs of its tiles", test_move_diffs),
+    };
+
+    return cinta_run_cases("Model tests", cases, NUMBER_TESTS);
+}
+
+bool same_board(board *b1, board *b2) {
+    if (b1->dim.width != b2->dim.width || b1->dim.height != b2->dim.height) {
+        return false;
+    }
+    for (int i = 0; i < b1->dim.width * b1->dim.height; i++) {
+        if (b1->grid[i] != b2->grid[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_same_seed_same_board(test_info *info) {
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    for (uint64_t seed = 0; seed < 20; seed++) {
+        int game_1 = init_model_with_seed(dim, SOLO, seed);
+        int game_2 = init_model_with_seed(dim, TEAM, seed);
+
+        board *b1 = get_game_board(game_1);
+        board *b2 = get_game_board(game_2);
+        CINTA_ASSERT(same_board(b1, b2), info);
+
+        free_board(b1);
+        free_board(b2);
+    }
+    reset_games();
+}
+
+void test_different_seed_different_board(test_info *info) {
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    int game_1 = init_model_with_seed(dim, SOLO, 1);
+    int game_2 = init_model_with_seed(dim, SOLO, 2);
+
+    board *b1 = get_game_board(game_1);
+    board *b2 = get_game_board(game_2);
+    CINTA_ASSERT_FALSE(same_board(b1, b2), info);
+
+    free_board(b1);
+    free_board(b2);
+    reset_games();
+}
+
+void test_game_seed(test_info *info) {
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    int game_id = init_model_with_seed(dim, SOLO, 123456789);
+    CINTA_ASSERT(get_game_seed(game_id) == 123456789, info);
+    reset_games();
+}
+
+void test_bitboard_row_window(test_info *info) {
+    board b = {calloc(100 * 3, sizeof(char)), {100, 3}};
+    b.grid[coord_to_int_dim(0, 1, b.dim)] = BOMB;
+    b.grid[coord_to_int_dim(63, 1, b.dim)] = BOMB;
+    b.grid[coord_to_int_dim(64, 1, b.dim)] = BOMB;
+    b.grid[coord_to_int_dim(99, 1, b.dim)] = BOMB;
+
+    bitboard *bb = create_bitboard(&b);
+    CINTA_ASSERT_NOT_NULL(bb, info);
+    CINTA_ASSERT(bitboard_row_window(bb, BOMB, -2, 1) == 0x4, info);
+    CINTA_ASSERT((bitboard_row_window(bb, BOMB, 62, 1) & 0xff) == 0x6, info);
+    CINTA_ASSERT(bitboard_row_window(bb, BOMB, 97, 1) == 0x4, info);
+    CINTA_ASSERT(bitboard_row_window(bb, BOMB, 0, 0) == 0, info);
+    CINTA_ASSERT(bitboard_row_window(bb, BOMB, 0, 3) == 0, info);
+    CINTA_ASSERT(bitboard_row_window(bb, BOMB, 100, 1) == 0, info);
+
+    bitboard_set_tile(bb, 64, 1, BOMB, EMPTY);
+    CINTA_ASSERT((bitboard_row_window(bb, BOMB, 62, 1) & 0xff) == 0x2, info);
+    CINTA_ASSERT(bitboard_row_window(bb, EMPTY, 62, 1) & 0x4, info);
+
+    free_bitboard(bb);
+    free(b.grid);
+}
+
+void test_bomb_blast(test_info *info) {
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    int game_id = init_model_with_seed(dim, SOLO, 1);
+
+    // The player 1 starts at (0, 0)
+    set_grid(1, 0, DESTRUCTIBLE_WALL, game_id);
+    set_grid(2, 0, DESTRUCTIBLE_WALL, game_id);
+    set_grid(0, 1, EMPTY, game_id);
+    set_grid(0, 2, DESTRUCTIBLE_WALL, game_id);
+    set_grid(1, 1, DESTRUCTIBLE_WALL, game_id);
+    set_grid(2, 2, DESTRUCTIBLE_WALL, game_id);
+
+    place_bomb(0, 1000, game_id);
+    CINTA_ASSERT_INT(get_grid(0, 0, game_id), BOMB, info);
+
+    update_bombs(3999, game_id);
+    CINTA_ASSERT_INT(get_grid(0, 0, game_id), BOMB, info);
+    CINTA_ASSERT_FALSE(is_player_dead(0, game_id), info);
+
+    update_bombs(4000, game_id);
+    CINTA_ASSERT_INT(get_grid(0, 0, game_id), EMPTY, info);
+    CINTA_ASSERT_INT(get_grid(1, 0, game_id), EMPTY, info);
+    CINTA_ASSERT_INT(get_grid(2, 0, game_id), DESTRUCTIBLE_WALL, info); // Behind the first wall
+    CINTA_ASSERT_INT(get_grid(0, 2, game_id), EMPTY, info);
+    CINTA_ASSERT_INT(get_grid(1, 1, game_id), EMPTY, info);              // Diagonal
+    CINTA_ASSERT_INT(get_grid(2, 2, game_id), DESTRUCTIBLE_WALL, info); // Out of range
+    CINTA_ASSERT(is_player_dead(0, game_id), info);
+    CINTA_ASSERT_FALSE(is_player_dead(1, game_id), info);
+
+    reset_games();
+}
+
+void test_bomb_lifetime(test_info *info) {
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    int game_id = init_model_with_seed(dim, SOLO, 1);
+    int other_id = init_model_with_seed(dim, SOLO, 1);
+    CINTA_ASSERT_INT(get_bomb_lifetime(game_id), BOMB_LIFETIME * 1000, info);
+
+    set_bomb_lifetime(500, game_id);
+    CINTA_ASSERT_INT(get_bomb_lifetime(game_id), 500, info);
+    place_bomb(0, 1000, game_id);
+    place_bomb(0, 1000, other_id);
+
+    update_bombs(1499, game_id);
+    CINTA_ASSERT_INT(get_grid(0, 0, game_id), BOMB, info);
+    update_bombs(1500, game_id);
+    update_bombs(1500, other_id);
+    CINTA_ASSERT_INT(get_grid(0, 0, game_id), EMPTY, info);
+    CINTA_ASSERT_INT(get_grid(0, 0, other_id), BOMB, info); // The other game keeps the default lifetime
+
+    reset_games();
+}
+
+void test_set_player_dead(test_info *info) {
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    int game_id = init_model_with_seed(dim, SOLO, 1);
+
+    set_grid(1, 0, EMPTY, game_id);
+    set_grid(2, 0, EMPTY, game_id);
+    place_bomb(0, 0, game_id);
+    perform_move(GAME_RIGHT, 0, game_id);
+    CINTA_ASSERT_INT(get_grid(0, 0, game_id), BOMB, info);
+    CINTA_ASSERT_INT(get_grid(1, 0, game_id), PLAYER_1, info);
+
+    set_player_dead(game_id, 0);
+    CINTA_ASSERT(is_player_dead(0, game_id), info);
+    CINTA_ASSERT_INT(get_grid(0, 0, game_id), BOMB, info);
+    CINTA_ASSERT_INT(get_grid(1, 0, game_id), EMPTY, info);
+
+    // A dead player neither moves nor is shown again
+    perform_move(GAME_RIGHT, 0, game_id);
+    CINTA_ASSERT_INT(get_grid(2, 0, game_id), EMPTY, info);
+
+    update_bombs(BOMB_LIFETIME * 1000, game_id);
+    CINTA_ASSERT_INT(get_grid(0, 0, game_id), EMPTY, info);
+
+    reset_games();
+}
+
+void test_sixteen_players(test_info *info) {
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    int game_id = init_model_with_players(dim, SOLO, 1, MAX_PLAYER_NUM);
+    CINTA_ASSERT(game_id >= 0, info);
+    CINTA_ASSERT_INT(get_nb_players(game_id), MAX_PLAYER_NUM, info);
+
+    for (int i = 0; i < MAX_PLAYER_NUM; i++) {
+        coord position = get_player_position(i, game_id);
+        CINTA_ASSERT_INT(get_grid(position.x, position.y, game_id), get_player(i), info);
+        CINTA_ASSERT_INT(get_player_id(get_player(i)), i, info);
+        for (int j = 0; j < i; j++) {
+            coord other = get_player_position(j, game_id);
+            CINTA_ASSERT(position.x != other.x || position.y != other.y, info);
+        }
+    }
+    CINTA_ASSERT_FALSE(is_game_over(game_id), info);
+    for (int i = 1; i < MAX_PLAYER_NUM; i++) {
+        set_player_dead(game_id, i);
+    }
+    CINTA_ASSERT(is_game_over(game_id), info);
+    CINTA_ASSERT_INT(get_winner_solo(game_id), 0, info);
+
+    // Too many players for the board or the protocol
+    dimension narrow = {MIN_WIDE_GAMEBOARD_WIDTH - 1, GAMEBOARD_HEIGHT};
+    CINTA_ASSERT_INT(init_model_with_players(narrow, SOLO, 1, PLAYER_NUM + 1), -1, info);
+    CINTA_ASSERT_INT(init_model_with_players(dim, SOLO, 1, MAX_PLAYER_NUM + 1), -1, info);
+
+    reset_games();
+}
+
+void test_teams_of_eight_players(test_info *info) {
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    int game_id = init_model_with_players(dim, TEAM, 1, MAX_PLAYER_NUM);
+
+    // The first version has the players 0 and 3 against 1 and 2
+    CINTA_ASSERT_INT(get_player_team(0), get_player_team(3), info);
+    CINTA_ASSERT_INT(get_player_team(1), get_player_team(2), info);
+    CINTA_ASSERT(get_player_team(0) != get_player_team(1), info);
+
+    for (int i = 0; i < MAX_PLAYER_NUM; i++) {
+        if (get_player_team(i) == 1) {
+            CINTA_ASSERT_FALSE(is_game_over(game_id), info);
+            set_player_dead(game_id, i);
+        }
+    }
+    CINTA_ASSERT(is_game_over(game_id), info);
+    CINTA_ASSERT_INT(get_winner_team(game_id), 0, info);
+
+    reset_games();
+}
+
+void test_board_view(test_info *info) {
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    int game_id = init_model_with_seed(dim, SOLO, 3);
+    board *b = get_game_board(game_id);
+    CINTA_ASSERT_NOT_NULL(b, info);
+
+    for (int y = 0; y < b->dim.height; y++) {
+        for (int x = 0; x < b->dim.width; x++) {
+            int i = board_index(b, x, y);
+            CINTA_ASSERT_INT(i, coord_to_int(x, y, game_id), info);
+            CINTA_ASSERT_INT(board_coord(b, i).x, x, info);
+            CINTA_ASSERT_INT(board_coord(b, i).y, y, info);
+            CINTA_ASSERT_INT(board_get(b, x, y), get_grid(x, y, game_id), info);
+        }
+    }
+
+    // Nothing goes through the outside of the board, which is never written
+    CINTA_ASSERT(!board_contains(b, -1, 0), info);
+    CINTA_ASSERT(!board_contains(b, 0, b->dim.height), info);
+    CINTA_ASSERT_INT(board_get(b, b->dim.width, 0), INDESTRUCTIBLE_WALL, info);
+    CINTA_ASSERT(!board_set(b, -1, -1, BOMB), info);
+    CINTA_ASSERT(board_set(b, 1, 0, BOMB), info);
+    CINTA_ASSERT_INT(board_get_unchecked(b, 1, 0), BOMB, info);
+
+    free_board(b);
+    reset_games();
+}
+
+void test_move_diffs(test_info *info) {
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    int game_id = init_model_with_seed(dim, SOLO, 3);
+    set_grid(1, 0, EMPTY, game_id);
+
+    // The first player starts in the top left corner
+    player_action action = {0, GAME_RIGHT};
+    unsigned nb = 0;
+    tile_diff *diffs = update_game_board(game_id, &action, 1, 0, &nb);
+    CINTA_ASSERT_NOT_NULL(diffs, info);
+    CINTA_ASSERT_INT(nb, 2, info);
+    CINTA_ASSERT_INT(diffs[0].x, 0, info);
+    CINTA_ASSERT_INT(diffs[0].y, 0, info);
+    CINTA_ASSERT_INT(diffs[0].tile, EMPTY, info);
+    CINTA_ASSERT_INT(diffs[1].x, 1, info);
+    CINTA_ASSERT_INT(diffs[1].y, 0, info);
+    CINTA_ASSERT_INT(diffs[1].tile, PLAYER_1, info);
+    free(diffs);
+
+    // Nothing changed
+    diffs = update_game_board(game_id, NULL, 0, 0, &nb);
+    CINTA_ASSERT_NOT_NULL(diffs, info);
+    CINTA_ASSERT_INT(nb, 0, info);
+    free(diffs);
+    reset_games();
+}
@@ -0,0 +1,261 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../src/netem.h"
+#include "../src/utils.h"
+#include "test.h"
+
+void test_no_link_without_config(test_info *);
+void test_config_parsed(test_info *);
+void test_invalid_config_rejected(test_info *);
+void test_loss_reproducible(test_info *);
+void test_received_duplicated(test_info *);
+void test_sent_delayed(test_info *);
+void test_received_reordered(test_info *);
+void test_sent_to_all(test_info *);
+void test_recv_timeout(test_info *);
+
+#define NUMBER_TESTS 9
+
+#define NB_DATAGRAMS 200
+
+test_info *netem_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("No link is created without configuration", test_no_link_without_config),
+        QUICK_CASE("Configuration is parsed", test_config_parsed),
+        QUICK_CASE("Invalid configuration is rejected", test_invalid_config_rejected),
+        QUICK_CASE("Loss is reproducible from the seed", test_loss_reproducible),
+        QUICK_CASE("Received datagrams are duplicated", test_received_duplicated),
+        QUICK_CASE("Sent datagrams are delayed", test_sent_delayed),
+        QUICK_CASE("Received datagrams are reordered", test_received_reordered),
+        QUICK_CASE("A datagram is sent to every address", test_sent_to_all),
+        QUICK_CASE("Receiving stops after the timeout", test_recv_timeout),
+    };
+
+    return cinta_run_cases("Network impairment tests", cases, NUMBER_TESTS);
+}
+
+static void configure(const char *str) {
+    netem_config config;
+    if (netem_parse_config(str, &config) == EXIT_SUCCESS) {
+        netem_configure(&config);
+    }
+}
+
+/** Sends NB_DATAGRAMS numbered datagrams through a new link, and writes in received which ones arrived, in order.
+ *  Returns how many arrived.
+ */
+static unsigned send_numbered(uint64_t salt, int received[NB_DATAGRAMS]) {
+    int socks[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, socks) < 0) {
+        return 0;
+    }
+    netem_link *link = netem_create_link(salt);
+    for (int i = 0; i < NB_DATAGRAMS; i++) {
+        netem_sendto(link, socks[0], &i, sizeof(int), NULL, 0);
+    }
+    unsigned nb = 0;
+    while (recv(socks[1], &received[nb], sizeof(int), MSG_DONTWAIT) == sizeof(int)) {
+        nb++;
+    }
+    netem_free_link(link);
+    close(socks[0]);
+    close(socks[1]);
+    return nb;
+}
+
+void test_no_link_without_config(test_info *info) {
+    CINTA_ASSERT_NULL(netem_get_config(), info);
+    CINTA_ASSERT_NULL(netem_create_link(0), info);
+}
+
+void test_config_parsed(test_info *info) {
+    netem_config config;
+    CINTA_ASSERT_INT(netem_parse_config("loss=5,duplicate=1.5,reorder=10,delay=30,jitter=10,seed=42", &config),
+                     EXIT_SUCCESS, info);
+    CINTA_ASSERT(config.loss_percent == 5, info);
+    CINTA_ASSERT(config.duplicate_percent == 1.5, info);
+    CINTA_ASSERT(config.reorder_percent == 10, info);
+    CINTA_ASSERT_INT(config.delay_ms, 30, info);
+    CINTA_ASSERT_INT(config.jitter_ms, 10, info);
+    CINTA_ASSERT_INT(config.seed, 42, info);
+
+    CINTA_ASSERT_INT(netem_parse_config("delay=20", &config), EXIT_SUCCESS, info);
+    CINTA_ASSERT(config.loss_percent == 0, info);
+    CINTA_ASSERT_INT(config.delay_ms, 20, info);
+}
+
+void test_invalid_config_rejected(test_info *info) {
+    netem_config config;
+    CINTA_ASSERT_INT(netem_parse_config("loss=101", &config), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(netem_parse_config("loss=-1", &config), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(netem_parse_config("latency=30", &config), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(netem_parse_config("delay", &config), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(netem_parse_config("delay=30ms", &config), EXIT_FAILURE, info);
+}
+
+void test_loss_reproducible(test_info *info) {
+    configure("loss=50,seed=7");
+
+    int first[NB_DATAGRAMS];
+    int second[NB_DATAGRAMS];
+    int other[NB_DATAGRAMS];
+    unsigned nb_first = send_numbered(1, first);
+    unsigned nb_second = send_numbered(1, second);
+    unsigned nb_other = send_numbered(2, other);
+
+    CINTA_ASSERT(nb_first > NB_DATAGRAMS / 4 && nb_first < NB_DATAGRAMS * 3 / 4, info);
+    CINTA_ASSERT_INT(nb_second, nb_first, info);
+    CINTA_ASSERT_INT(memcmp(first, second, nb_first * sizeof(int)), 0, info);
+    // Another salt loses other datagrams
+    CINTA_ASSERT(nb_other != nb_first || memcmp(first, other, nb_first * sizeof(int)) != 0, info);
+}
+
+void test_received_duplicated(test_info *info) {
+    configure("duplicate=100");
+
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_DGRAM, 0, socks), 0, info);
+    netem_link *link = netem_create_link(0);
+    CINTA_ASSERT_NOT_NULL(link, info);
+
+    for (int i = 0; i < 10; i++) {
+        CINTA_ASSERT_INT(send(socks[0], &i, sizeof(int), 0), sizeof(int), info);
+    }
+    for (int i = 0; i < 20; i++) {
+        int value = -1;
+        CINTA_ASSERT_INT(netem_recv(link, socks[1], &value, sizeof(int), -1), sizeof(int), info);
+        CINTA_ASSERT_INT(value, i / 2, info);
+    }
+
+    netem_free_link(link);
+    close(socks[0]);
+    close(socks[1]);
+}
+
+void test_sent_delayed(test_info *info) {
+    configure("delay=30");
+
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_DGRAM, 0, socks), 0, info);
+    netem_link *link = netem_create_link(0);
+    CINTA_ASSERT_NOT_NULL(link, info);
+
+    uint64_t start_ms = get_time_ms();
+    int value = 42;
+    CINTA_ASSERT_INT(netem_sendto(link, socks[0], &value, sizeof(int), NULL, 0), sizeof(int), info);
+    CINTA_ASSERT_INT(recv(socks[1], &value, sizeof(int), MSG_DONTWAIT), -1, info);
+    CINTA_ASSERT_INT(errno, EAGAIN, info);
+
+    struct pollfd p;
+    p.fd = socks[1];
+    p.events = POLLIN;
+    CINTA_ASSERT_INT(poll(&p, 1, 1000), 1, info);
+    CINTA_ASSERT(get_time_ms() - start_ms >= 30, info);
+    value = 0;
+    CINTA_ASSERT_INT(recv(socks[1], &value, sizeof(int), 0), sizeof(int), info);
+    CINTA_ASSERT_INT(value, 42, info);
+
+    netem_free_link(link);
+    close(socks[0]);
+    close(socks[1]);
+}
+
+void test_received_reordered(test_info *info) {
+    configure("reorder=50,seed=3");
+
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_DGRAM, 0, socks), 0, info);
+    netem_link *link = netem_create_link(0);
+    CINTA_ASSERT_NOT_NULL(link, info);
+
+    for (int i = 0; i < 20; i++) {
+        CINTA_ASSERT_INT(send(socks[0], &i, sizeof(int), 0), sizeof(int), info);
+    }
+    bool seen[20] = {false};
+    bool in_order = true;
+    int last = -1;
+    for (int i = 0; i < 20; i++) {
+        int value = -1;
+        CINTA_ASSERT_INT(netem_recv(link, socks[1], &value, sizeof(int), -1), sizeof(int), info);
+        CINTA_ASSERT(value >= 0 && value < 20 && !seen[value], info);
+        seen[value] = true;
+        in_order = in_order && value > last;
+        last = value;
+    }
+    CINTA_ASSERT(!in_order, info);
+
+    netem_free_link(link);
+    close(socks[0]);
+    close(socks[1]);
+}
+
+/** Binds a UDP socket to a port chosen by the system on the loopback, and writes its address in addr
+ */
+static int bind_loopback(struct sockaddr_in6 *addr) {
+    int sock = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    memset(addr, 0, sizeof(struct sockaddr_in6));
+    addr->sin6_family = AF_INET6;
+    addr->sin6_addr = in6addr_loopback;
+    socklen_t len = sizeof(struct sockaddr_in6);
+    if (bind(sock, (struct sockaddr *)addr, len) < 0 || getsockname(sock, (struct sockaddr *)addr, &len) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+void test_sent_to_all(test_info *info) {
+    struct sockaddr_in6 addrs[3];
+    int socks[3];
+    for (int i = 0; i < 3; i++) {
+        socks[i] = bind_loopback(&addrs[i]);
+        CINTA_ASSERT(socks[i] >= 0, info);
+    }
+    int sender = socket(AF_INET6, SOCK_DGRAM, 0);
+    CINTA_ASSERT(sender >= 0, info);
+
+    int value = 42;
+    CINTA_ASSERT_INT(netem_sendto_all(NULL, sender, &value, sizeof(int), addrs, 3), 3, info);
+    for (int i = 0; i < 3; i++) {
+        value = 0;
+        CINTA_ASSERT_INT(netem_recv(NULL, socks[i], &value, sizeof(int), 1000), sizeof(int), info);
+        CINTA_ASSERT_INT(value, 42, info);
+        close(socks[i]);
+    }
+    close(sender);
+}
+
+void test_recv_timeout(test_info *info) {
+    configure("delay=200");
+
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_DGRAM, 0, socks), 0, info);
+    netem_link *link = netem_create_link(0);
+    CINTA_ASSERT_NOT_NULL(link, info);
+
+    int value = 42;
+    CINTA_ASSERT_INT(netem_recv(NULL, socks[1], &value, sizeof(int), 10), -1, info);
+    CINTA_ASSERT_INT(errno, EAGAIN, info);
+
+    // Arrived but still delayed in the link
+    CINTA_ASSERT_INT(send(socks[0], &value, sizeof(int), 0), sizeof(int), info);
+    uint64_t start_ms = get_time_ms();
+    CINTA_ASSERT_INT(netem_recv(link, socks[1], &value, sizeof(int), 20), -1, info);
+    CINTA_ASSERT_INT(errno, EAGAIN, info);
+    CINTA_ASSERT(get_time_ms() - start_ms < 200, info);
+    CINTA_ASSERT_INT(netem_recv(link, socks[1], &value, sizeof(int), -1), sizeof(int), info);
+    CINTA_ASSERT_INT(value, 42, info);
+
+    netem_free_link(link);
+    close(socks[0]);
+    close(socks[1]);
+}
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../src/model.h"
+#include "../src/prng.h"
+#include "../src/recorder.h"
+#include "test.h"
+
+void test_record_header(test_info *);
+void test_replay_gives_same_game(test_info *);
+void test_invalid_record(test_info *);
+
+#define NUMBER_TESTS 3
+
+test_info *match_record() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Record header", test_record_header),
+        QUICK_CASE("Replaying a record gives the same game", test_replay_gives_same_game),
+        QUICK_CASE("Invalid record", test_invalid_record),
+    };
+
+    return cinta_run_cases("Record tests", cases, NUMBER_TESTS);
+}
+
+char *create_record_path() {
+    char *path = malloc(32);
+    strcpy(path, "/tmp/bomberman_record_XXXXXX");
+    int fd = mkstemp(path);
+    close(fd);
+    return path;
+}
+
+void test_record_header(test_info *info) {
+    char *path = create_record_path();
+    record_header header = {TEAM, {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT}, 0xDEADBEEFCAFEULL, 12, 1500};
+
+    recorder *r = recorder_open(path, &header, 0);
+    CINTA_ASSERT_NOT_NULL(r, info);
+    recorder_close(r);
+
+    record_header read_header;
+    record_reader *reader = record_reader_open(path, &read_header);
+    CINTA_ASSERT_NOT_NULL(reader, info);
+    CINTA_ASSERT_INT(read_header.game_mode, TEAM, info);
+    CINTA_ASSERT_INT(read_header.dim.width, GAMEBOARD_WIDTH, info);
+    CINTA_ASSERT_INT(read_header.dim.height, GAMEBOARD_HEIGHT, info);
+    CINTA_ASSERT(read_header.seed == 0xDEADBEEFCAFEULL, info);
+    CINTA_ASSERT_INT(read_header.nb_players, 12, info);
+    CINTA_ASSERT_INT(read_header.bomb_lifetime_ms, 1500, info);
+
+    record rec;
+    CINTA_ASSERT_INT(record_reader_next(reader, &rec), EXIT_FAILURE, info);
+
+    record_reader_close(reader);
+    unlink(path);
+    free(path);
+}
+
+unsigned hash_diffs(unsigned h, tile_diff *diffs, unsigned size) {
+    for (unsigned i = 0; i < size; i++) {
+        h = h * 31 + diffs[i].x;
+        h = h * 31 + diffs[i].y;
+        h = h * 31 + diffs[i].tile;
+    }
+    return h;
+}
+
+void test_replay_gives_same_game(test_info *info) {
+    char *path = create_record_path();
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    record_header header = {SOLO, dim, 42, PLAYER_NUM, BOMB_LIFETIME * 1000};
+    uint64_t start_ms = 100000;
+
+    recorder *r = recorder_open(path, &header, start_ms);
+    int game_id = init_model_with_seed(dim, SOLO, 42);
+
+    prng script;
+    prng_seed(&script, 7);
+
+    unsigned hash = 0;
+    uint64_t now_ms = start_ms;
+    for (int t = 0; t < 500; t++) {
+        now_ms += 50;
+
+        player_action actions[PLAYER_NUM];
+        unsigned nb_actions = 0;
+        for (int id = 0; id < PLAYER_NUM; id++) {
+            if (prng_range(&script, 2) == 0) {
+                actions[nb_actions].id = id;
+                actions[nb_actions].action = prng_range(&script, GAME_PLACE_BOMB + 1);
+                nb_actions++;
+            }
+        }
+
+        record_tick(r, now_ms, actions, nb_actions);
+        unsigned size_tile_diff = 0;
+        tile_diff *diffs = update_game_board(game_id, actions, nb_actions, now_ms, &size_tile_diff);
+        hash = hash_diffs(hash, diffs, size_tile_diff);
+        free(diffs);
+
+        if (t % 20 == 0) {
+            record_bombs(r, now_ms);
+            update_bombs(now_ms, game_id);
+        }
+        if (t == 300) {
+            record_player_dead(r, now_ms, 2);
+            set_player_dead(game_id, 2);
+        }
+    }
+    recorder_close(r);
+
+    record_header read_header;
+    record_reader *reader = record_reader_open(path, &read_header);
+    int replay_id = init_model_with_seed(read_header.dim, read_header.game_mode, read_header.seed);
+
+    unsigned replay_hash = 0;
+    record rec;
+    while (record_reader_next(reader, &rec) == EXIT_SUCCESS) {
+        unsigned size_tile_diff = 0;
+        tile_diff *diffs = apply_record(replay_id, &rec, &size_tile_diff);
+        replay_hash = hash_diffs(replay_hash, diffs, size_tile_diff);
+        free(diffs);
+    }
+    record_reader_close(reader);
+
+    CINTA_ASSERT(hash == replay_hash, info);
+
+    board *expected = get_game_board(game_id);
+    board *replayed = get_game_board(replay_id);
+    CINTA_ASSERT(memcmp(expected->grid, replayed->grid, expected->dim.width * expected->dim.height) == 0, info);
+    CINTA_ASSERT(is_player_dead(2, replay_id), info);
+
+    free_board(expected);
+    free_board(replayed);
+    reset_games();
+    unlink(path);
+    free(path);
+}
+
+void test_invalid_record(test_info *info) {
+    char *path = create_record_path();
+    FILE *f = fopen(path, "wb");
+    fputs("not a record at all", f);
+    fclose(f);
+
+    record_header header;
+    CINTA_ASSERT_NULL(record_reader_open(path, &header), info);
+
+    unlink(path);
+    free(path);
+}
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/model.h"
+#include "../src/prng.h"
+#include "../src/replay_file.h"
+#include "test.h"
+
+void test_board_at_every_tick(test_info *);
+void test_invalid_replay_file(test_info *);
+
+#define NUMBER_TESTS 2
+#define NB_STEPS 500
+
+test_info *replay_file_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Board at every tick of a replay file", test_board_at_every_tick),
+        QUICK_CASE("Invalid replay file", test_invalid_replay_file),
+    };
+
+    return cinta_run_cases("Replay file tests", cases, NUMBER_TESTS);
+}
+
+/** Plays a scripted game and writes it to path, boards gets the board after each tick and the number of ticks is
+ *  returned
+ */
+unsigned write_scripted_replay(const char *path, board **boards) {
+    dimension dim = {GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT};
+    record_header header = {SOLO, dim, 42, PLAYER_NUM, BOMB_LIFETIME * 1000};
+    int game_id = init_model_with_seed(dim, SOLO, 42);
+
+    boards[0] = get_game_board(game_id);
+    replay_writer *w = replay_writer_open(path, &header, boards[0]);
+
+    prng script;
+    prng_seed(&script, 11);
+
+    unsigned nb_ticks = 0;
+    for (int t = 1; t <= NB_STEPS; t++) {
+        player_action actions[PLAYER_NUM];
+        unsigned nb_actions = 0;
+        for (int id = 0; id < PLAYER_NUM; id++) {
+            if (prng_range(&script, 2) == 0) {
+                actions[nb_actions].id = id;
+                actions[nb_actions].action = prng_range(&script, GAME_PLACE_BOMB + 1);
+                nb_actions++;
+            }
+        }
+
+        unsigned size_tile_diff = 0;
+        tile_diff *diffs = update_game_board(game_id, actions, nb_actions, t * 50, &size_tile_diff);
+        if (size_tile_diff > 0) {
+            nb_ticks++;
+            boards[nb_ticks] = get_game_board(game_id);
+            replay_writer_add_update(w, t * 50, diffs, size_tile_diff, boards[nb_ticks]);
+        }
+        free(diffs);
+    }
+    replay_writer_close(w);
+    reset_games();
+    return nb_ticks;
+}
+
+void test_board_at_every_tick(test_info *info) {
+    char *path = create_record_path();
+    board *boards[NB_STEPS + 1];
+    unsigned nb_ticks = write_scripted_replay(path, boards);
+
+    replay_file *f = replay_file_open(path);
+    CINTA_ASSERT_NOT_NULL(f, info);
+    CINTA_ASSERT_INT(f->nb_ticks, nb_ticks, info);
+    CINTA_ASSERT_INT(f->nb_keyframes, nb_ticks / REPLAY_KEYFRAME_INTERVAL + 1, info);
+    CINTA_ASSERT_INT(f->header.seed, 42, info);
+
+    for (unsigned tick = 0; tick <= nb_ticks; tick++) {
+        uint32_t time_ms = 0;
+        board *b = replay_file_board_at(f, tick, &time_ms);
+        CINTA_ASSERT_NOT_NULL(b, info);
+        CINTA_ASSERT_INT(b->dim.width, boards[tick]->dim.width, info);
+        CINTA_ASSERT_INT(b->dim.height, boards[tick]->dim.height, info);
+        CINTA_ASSERT(memcmp(b->grid, boards[tick]->grid, b->dim.width * b->dim.height) == 0, info);
+        free_board(b);
+    }
+
+    uint32_t time_ms = 0;
+    CINTA_ASSERT_NULL(replay_file_board_at(f, nb_ticks + 1, &time_ms), info);
+
+    replay_file_close(f);
+    for (unsigned tick = 0; tick <= nb_ticks; tick++) {
+        free_board(boards[tick]);
+    }
+    unlink(path);
+    free(path);
+}
+
+void test_invalid_replay_file(test_info *info) {
+    char *path = create_record_path();
+    board *boards[NB_STEPS + 1];
+    unsigned nb_ticks = write_scripted_replay(path, boards);
+    for (unsigned tick = 0; tick <= nb_ticks; tick++) {
+        free_board(boards[tick]);
+    }
+
+    // Without its last byte, the trailer is not found anymore
+    FILE *file = fopen(path, "rb+");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    CINTA_ASSERT_INT(truncate(path, size - 1), 0, info);
+    CINTA_ASSERT_NULL(replay_file_open(path), info);
+
+    // A record is not a replay file
+    file = fopen(path, "wb");
+    fputs("BMRC not a replay file at all", file);
+    fclose(file);
+    CINTA_ASSERT_NULL(replay_file_open(path), info);
+
+    unlink(path);
+    free(path);
+}
@@ -0,0 +1,61 @@
+#include <stdlib.h>
+
+#include "../src/rtt.h"
+#include "test.h"
+
+void test_first_sample(test_info *);
+void test_answer_time_excluded(test_info *);
+void test_samples_smoothed(test_info *);
+void test_incoherent_sample_rejected(test_info *);
+
+#define NUMBER_TESTS 4
+
+test_info *rtt_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("First sample is taken as is", test_first_sample),
+        QUICK_CASE("Time taken to answer is not in the round trip", test_answer_time_excluded),
+        QUICK_CASE("Samples are smoothed", test_samples_smoothed),
+        QUICK_CASE("Incoherent sample is rejected", test_incoherent_sample_rejected),
+    };
+
+    return cinta_run_cases("Round-trip time tests", cases, NUMBER_TESTS);
+}
+
+void test_first_sample(test_info *info) {
+    rtt_estimator rtt = {0};
+    // 10ms each way, the clock of the peer is 500ms ahead
+    CINTA_ASSERT_INT(rtt_add_sample(&rtt, 1000000, 1510000, 1510000, 1020000), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(rtt.samples, 1, info);
+    CINTA_ASSERT_INT(rtt.srtt_us, 20000, info);
+    CINTA_ASSERT_INT(rtt.rttvar_us, 10000, info);
+    CINTA_ASSERT_INT(rtt.offset_us, 500000, info);
+}
+
+void test_answer_time_excluded(test_info *info) {
+    rtt_estimator rtt = {0};
+    // Answered 30ms after the ping arrived, the clock of the peer is 200ms behind
+    CINTA_ASSERT_INT(rtt_add_sample(&rtt, 1000000, 805000, 835000, 1040000), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(rtt.srtt_us, 10000, info);
+    CINTA_ASSERT_INT(rtt.offset_us, -200000, info);
+}
+
+void test_samples_smoothed(test_info *info) {
+    rtt_estimator rtt = {0};
+    CINTA_ASSERT_INT(rtt_add_sample(&rtt, 0, 0, 0, 8000), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(rtt_add_sample(&rtt, 0, 0, 0, 16000), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(rtt.samples, 2, info);
+    CINTA_ASSERT_INT(rtt.srtt_us, 9000, info);
+    CINTA_ASSERT_INT(rtt.rttvar_us, 5000, info);
+    CINTA_ASSERT_INT(rtt.offset_us, -4500, info);
+}
+
+void test_incoherent_sample_rejected(test_info *info) {
+    rtt_estimator rtt = {0};
+    // Answered before the ping arrived
+    CINTA_ASSERT_INT(rtt_add_sample(&rtt, 1000, 2000, 1000, 3000), EXIT_FAILURE, info);
+    // Answered after the answer came back
+    CINTA_ASSERT_INT(rtt_add_sample(&rtt, 1000, 1000, 5000, 3000), EXIT_FAILURE, info);
+    // Answer to a ping of a previous connection
+    CINTA_ASSERT_INT(rtt_add_sample(&rtt, 0, 0, 0, RTT_MAX_SAMPLE_US + 1), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(rtt.samples, 0, info);
+}
@@ -152,7 +152,7 @@ void test_team_message_invalid_id(test_info *info) {
     msg->message = "Hello";
     msg->message_length = 5;
     msg->type = TEAM_M;
-    msg->id = 5;
+    msg->id = MAX_PLAYER_NUM;
     msg->eq = 0;
 
     char *serialized = client_serialize_chat_message(msg);
@@ -1,15 +1,18 @@
+#include <arpa/inet.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../src/messages.h"
 #include "test.h"
 
-#define NUMBER_TESTS 16
+#define NUMBER_TESTS 21
 
 void test_initial_connection_solo(test_info *info);
 void test_initial_connection_team(test_info *info);
 void test_initial_connection_invalid_deserialization(test_info *info);
 void test_initial_connection_invalid_serialization(test_info *info);
+void test_initial_connection_second_version(test_info *info);
 
 void test_ready_connection_solo(test_info *info);
 void test_ready_connection_team(test_info *info);
@@ -24,6 +27,11 @@ void test_connection_information_team(test_info *info);
 void test_connection_information_invalid_game_mode(test_info *info);
 void test_connection_information_invalid_team_number(test_info *info);
 void test_connection_information_invalid_id(test_info *info);
+void test_connection_information_second_version(test_info *info);
+
+void test_initial_connection_with_capabilities(test_info *info);
+void test_capabilities(test_info *info);
+void test_capabilities_invalid(test_info *info);
 
 test_info *serialization_connection() {
     test_case cases[NUMBER_TESTS] = {
@@ -31,6 +39,7 @@ test_info *serialization_connection() {
         QUICK_CASE("De/Serializing initial connection in TEAM mode", test_initial_connection_team),
         QUICK_CASE("Deserializing invalid initial connection", test_initial_connection_invalid_deserialization),
         QUICK_CASE("Serializing invalid initial connection", test_initial_connection_invalid_serialization),
+        QUICK_CASE("De/Serializing initial connection of the second version", test_initial_connection_second_version),
         QUICK_CASE("De/Serializing ready connection in SOLO mode", test_ready_connection_solo),
         QUICK_CASE("De/Serializing ready connection in TEAM mode", test_ready_connection_team),
         QUICK_CASE("De/Serializing invalid ready connection with invalid game mode",
@@ -47,7 +56,12 @@ test_info *serialization_connection() {
         QUICK_CASE("De/Serializing invalid connection information with invalid team number",
                    test_connection_information_invalid_team_number),
         QUICK_CASE("De/Serializing invalid connection information with invalid id",
-                   test_connection_information_invalid_id)};
+                   test_connection_information_invalid_id),
+        QUICK_CASE("De/Serializing connection information of the second version",
+                   test_connection_information_second_version),
+        QUICK_CASE("De/Serializing initial connection with capabilities", test_initial_connection_with_capabilities),
+        QUICK_CASE("De/Serializing capabilities", test_capabilities),
+        QUICK_CASE("Deserializing invalid capabilities", test_capabilities_invalid)};
 
     return cinta_run_cases("Serialization tests | Connection", cases, NUMBER_TESTS);
 }
@@ -55,6 +69,8 @@ test_info *serialization_connection() {
 void test_initial_connection_solo(test_info *info) {
     initial_connection_header *header = malloc(sizeof(initial_connection_header));
     header->game_mode = SOLO;
+    header->version = PROTOCOL_V1;
+    header->capabilities = false;
     connection_header_raw *connection = serialize_initial_connection(header);
     initial_connection_header *deserialized = deserialize_initial_connection(connection);
     CINTA_ASSERT(header->game_mode == deserialized->game_mode, info);
@@ -66,6 +82,8 @@ void test_initial_connection_solo(test_info *info) {
 void test_initial_connection_team(test_info *info) {
     initial_connection_header *header = malloc(sizeof(initial_connection_header));
     header->game_mode = TEAM;
+    header->version = PROTOCOL_V1;
+    header->capabilities = false;
     connection_header_raw *connection = serialize_initial_connection(header);
     initial_connection_header *deserialized = deserialize_initial_connection(connection);
     CINTA_ASSERT(header->game_mode == deserialized->game_mode, info);
@@ -86,6 +104,8 @@ void test_initial_connection_invalid_deserialization(test_info *info) {
 void test_initial_connection_invalid_serialization(test_info *info) {
     initial_connection_header *header = malloc(sizeof(initial_connection_header));
     header->game_mode = 3;
+    header->version = PROTOCOL_V1;
+    header->capabilities = false;
     connection_header_raw *connection = serialize_initial_connection(header);
     CINTA_ASSERT_NULL(connection, info);
     free(header);
@@ -160,7 +180,7 @@ void test_ready_connection_invalid_team_number(test_info *info) {
 void test_ready_connection_invalid_id(test_info *info) {
     ready_connection_header *header = malloc(sizeof(ready_connection_header));
     header->game_mode = TEAM;
-    header->id = 4;
+    header->id = MAX_PLAYER_NUM;
     header->eq = 0;
     connection_header_raw *connection = serialize_ready_connection(header);
     CINTA_ASSERT_NULL(connection, info);
@@ -203,6 +223,7 @@ void test_ready_connnection_invalid_eq(test_info *info) {
 
 void test_connection_information(GAME_MODE game_mode, test_info *info, int portudp, int portmdiff, int *adrmdiff) {
     connection_information *header = malloc(sizeof(connection_information));
+    header->version = PROTOCOL_V1;
     header->game_mode = game_mode;
     for (int i = 0; i < 4; i++) {
         header->id = i;
@@ -250,6 +271,7 @@ void test_connection_information_team(test_info *info) {
 
 void test_connection_information_invalid_game_mode(test_info *info) {
     connection_information *header = malloc(sizeof(connection_information));
+    header->version = PROTOCOL_V1;
     header->game_mode = 3;
     header->id = 0;
     header->eq = 0;
@@ -278,6 +300,7 @@ void test_connection_information_invalid_game_mode(test_info *info) {
 
 void test_connection_information_invalid_team_number(test_info *info) {
     connection_information *header = malloc(sizeof(connection_information));
+    header->version = PROTOCOL_V1;
     header->game_mode = TEAM;
     header->id = 0;
     header->eq = 3;
@@ -306,6 +329,7 @@ void test_connection_information_invalid_team_number(test_info *info) {
 
 void test_connection_information_invalid_id(test_info *info) {
     connection_information *header = malloc(sizeof(connection_information));
+    header->version = PROTOCOL_V1;
     header->game_mode = TEAM;
     header->id = 4;
     header->eq = 0;
@@ -331,3 +355,101 @@ void test_connection_information_invalid_id(test_info *info) {
     free(connection2);
     free(deserialized);
 }
+
+void test_initial_connection_second_version(test_info *info) {
+    initial_connection_header header = {TEAM, PROTOCOL_V2, false};
+    connection_header_raw *connection = serialize_initial_connection(&header);
+    CINTA_ASSERT_NOT_NULL(connection, info);
+    // Still in the layout of the first version, which a server of the first version reads
+    CINTA_ASSERT(!(ntohs(connection->req) & PROTOCOL_V2_FLAG), info);
+
+    initial_connection_header *deserialized = deserialize_initial_connection(connection);
+    CINTA_ASSERT_NOT_NULL(deserialized, info);
+    CINTA_ASSERT(deserialized->game_mode == TEAM, info);
+    CINTA_ASSERT_INT(deserialized->version, PROTOCOL_V2, info);
+
+    header.version = 3;
+    CINTA_ASSERT_NULL(serialize_initial_connection(&header), info);
+
+    free(connection);
+    free(deserialized);
+}
+
+void test_connection_information_second_version(test_info *info) {
+    connection_information header = {SOLO, PROTOCOL_V2, 12, 0, 1234, 1235, {0}};
+    connection_information_raw *connection = serialize_connection_information(&header);
+    CINTA_ASSERT_NOT_NULL(connection, info);
+
+    connection_information *deserialized = deserialize_connection_information(connection);
+    CINTA_ASSERT_NOT_NULL(deserialized, info);
+    CINTA_ASSERT_INT(deserialized->version, PROTOCOL_V2, info);
+    CINTA_ASSERT_INT(deserialized->id, 12, info);
+    CINTA_ASSERT_INT(deserialized->portudp, 1234, info);
+    free(connection);
+    free(deserialized);
+
+    // Even the players of the first ids learn the version of their game
+    header.id = 0;
+    connection = serialize_connection_information(&header);
+    deserialized = deserialize_connection_information(connection);
+    CINTA_ASSERT_INT(deserialized->version, PROTOCOL_V2, info);
+    free(connection);
+    free(deserialized);
+
+    header.id = MAX_PLAYER_NUM;
+    CINTA_ASSERT_NULL(serialize_connection_information(&header), info);
+}
+
+void test_initial_connection_with_capabilities(test_info *info) {
+    initial_connection_header header = {SOLO, PROTOCOL_V1, true};
+    connection_header_raw *connection = serialize_initial_connection(&header);
+    CINTA_ASSERT_NOT_NULL(connection, info);
+
+    initial_connection_header *deserialized = deserialize_initial_connection(connection);
+    CINTA_ASSERT_NOT_NULL(deserialized, info);
+    CINTA_ASSERT(deserialized->game_mode == SOLO, info);
+    CINTA_ASSERT_INT(deserialized->version, PROTOCOL_V1, info);
+    CINTA_ASSERT(deserialized->capabilities, info);
+    free(connection);
+    free(deserialized);
+
+    header.capabilities = false;
+    connection = serialize_initial_connection(&header);
+    deserialized = deserialize_initial_connection(connection);
+    CINTA_ASSERT(!deserialized->capabilities, info);
+    free(connection);
+    free(deserialized);
+}
+
+void test_capabilities(test_info *info) {
+    capabilities caps = {CAPABILITY_ACTION_BATCH | CAPABILITY_AREAS | 0x8000, 1400};
+    char *serialized = serialize_capabilities(&caps);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+    CINTA_ASSERT_INT(message_frame_length(serialized, 2), CAPABILITIES_SIZE, info);
+
+    capabilities deserialized;
+    CINTA_ASSERT_INT(read_capabilities(serialized, CAPABILITIES_SIZE, &deserialized), EXIT_SUCCESS, info);
+    // The unknown capabilities are read, to be ignored by the server
+    CINTA_ASSERT_INT(deserialized.flags, CAPABILITY_ACTION_BATCH | CAPABILITY_AREAS | 0x8000, info);
+    CINTA_ASSERT_INT(deserialized.max_datagram, 1400, info);
+    free(serialized);
+}
+
+void test_capabilities_invalid(test_info *info) {
+    capabilities caps = {CAPABILITY_ACTION_BATCH, MIN_DATAGRAM_SIZE - 1};
+    char *serialized = serialize_capabilities(&caps);
+    capabilities deserialized;
+    CINTA_ASSERT_INT(read_capabilities(serialized, CAPABILITIES_SIZE, &deserialized), EXIT_FAILURE, info);
+
+    caps.max_datagram = MIN_DATAGRAM_SIZE;
+    free(serialized);
+    serialized = serialize_capabilities(&caps);
+    CINTA_ASSERT_INT(read_capabilities(serialized, CAPABILITIES_SIZE - 1, &deserialized), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(read_capabilities(serialized, CAPABILITIES_SIZE, &deserialized), EXIT_SUCCESS, info);
+
+    // Another message
+    uint16_t header = htons(KEYFRAME_REQUEST_CODE << 3);
+    memcpy(serialized, &header, sizeof(uint16_t));
+    CINTA_ASSERT_INT(read_capabilities(serialized, CAPABILITIES_SIZE, &deserialized), EXIT_FAILURE, info);
+    free(serialized);
+}
@@ -1,4 +1,6 @@
+#include <arpa/inet.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../src/messages.h"
 #include "test.h"
@@ -11,18 +13,32 @@ void test_game_action_ignores_eq_on_solo(test_info *info);
 void test_invalid_game_action_eq(test_info *info);
 void test_invalid_game_action_message_number(test_info *info);
 void test_invalid_game_action_action(test_info *info);
+void test_game_action_batch(test_info *info);
+void test_invalid_game_action_batch(test_info *info);
+void test_second_version_game_action(test_info *info);
 
 void test_small_board(test_info *info);
 void test_medium_board(test_info *info);
 void test_big_board(test_info *info);
 void test_invalid_header(test_info *info);
 void test_invalid_board(test_info *info);
+void test_keyframe(test_info *info);
+void test_keyframe_is_not_a_board(test_info *info);
+void test_read_board_in_place(test_info *info);
+void test_board_region(test_info *info);
+void test_ping(test_info *info);
+void test_pong(test_info *info);
+void test_subscription(test_info *info);
+void test_wide_board(test_info *info);
 
 void test_game_board_update_small(test_info *info);
 void test_game_board_update_medium(test_info *info);
 void test_game_board_update_large(test_info *info);
 void test_game_board_update_invalid_header(test_info *info);
 void test_game_board_update_invalid_diff(test_info *info);
+void test_read_game_board_update_in_place(test_info *info);
+void test_wide_game_board_update(test_info *info);
+void test_update_fits_datagram(test_info *info);
 
 void test_game_end_solo(test_info *info);
 void test_game_end_team(test_info *info);
@@ -32,7 +48,7 @@ void test_team_ignore_id(test_info *info);
 void test_invalid_game_end_eq(test_info *info);
 void test_solo_ignores_eq(test_info *info);
 
-#define NUMBER_TESTS 25
+#define NUMBER_TESTS 39
 
 test_info *serialization_game() {
     test_case cases[NUMBER_TESTS] = {
@@ -44,18 +60,32 @@ test_info *serialization_game() {
         QUICK_CASE("Test invalid game action eq", test_invalid_game_action_eq),
         QUICK_CASE("Test invalid game action message number", test_invalid_game_action_message_number),
         QUICK_CASE("Test invalid game action action", test_invalid_game_action_action),
+        QUICK_CASE("Test game action batch", test_game_action_batch),
+        QUICK_CASE("Test invalid game action batch", test_invalid_game_action_batch),
+        QUICK_CASE("Test game action of the second version", test_second_version_game_action),
 
         QUICK_CASE("Test small board", test_small_board),
         QUICK_CASE("Test medium board", test_medium_board),
         QUICK_CASE("Test big board", test_big_board),
         QUICK_CASE("Test invalid header", test_invalid_header),
         QUICK_CASE("Test invalid board", test_invalid_board),
+        QUICK_CASE("Test keyframe", test_keyframe),
+        QUICK_CASE("Test keyframe is not a board", test_keyframe_is_not_a_board),
+        QUICK_CASE("Test read board in place", test_read_board_in_place),
+        QUICK_CASE("Test board region", test_board_region),
+        QUICK_CASE("Test ping", test_ping),
+        QUICK_CASE("Test pong", test_pong),
+        QUICK_CASE("Test subscription", test_subscription),
+        QUICK_CASE("Test wide board", test_wide_board),
 
         QUICK_CASE("Test game board update small", test_game_board_update_small),
         QUICK_CASE("Test game board update medium", test_game_board_update_medium),
         QUICK_CASE("Test game board update large", test_game_board_update_large),
         QUICK_CASE("Test game board update invalid header", test_game_board_update_invalid_header),
         QUICK_CASE("Test game board update invalid diff", test_game_board_update_invalid_diff),
+        QUICK_CASE("Test read game board update in place", test_read_game_board_update_in_place),
+        QUICK_CASE("Test wide game board update", test_wide_game_board_update),
+        QUICK_CASE("Test game board update fits in a datagram", test_update_fits_datagram),
 
         QUICK_CASE("Test game end solo", test_game_end_solo),
         QUICK_CASE("Test game end team", test_game_end_team),
@@ -160,7 +190,7 @@ void test_invalid_game_action_id(test_info *info) {
     game_action *action = malloc(sizeof(game_action));
     action->game_mode = SOLO;
     action->eq = 0;
-    action->id = 4;
+    action->id = MAX_PLAYER_NUM;
     action->message_number = 0;
     action->action = GAME_UP;
 
@@ -229,6 +259,62 @@ void test_board(int height, int width, test_info *info, int seed, int message_nu
     free(deserialized);
 }
 
+void test_game_action_batch(test_info *info) {
+    game_action actions[3] = {
+        {TEAM, 2, 1, 8190, GAME_UP},
+        {TEAM, 2, 1, 8191, GAME_PLACE_BOMB},
+        {TEAM, 2, 1, 0, GAME_LEFT},
+    };
+    char *serialized = serialize_game_action_batch(actions, 3);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+
+    // Each action has the format of a single one
+    game_action *single = deserialize_game_action(serialized + GAME_ACTION_SIZE);
+    CINTA_ASSERT_NOT_NULL(single, info);
+    CINTA_ASSERT_INT(single->message_number, 8191, info);
+    free(single);
+
+    game_action *deserialized[GAME_ACTION_BATCH_MAX];
+    CINTA_ASSERT_INT(deserialize_game_action_batch(serialized, 3 * GAME_ACTION_SIZE, deserialized), 3, info);
+    for (int i = 0; i < 3; i++) {
+        CINTA_ASSERT(deserialized[i]->game_mode == TEAM, info);
+        CINTA_ASSERT_INT(deserialized[i]->id, 2, info);
+        CINTA_ASSERT_INT(deserialized[i]->eq, 1, info);
+        CINTA_ASSERT_INT(deserialized[i]->message_number, actions[i].message_number, info);
+        CINTA_ASSERT_INT(deserialized[i]->action, actions[i].action, info);
+        free(deserialized[i]);
+    }
+    free(serialized);
+}
+
+void test_invalid_game_action_batch(test_info *info) {
+    game_action actions[GAME_ACTION_BATCH_MAX + 1];
+    for (int i = 0; i <= GAME_ACTION_BATCH_MAX; i++) {
+        actions[i] = (game_action){SOLO, 1, 0, i, GAME_DOWN};
+    }
+    CINTA_ASSERT_NULL(serialize_game_action_batch(actions, 0), info);
+    CINTA_ASSERT_NULL(serialize_game_action_batch(actions, GAME_ACTION_BATCH_MAX + 1), info);
+
+    char *serialized = serialize_game_action_batch(actions, GAME_ACTION_BATCH_MAX);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+    game_action *deserialized[GAME_ACTION_BATCH_MAX];
+    CINTA_ASSERT_INT(deserialize_game_action_batch(serialized, GAME_ACTION_SIZE + 1, deserialized), 0, info);
+    CINTA_ASSERT_INT(deserialize_game_action_batch(serialized, 0, deserialized), 0, info);
+    free(serialized);
+
+    // Actions of two players
+    actions[1].id = 2;
+    CINTA_ASSERT_NULL(serialize_game_action_batch(actions, 2), info);
+    char *first = serialize_game_action(&actions[0]);
+    char *second = serialize_game_action(&actions[1]);
+    char batch[2 * GAME_ACTION_SIZE];
+    memcpy(batch, first, GAME_ACTION_SIZE);
+    memcpy(batch + GAME_ACTION_SIZE, second, GAME_ACTION_SIZE);
+    CINTA_ASSERT_INT(deserialize_game_action_batch(batch, 2 * GAME_ACTION_SIZE, deserialized), 0, info);
+    free(first);
+    free(second);
+}
+
 void test_small_board(test_info *info) {
     test_board(1, 1, info, 0, 0);
 }
@@ -268,6 +354,81 @@ void test_invalid_board(test_info *info) {
     free(game_info);
 }
 
+game_board_information *create_random_board(int height, int width, int message_number) {
+    game_board_information *game_info = malloc(sizeof(game_board_information));
+    game_info->num = message_number;
+    game_info->height = height;
+    game_info->width = width;
+    game_info->board = malloc(sizeof(TILE) * height * width);
+    for (int i = 0; i < height * width; i++) {
+        game_info->board[i] = rand() % 9;
+    }
+    return game_info;
+}
+
+void test_keyframe(test_info *info) {
+    srandom(0);
+    game_board_information *game_info = create_random_board(GAMEBOARD_HEIGHT, GAMEBOARD_WIDTH, 65535);
+
+    char *serialized = serialize_game_board_keyframe(game_info);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+    game_board_information *deserialized = deserialize_game_board_keyframe(serialized);
+    CINTA_ASSERT_NOT_NULL(deserialized, info);
+
+    CINTA_ASSERT_INT(ntohs(*(uint16_t *)serialized) >> 3, KEYFRAME_CODE, info);
+    CINTA_ASSERT_INT(game_info->num, deserialized->num, info);
+    CINTA_ASSERT_INT(game_info->height, deserialized->height, info);
+    CINTA_ASSERT_INT(game_info->width, deserialized->width, info);
+    for (int i = 0; i < GAMEBOARD_HEIGHT * GAMEBOARD_WIDTH; i++) {
+        CINTA_ASSERT_INT(game_info->board[i], deserialized->board[i], info);
+    }
+
+    free(serialized);
+    free_game_board_information(game_info);
+    free_game_board_information(deserialized);
+}
+
+void test_keyframe_is_not_a_board(test_info *info) {
+    srandom(0);
+    game_board_information *game_info = create_random_board(10, 10, 0);
+
+    char *keyframe = serialize_game_board_keyframe(game_info);
+    CINTA_ASSERT_NULL(deserialize_game_board(keyframe), info);
+
+    char *board = serialize_game_board(game_info);
+    CINTA_ASSERT_NULL(deserialize_game_board_keyframe(board), info);
+
+    free(keyframe);
+    free(board);
+    free_game_board_information(game_info);
+}
+
+void test_read_board_in_place(test_info *info) {
+    srandom(0);
+    game_board_information *game_info = create_random_board(GAMEBOARD_HEIGHT, GAMEBOARD_WIDTH, 1234);
+    size_t size = GAME_BOARD_HEADER_SIZE + GAMEBOARD_HEIGHT * GAMEBOARD_WIDTH;
+
+    char *serialized = serialize_game_board(game_info);
+    uint16_t num;
+    uint16_t height, width;
+    CINTA_ASSERT_INT(read_game_board(serialized, size, &num, &height, &width), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(num, 1234, info);
+    CINTA_ASSERT_INT(height, GAMEBOARD_HEIGHT, info);
+    CINTA_ASSERT_INT(width, GAMEBOARD_WIDTH, info);
+    for (int i = 0; i < GAMEBOARD_HEIGHT * GAMEBOARD_WIDTH; i++) {
+        CINTA_ASSERT_INT(serialized[GAME_BOARD_HEADER_SIZE + i], game_info->board[i], info);
+    }
+
+    CINTA_ASSERT_INT(read_game_board(serialized, size - 1, &num, &height, &width), EXIT_FAILURE, info);
+
+    char *keyframe = serialize_game_board_keyframe(game_info);
+    CINTA_ASSERT_INT(read_game_board(keyframe, size, &num, &height, &width), EXIT_FAILURE, info);
+
+    free(serialized);
+    free(keyframe);
+    free_game_board_information(game_info);
+}
+
 void test_update(int nb, test_info *info, int seed, int message_number) {
     game_board_update *update = malloc(sizeof(game_board_update));
     update->num = message_number;
@@ -301,6 +462,110 @@ void test_update(int nb, test_info *info, int seed, int message_number) {
     free(deserialized);
 }
 
+void test_board_region(test_info *info) {
+    board b;
+    b.dim.width = GAMEBOARD_WIDTH;
+    b.dim.height = GAMEBOARD_HEIGHT;
+    b.grid = malloc(GAMEBOARD_WIDTH * GAMEBOARD_HEIGHT);
+    for (int i = 0; i < GAMEBOARD_WIDTH * GAMEBOARD_HEIGHT; i++) {
+        b.grid[i] = i % 9;
+    }
+
+    size_t size;
+    char *serialized = serialize_game_board_region(321, &b, 4, 2, 5, 3, &size);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+    CINTA_ASSERT_INT(size, GAME_BOARD_REGION_HEADER_SIZE + 5 * 3, info);
+
+    uint16_t num;
+    uint16_t x, y, width, height;
+    CINTA_ASSERT_INT(read_game_board_region(serialized, size, &num, &x, &y, &width, &height), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(num, 321, info);
+    CINTA_ASSERT_INT(x, 4, info);
+    CINTA_ASSERT_INT(y, 2, info);
+    CINTA_ASSERT_INT(width, 5, info);
+    CINTA_ASSERT_INT(height, 3, info);
+    for (int row = 0; row < 3; row++) {
+        for (int col = 0; col < 5; col++) {
+            CINTA_ASSERT_INT(serialized[GAME_BOARD_REGION_HEADER_SIZE + row * 5 + col],
+                             b.grid[(2 + row) * GAMEBOARD_WIDTH + 4 + col], info);
+        }
+    }
+    CINTA_ASSERT_INT(read_game_board_region(serialized, size - 1, &num, &x, &y, &width, &height), EXIT_FAILURE, info);
+
+    size_t board_size;
+    char *whole = serialize_game_board_region(0, &b, 0, 0, GAMEBOARD_WIDTH, GAMEBOARD_HEIGHT, &board_size);
+    CINTA_ASSERT_NOT_NULL(whole, info);
+    CINTA_ASSERT_NULL(serialize_game_board_region(0, &b, GAMEBOARD_WIDTH - 4, 0, 5, 1, &size), info);
+    CINTA_ASSERT_INT(read_game_board(whole, board_size, &num, &height, &width), EXIT_FAILURE, info);
+
+    free(whole);
+    free(serialized);
+    free(b.grid);
+}
+
+void test_ping(test_info *info) {
+    char *serialized = serialize_ping(1781234567890123);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+
+    uint64_t sent_us = 0;
+    CINTA_ASSERT_INT(read_ping(serialized, PING_SIZE, &sent_us), EXIT_SUCCESS, info);
+    CINTA_ASSERT(sent_us == 1781234567890123, info);
+    CINTA_ASSERT_INT(read_ping(serialized, PING_SIZE - 1, &sent_us), EXIT_FAILURE, info);
+
+    serialized[1] = 12 << 3; // Update
+    CINTA_ASSERT_INT(read_ping(serialized, PING_SIZE, &sent_us), EXIT_FAILURE, info);
+
+    free(serialized);
+}
+
+void test_pong(test_info *info) {
+    pong_message pong = {3, 1, 1000, 1781234567890123, 1781234567890456};
+    char *serialized = serialize_pong(&pong);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+
+    pong_message deserialized;
+    CINTA_ASSERT_INT(read_pong(serialized, PONG_SIZE, &deserialized), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(deserialized.id, 3, info);
+    CINTA_ASSERT_INT(deserialized.eq, 1, info);
+    CINTA_ASSERT(deserialized.ping_sent_us == 1000, info);
+    CINTA_ASSERT(deserialized.ping_received_us == 1781234567890123, info);
+    CINTA_ASSERT(deserialized.sent_us == 1781234567890456, info);
+    CINTA_ASSERT_INT(read_pong(serialized, PONG_SIZE - 1, &deserialized), EXIT_FAILURE, info);
+
+    pong.id = MAX_PLAYER_NUM;
+    CINTA_ASSERT_NULL(serialize_pong(&pong), info);
+
+    free(serialized);
+}
+
+void test_subscription(test_info *info) {
+    subscription_message subscription = {9, 1, 0x0123456789abcdef, true};
+    char *serialized = serialize_subscription(&subscription);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+
+    subscription_message deserialized;
+    CINTA_ASSERT_INT(read_subscription(serialized, UDP_SUBSCRIBE_SIZE, &deserialized), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(deserialized.id, 9, info);
+    CINTA_ASSERT_INT(deserialized.eq, 1, info);
+    CINTA_ASSERT(deserialized.token == 0x0123456789abcdef, info);
+    CINTA_ASSERT(deserialized.unicast, info);
+    // The subscription of the header alone has no token
+    CINTA_ASSERT_INT(read_subscription(serialized, sizeof(uint16_t), &deserialized), EXIT_FAILURE, info);
+
+    char *token = serialize_subscription_token(0x0123456789abcdef);
+    CINTA_ASSERT_NOT_NULL(token, info);
+    uint64_t read_token;
+    CINTA_ASSERT_INT(read_subscription_token(token, SUBSCRIPTION_TOKEN_SIZE, &read_token), EXIT_SUCCESS, info);
+    CINTA_ASSERT(read_token == 0x0123456789abcdef, info);
+    CINTA_ASSERT_INT(message_frame_length(token, SUBSCRIPTION_TOKEN_SIZE), SUBSCRIPTION_TOKEN_SIZE, info);
+
+    subscription.id = MAX_PLAYER_NUM;
+    CINTA_ASSERT_NULL(serialize_subscription(&subscription), info);
+
+    free(token);
+    free(serialized);
+}
+
 void test_game_board_update_small(test_info *info) {
     test_update(1, info, 0, 0);
 }
@@ -343,6 +608,40 @@ void test_game_board_update_invalid_diff(test_info *info) {
     free(update);
 }
 
+void test_read_game_board_update_in_place(test_info *info) {
+    game_board_update *update = malloc(sizeof(game_board_update));
+    update->num = 4321;
+    update->nb = 20;
+    update->diff = malloc(sizeof(tile_diff) * update->nb);
+
+    srandom(0);
+    for (int i = 0; i < update->nb; i++) {
+        update->diff[i].x = rand() % GAMEBOARD_WIDTH;
+        update->diff[i].y = rand() % GAMEBOARD_HEIGHT;
+        update->diff[i].tile = rand() % 9;
+    }
+
+    char *serialized = serialize_game_board_update(update);
+    size_t size = GAME_BOARD_UPDATE_HEADER_SIZE + update->nb * TILE_DIFF_SIZE;
+    uint16_t num;
+    uint16_t nb;
+    CINTA_ASSERT_INT(read_game_board_update(serialized, size, &num, &nb), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(num, 4321, info);
+    CINTA_ASSERT_INT(nb, update->nb, info);
+    for (int i = 0; i < nb; i++) {
+        tile_diff diff = read_game_board_update_diff(serialized, i);
+        CINTA_ASSERT_INT(diff.x, update->diff[i].x, info);
+        CINTA_ASSERT_INT(diff.y, update->diff[i].y, info);
+        CINTA_ASSERT_INT(diff.tile, update->diff[i].tile, info);
+    }
+
+    CINTA_ASSERT_INT(read_game_board_update(serialized, size - 1, &num, &nb), EXIT_FAILURE, info);
+
+    free(serialized);
+    free(update->diff);
+    free(update);
+}
+
 void test_game_end(GAME_MODE game_mode, test_info *info) {
     game_end *end = malloc(sizeof(game_end));
     end->game_mode = game_mode;
@@ -391,7 +690,7 @@ void test_invalid_game_end_game_mode(test_info *info) {
 void test_invalid_game_end_id(test_info *info) {
     game_end *end = malloc(sizeof(game_end));
     end->game_mode = SOLO;
-    end->id = 5;
+    end->id = MAX_PLAYER_NUM;
     end->eq = 0;
 
     char *serialized = serialize_game_end(end);
@@ -409,7 +708,7 @@ void test_team_ignore_id(test_info *info) {
     char *serialized = serialize_game_end(end);
     game_end *deserialized = deserialize_game_end(serialized);
 
-    CINTA_ASSERT_INT(deserialized->id, 1, info);
+    CINTA_ASSERT_INT(deserialized->id, 5, info); // In the layout of the second version
     CINTA_ASSERT(deserialized->game_mode == end->game_mode, info);
 
     free(end);
@@ -445,3 +744,120 @@ void test_solo_ignores_eq(test_info *info) {
     free(deserialized);
     free(serialized);
 }
+
+void test_second_version_game_action(test_info *info) {
+    game_action action = {SOLO, 10, 1, 42, GAME_DOWN};
+    char *serialized = serialize_game_action(&action);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+
+    uint16_t header;
+    memcpy(&header, serialized, sizeof(uint16_t));
+    CINTA_ASSERT(ntohs(header) & PROTOCOL_V2_FLAG, info);
+    CINTA_ASSERT_INT(message_code(header), 5, info);
+
+    game_action *deserialized = deserialize_game_action(serialized);
+    CINTA_ASSERT_NOT_NULL(deserialized, info);
+    CINTA_ASSERT_INT(deserialized->id, 10, info);
+    CINTA_ASSERT_INT(deserialized->message_number, 42, info);
+    CINTA_ASSERT_INT(deserialized->action, GAME_DOWN, info);
+
+    free(deserialized);
+    free(serialized);
+}
+
+void test_wide_board(test_info *info) {
+    // Wider than the layout of the first version, with the tile of the last player
+    int width = 300;
+    int height = 2;
+    TILE *board = malloc(width * height * sizeof(TILE));
+    for (int i = 0; i < width * height; i++) {
+        board[i] = i % 2 == 0 ? EMPTY : PLAYER_16;
+    }
+    game_board_information game_info = {7, height, width, board};
+
+    char *serialized = serialize_game_board(&game_info);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+    CINTA_ASSERT_INT(game_board_size(serialized), GAME_BOARD_V2_HEADER_SIZE + width * height, info);
+
+    uint16_t num, read_height, read_width;
+    CINTA_ASSERT_INT(read_game_board(serialized, game_board_size(serialized), &num, &read_height, &read_width),
+                     EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(num, 7, info);
+    CINTA_ASSERT_INT(read_width, width, info);
+    CINTA_ASSERT_INT(read_height, height, info);
+
+    game_board_information *deserialized = deserialize_game_board(serialized);
+    CINTA_ASSERT_NOT_NULL(deserialized, info);
+    for (int i = 0; i < width * height; i++) {
+        CINTA_ASSERT_INT(deserialized->board[i], board[i], info);
+    }
+
+    // A board which fits keeps the layout of the first version
+    game_info.width = 10;
+    for (int i = 0; i < game_info.width * height; i++) {
+        board[i] = PLAYER_4;
+    }
+    char *narrow = serialize_game_board(&game_info);
+    CINTA_ASSERT_INT(game_board_size(narrow), GAME_BOARD_HEADER_SIZE + 10 * height, info);
+
+    free(narrow);
+    free_game_board_information(deserialized);
+    free(serialized);
+    free(board);
+}
+
+void test_wide_game_board_update(test_info *info) {
+    // More diffs than the layout of the first version holds, out of its coordinates
+    unsigned nb = 300;
+    tile_diff *diffs = malloc(nb * sizeof(tile_diff));
+    for (unsigned i = 0; i < nb; i++) {
+        diffs[i].x = 1000 + i;
+        diffs[i].y = i;
+        diffs[i].tile = i % 2 == 0 ? PLAYER_5 : BOMB;
+    }
+    game_board_update update = {12, nb, diffs};
+
+    char *serialized = serialize_game_board_update(&update);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+    size_t size = game_board_update_size(serialized);
+    CINTA_ASSERT_INT(size, GAME_BOARD_UPDATE_V2_HEADER_SIZE + nb * TILE_DIFF_V2_SIZE, info);
+
+    uint16_t num, read_nb;
+    CINTA_ASSERT_INT(read_game_board_update(serialized, size, &num, &read_nb), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(num, 12, info);
+    CINTA_ASSERT_INT(read_nb, nb, info);
+    CINTA_ASSERT_INT(read_game_board_update(serialized, size - 1, &num, &read_nb), EXIT_FAILURE, info);
+    for (unsigned i = 0; i < nb; i++) {
+        tile_diff diff = read_game_board_update_diff(serialized, i);
+        CINTA_ASSERT_INT(diff.x, diffs[i].x, info);
+        CINTA_ASSERT_INT(diff.y, diffs[i].y, info);
+        CINTA_ASSERT_INT(diff.tile, diffs[i].tile, info);
+    }
+
+    free(serialized);
+    free(diffs);
+}
+
+void test_update_fits_datagram(test_info *info) {
+    CINTA_ASSERT_INT(max_tile_diffs_in(PROTOCOL_V1, MIN_DATAGRAM_SIZE), (MIN_DATAGRAM_SIZE - 5) / 3, info);
+    CINTA_ASSERT_INT(max_tile_diffs_in(PROTOCOL_V2, MIN_DATAGRAM_SIZE), (MIN_DATAGRAM_SIZE - 6) / 5, info);
+    // Bounded by the number of diffs of the layout
+    CINTA_ASSERT_INT(max_tile_diffs_in(PROTOCOL_V1, UINT16_MAX), UINT8_MAX, info);
+    CINTA_ASSERT_INT(max_tile_diffs_in(PROTOCOL_V2, UINT16_MAX), (UINT16_MAX - 6) / 5, info);
+    CINTA_ASSERT_INT(max_tile_diffs_in(PROTOCOL_V2, 4), 0, info);
+
+    // The widest update of the second version fits
+    unsigned nb = max_tile_diffs_in(PROTOCOL_V2, 1000);
+    tile_diff *diffs = malloc(nb * sizeof(tile_diff));
+    for (unsigned i = 0; i < nb; i++) {
+        diffs[i].x = 1000 + i;
+        diffs[i].y = i;
+        diffs[i].tile = PLAYER_16;
+    }
+    game_board_update update = {1, nb, diffs};
+    char *serialized = serialize_game_board_update(&update);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+    CINTA_ASSERT(game_board_update_size(serialized) <= 1000, info);
+    free(serialized);
+    free(diffs);
+}
@@ -0,0 +1,81 @@
+#include <string.h>
+
+#include "../src/source_limit.h"
+#include "test.h"
+
+void test_source_limited(test_info *);
+void test_new_sources_get_no_burst(test_info *);
+void test_limited_source_not_forgotten(test_info *);
+
+#define NUMBER_TESTS 3
+
+test_info *source_limit_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Source is limited to its burst and rate", test_source_limited),
+        QUICK_CASE("New sources get no burst once the buckets are empty", test_new_sources_get_no_burst),
+        QUICK_CASE("Limited source is not forgotten after many others", test_limited_source_not_forgotten),
+    };
+
+    return cinta_run_cases("Source limit tests", cases, NUMBER_TESTS);
+}
+
+/** Returns the source number n, from its own address and port
+ */
+static struct sockaddr_in6 source(unsigned n) {
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(struct sockaddr_in6));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr.s6_addr[0] = 0x20;
+    addr.sin6_addr.s6_addr[1] = 0x01;
+    memcpy(addr.sin6_addr.s6_addr + 12, &n, sizeof(unsigned));
+    addr.sin6_port = htons(1024 + n % 50000);
+    return addr;
+}
+
+/** Returns how many datagrams of the source are let through at now_us
+ */
+static unsigned take_all(source_limits *limits, const struct sockaddr_in6 *from, uint64_t now_us) {
+    unsigned nb = 0;
+    while (nb < 1000 && source_limits_take(limits, from, now_us)) {
+        nb++;
+    }
+    return nb;
+}
+
+void test_source_limited(test_info *info) {
+    source_limits limits;
+    source_limits_init(&limits, 42, 80, 40, 0);
+    struct sockaddr_in6 from = source(1);
+    CINTA_ASSERT_INT(take_all(&limits, &from, 0), 40, info);
+    CINTA_ASSERT_INT(take_all(&limits, &from, 100000), 8, info);
+}
+
+void test_new_sources_get_no_burst(test_info *info) {
+    source_limits limits;
+    source_limits_init(&limits, 42, 80, 40, 0);
+    // Rotating sources take at most the bursts of every bucket, however many they are
+    unsigned taken = 0;
+    for (unsigned n = 0; n < 100 * SOURCE_LIMIT_BUCKETS; n++) {
+        struct sockaddr_in6 from = source(n);
+        taken += take_all(&limits, &from, 0);
+    }
+    CINTA_ASSERT_INT(taken, 40 * SOURCE_LIMIT_BUCKETS, info);
+
+    struct sockaddr_in6 from = source(100 * SOURCE_LIMIT_BUCKETS);
+    CINTA_ASSERT_INT(take_all(&limits, &from, 0), 0, info);
+}
+
+void test_limited_source_not_forgotten(test_info *info) {
+    source_limits limits;
+    source_limits_init(&limits, 42, 80, 40, 0);
+    struct sockaddr_in6 limited = source(1);
+    CINTA_ASSERT_INT(take_all(&limits, &limited, 0), 40, info);
+
+    // A table of the latest sources would forget it and give it a full burst again
+    for (unsigned n = 2; n < 2 + 4 * SOURCE_LIMIT_BUCKETS; n++) {
+        struct sockaddr_in6 from = source(n);
+        source_limits_take(&limits, &from, 0);
+    }
+    CINTA_ASSERT_INT(take_all(&limits, &limited, 0), 0, info);
+    CINTA_ASSERT_INT(take_all(&limits, &limited, 100000), 8, info);
+}
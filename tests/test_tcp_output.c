@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../src/tcp_output.h"
+#include "test.h"
+
+void test_messages_in_order(test_info *);
+void test_slow_client_disconnected(test_info *);
+
+#define NUMBER_TESTS 2
+
+test_info *tcp_output_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Messages are written in order", test_messages_in_order),
+        QUICK_CASE("Slow client is disconnected", test_slow_client_disconnected),
+    };
+
+    return cinta_run_cases("TCP output tests", cases, NUMBER_TESTS);
+}
+
+void test_messages_in_order(test_info *info) {
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0, info);
+
+    tcp_output *out = tcp_output_start(TCP_OUTPUT_MAX_QUEUED, NULL);
+    CINTA_ASSERT_NOT_NULL(out, info);
+    tcp_output_set_socket(out, 0, socks[0]);
+
+    CINTA_ASSERT_INT(tcp_output_send(out, 0, "abc", 3), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(tcp_output_send(out, 0, "defg", 4), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(tcp_output_send(out, 1, "xyz", 3), EXIT_FAILURE, info); // Not connected
+    CINTA_ASSERT_INT(tcp_output_flush(out, 1000), EXIT_SUCCESS, info);
+
+    char buffer[8] = {0};
+    size_t received = 0;
+    while (received < 7) {
+        ssize_t res = recv(socks[1], buffer + received, 7 - received, 0);
+        if (res <= 0) {
+            break;
+        }
+        received += res;
+    }
+    CINTA_ASSERT_INT(received, 7, info);
+    CINTA_ASSERT_STRING(buffer, "abcdefg", info);
+
+    tcp_output_stop(out);
+    close(socks[0]);
+    close(socks[1]);
+}
+
+void test_slow_client_disconnected(test_info *info) {
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0, info);
+
+    tcp_output *out = tcp_output_start(1024, NULL);
+    CINTA_ASSERT_NOT_NULL(out, info);
+    tcp_output_set_socket(out, 2, socks[0]);
+
+    // Nobody reads the other end, the socket buffer then the queue end up full
+    char chunk[512];
+    memset(chunk, 'a', sizeof(chunk));
+    int nb_sent = 0;
+    while (nb_sent < 100000 && tcp_output_send(out, 2, chunk, sizeof(chunk)) == EXIT_SUCCESS) {
+        nb_sent++;
+    }
+    CINTA_ASSERT(nb_sent < 100000, info);
+    CINTA_ASSERT_INT(tcp_output_send(out, 2, chunk, 1), EXIT_FAILURE, info);
+
+    // The connection was shut down after the bytes already written
+    char buffer[4096];
+    ssize_t res;
+    while ((res = recv(socks[1], buffer, sizeof(buffer), 0)) > 0) {
+    }
+    CINTA_ASSERT_INT(res, 0, info);
+
+    tcp_output_stop(out);
+    close(socks[0]);
+    close(socks[1]);
+}
@@ -0,0 +1,243 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../src/communication_client.h"
+#include "../src/messages.h"
+#include "../src/tcp_reader.h"
+#include "test.h"
+
+void test_many_messages_per_fill(test_info *);
+void test_partial_message(test_info *);
+void test_large_message(test_info *);
+void test_unknown_message(test_info *);
+void test_wait_timeout(test_info *);
+void test_capabilities_without_answer(test_info *);
+
+#define NUMBER_TESTS 6
+
+test_info *tcp_reader_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Many messages per fill", test_many_messages_per_fill),
+        QUICK_CASE("Partial message", test_partial_message),
+        QUICK_CASE("Message larger than the buffer", test_large_message),
+        QUICK_CASE("Unknown message", test_unknown_message),
+        QUICK_CASE("Waiting for a message stops after the timeout", test_wait_timeout),
+        QUICK_CASE("Capabilities are none without an answer of the server", test_capabilities_without_answer),
+    };
+
+    return cinta_run_cases("TCP reader tests", cases, NUMBER_TESTS);
+}
+
+/** Serializes a chat message from the client with the given text
+ */
+static char *create_client_chat(const char *text, size_t *size) {
+    chat_message msg = {GLOBAL_M, 1, 0, strlen(text), (char *)text};
+    *size = 3 + msg.message_length;
+    return client_serialize_chat_message(&msg);
+}
+
+void test_many_messages_per_fill(test_info *info) {
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0, info);
+
+    size_t size_hello, size_world;
+    char *hello = create_client_chat("hello", &size_hello);
+    char *world = create_client_chat("world!", &size_world);
+    message_header head = {KEYFRAME_REQUEST_CODE, 1, 0};
+    uint16_t request = serialize_message_header(&head);
+    send(socks[1], hello, size_hello, 0);
+    send(socks[1], &request, sizeof(uint16_t), 0);
+    send(socks[1], world, size_world, 0);
+
+    tcp_reader *reader = create_tcp_reader(socks[0]);
+    CINTA_ASSERT_INT(tcp_reader_fill(reader), size_hello + 2 + size_world, info);
+
+    const char *message;
+    size_t size;
+    CINTA_ASSERT_INT(tcp_reader_next(reader, &message, &size), 1, info);
+    CINTA_ASSERT_INT(size, size_hello, info);
+    chat_message *msg = client_deserialize_chat_message(message);
+    CINTA_ASSERT_STRING(msg->message, "hello", info);
+    free(msg->message);
+    free(msg);
+
+    CINTA_ASSERT_INT(tcp_reader_next(reader, &message, &size), 1, info);
+    CINTA_ASSERT_INT(size, 2, info);
+
+    CINTA_ASSERT_INT(tcp_reader_next(reader, &message, &size), 1, info);
+    msg = client_deserialize_chat_message(message);
+    CINTA_ASSERT_STRING(msg->message, "world!", info);
+    free(msg->message);
+    free(msg);
+
+    CINTA_ASSERT_INT(tcp_reader_next(reader, &message, &size), 0, info);
+
+    // The reader sees the connection closed once everything is read
+    close(socks[1]);
+    CINTA_ASSERT_INT(tcp_reader_wait_next(reader, &message, &size), -1, info);
+
+    free_tcp_reader(reader);
+    free(hello);
+    free(world);
+    close(socks[0]);
+}
+
+void test_partial_message(test_info *info) {
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0, info);
+
+    size_t size_hello;
+    char *hello = create_client_chat("hello", &size_hello);
+    tcp_reader *reader = create_tcp_reader(socks[0]);
+    const char *message;
+    size_t size;
+
+    send(socks[1], hello, 2, 0);
+    CINTA_ASSERT_INT(tcp_reader_fill(reader), 2, info);
+    CINTA_ASSERT_INT(tcp_reader_next(reader, &message, &size), 0, info);
+
+    send(socks[1], hello + 2, 3, 0);
+    CINTA_ASSERT_INT(tcp_reader_fill(reader), 3, info);
+    CINTA_ASSERT_INT(tcp_reader_next(reader, &message, &size), 0, info);
+
+    send(socks[1], hello + 5, size_hello - 5, 0);
+    CINTA_ASSERT_INT(tcp_reader_wait_next(reader, &message, &size), 1, info);
+    CINTA_ASSERT_INT(size, size_hello, info);
+    CINTA_ASSERT(memcmp(message, hello, size_hello) == 0, info);
+
+    free_tcp_reader(reader);
+    free(hello);
+    close(socks[0]);
+    close(socks[1]);
+}
+
+void test_large_message(test_info *info) {
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0, info);
+
+    game_board_information board_info = {42, 200, 200, calloc(200 * 200, sizeof(TILE))};
+    board_info.board[200 * 200 - 1] = BOMB;
+    char *keyframe = serialize_game_board_keyframe(&board_info);
+    size_t keyframe_size = 6 + 200 * 200;
+
+    tcp_reader *reader = create_tcp_reader(socks[0]);
+    size_t sent = 0;
+    const char *message = NULL;
+    size_t size = 0;
+    int res = 0;
+    while (res == 0) {
+        if (sent < keyframe_size) {
+            ssize_t n = send(socks[1], keyframe + sent, keyframe_size - sent, MSG_DONTWAIT);
+            sent += n > 0 ? n : 0;
+        }
+        if (tcp_reader_fill(reader) <= 0) {
+            break;
+        }
+        res = tcp_reader_next(reader, &message, &size);
+    }
+    CINTA_ASSERT_INT(res, 1, info);
+    CINTA_ASSERT_INT(size, keyframe_size, info);
+
+    game_board_information *received = deserialize_game_board_keyframe(message);
+    CINTA_ASSERT_NOT_NULL(received, info);
+    CINTA_ASSERT_INT(received->num, 42, info);
+    CINTA_ASSERT_INT(received->board[200 * 200 - 1], BOMB, info);
+
+    free_game_board_information(received);
+    free_tcp_reader(reader);
+    free(keyframe);
+    free(board_info.board);
+    close(socks[0]);
+    close(socks[1]);
+}
+
+void test_unknown_message(test_info *info) {
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0, info);
+
+    // A board is only sent over multicast
+    message_header head = {11, 0, 0};
+    uint16_t header = serialize_message_header(&head);
+    send(socks[1], &header, sizeof(uint16_t), 0);
+
+    tcp_reader *reader = create_tcp_reader(socks[0]);
+    const char *message;
+    size_t size;
+    CINTA_ASSERT_INT(tcp_reader_wait_next(reader, &message, &size), -1, info);
+
+    free_tcp_reader(reader);
+    close(socks[0]);
+    close(socks[1]);
+}
+
+void test_wait_timeout(test_info *info) {
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0, info);
+    tcp_reader *reader = create_tcp_reader(socks[0]);
+
+    const char *message;
+    size_t size;
+    CINTA_ASSERT_INT(tcp_reader_wait_next_timeout(reader, &message, &size, 10), 0, info);
+
+    // Half a message is not enough
+    message_header head = {KEYFRAME_REQUEST_CODE, 1, 0};
+    uint16_t request = serialize_message_header(&head);
+    send(socks[1], &request, 1, 0);
+    CINTA_ASSERT_INT(tcp_reader_wait_next_timeout(reader, &message, &size, 10), 0, info);
+    send(socks[1], (char *)&request + 1, 1, 0);
+    CINTA_ASSERT_INT(tcp_reader_wait_next_timeout(reader, &message, &size, 10), 1, info);
+    CINTA_ASSERT_INT(size, 2, info);
+
+    // The message given back is taken again
+    tcp_reader_unread(reader, size);
+    CINTA_ASSERT_INT(tcp_reader_next(reader, &message, &size), 1, info);
+    CINTA_ASSERT_INT(size, 2, info);
+
+    close(socks[1]);
+    CINTA_ASSERT_INT(tcp_reader_wait_next_timeout(reader, &message, &size, 10), -1, info);
+
+    free_tcp_reader(reader);
+    close(socks[0]);
+}
+
+void test_capabilities_without_answer(test_info *info) {
+    int socks[2];
+    CINTA_ASSERT_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0, info);
+    tcp_reader *reader = create_tcp_reader(socks[0]);
+
+    // A server which does not know the capabilities sends the messages of the game instead
+    size_t size_hello;
+    char *hello = create_client_chat("hello", &size_hello);
+    send(socks[1], hello, size_hello, 0);
+    capabilities caps = {CAPABILITY_ACTION_BATCH, UINT16_MAX};
+    uint64_t token = 1;
+    CINTA_ASSERT_INT(recv_capabilities(reader, &caps, &token), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(caps.flags, 0, info);
+    CINTA_ASSERT(token == 0, info);
+
+    const char *message;
+    size_t size;
+    CINTA_ASSERT_INT(tcp_reader_next(reader, &message, &size), 1, info);
+    CINTA_ASSERT_INT(size, size_hello, info);
+    CINTA_ASSERT_INT(memcmp(message, hello, size_hello), 0, info);
+
+    // A server which knows them answers, with the token of the subscriptions
+    capabilities chosen = {CAPABILITY_AREAS, 1000};
+    char *answer = serialize_capabilities(&chosen);
+    send(socks[1], answer, CAPABILITIES_SIZE, 0);
+    char *answer_token = serialize_subscription_token(42);
+    send(socks[1], answer_token, SUBSCRIPTION_TOKEN_SIZE, 0);
+    CINTA_ASSERT_INT(recv_capabilities(reader, &caps, &token), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(caps.flags, CAPABILITY_AREAS, info);
+    CINTA_ASSERT_INT(caps.max_datagram, 1000, info);
+    CINTA_ASSERT(token == 42, info);
+
+    free(answer_token);
+    free(answer);
+    free(hello);
+    free_tcp_reader(reader);
+    close(socks[0]);
+    close(socks[1]);
+}
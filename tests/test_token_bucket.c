@@ -0,0 +1,54 @@
+#include "../src/token_bucket.h"
+#include "test.h"
+
+void test_burst_taken(test_info *);
+void test_tokens_refilled(test_info *);
+void test_refill_capped(test_info *);
+
+#define NUMBER_TESTS 3
+
+test_info *token_bucket_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Burst is taken at once", test_burst_taken),
+        QUICK_CASE("Tokens are refilled at the rate", test_tokens_refilled),
+        QUICK_CASE("Refill is capped to the burst", test_refill_capped),
+    };
+
+    return cinta_run_cases("Token bucket tests", cases, NUMBER_TESTS);
+}
+
+/** Returns how many tokens are taken from the bucket at now_us
+ */
+static unsigned take_all(token_bucket *bucket, uint64_t now_us) {
+    unsigned nb = 0;
+    while (nb < 1000 && token_bucket_take(bucket, now_us)) {
+        nb++;
+    }
+    return nb;
+}
+
+void test_burst_taken(test_info *info) {
+    token_bucket bucket;
+    token_bucket_init(&bucket, 40, 10, 5000);
+    CINTA_ASSERT_INT(take_all(&bucket, 5000), 10, info);
+    // Earlier than the previous call
+    CINTA_ASSERT_INT(take_all(&bucket, 1000), 0, info);
+}
+
+void test_tokens_refilled(test_info *info) {
+    token_bucket bucket;
+    token_bucket_init(&bucket, 40, 10, 0);
+    CINTA_ASSERT_INT(take_all(&bucket, 0), 10, info);
+    // A token every 25ms
+    CINTA_ASSERT_INT(take_all(&bucket, 24999), 0, info);
+    CINTA_ASSERT_INT(take_all(&bucket, 25000), 1, info);
+    CINTA_ASSERT_INT(take_all(&bucket, 125000), 4, info);
+}
+
+void test_refill_capped(test_info *info) {
+    token_bucket bucket;
+    token_bucket_init(&bucket, 40, 10, 0);
+    CINTA_ASSERT_INT(take_all(&bucket, 0), 10, info);
+    CINTA_ASSERT_INT(take_all(&bucket, 3600000000), 10, info);
+    CINTA_ASSERT_INT(take_all(&bucket, 3600100000), 4, info);
+}
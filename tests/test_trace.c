@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/trace.h"
+#include "test.h"
+
+void test_disabled_trace(test_info *);
+void test_events_written(test_info *);
+void test_ring_keeps_last_events(test_info *);
+
+#define NUMBER_TESTS 3
+
+test_info *trace_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Nothing is traced before enabling", test_disabled_trace),
+        QUICK_CASE("Events are written", test_events_written),
+        QUICK_CASE("Ring keeps the last events", test_ring_keeps_last_events),
+    };
+
+    return cinta_run_cases("Trace tests", cases, NUMBER_TESTS);
+}
+
+/** Returns the trace in the trace-event format, to free
+ */
+static char *write_trace() {
+    char *text = NULL;
+    size_t size = 0;
+    FILE *file = open_memstream(&text, &size);
+    if (file == NULL) {
+        return NULL;
+    }
+    trace_write(file);
+    fclose(file);
+    return text;
+}
+
+static unsigned count_occurrences(const char *text, const char *pattern) {
+    unsigned count = 0;
+    for (const char *c = strstr(text, pattern); c != NULL; c = strstr(c + 1, pattern)) {
+        count++;
+    }
+    return count;
+}
+
+void test_disabled_trace(test_info *info) {
+    CINTA_ASSERT_INT(trace_begin(), 0, info);
+    trace_end("disabled", 0, trace_begin());
+
+    char *text = write_trace();
+    CINTA_ASSERT_NOT_NULL(text, info);
+    CINTA_ASSERT(strstr(text, "disabled") == NULL, info);
+    free(text);
+}
+
+void test_events_written(test_info *info) {
+    trace_enable();
+    trace_thread_name("test thread");
+
+    uint64_t start = trace_begin();
+    CINTA_ASSERT(start != 0, info);
+    trace_end("first phase", 3, start);
+    trace_end("second phase", 3, trace_begin());
+
+    char *text = write_trace();
+    CINTA_ASSERT_NOT_NULL(text, info);
+    CINTA_ASSERT(strncmp(text, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 39) == 0, info);
+    CINTA_ASSERT(strstr(text, "\"args\":{\"name\":\"test thread\"}") != NULL, info);
+
+    char *first = strstr(text, "\"name\":\"first phase\",\"cat\":\"game\",\"ph\":\"X\"");
+    char *second = strstr(text, "\"name\":\"second phase\"");
+    CINTA_ASSERT_NOT_NULL(first, info);
+    CINTA_ASSERT_NOT_NULL(second, info);
+    CINTA_ASSERT(first < second, info);
+    CINTA_ASSERT(strstr(text, "\"args\":{\"game\":3}") != NULL, info);
+    CINTA_ASSERT(strcmp(text + strlen(text) - 4, "\n]}\n") == 0, info);
+    free(text);
+}
+
+void test_ring_keeps_last_events(test_info *info) {
+    trace_enable();
+    trace_end("oldest", 0, trace_begin());
+    for (unsigned i = 0; i < TRACE_RING_SIZE; i++) {
+        trace_end("filler", 0, trace_begin());
+    }
+    trace_end("newest", 0, trace_begin());
+
+    char *text = write_trace();
+    CINTA_ASSERT_NOT_NULL(text, info);
+    CINTA_ASSERT(strstr(text, "\"oldest\"") == NULL, info);
+    CINTA_ASSERT(strstr(text, "\"newest\"") != NULL, info);
+    CINTA_ASSERT_INT(count_occurrences(text, "\"ph\":\"X\""), TRACE_RING_SIZE, info);
+    free(text);
+}
@@ -0,0 +1,113 @@
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../src/communication_server.h"
+#include "test.h"
+
+void test_action_of_player_received(test_info *);
+void test_action_of_missing_player_rejected(test_info *);
+void test_wide_action_in_first_version_rejected(test_info *);
+void test_subscription_received_with_token(test_info *);
+
+#define NUMBER_TESTS 4
+
+test_info *udp_message_tests() {
+    test_case cases[NUMBER_TESTS] = {
+        QUICK_CASE("Action of a player of the game is received", test_action_of_player_received),
+        QUICK_CASE("Action of a player the game does not have is rejected", test_action_of_missing_player_rejected),
+        QUICK_CASE("Action of the second version in a game of the first is rejected",
+                   test_wide_action_in_first_version_rejected),
+        QUICK_CASE("Subscription is received with its token", test_subscription_received_with_token),
+    };
+
+    return cinta_run_cases("UDP message tests", cases, NUMBER_TESTS);
+}
+
+/** Sends the datagram of size bytes from a new socket to a new socket bound on the loopback, and receives it as a game
+ *  of nb_players with the version of the protocol would. Returns what recv_udp_message returns.
+ */
+static int send_and_receive(const char *datagram, size_t size, PROTOCOL_VERSION version, unsigned nb_players,
+                            udp_message *message) {
+    int receiver = socket(AF_INET6, SOCK_DGRAM, 0);
+    int sender = socket(AF_INET6, SOCK_DGRAM, 0);
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(struct sockaddr_in6));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_loopback;
+    socklen_t len = sizeof(struct sockaddr_in6);
+    int res = EXIT_FAILURE;
+    if (receiver >= 0 && sender >= 0 && bind(receiver, (struct sockaddr *)&addr, len) == 0 &&
+        getsockname(receiver, (struct sockaddr *)&addr, &len) == 0 &&
+        sendto(sender, datagram, size, 0, (struct sockaddr *)&addr, len) == (ssize_t)size) {
+        res = recv_udp_message(receiver, version, nb_players, message);
+    }
+    close(receiver);
+    close(sender);
+    return res;
+}
+
+static int send_and_receive_action(int id, PROTOCOL_VERSION version, unsigned nb_players, udp_message *message) {
+    game_action action = {SOLO, id, 0, 1, GAME_UP};
+    char *serialized = serialize_game_action(&action);
+    if (serialized == NULL) {
+        return EXIT_FAILURE;
+    }
+    int res = send_and_receive(serialized, GAME_ACTION_SIZE, version, nb_players, message);
+    free(serialized);
+    return res;
+}
+
+static void free_actions(udp_message *message) {
+    for (unsigned i = 0; i < message->nb_actions; i++) {
+        free(message->actions[i]);
+    }
+}
+
+void test_action_of_player_received(test_info *info) {
+    udp_message message;
+    CINTA_ASSERT_INT(send_and_receive_action(3, PROTOCOL_V1, PLAYER_NUM, &message), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(message.type, UDP_GAME_ACTION, info);
+    CINTA_ASSERT_INT(message.id, 3, info);
+    CINTA_ASSERT_INT(message.nb_actions, 1, info);
+    free_actions(&message);
+
+    CINTA_ASSERT_INT(send_and_receive_action(15, PROTOCOL_V2, MAX_PLAYER_NUM, &message), EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(message.id, 15, info);
+    free_actions(&message);
+}
+
+void test_action_of_missing_player_rejected(test_info *info) {
+    udp_message message;
+    CINTA_ASSERT_INT(send_and_receive_action(5, PROTOCOL_V2, 4, &message), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(message.nb_actions, 0, info);
+    CINTA_ASSERT_INT(send_and_receive_action(2, PROTOCOL_V2, 2, &message), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(message.nb_actions, 0, info);
+}
+
+void test_wide_action_in_first_version_rejected(test_info *info) {
+    udp_message message;
+    // The id does not fit in the layout of the first version
+    CINTA_ASSERT_INT(send_and_receive_action(4, PROTOCOL_V1, PLAYER_NUM, &message), EXIT_FAILURE, info);
+    CINTA_ASSERT_INT(message.nb_actions, 0, info);
+}
+
+void test_subscription_received_with_token(test_info *info) {
+    udp_message message;
+    subscription_message subscription = {2, 0, 0x0123456789abcdef, false};
+    char *serialized = serialize_subscription(&subscription);
+    CINTA_ASSERT_NOT_NULL(serialized, info);
+    CINTA_ASSERT_INT(send_and_receive(serialized, UDP_SUBSCRIBE_SIZE, PROTOCOL_V1, PLAYER_NUM, &message),
+                     EXIT_SUCCESS, info);
+    CINTA_ASSERT_INT(message.type, UDP_SUBSCRIPTION, info);
+    CINTA_ASSERT_INT(message.id, 2, info);
+    CINTA_ASSERT(message.subscription.token == 0x0123456789abcdef, info);
+    CINTA_ASSERT(!message.subscription.unicast, info);
+
+    // The header alone, which anyone can send for any player, does not subscribe
+    CINTA_ASSERT_INT(send_and_receive(serialized, sizeof(uint16_t), PROTOCOL_V1, PLAYER_NUM, &message), EXIT_FAILURE,
+                     info);
+    free(serialized);
+}